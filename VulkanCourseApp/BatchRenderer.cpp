@@ -0,0 +1,467 @@
+#include "BatchRenderer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+
+bool BatchRenderer::loadJobList(const std::string& fileName, std::vector<Job>* jobs)
+{
+	std::ifstream file(fileName);
+	if (!file.is_open())
+	{
+		printf("Batch: failed to open the job list '%s'\n", fileName.c_str());
+		return false;
+	}
+
+	std::vector<CameraPath::Key> keys;
+	bool orbit = false;
+	bool loop = false;
+	uint32_t lineNumber = 0;
+
+	auto fail = [&](const std::string& message)
+	{
+		printf("Batch: %s:%u: %s\n", fileName.c_str(), lineNumber, message.c_str());
+		return false;
+	};
+
+	// Settings that depend on the whole job block are resolved when the next job starts or the file ends
+	auto completeJob = [&]()
+	{
+		if (jobs->empty()) return true;
+
+		Job& job = jobs->back();
+		if (job.models.empty())
+		{
+			return fail("job '" + job.name + "' has no model");
+		}
+
+		if (!keys.empty())
+		{
+			job.cameraPath = CameraPath::spline(keys, loop);
+		}
+
+		if (job.output.empty())
+		{
+			job.output = "Batch/" + job.name + (job.format == CaptureWriter::Format::Y4m ? ".y4m" : "");
+		}
+
+		keys.clear();
+		orbit = false;
+		loop = false;
+		return true;
+	};
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+		{
+			line.erase(comment);
+		}
+
+		std::istringstream tokens(line);
+		std::string command;
+		if (!(tokens >> command)) continue; // Empty line
+
+		if (command == "job")
+		{
+			if (!completeJob()) return false;
+
+			Job job;
+			if (!(tokens >> job.name))
+			{
+				return fail("job without a name");
+			}
+			jobs->push_back(job);
+			continue;
+		}
+
+		if (jobs->empty())
+		{
+			return fail("'" + command + "' before the first job");
+		}
+
+		Job& job = jobs->back();
+
+		if (command == "model")
+		{
+			ModelEntry model;
+			if (!(tokens >> model.fileName))
+			{
+				return fail("model without a file");
+			}
+
+			// Optional values, in order: position, scale, turns (a failed read would zero the default)
+			float x, y, z, value;
+			if (tokens >> x)
+			{
+				if (!(tokens >> y >> z))
+				{
+					return fail("model position needs X Y Z");
+				}
+				model.position = glm::vec3(x, y, z);
+
+				if (tokens >> value)
+				{
+					model.scale = value;
+					if (tokens >> value)
+					{
+						model.turns = value;
+					}
+				}
+			}
+			job.models.push_back(model);
+		}
+		else if (command == "orbit")
+		{
+			glm::vec3 target;
+			float radius, height, turns;
+			if (!(tokens >> target.x >> target.y >> target.z >> radius >> height))
+			{
+				return fail("orbit needs X Y Z RADIUS HEIGHT [TURNS]");
+			}
+			if (!(tokens >> turns))
+			{
+				turns = 1.0f;
+			}
+
+			if (!keys.empty())
+			{
+				return fail("a job has either an orbit or spline keys");
+			}
+			job.cameraPath = CameraPath::orbit(target, radius, height, turns);
+			orbit = true;
+		}
+		else if (command == "key")
+		{
+			CameraPath::Key key;
+			if (!(tokens >> key.position.x >> key.position.y >> key.position.z >> key.target.x >> key.target.y >> key.target.z))
+			{
+				return fail("key needs PX PY PZ TX TY TZ");
+			}
+
+			if (orbit)
+			{
+				return fail("a job has either an orbit or spline keys");
+			}
+			keys.push_back(key);
+		}
+		else if (command == "loop")
+		{
+			loop = true;
+		}
+		else if (command == "resolution")
+		{
+			std::string size;
+			tokens >> size;
+			if (sscanf(size.c_str(), "%ux%u", &job.width, &job.height) != 2 || job.width == 0 || job.height == 0)
+			{
+				return fail("invalid resolution '" + size + "' (expected WxH)");
+			}
+		}
+		else if (command == "frames")
+		{
+			int frames = 0;
+			if (!(tokens >> frames) || frames < 1)
+			{
+				return fail("frames needs a count of at least 1");
+			}
+			job.frameCount = (uint32_t)frames;
+		}
+		else if (command == "format")
+		{
+			std::string format;
+			tokens >> format;
+			if (!CaptureWriter::parseFormat(format.c_str(), &job.format))
+			{
+				return fail("unknown format '" + format + "' (expected png, qoi or y4m)");
+			}
+		}
+		else if (command == "output")
+		{
+			if (!(tokens >> job.output))
+			{
+				return fail("output without a path");
+			}
+		}
+		else
+		{
+			return fail("unknown setting '" + command + "'");
+		}
+	}
+
+	if (!completeJob()) return false;
+
+	if (jobs->empty())
+	{
+		printf("Batch: the job list '%s' has no job\n", fileName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+BatchRenderer::BatchRenderer(VulkanRenderer& renderer, std::shared_ptr<WindowLVE> window, std::shared_ptr<Camera> camera,
+	std::vector<Job> jobs, const CaptureWriter::Settings& captureSettings)
+	: m_Renderer(renderer), m_Window{ window }, m_Camera{ camera }, m_CaptureSettings{ captureSettings }
+{
+	for (Job& job : jobs)
+	{
+		auto state = std::make_shared<JobState>();
+		state->job = std::move(job);
+		m_Jobs.push_back(state);
+	}
+
+	// Offline: every frame is kept, a full encoder queue or readback ring slows the rendering down instead
+	m_CaptureSettings.interval = 1;
+	m_CaptureSettings.overflowPolicy = CaptureWriter::OverflowPolicy::Stall;
+
+	m_Delivery = std::make_shared<Delivery>();
+	std::shared_ptr<Delivery> delivery = m_Delivery;
+	m_Renderer.setFrameReadback([delivery](const FrameReadback::Frame& frame) { deliverFrame(*delivery, frame); });
+	m_Renderer.setReadbackInterval(1);
+	m_Renderer.setReadbackWaitWhenFull(true);
+	m_Renderer.setReadbackEnabled(true);
+}
+
+bool BatchRenderer::run()
+{
+	printf("Batch: %zu jobs, %u frames in flight\n", m_Jobs.size(), m_Renderer.getFramesInFlight());
+
+	auto batchStart = std::chrono::steady_clock::now();
+
+	// Called by draw(): the scene is set from the job frame, not from a clock, a skipped draw simply publishes it again
+	m_Renderer.setInputSampler([this]() { publishFrame(); });
+
+	try
+	{
+		for (size_t jobIndex = 0; jobIndex < m_Jobs.size(); jobIndex++)
+		{
+			startJob(jobIndex);
+
+			while (m_Frame < m_Current->job.frameCount)
+			{
+				// Tagged before the draw: the readback of a fast frame may be delivered before draw() returns
+				if (!m_FrameTagged)
+				{
+					std::lock_guard<std::mutex> lock(m_Delivery->mutex);
+					m_Delivery->pending.push_back({ m_Renderer.getRecordingFrame(), m_Current, m_Frame });
+					m_FrameTagged = true;
+				}
+
+				uint64_t renderedFrames = m_Renderer.getRenderedFrameCount();
+				m_Renderer.draw();
+
+				// Skipped (bounded wait timed out, images recreated): the tag is still right for the next attempt
+				if (m_Renderer.getRenderedFrameCount() == renderedFrames) continue;
+
+				m_Current->framesRendered++;
+				m_Frame++;
+				m_FrameTagged = false;
+
+				// Earlier jobs finish writing while this one renders
+				finishWrittenJobs(false);
+			}
+		}
+
+		// The last frames are still in flight or waiting for their readback
+		m_Renderer.flushFrameReadback();
+	}
+	catch (const std::runtime_error& e)
+	{
+		printf("ERROR: %s\n", e.what());
+		m_Renderer.setInputSampler(nullptr);
+		return false;
+	}
+
+	m_Renderer.setInputSampler(nullptr);
+
+	// Everything was delivered, frames still tagged never had a readback
+	{
+		std::lock_guard<std::mutex> lock(m_Delivery->mutex);
+		for (FrameTag& tag : m_Delivery->pending)
+		{
+			tag.job->framesLost++;
+		}
+		m_Delivery->pending.clear();
+	}
+
+	finishWrittenJobs(true);
+
+	printReport(std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count());
+
+	return true;
+}
+
+void BatchRenderer::deliverFrame(Delivery& delivery, const FrameReadback::Frame& frame)
+{
+	std::shared_ptr<JobState> job;
+	std::shared_ptr<CaptureWriter> writer; // Kept alive until submitted, even if the job finishes meanwhile
+	uint32_t frameNumber = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(delivery.mutex);
+
+		// Frames arrive in submission order, tags before this frame had no readback
+		while (!delivery.pending.empty() && delivery.pending.front().timelineFrame < frame.frameIndex)
+		{
+			delivery.pending.front().job->framesLost++;
+			delivery.pending.pop_front();
+		}
+
+		if (delivery.pending.empty() || delivery.pending.front().timelineFrame != frame.frameIndex) return;
+
+		job = delivery.pending.front().job;
+		frameNumber = delivery.pending.front().frameNumber;
+		writer = job->writer;
+		delivery.pending.pop_front();
+	}
+
+	if (writer == nullptr) return;
+
+	if (frame.width != job->job.width || frame.height != job->job.height)
+	{
+		job->framesLost++;
+		return;
+	}
+
+	// Files are numbered by the frame of the job
+	FrameReadback::Frame jobFrame = frame;
+	jobFrame.frameIndex = frameNumber;
+	writer->submit(jobFrame);
+}
+
+void BatchRenderer::startJob(size_t jobIndex)
+{
+	m_Current = m_Jobs[jobIndex];
+	const Job& job = m_Current->job;
+
+	// Headless: the offscreen images are recreated at the next draw
+	m_Window->setExtent(job.width, job.height);
+
+	// Reuse the models of earlier jobs, create only the instances this job has more of
+	std::unordered_map<std::string, size_t> usedPerFile;
+	m_JobModelIds.clear();
+	for (const ModelEntry& model : job.models)
+	{
+		std::vector<int>& ids = m_ModelIds[model.fileName];
+		size_t instance = usedPerFile[model.fileName]++;
+		if (instance == ids.size())
+		{
+			int modelId = m_Renderer.createMeshModel(model.fileName);
+			ids.push_back(modelId);
+			m_AllModelIds.push_back(modelId);
+		}
+		m_JobModelIds.push_back(ids[instance]);
+	}
+
+	CaptureWriter::Settings captureSettings = m_CaptureSettings;
+	captureSettings.format = job.format;
+	captureSettings.path = job.output;
+
+	std::shared_ptr<CaptureWriter> writer = std::make_shared<CaptureWriter>(captureSettings);
+	{
+		std::lock_guard<std::mutex> lock(m_Delivery->mutex);
+		m_Current->writer = writer;
+	}
+
+	m_Current->startTime = std::chrono::steady_clock::now();
+	m_Frame = 0;
+	m_FrameTagged = false;
+
+	printf("Batch: job %zu/%zu '%s', %zu models, %u frames at %ux%u\n", jobIndex + 1, m_Jobs.size(), job.name.c_str(),
+		job.models.size(), job.frameCount, job.width, job.height);
+}
+
+void BatchRenderer::publishFrame()
+{
+	const Job& job = m_Current->job;
+
+	for (int modelId : m_AllModelIds)
+	{
+		m_Renderer.setModelVisible(modelId, false);
+	}
+
+	// Turntable: whole turns over the job end one step before the start, the frames loop
+	float spin = (float)m_Frame / job.frameCount;
+
+	for (size_t i = 0; i < job.models.size(); i++)
+	{
+		const ModelEntry& model = job.models[i];
+
+		glm::mat4 modelMat(1.0f);
+		modelMat = glm::translate(modelMat, model.position);
+		modelMat = glm::rotate(modelMat, glm::radians(360.0f * model.turns * spin), glm::vec3(0.0f, 1.0f, 0.0f));
+		modelMat = glm::scale(modelMat, glm::vec3(model.scale));
+
+		m_Renderer.updateModel(m_JobModelIds[i], modelMat);
+		m_Renderer.setModelVisible(m_JobModelIds[i], true);
+	}
+
+	job.cameraPath.apply(job.cameraPath.getFrameTime(m_Frame, job.frameCount), *m_Camera);
+	m_Renderer.update(0.0f, m_Camera);
+
+	m_Renderer.publishSnapshot();
+}
+
+bool BatchRenderer::isJobWritten(JobState& state)
+{
+	if (state.framesRendered < state.job.frameCount) return false;
+
+	CaptureWriter::Stats stats = state.writer->getStats();
+	return stats.written + stats.failed + stats.dropped + state.framesLost >= state.job.frameCount;
+}
+
+void BatchRenderer::finishWrittenJobs(bool wait)
+{
+	for (auto& state : m_Jobs)
+	{
+		if (state->writer == nullptr) continue;
+
+		if (wait)
+		{
+			state->writer->finish();
+		}
+		else if (!isJobWritten(*state))
+		{
+			continue;
+		}
+
+		CaptureWriter::Stats stats = state->writer->getStats();
+		state->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - state->startTime).count();
+
+		m_JobsWritten++;
+		m_FramesWritten += stats.written;
+		m_FramesLost += stats.failed + stats.dropped + state->framesLost;
+
+		printf("Batch: job '%s' written, %llu of %u frames in %.1f s\n", state->job.name.c_str(),
+			(unsigned long long)stats.written, state->job.frameCount, state->seconds);
+
+		// The readback worker may still hold it for a moment, the last reference stops the encoders
+		std::shared_ptr<CaptureWriter> writer;
+		{
+			std::lock_guard<std::mutex> lock(m_Delivery->mutex);
+			writer = std::move(state->writer);
+		}
+		writer.reset();
+	}
+}
+
+void BatchRenderer::printReport(double seconds)
+{
+	const VulkanRenderer::AssetCacheStats& cacheStats = m_Renderer.getAssetCacheStats();
+
+	printf("==== Batch (%zu jobs, %u frames in flight) ====\n", m_Jobs.size(), m_Renderer.getFramesInFlight());
+	printf("  jobs         %u written in %.1f s, %.1f jobs/hour\n", m_JobsWritten, seconds, seconds > 0.0 ? m_JobsWritten * 3600.0 / seconds : 0.0);
+	printf("  frames       %llu written, %llu lost, %.1f frames/s\n",
+		(unsigned long long)m_FramesWritten, (unsigned long long)m_FramesLost, seconds > 0.0 ? m_FramesWritten / seconds : 0.0);
+	printf("  models       %u files loaded, %u models from the mesh cache\n", cacheStats.meshLoads, cacheStats.meshHits);
+	printf("  textures     %u files loaded, %u requests from the texture cache\n", cacheStats.textureLoads, cacheStats.textureHits);
+}
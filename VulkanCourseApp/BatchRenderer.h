@@ -0,0 +1,131 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "WindowLVE.h"
+#include "Camera.h"
+#include "CameraPath.h"
+#include "CaptureWriter.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// Offline rendering of a job list (turntables of assets): every job places models, moves the camera along its
+// path and renders its frames headless at its own resolution, each frame goes through the frame readback to a
+// CaptureWriter. Jobs run back to back on the calling thread with several frames in flight, so the GPU renders
+// while the readback worker and the encoders of the previous frames (and jobs) are still busy.
+// Models are created once per file and instance and hidden while a job does not use them: files are parsed and
+// uploaded once for the whole batch (the renderer's mesh and texture caches).
+//
+// Job list (text, one setting per line, '#' starts a comment):
+//   job NAME                          starts a job, the settings below belong to it
+//   model FILE [X Y Z [SCALE [TURNS]]] a model at X Y Z, TURNS rotations around Y over the job (default 0 0 0 1 0)
+//   orbit X Y Z RADIUS HEIGHT [TURNS]  camera circling the target X Y Z (default one turn)
+//   key PX PY PZ TX TY TZ              camera spline key: position and target (two or more keys, in order)
+//   loop                               the spline returns to its first key
+//   resolution WxH                     default 1280x720
+//   frames N                           default 120
+//   format png|qoi|y4m                 default png
+//   output PATH                        image directory or Y4M file, default Batch/NAME (.y4m)
+class BatchRenderer
+{
+public:
+	struct ModelEntry
+	{
+		std::string fileName;
+		glm::vec3 position = glm::vec3(0.0f);
+		float scale = 1.0f;
+		float turns = 0.0f;
+	};
+
+	struct Job
+	{
+		std::string name;
+		std::vector<ModelEntry> models;
+		CameraPath cameraPath;
+		uint32_t width = 1280;
+		uint32_t height = 720;
+		uint32_t frameCount = 120;
+		CaptureWriter::Format format = CaptureWriter::Format::Png;
+		std::string output;
+	};
+
+	// Parses a job list, prints the first error (with its line) and returns false on failure
+	static bool loadJobList(const std::string& fileName, std::vector<Job>* jobs);
+
+	// Installs the renderer's readback callback: call before VulkanRenderer::init(). The renderer draws on the
+	// thread that calls run(), no render thread. captureSettings: encoder threads and queue per job.
+	BatchRenderer(VulkanRenderer& renderer, std::shared_ptr<WindowLVE> window, std::shared_ptr<Camera> camera,
+		std::vector<Job> jobs, const CaptureWriter::Settings& captureSettings);
+
+	BatchRenderer(const BatchRenderer&) = delete;
+	BatchRenderer& operator=(const BatchRenderer&) = delete;
+
+	// Renders every job and waits until all frames are written. False if rendering failed.
+	bool run();
+
+private:
+	struct JobState
+	{
+		Job job;
+		std::shared_ptr<CaptureWriter> writer; // Released once every frame of the job is written
+		uint32_t framesRendered = 0;
+		std::atomic<uint32_t> framesLost{ 0 }; // No readback (buffers full) or of another size than the job's
+		std::chrono::steady_clock::time_point startTime;
+		double seconds = 0.0;
+	};
+
+	// Timeline value of a rendered frame and what it shows, in submission order
+	struct FrameTag
+	{
+		uint64_t timelineFrame;
+		std::shared_ptr<JobState> job;
+		uint32_t frameNumber;
+	};
+
+	// Shared with the readback callback (worker thread), which may outlive this object
+	struct Delivery
+	{
+		std::mutex mutex;
+		std::deque<FrameTag> pending;
+	};
+
+	static void deliverFrame(Delivery& delivery, const FrameReadback::Frame& frame);
+
+	void startJob(size_t jobIndex);
+	void publishFrame();       // Input sampler: the scene of the current job frame
+	bool isJobWritten(JobState& state);
+	void finishWrittenJobs(bool wait);
+	void printReport(double seconds);
+
+	VulkanRenderer& m_Renderer;
+	std::shared_ptr<WindowLVE> m_Window;
+	std::shared_ptr<Camera> m_Camera;
+	CaptureWriter::Settings m_CaptureSettings;
+
+	std::vector<std::shared_ptr<JobState>> m_Jobs;
+	std::shared_ptr<Delivery> m_Delivery;
+
+	// Model ids per file, the nth model of a file in a job uses the nth id. Ids a job does not use are hidden.
+	std::unordered_map<std::string, std::vector<int>> m_ModelIds;
+	std::vector<int> m_AllModelIds;
+	std::vector<int> m_JobModelIds; // Current job, one per ModelEntry
+
+	std::shared_ptr<JobState> m_Current;
+	uint32_t m_Frame = 0;
+	bool m_FrameTagged = false;
+
+	uint32_t m_JobsWritten = 0;
+	uint64_t m_FramesWritten = 0;
+	uint64_t m_FramesLost = 0;
+
+};
@@ -0,0 +1,419 @@
+#include "Benchmark.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	struct ProcessMemory
+	{
+		uint64_t residentBytes = 0;
+		uint64_t peakResidentBytes = 0;
+	};
+
+	ProcessMemory getProcessMemory()
+	{
+		ProcessMemory memory;
+
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters = {};
+		if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		{
+			memory.residentBytes = counters.WorkingSetSize;
+			memory.peakResidentBytes = counters.PeakWorkingSetSize;
+		}
+#else
+		// VmRSS and VmHWM (peak) in kB
+		FILE* status = fopen("/proc/self/status", "r");
+		if (status != nullptr)
+		{
+			char line[256];
+			unsigned long long kilobytes = 0;
+			while (fgets(line, sizeof(line), status) != nullptr)
+			{
+				if (sscanf(line, "VmRSS: %llu kB", &kilobytes) == 1) memory.residentBytes = kilobytes * 1024;
+				if (sscanf(line, "VmHWM: %llu kB", &kilobytes) == 1) memory.peakResidentBytes = kilobytes * 1024;
+			}
+			fclose(status);
+		}
+#endif
+
+		return memory;
+	}
+
+	std::string escapeJson(const std::string& text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\') escaped += '\\';
+			if ((unsigned char)c < 0x20) continue;
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	const char* getDeviceTypeName(VkPhysicalDeviceType type)
+	{
+		switch (type)
+		{
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   return "discrete";
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    return "virtual";
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:            return "cpu";
+		default:                                     return "other";
+		}
+	}
+}
+
+
+bool Benchmark::loadScene(const Settings& settings, BatchRenderer::Job* scene)
+{
+	if (!settings.sceneFile.empty())
+	{
+		std::vector<BatchRenderer::Job> jobs;
+		if (!BatchRenderer::loadJobList(settings.sceneFile, &jobs))
+		{
+			return false;
+		}
+
+		if (jobs.size() > 1)
+		{
+			printf("Benchmark: %s has %zu jobs, the first one is the scene\n", settings.sceneFile.c_str(), jobs.size());
+		}
+		*scene = jobs[0];
+	}
+	else
+	{
+		// main.cpp's scene: two cyborgs turning at 20 degrees per second (10 seconds at 60 Hz),
+		// the camera loops around them from the usual start view
+		BatchRenderer::Job defaultScene;
+		defaultScene.name = "default";
+		defaultScene.frameCount = 600;
+		defaultScene.models.push_back({ "Models/cyborg.obj", glm::vec3(-9.5f, 0.0f, 0.0f), 5.0f, 20.0f * 10.0f / 360.0f });
+		defaultScene.models.push_back({ "Models/cyborg.obj", glm::vec3(9.5f, 0.0f, 0.0f), 5.0f, 20.0f * 10.0f / 360.0f });
+		defaultScene.cameraPath = CameraPath::spline({
+			{ glm::vec3(0.0f, 10.0f, 40.0f), glm::vec3(0.0f, 10.0f, 0.0f) },
+			{ glm::vec3(30.0f, 15.0f, 20.0f), glm::vec3(0.0f, 8.0f, 0.0f) },
+			{ glm::vec3(0.0f, 20.0f, -35.0f), glm::vec3(0.0f, 8.0f, 0.0f) },
+			{ glm::vec3(-30.0f, 12.0f, 20.0f), glm::vec3(0.0f, 8.0f, 0.0f) } }, true);
+		*scene = defaultScene;
+	}
+
+	if (settings.measuredFrames > 0)
+	{
+		scene->frameCount = settings.measuredFrames;
+	}
+
+	return true;
+}
+
+Benchmark::Benchmark(VulkanRenderer& renderer, std::shared_ptr<WindowLVE> window, std::shared_ptr<Camera> camera,
+	const BatchRenderer::Job& scene, const Settings& settings)
+	: m_Renderer(renderer), m_Window{ window }, m_Camera{ camera }, m_Scene{ scene }, m_Settings{ settings }
+{
+}
+
+bool Benchmark::run()
+{
+	const uint32_t warmupFrames = m_Settings.warmupFrames;
+	const uint32_t measuredFrames = m_Scene.frameCount;
+
+	printf("Benchmark: scene '%s', %zu models at %ux%u, %u warm-up + %u measured frames, timestep %.4f s\n", m_Scene.name.c_str(),
+		m_Scene.models.size(), m_Scene.width, m_Scene.height, warmupFrames, measuredFrames, m_Settings.timestep);
+
+	m_FrameMs.reserve(measuredFrames);
+	m_CpuMs.reserve(measuredFrames);
+	m_RecordMs.reserve(measuredFrames);
+	m_GpuMs.reserve(measuredFrames);
+	m_DrawCalls.reserve(measuredFrames);
+	m_Triangles.reserve(measuredFrames);
+
+	m_Window->setExtent(m_Scene.width, m_Scene.height);
+
+	// The models are uploaded during the first frame, before any measurement
+	for (const BatchRenderer::ModelEntry& model : m_Scene.models)
+	{
+		m_ModelIds.push_back(m_Renderer.createMeshModel(model.fileName));
+	}
+
+	m_Renderer.setInputSampler([this]() { publishFrame(); });
+
+	auto benchmarkStart = std::chrono::steady_clock::now();
+	uint64_t firstMeasuredFrame = 0; // Renderer frame number of the first measured frame
+	uint64_t lastGpuFrame = UINT64_MAX;
+
+	// GPU times arrive a few frames late: after the measured frames, a few more are drawn (not measured) to collect them
+	const uint32_t drainFrames = m_Renderer.getFramesInFlight() + 2;
+	uint32_t drained = 0;
+
+	try
+	{
+		auto previousFrameEnd = std::chrono::steady_clock::now();
+
+		while (m_Frame < warmupFrames + measuredFrames || (m_GpuMs.size() < measuredFrames && drained < drainFrames))
+		{
+			if (!m_Window->isHeadless() && m_Window->shouldClose())
+			{
+				printf("Benchmark: window closed, no report\n");
+				m_Renderer.setInputSampler(nullptr);
+				return false;
+			}
+
+			// Background compilations finishing mid-measurement would time the fallback path and the pipeline
+			// switch, so the measured frames only start once every pipeline is installed
+			if (m_Frame == warmupFrames && m_Renderer.getPipelinesPending() > 0)
+			{
+				m_PipelinesPendingAfterWarmup = m_Renderer.getPipelinesPending();
+				printf("Benchmark: waiting for %u pipelines before measuring\n", m_PipelinesPendingAfterWarmup);
+				m_Renderer.waitForPendingPipelines();
+				previousFrameEnd = std::chrono::steady_clock::now();
+			}
+
+			uint64_t renderedFrames = m_Renderer.getRenderedFrameCount();
+
+			auto drawStart = std::chrono::steady_clock::now();
+			m_Renderer.draw();
+			auto drawEnd = std::chrono::steady_clock::now();
+
+			// Skipped (bounded wait timed out, images recreated): the same frame again
+			if (m_Renderer.getRenderedFrameCount() == renderedFrames) continue;
+
+			bool measured = m_Frame >= warmupFrames && m_Frame < warmupFrames + measuredFrames;
+
+			if (m_Frame == warmupFrames)
+			{
+				firstMeasuredFrame = renderedFrames;
+			}
+
+			if (measured)
+			{
+				double drawMs = std::chrono::duration<double, std::milli>(drawEnd - drawStart).count();
+				const VulkanRenderer::FrameStats& frameStats = m_Renderer.getLastFrameStats();
+
+				m_FrameMs.push_back(std::chrono::duration<double, std::milli>(drawEnd - previousFrameEnd).count());
+				m_CpuMs.push_back(std::max(drawMs - m_Renderer.getLastFrameLatency().acquireWaitMs, 0.0));
+				m_RecordMs.push_back(frameStats.recordCpuMs);
+				m_DrawCalls.push_back((double)frameStats.drawCalls);
+				m_Triangles.push_back((double)frameStats.triangles);
+
+				// The path the models were actually drawn with, which differs from the requested one on fallback frames
+				m_MeasuredPathMask |= 1u << (int)frameStats.objectDataPath;
+				m_DrawnObjectDataPath = frameStats.objectDataPath;
+				if (frameStats.fallback) m_FallbackFrames++;
+			}
+			else if (m_Frame >= warmupFrames + measuredFrames)
+			{
+				drained++;
+			}
+			previousFrameEnd = drawEnd;
+
+			// At most one new GPU time per drawn frame, kept if it belongs to a measured frame
+			uint64_t gpuFrame = 0;
+			double gpuMs = 0.0;
+			if (m_Frame >= warmupFrames && m_Renderer.getLastGpuTime(&gpuFrame, &gpuMs) && gpuFrame != lastGpuFrame)
+			{
+				lastGpuFrame = gpuFrame;
+				if (gpuFrame >= firstMeasuredFrame && gpuFrame < firstMeasuredFrame + measuredFrames)
+				{
+					m_GpuMs.push_back(gpuMs);
+				}
+			}
+
+			m_Frame++;
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		printf("ERROR: %s\n", e.what());
+		m_Renderer.setInputSampler(nullptr);
+		return false;
+	}
+
+	m_Renderer.setInputSampler(nullptr);
+
+	double measuredSeconds = 0.0;
+	for (double frameMs : m_FrameMs)
+	{
+		measuredSeconds += frameMs / 1000.0;
+	}
+
+	printf("Benchmark: %u measured frames in %.2f s (%.1f s total)\n", measuredFrames, measuredSeconds,
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - benchmarkStart).count());
+
+	return writeReport(measuredSeconds);
+}
+
+void Benchmark::publishFrame()
+{
+	// Windowed: keep the window responsive, input is not used
+	if (!m_Window->isHeadless())
+	{
+		glfwPollEvents();
+	}
+
+	// Warm-up frames play the path as well, the measured frames start it over. Fixed timestep: the time is the frame
+	// number, the last measured frame is held while the late GPU times are collected.
+	uint32_t measuredFrames = m_Scene.frameCount;
+	uint32_t frame = m_Frame < m_Settings.warmupFrames ? m_Frame % measuredFrames : std::min(m_Frame - m_Settings.warmupFrames, measuredFrames - 1);
+
+	float spin = (float)frame / measuredFrames;
+	for (size_t i = 0; i < m_Scene.models.size(); i++)
+	{
+		const BatchRenderer::ModelEntry& model = m_Scene.models[i];
+
+		glm::mat4 modelMat(1.0f);
+		modelMat = glm::translate(modelMat, model.position);
+		modelMat = glm::rotate(modelMat, glm::radians(360.0f * model.turns * spin), glm::vec3(0.0f, 1.0f, 0.0f));
+		modelMat = glm::scale(modelMat, glm::vec3(model.scale));
+
+		m_Renderer.updateModel(m_ModelIds[i], modelMat);
+	}
+
+	m_Scene.cameraPath.apply(m_Scene.cameraPath.getFrameTime(frame, measuredFrames), *m_Camera);
+	m_Renderer.update((float)m_Settings.timestep, m_Camera);
+
+	m_Renderer.publishSnapshot();
+}
+
+Benchmark::Summary Benchmark::summarize(std::vector<double> samples)
+{
+	Summary summary;
+	summary.count = samples.size();
+	if (samples.empty()) return summary;
+
+	std::sort(samples.begin(), samples.end());
+
+	double sum = 0.0;
+	for (double sample : samples)
+	{
+		sum += sample;
+	}
+
+	// Nearest rank
+	auto percentile = [&](double p)
+	{
+		size_t rank = (size_t)std::ceil(p / 100.0 * samples.size());
+		return samples[std::min(std::max(rank, (size_t)1), samples.size()) - 1];
+	};
+
+	summary.mean = sum / samples.size();
+	summary.min = samples.front();
+	summary.max = samples.back();
+	summary.p50 = percentile(50.0);
+	summary.p95 = percentile(95.0);
+	summary.p99 = percentile(99.0);
+	return summary;
+}
+
+bool Benchmark::writeReport(double seconds)
+{
+	FILE* file = fopen(m_Settings.reportFile.c_str(), "w");
+	if (file == nullptr)
+	{
+		printf("Benchmark: failed to write the report '%s'\n", m_Settings.reportFile.c_str());
+		return false;
+	}
+
+	auto writeSummary = [&](const char* name, const Summary& summary, bool last)
+	{
+		fprintf(file, "  \"%s\": { \"samples\": %zu, \"mean\": %.4f, \"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f }%s\n",
+			name, summary.count, summary.mean, summary.min, summary.max, summary.p50, summary.p95, summary.p99, last ? "" : ",");
+	};
+
+	std::shared_ptr<DeviceLVE> device = m_Renderer.getDevice();
+	const VkPhysicalDeviceProperties& properties = device->properties;
+
+	Summary frameMs = summarize(m_FrameMs);
+	Summary cpuMs = summarize(m_CpuMs);
+	Summary recordMs = summarize(m_RecordMs);
+	Summary gpuMs = summarize(m_GpuMs);
+	Summary drawCalls = summarize(m_DrawCalls);
+	Summary triangles = summarize(m_Triangles);
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"scene\": \"%s\",\n", escapeJson(m_Settings.sceneFile.empty() ? "default" : m_Settings.sceneFile).c_str());
+	fprintf(file, "  \"device\": \"%s\",\n", escapeJson(properties.deviceName).c_str());
+	fprintf(file, "  \"deviceType\": \"%s\",\n", getDeviceTypeName(properties.deviceType));
+	fprintf(file, "  \"driverVersion\": %u,\n", properties.driverVersion);
+	fprintf(file, "  \"headless\": %s,\n", m_Window->isHeadless() ? "true" : "false");
+	fprintf(file, "  \"width\": %u,\n", m_Scene.width);
+	fprintf(file, "  \"height\": %u,\n", m_Scene.height);
+	fprintf(file, "  \"framesInFlight\": %u,\n", m_Renderer.getFramesInFlight());
+	// Several paths in one run only happen if a pipeline failed to compile and the fallback path took over
+	bool mixedPaths = (m_MeasuredPathMask & (m_MeasuredPathMask - 1)) != 0;
+	fprintf(file, "  \"objectDataPath\": \"%s\",\n", mixedPaths ? "mixed" : getObjectDataPathName(m_DrawnObjectDataPath));
+	fprintf(file, "  \"requestedObjectDataPath\": \"%s\",\n", getObjectDataPathName(m_Renderer.getObjectDataPath()));
+	fprintf(file, "  \"fallbackFrames\": %u,\n", m_FallbackFrames);
+	fprintf(file, "  \"depthPrepass\": %s,\n", m_Renderer.getDepthPrepass() ? "true" : "false");
+	fprintf(file, "  \"warmupFrames\": %u,\n", m_Settings.warmupFrames);
+	fprintf(file, "  \"measuredFrames\": %u,\n", m_Scene.frameCount);
+	fprintf(file, "  \"timestepSeconds\": %.6f,\n", m_Settings.timestep);
+	fprintf(file, "  \"pipelinesPendingAfterWarmup\": %u,\n", m_PipelinesPendingAfterWarmup);
+	fprintf(file, "  \"measuredSeconds\": %.4f,\n", seconds);
+	fprintf(file, "  \"framesPerSecond\": %.2f,\n", seconds > 0.0 ? m_FrameMs.size() / seconds : 0.0);
+	writeSummary("frameMs", frameMs, false);
+	writeSummary("cpuMs", cpuMs, false);
+	writeSummary("recordMs", recordMs, false);
+	writeSummary("gpuMs", gpuMs, false); // No samples without timestamp support
+	writeSummary("drawCalls", drawCalls, false);
+	writeSummary("triangles", triangles, false);
+
+	ProcessMemory processMemory = getProcessMemory();
+	std::vector<DeviceLVE::HeapMemory> heaps = device->getHeapMemory();
+
+	fprintf(file, "  \"memory\": {\n");
+	fprintf(file, "    \"processResidentBytes\": %llu,\n", (unsigned long long)processMemory.residentBytes);
+	fprintf(file, "    \"processPeakResidentBytes\": %llu,\n", (unsigned long long)processMemory.peakResidentBytes);
+	fprintf(file, "    \"memoryBudget\": %s,\n", device->hasMemoryBudget() ? "true" : "false");
+	fprintf(file, "    \"heaps\": [\n");
+	for (size_t i = 0; i < heaps.size(); i++)
+	{
+		fprintf(file, "      { \"size\": %llu, \"budget\": %llu, \"usage\": %llu, \"deviceLocal\": %s }%s\n",
+			(unsigned long long)heaps[i].size, (unsigned long long)heaps[i].budget, (unsigned long long)heaps[i].usage,
+			heaps[i].deviceLocal ? "true" : "false", i + 1 < heaps.size() ? "," : "");
+	}
+	fprintf(file, "    ]\n");
+	fprintf(file, "  }\n");
+	fprintf(file, "}\n");
+
+	bool written = ferror(file) == 0;
+	written = fclose(file) == 0 && written;
+	if (!written)
+	{
+		printf("Benchmark: failed to write the report '%s'\n", m_Settings.reportFile.c_str());
+		return false;
+	}
+
+	printf("==== Benchmark (%s, %ux%u) ====\n", properties.deviceName, m_Scene.width, m_Scene.height);
+	printf("  frame        p50 %.3f ms, p95 %.3f ms, p99 %.3f ms (%.1f fps)\n", frameMs.p50, frameMs.p95, frameMs.p99, frameMs.mean > 0.0 ? 1000.0 / frameMs.mean : 0.0);
+	printf("  cpu          p50 %.3f ms, p95 %.3f ms, p99 %.3f ms (record %.3f ms)\n", cpuMs.p50, cpuMs.p95, cpuMs.p99, recordMs.p50);
+	if (gpuMs.count > 0)
+	{
+		printf("  gpu          p50 %.3f ms, p95 %.3f ms, p99 %.3f ms (%zu samples)\n", gpuMs.p50, gpuMs.p95, gpuMs.p99, gpuMs.count);
+	}
+	else
+	{
+		printf("  gpu          no timestamps\n");
+	}
+	printf("  draws        %.0f draw calls, %.0f triangles per frame\n", drawCalls.mean, triangles.mean);
+	printf("  report       %s\n", m_Settings.reportFile.c_str());
+
+	return true;
+}
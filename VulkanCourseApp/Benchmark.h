@@ -0,0 +1,82 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+#include "WindowLVE.h"
+#include "Camera.h"
+#include "BatchRenderer.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Reproducible performance measurement: a scene (job list format, see BatchRenderer.h, its first job) is drawn
+// on the calling thread with a fixed timestep. Models and camera follow the scene's scripted path by frame number,
+// never by wall clock or input, so every run renders the same frames. Warm-up frames (pipeline compilation,
+// first touch of memory) are followed by the measured frames, the results go to a JSON report:
+// frame, CPU, record and GPU times with percentiles, draw calls, triangles and memory use.
+// Works windowed and headless (lavapipe), with the renderer's present mode as it is (use immediate to uncap).
+class Benchmark
+{
+public:
+	struct Settings
+	{
+		std::string sceneFile;           // Empty = default scene, the two cyborgs of main.cpp with a camera loop around them
+		uint32_t warmupFrames = 60;
+		uint32_t measuredFrames = 0;     // 0 = the scene's frame count
+		double timestep = 1.0 / 60.0;    // Simulated seconds per frame (reported, the path spans the measured frames)
+		std::string reportFile = "benchmark.json";
+	};
+
+	// Scene of settings.sceneFile, or the default scene. False (error printed) if the file can not be used.
+	static bool loadScene(const Settings& settings, BatchRenderer::Job* scene);
+
+	Benchmark(VulkanRenderer& renderer, std::shared_ptr<WindowLVE> window, std::shared_ptr<Camera> camera,
+		const BatchRenderer::Job& scene, const Settings& settings);
+
+	Benchmark(const Benchmark&) = delete;
+	Benchmark& operator=(const Benchmark&) = delete;
+
+	// Renders warm-up and measured frames, writes the report. False if rendering failed or the window was closed.
+	bool run();
+
+private:
+	struct Summary
+	{
+		size_t count = 0;
+		double mean = 0.0;
+		double min = 0.0;
+		double max = 0.0;
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+	};
+
+	static Summary summarize(std::vector<double> samples);
+
+	void publishFrame(); // Input sampler: the scene at m_Frame
+	bool writeReport(double seconds);
+
+	VulkanRenderer& m_Renderer;
+	std::shared_ptr<WindowLVE> m_Window;
+	std::shared_ptr<Camera> m_Camera;
+	BatchRenderer::Job m_Scene;
+	Settings m_Settings;
+
+	std::vector<int> m_ModelIds; // One per scene model
+	uint32_t m_Frame = 0;        // Warm-up frames first, the path restarts with the measured frames
+
+	// Measured frames only
+	std::vector<double> m_FrameMs;  // Wall time from the end of the previous frame
+	std::vector<double> m_CpuMs;    // draw() without the wait for the frame slot and the image
+	std::vector<double> m_RecordMs; // Command recording
+	std::vector<double> m_GpuMs;    // Timestamps, collected a few frames late
+	std::vector<double> m_DrawCalls;
+	std::vector<double> m_Triangles;
+	uint32_t m_PipelinesPendingAfterWarmup = 0; // Waited for before the first measured frame
+	ObjectDataPath m_DrawnObjectDataPath = ObjectDataPath::PushConstant;
+	uint32_t m_MeasuredPathMask = 0; // One bit per drawn ObjectDataPath
+	uint32_t m_FallbackFrames = 0;
+
+};
@@ -0,0 +1,118 @@
+#include "CameraPath.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+
+namespace
+{
+	// Uniform Catmull-Rom segment between p1 and p2, s in [0, 1]
+	glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float s)
+	{
+		float s2 = s * s;
+		float s3 = s2 * s;
+
+		return 0.5f * ((2.0f * p1) + (p2 - p0) * s + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * s2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * s3);
+	}
+}
+
+
+CameraPath::CameraPath()
+{
+	// Camera of main.cpp: at (0, 10, 40) looking down -Z
+	m_Keys.push_back({ glm::vec3(0.0f, 10.0f, 40.0f), glm::vec3(0.0f, 10.0f, 0.0f) });
+}
+
+CameraPath CameraPath::orbit(glm::vec3 target, float radius, float height, float turns)
+{
+	CameraPath path;
+	path.m_Type = Type::Orbit;
+	path.m_Closed = std::fabs(turns - std::round(turns)) < 1e-4f && turns != 0.0f; // Whole turns end where they start
+	path.m_Target = target;
+	path.m_Radius = radius;
+	path.m_Height = height;
+	path.m_Turns = turns;
+	path.m_Keys.clear();
+
+	return path;
+}
+
+CameraPath CameraPath::spline(const std::vector<Key>& keys, bool closed)
+{
+	CameraPath path;
+	if (!keys.empty())
+	{
+		path.m_Keys = keys;
+	}
+	path.m_Closed = closed && path.m_Keys.size() > 1;
+
+	return path;
+}
+
+float CameraPath::getFrameTime(uint32_t frameIndex, uint32_t frameCount) const
+{
+	if (m_Closed)
+	{
+		return frameCount > 0 ? (float)frameIndex / frameCount : 0.0f;
+	}
+
+	return frameCount > 1 ? (float)frameIndex / (frameCount - 1) : 0.0f;
+}
+
+CameraPath::Key CameraPath::evaluate(float t) const
+{
+	t = std::min(std::max(t, 0.0f), 1.0f);
+
+	if (m_Type == Type::Orbit)
+	{
+		float angle = glm::two_pi<float>() * m_Turns * t;
+		glm::vec3 offset = glm::vec3(std::sin(angle) * m_Radius, m_Height, std::cos(angle) * m_Radius);
+		return { m_Target + offset, m_Target };
+	}
+
+	size_t keyCount = m_Keys.size();
+	if (keyCount == 1)
+	{
+		return m_Keys[0];
+	}
+
+	// Closed: keyCount segments, the last one back to the first key. Open: keyCount - 1 segments,
+	// the end keys are repeated as their outer neighbours.
+	size_t segmentCount = m_Closed ? keyCount : keyCount - 1;
+	float position = t * segmentCount;
+	size_t segment = std::min((size_t)position, segmentCount - 1);
+	float s = position - segment;
+
+	auto key = [&](ptrdiff_t index) -> const Key&
+	{
+		if (m_Closed)
+		{
+			return m_Keys[(size_t)((index % (ptrdiff_t)keyCount + keyCount) % keyCount)];
+		}
+		return m_Keys[(size_t)std::min(std::max(index, (ptrdiff_t)0), (ptrdiff_t)keyCount - 1)];
+	};
+
+	ptrdiff_t i = (ptrdiff_t)segment;
+	Key result;
+	result.position = catmullRom(key(i - 1).position, key(i).position, key(i + 1).position, key(i + 2).position, s);
+	result.target = catmullRom(key(i - 1).target, key(i).target, key(i + 1).target, key(i + 2).target, s);
+	return result;
+}
+
+void CameraPath::apply(float t, Camera& camera) const
+{
+	Key key = evaluate(t);
+
+	glm::vec3 front = key.target - key.position;
+	if (glm::dot(front, front) < 1e-8f)
+	{
+		front = glm::vec3(0.0f, 0.0f, -1.0f);
+	}
+
+	camera.SetPosition(key.position);
+	camera.SetFront(glm::normalize(front));
+	camera.OnUpdate(0.0f); // Up/right from the new front, then the view matrix
+}
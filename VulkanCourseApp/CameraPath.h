@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Camera.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+// Scripted camera motion over a normalized time t in [0, 1]: an orbit around a target (turntables) or a
+// Catmull-Rom spline through keys of position and look-at target. Evaluation is a pure function of t,
+// so every run of a path gives the same views.
+class CameraPath
+{
+public:
+	struct Key
+	{
+		glm::vec3 position;
+		glm::vec3 target;
+	};
+
+	CameraPath(); // Fixed view of the default scene, the one main.cpp starts with
+
+	// turns full circles around target over the path, at radius and height above the target, starting on +Z
+	static CameraPath orbit(glm::vec3 target, float radius, float height, float turns = 1.0f);
+	// Passes through every key. A closed spline returns from the last key to the first one.
+	static CameraPath spline(const std::vector<Key>& keys, bool closed = false);
+
+	bool isClosed() const { return m_Closed; }
+
+	// Time of frame frameIndex out of frameCount: a closed path ends one step before its start, so a loop of
+	// the frames has no repeated frame. An open path ends on its last key.
+	float getFrameTime(uint32_t frameIndex, uint32_t frameCount) const;
+
+	Key evaluate(float t) const;
+	// Positions the camera and points it at the target (view matrix updated)
+	void apply(float t, Camera& camera) const;
+
+private:
+	enum class Type
+	{
+		Orbit,
+		Spline
+	};
+
+	Type m_Type = Type::Spline;
+	bool m_Closed = false;
+
+	// Orbit
+	glm::vec3 m_Target = glm::vec3(0.0f);
+	float m_Radius = 0.0f;
+	float m_Height = 0.0f;
+	float m_Turns = 1.0f;
+
+	// Spline
+	std::vector<Key> m_Keys;
+
+};
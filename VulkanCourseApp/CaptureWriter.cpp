@@ -0,0 +1,715 @@
+#include "CaptureWriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+
+namespace
+{
+	// -- PNG --
+
+	uint32_t crcTable[256];
+	bool crcTableReady = false;
+
+	void initCrcTable()
+	{
+		for (uint32_t n = 0; n < 256; n++)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+			{
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			crcTable[n] = c;
+		}
+		crcTableReady = true;
+	}
+
+	uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+	{
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	uint32_t adler32(const uint8_t* data, size_t size)
+	{
+		uint32_t a = 1, b = 0;
+		while (size > 0)
+		{
+			// Largest block before the sums can overflow
+			size_t block = std::min(size, (size_t)5552);
+			for (size_t i = 0; i < block; i++)
+			{
+				a += data[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += block;
+			size -= block;
+		}
+		return (b << 16) | a;
+	}
+
+	void writeBigEndian(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back((uint8_t)(value >> 24));
+		out.push_back((uint8_t)(value >> 16));
+		out.push_back((uint8_t)(value >> 8));
+		out.push_back((uint8_t)value);
+	}
+
+	// Deflate bit stream: values LSB first, Huffman codes MSB first
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<uint8_t>& out) : m_Out(out) {}
+
+		void write(uint32_t value, uint32_t count)
+		{
+			m_Bits |= value << m_Count;
+			m_Count += count;
+			while (m_Count >= 8)
+			{
+				m_Out.push_back((uint8_t)m_Bits);
+				m_Bits >>= 8;
+				m_Count -= 8;
+			}
+		}
+
+		void writeCode(uint32_t code, uint32_t length)
+		{
+			uint32_t reversed = 0;
+			for (uint32_t i = 0; i < length; i++)
+			{
+				reversed |= ((code >> i) & 1) << (length - 1 - i);
+			}
+			write(reversed, length);
+		}
+
+		void flush()
+		{
+			if (m_Count > 0)
+			{
+				m_Out.push_back((uint8_t)m_Bits);
+			}
+			m_Bits = 0;
+			m_Count = 0;
+		}
+
+	private:
+		std::vector<uint8_t>& m_Out;
+		uint32_t m_Bits = 0;
+		uint32_t m_Count = 0;
+	};
+
+	const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+		4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// Fixed Huffman code of a literal/length symbol (RFC 1951 3.2.6)
+	void writeSymbol(BitWriter& bits, uint32_t symbol)
+	{
+		if (symbol < 144)      bits.writeCode(0x30 + symbol, 8);
+		else if (symbol < 256) bits.writeCode(0x190 + symbol - 144, 9);
+		else if (symbol < 280) bits.writeCode(symbol - 256, 7);
+		else                   bits.writeCode(0xC0 + symbol - 280, 8);
+	}
+
+	void writeMatch(BitWriter& bits, uint32_t length, uint32_t distance)
+	{
+		int l = 28;
+		while (lengthBase[l] > length) l--;
+		writeSymbol(bits, 257 + l);
+		bits.write(length - lengthBase[l], lengthExtra[l]);
+
+		int d = 29;
+		while (distanceBase[d] > distance) d--;
+		bits.writeCode(d, 5);
+		bits.write(distance - distanceBase[d], distanceExtra[d]);
+	}
+
+	// zlib stream of one fixed Huffman block, greedy LZ77 with a hash of the last position of every 3 byte prefix
+	void deflate(const std::vector<uint8_t>& data, std::vector<uint8_t>& out)
+	{
+		const uint32_t WINDOW = 32768;
+		const uint32_t MAX_MATCH = 258;
+		const uint32_t HASH_BITS = 15;
+
+		out.push_back(0x78); // CM 8, 32K window
+		out.push_back(0x01); // no dictionary, fastest, header checksum
+
+		BitWriter bits(out);
+		bits.write(1, 1); // BFINAL
+		bits.write(1, 2); // BTYPE fixed Huffman
+
+		std::vector<int32_t> head((size_t)1 << HASH_BITS, -1);
+		auto hash = [&](size_t i) { return ((data[i] << 16 | data[i + 1] << 8 | data[i + 2]) * 2654435761u) >> (32 - HASH_BITS); };
+
+		size_t size = data.size();
+		size_t i = 0;
+		while (i < size)
+		{
+			uint32_t bestLength = 0;
+			size_t bestDistance = 0;
+
+			if (i + 3 <= size)
+			{
+				uint32_t h = hash(i);
+				int32_t candidate = head[h];
+				head[h] = (int32_t)i;
+
+				if (candidate >= 0 && i - candidate <= WINDOW)
+				{
+					size_t maxLength = std::min((size_t)MAX_MATCH, size - i);
+					uint32_t length = 0;
+					while (length < maxLength && data[candidate + length] == data[i + length]) length++;
+
+					if (length >= 3)
+					{
+						bestLength = length;
+						bestDistance = i - candidate;
+					}
+				}
+			}
+
+			if (bestLength == 0)
+			{
+				writeSymbol(bits, data[i]);
+				i++;
+				continue;
+			}
+
+			writeMatch(bits, bestLength, (uint32_t)bestDistance);
+
+			// Positions inside the match are still worth finding later
+			for (size_t j = i + 1; j < i + bestLength && j + 3 <= size; j++)
+			{
+				head[hash(j)] = (int32_t)j;
+			}
+			i += bestLength;
+		}
+
+		writeSymbol(bits, 256); // end of block
+		bits.flush();
+
+		writeBigEndian(out, adler32(data.data(), data.size()));
+	}
+
+	void writeChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+	{
+		writeBigEndian(out, (uint32_t)data.size());
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+		writeBigEndian(out, crc32(out.data() + start, out.size() - start));
+	}
+
+	uint8_t paeth(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc) return (uint8_t)a;
+		if (pb <= pc) return (uint8_t)b;
+		return (uint8_t)c;
+	}
+
+	void encodePng(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+	{
+		// Filter every row with the filter of the smallest absolute sum (the usual heuristic), one filter type byte per row
+		const size_t rowBytes = (size_t)width * 4;
+		std::vector<uint8_t> filtered((rowBytes + 1) * height);
+		std::vector<uint8_t> candidate(rowBytes);
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			const uint8_t* row = rgba + y * rowBytes;
+			const uint8_t* up = y > 0 ? row - rowBytes : nullptr;
+			uint8_t* dst = filtered.data() + y * (rowBytes + 1);
+
+			uint64_t bestSum = UINT64_MAX;
+			for (uint8_t filter : { 0, 1, 2, 4 })
+			{
+				uint64_t sum = 0;
+				for (size_t x = 0; x < rowBytes; x++)
+				{
+					int a = x >= 4 ? row[x - 4] : 0;
+					int b = up != nullptr ? up[x] : 0;
+					int c = x >= 4 && up != nullptr ? up[x - 4] : 0;
+
+					uint8_t predicted = filter == 0 ? 0 : filter == 1 ? (uint8_t)a : filter == 2 ? (uint8_t)b : paeth(a, b, c);
+					candidate[x] = (uint8_t)(row[x] - predicted);
+					sum += (uint64_t)std::abs((int)(int8_t)candidate[x]);
+				}
+
+				if (sum < bestSum)
+				{
+					bestSum = sum;
+					dst[0] = filter;
+					memcpy(dst + 1, candidate.data(), rowBytes);
+				}
+			}
+		}
+
+		static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		out.insert(out.end(), signature, signature + 8);
+
+		std::vector<uint8_t> header;
+		writeBigEndian(header, width);
+		writeBigEndian(header, height);
+		header.push_back(8); // bit depth
+		header.push_back(6); // RGBA
+		header.push_back(0); // deflate
+		header.push_back(0); // adaptive filtering
+		header.push_back(0); // no interlace
+		writeChunk(out, "IHDR", header);
+
+		std::vector<uint8_t> compressed;
+		deflate(filtered, compressed);
+		writeChunk(out, "IDAT", compressed);
+
+		writeChunk(out, "IEND", {});
+	}
+
+	// -- QOI (qoiformat.org) --
+
+	void encodeQoi(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+	{
+		out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+		writeBigEndian(out, width);
+		writeBigEndian(out, height);
+		out.push_back(4); // RGBA
+		out.push_back(0); // sRGB with linear alpha
+
+		uint8_t index[64][4] = {};
+		uint8_t previous[4] = { 0, 0, 0, 255 };
+		uint32_t run = 0;
+
+		size_t pixelCount = (size_t)width * height;
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			const uint8_t* pixel = rgba + i * 4;
+
+			if (memcmp(pixel, previous, 4) == 0)
+			{
+				run++;
+				if (run == 62 || i == pixelCount - 1)
+				{
+					out.push_back((uint8_t)(0xC0 | (run - 1))); // QOI_OP_RUN
+					run = 0;
+				}
+				continue;
+			}
+
+			if (run > 0)
+			{
+				out.push_back((uint8_t)(0xC0 | (run - 1)));
+				run = 0;
+			}
+
+			uint32_t hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+			if (memcmp(index[hash], pixel, 4) == 0)
+			{
+				out.push_back((uint8_t)hash); // QOI_OP_INDEX
+			}
+			else
+			{
+				memcpy(index[hash], pixel, 4);
+
+				if (pixel[3] == previous[3])
+				{
+					int8_t dr = (int8_t)(pixel[0] - previous[0]);
+					int8_t dg = (int8_t)(pixel[1] - previous[1]);
+					int8_t db = (int8_t)(pixel[2] - previous[2]);
+					int8_t drg = (int8_t)(dr - dg);
+					int8_t dbg = (int8_t)(db - dg);
+
+					if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+					{
+						out.push_back((uint8_t)(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2))); // QOI_OP_DIFF
+					}
+					else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+					{
+						out.push_back((uint8_t)(0x80 | (dg + 32)));           // QOI_OP_LUMA
+						out.push_back((uint8_t)((drg + 8) << 4 | (dbg + 8)));
+					}
+					else
+					{
+						out.insert(out.end(), { 0xFE, pixel[0], pixel[1], pixel[2] }); // QOI_OP_RGB
+					}
+				}
+				else
+				{
+					out.insert(out.end(), { 0xFF, pixel[0], pixel[1], pixel[2], pixel[3] }); // QOI_OP_RGBA
+				}
+			}
+
+			memcpy(previous, pixel, 4);
+		}
+
+		out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+	}
+
+	// -- Y4M --
+
+	// Full range BT.601 (JPEG) YCbCr, planar 4:4:4. The "FRAME" marker is written with the frame.
+	void encodeY4mFrame(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+	{
+		static const char marker[] = "FRAME\n";
+		out.insert(out.end(), marker, marker + 6);
+
+		size_t pixelCount = (size_t)width * height;
+		size_t start = out.size();
+		out.resize(start + pixelCount * 3);
+		uint8_t* planeY = out.data() + start;
+		uint8_t* planeCb = planeY + pixelCount;
+		uint8_t* planeCr = planeCb + pixelCount;
+
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			int r = rgba[i * 4 + 0], g = rgba[i * 4 + 1], b = rgba[i * 4 + 2];
+			planeY[i] = (uint8_t)((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+			planeCb[i] = (uint8_t)std::min((-11059 * r - 21709 * g + 32768 * b + (128 << 16) + 32768) >> 16, 255);
+			planeCr[i] = (uint8_t)std::min((32768 * r - 27439 * g - 5329 * b + (128 << 16) + 32768) >> 16, 255);
+		}
+	}
+}
+
+
+CaptureWriter::CaptureWriter(const Settings& settings)
+	: m_Settings{ settings }
+{
+	if (!crcTableReady)
+	{
+		initCrcTable();
+	}
+
+	m_Settings.interval = std::max(m_Settings.interval, 1u);
+	m_Settings.workerCount = std::max(m_Settings.workerCount, 1u);
+	m_Settings.queueCapacity = std::max(m_Settings.queueCapacity, 1u);
+	m_Settings.videoFrameRate = std::max(m_Settings.videoFrameRate, 1u);
+	if (m_Settings.path.empty())
+	{
+		m_Settings.path = m_Settings.format == Format::Y4m ? "capture.y4m" : "Captures";
+	}
+
+	for (uint32_t i = 0; i < m_Settings.workerCount; i++)
+	{
+		m_Workers.emplace_back(&CaptureWriter::workerMain, this);
+	}
+
+	printf("Capture writer: %s to %s, every %u frames, %u encoder threads, queue of %u frames, %s when full.\n",
+		getFormatName(m_Settings.format), m_Settings.path.c_str(), m_Settings.interval, m_Settings.workerCount, m_Settings.queueCapacity,
+		m_Settings.overflowPolicy == OverflowPolicy::Drop ? "drop" : "stall");
+}
+
+CaptureWriter::~CaptureWriter()
+{
+	finish();
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_WorkCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+
+	if (m_Stats.submitted > 0)
+	{
+		printStats();
+	}
+}
+
+const char* CaptureWriter::getFormatName(Format format)
+{
+	switch (format)
+	{
+	case Format::Png: return "PNG";
+	case Format::Qoi: return "QOI";
+	case Format::Y4m: return "Y4M";
+	}
+
+	return "Unknown";
+}
+
+bool CaptureWriter::parseFormat(const char* name, Format* format)
+{
+	if (strcmp(name, "png") == 0) { *format = Format::Png; return true; }
+	if (strcmp(name, "qoi") == 0) { *format = Format::Qoi; return true; }
+	if (strcmp(name, "y4m") == 0) { *format = Format::Y4m; return true; }
+	return false;
+}
+
+void CaptureWriter::submit(const FrameReadback::Frame& frame)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	auto now = std::chrono::steady_clock::now();
+	if (m_Stats.submitted == 0)
+	{
+		m_FirstSubmit = now;
+	}
+	m_Stats.submitted++;
+
+	if (m_Queue.size() + m_Reserved >= m_Settings.queueCapacity)
+	{
+		if (m_Settings.overflowPolicy == OverflowPolicy::Drop)
+		{
+			m_Stats.dropped++;
+			return;
+		}
+
+		// Back pressure: the readback worker (and behind it the render thread) waits for the encoders
+		m_SpaceCondition.wait(lock, [this]() { return m_Queue.size() + m_Reserved < m_Settings.queueCapacity; });
+		m_Stats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - now).count();
+	}
+
+	// The slot is reserved, the frame is copied without holding the lock (the encoders keep taking frames meanwhile).
+	// Buffers come back from the encoders, after the first few frames the copy allocates nothing.
+	m_Reserved++;
+	CaptureFrame captureFrame;
+	if (!m_FreeBuffers.empty())
+	{
+		captureFrame.rgba = std::move(m_FreeBuffers.back());
+		m_FreeBuffers.pop_back();
+	}
+	lock.unlock();
+
+	captureFrame.frameIndex = frame.frameIndex;
+	captureFrame.width = frame.width;
+	captureFrame.height = frame.height;
+	captureFrame.rgba.assign(frame.rgba, frame.rgba + (size_t)frame.width * frame.height * 4);
+
+	lock.lock();
+	m_Reserved--;
+	captureFrame.sequence = m_NextSequence++;
+	m_Queue.push_back(std::move(captureFrame));
+
+	m_Stats.queueDepth = (uint32_t)m_Queue.size();
+	m_Stats.maxQueueDepth = std::max(m_Stats.maxQueueDepth, m_Stats.queueDepth);
+	m_Stats.queueDepthSum += m_Stats.queueDepth;
+
+	lock.unlock();
+	m_WorkCondition.notify_one();
+}
+
+void CaptureWriter::finish()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_IdleCondition.wait(lock, [this]() { return m_Queue.empty() && m_Reserved == 0 && m_Encoding == 0; });
+
+	lock.unlock();
+
+	std::lock_guard<std::mutex> writeLock(m_WriteMutex);
+	if (m_Video.is_open())
+	{
+		m_Video.flush();
+	}
+}
+
+CaptureWriter::Stats CaptureWriter::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	Stats stats = m_Stats;
+	stats.queueDepth = (uint32_t)m_Queue.size();
+	stats.seconds = stats.written > 0 ? std::chrono::duration<double>(m_LastWrite - m_FirstSubmit).count() : 0.0;
+	return stats;
+}
+
+void CaptureWriter::printStats()
+{
+	Stats stats = getStats();
+
+	double accepted = (double)(stats.submitted - std::min(stats.submitted, stats.dropped));
+	printf("==== Capture (%s, %u encoder threads, %s when full) ====\n", getFormatName(m_Settings.format), m_Settings.workerCount,
+		m_Settings.overflowPolicy == OverflowPolicy::Drop ? "drop" : "stall");
+	printf("  frames       %llu submitted, %llu written, %llu dropped, %llu failed\n",
+		(unsigned long long)stats.submitted, (unsigned long long)stats.written, (unsigned long long)stats.dropped, (unsigned long long)stats.failed);
+	printf("  throughput   %.1f frames/s, %.1f MB/s, %.1f MB total\n",
+		stats.seconds > 0.0 ? stats.written / stats.seconds : 0.0, stats.seconds > 0.0 ? stats.bytes / stats.seconds / 1e6 : 0.0, stats.bytes / 1e6);
+	printf("  encode       %.2f ms/frame (per thread)\n", stats.written > 0 ? stats.encodeMs / stats.written : 0.0);
+	printf("  queue depth  avg %.1f, max %u of %u, producer stalled %.1f ms\n",
+		accepted > 0.0 ? stats.queueDepthSum / accepted : 0.0, stats.maxQueueDepth, m_Settings.queueCapacity, stats.stallMs);
+}
+
+void CaptureWriter::workerMain()
+{
+	std::vector<uint8_t> encoded;
+
+	while (true)
+	{
+		CaptureFrame frame;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WorkCondition.wait(lock, [this]() { return m_Stop || !m_Queue.empty(); });
+
+			if (m_Queue.empty()) return; // Stopped
+
+			frame = std::move(m_Queue.front());
+			m_Queue.pop_front();
+			m_Encoding++;
+		}
+		m_SpaceCondition.notify_one();
+
+		auto encodeStart = std::chrono::steady_clock::now();
+
+		encoded.clear();
+		switch (m_Settings.format)
+		{
+		case Format::Png: encodePng(frame.rgba.data(), frame.width, frame.height, encoded); break;
+		case Format::Qoi: encodeQoi(frame.rgba.data(), frame.width, frame.height, encoded); break;
+		case Format::Y4m: encodeY4mFrame(frame.rgba.data(), frame.width, frame.height, encoded); break;
+		}
+
+		double encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - encodeStart).count();
+
+		bool written = m_Settings.format == Format::Y4m ? writeVideoFrame(frame, encoded) : writeImage(frame, encoded);
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Encoding--;
+			// Enough buffers for a full queue plus the frames being encoded
+			if (m_FreeBuffers.size() < m_Settings.queueCapacity + m_Settings.workerCount)
+			{
+				m_FreeBuffers.push_back(std::move(frame.rgba));
+			}
+			m_Stats.encodeMs += encodeMs;
+			if (written)
+			{
+				m_Stats.written++;
+				m_Stats.bytes += encoded.size();
+				m_LastWrite = std::chrono::steady_clock::now();
+			}
+		}
+		m_IdleCondition.notify_all();
+	}
+}
+
+void CaptureWriter::createOutputDirectory()
+{
+	// The image directory or the directory of the video file, with every missing parent. Existing directories are fine.
+	std::string directory = m_Settings.path;
+	if (m_Settings.format == Format::Y4m)
+	{
+		size_t separator = directory.find_last_of("/\\");
+		directory = separator != std::string::npos ? directory.substr(0, separator) : std::string();
+	}
+
+	for (size_t end = 0; end != std::string::npos && !directory.empty(); )
+	{
+		end = directory.find_first_of("/\\", end + 1);
+		std::string partial = directory.substr(0, end);
+#ifdef _WIN32
+		CreateDirectoryA(partial.c_str(), nullptr);
+#else
+		mkdir(partial.c_str(), 0755);
+#endif
+	}
+}
+
+bool CaptureWriter::writeImage(const CaptureFrame& frame, const std::vector<uint8_t>& encoded)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_WriteMutex);
+		if (!m_DirectoryCreated)
+		{
+			createOutputDirectory();
+			m_DirectoryCreated = true;
+		}
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "/frame_%06llu.%s", (unsigned long long)frame.frameIndex, m_Settings.format == Format::Png ? "png" : "qoi");
+
+	std::ofstream file(m_Settings.path + name, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+
+	if (!file.good())
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stats.failed++;
+		return false;
+	}
+
+	return true;
+}
+
+bool CaptureWriter::writeVideoFrame(const CaptureFrame& frame, const std::vector<uint8_t>& encoded)
+{
+	// One stream, frames in acceptance order: wait for this frame's turn (encoded in parallel, written in sequence).
+	// Only the write mutex is held during the file I/O, the queue stays available to submit() and the other encoders.
+	std::unique_lock<std::mutex> lock(m_WriteMutex);
+	m_WriteCondition.wait(lock, [&]() { return m_NextWriteSequence == frame.sequence; });
+
+	bool written = false;
+	bool dropped = false;
+
+	if (!m_Video.is_open())
+	{
+		createOutputDirectory();
+		m_Video.open(m_Settings.path, std::ios::binary | std::ios::trunc);
+		m_VideoWidth = frame.width;
+		m_VideoHeight = frame.height;
+
+		char header[128];
+		snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444 XCOLORRANGE=FULL\n", m_VideoWidth, m_VideoHeight, m_Settings.videoFrameRate);
+		m_Video << header;
+	}
+
+	if (frame.width != m_VideoWidth || frame.height != m_VideoHeight)
+	{
+		// The stream has one size, frames after a resize do not fit
+		if (!m_VideoSizeMismatch || frame.sequence % 60 == 0)
+		{
+			printf("Capture: %ux%u frame does not fit the %ux%u video, dropped.\n", frame.width, frame.height, m_VideoWidth, m_VideoHeight);
+		}
+		m_VideoSizeMismatch = true;
+		dropped = true;
+	}
+	else
+	{
+		m_Video.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+		written = m_Video.good();
+	}
+
+	m_NextWriteSequence++;
+	lock.unlock();
+	m_WriteCondition.notify_all();
+
+	// Stats (and the written ones by the caller) under the queue lock, after the I/O
+	if (!written)
+	{
+		std::lock_guard<std::mutex> statsLock(m_Mutex);
+		if (dropped)
+		{
+			m_Stats.dropped++;
+		}
+		else
+		{
+			m_Stats.failed++;
+		}
+	}
+
+	return written;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "FrameReadback.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Writes captured frames (from FrameReadback) to disk on a small pool of encoder threads: one image per frame
+// (PNG or QOI, named after the frame index) or one raw Y4M video stream (frames written in order).
+// The queue in front of the encoders is bounded. When it is full the overflow policy either drops the frame or
+// blocks submit(), which backs up the readback worker and, with FrameReadback's wait when full, the render thread.
+class CaptureWriter
+{
+public:
+	enum class Format
+	{
+		Png, // Lossless, deflate with fixed Huffman codes (fast, moderate compression)
+		Qoi, // Lossless, faster to encode than PNG at a similar size
+		Y4m  // Raw YUV 4:4:4 video, one file for the whole capture
+	};
+
+	enum class OverflowPolicy
+	{
+		Drop, // Keep the render rate, lose frames while the encoders are behind
+		Stall // Keep every frame, slow the producer down to the encoders
+	};
+
+	struct Settings
+	{
+		Format format = Format::Png;
+		std::string path;             // Directory of an image sequence or the Y4M file, empty = Captures/ or capture.y4m
+		uint32_t interval = 1;        // Every Nth rendered frame (applied by the renderer, see setReadbackInterval)
+		uint32_t workerCount = 2;
+		uint32_t queueCapacity = 8;   // Frames waiting for an encoder
+		OverflowPolicy overflowPolicy = OverflowPolicy::Drop;
+		uint32_t videoFrameRate = 60; // Y4M header only, the playback rate
+	};
+
+	struct Stats
+	{
+		uint64_t submitted = 0;
+		uint64_t written = 0;
+		uint64_t dropped = 0;        // Queue full (drop policy) or a frame size change within a video
+		uint64_t failed = 0;         // Could not be written
+		uint64_t bytes = 0;
+		double encodeMs = 0.0;       // Summed over the workers
+		double stallMs = 0.0;        // submit() blocked on a full queue (stall policy)
+		uint32_t queueDepth = 0;
+		uint32_t maxQueueDepth = 0;
+		double queueDepthSum = 0.0;  // Sampled at every submit
+		double seconds = 0.0;        // First submit to last write
+	};
+
+	explicit CaptureWriter(const Settings& settings);
+	~CaptureWriter(); // Writes everything still queued
+
+	CaptureWriter(const CaptureWriter&) = delete;
+	CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+	static const char* getFormatName(Format format);
+	static bool parseFormat(const char* name, Format* format);
+
+	// From the FrameReadback callback, the pixels are copied (into a pooled buffer, outside the lock)
+	void submit(const FrameReadback::Frame& frame);
+
+	// Waits until every queued frame has been written
+	void finish();
+
+	const Settings& getSettings() { return m_Settings; }
+	Stats getStats();
+	void printStats();
+
+private:
+	struct CaptureFrame
+	{
+		uint64_t sequence;   // Order of acceptance, the Y4M stream is written in this order
+		uint64_t frameIndex;
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> rgba;
+	};
+
+	void workerMain();
+	bool writeImage(const CaptureFrame& frame, const std::vector<uint8_t>& encoded);
+	bool writeVideoFrame(const CaptureFrame& frame, const std::vector<uint8_t>& encoded);
+	void createOutputDirectory();
+
+	Settings m_Settings;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkCondition;  // Frames queued or stopping
+	std::condition_variable m_SpaceCondition; // Queue space freed
+	std::condition_variable m_IdleCondition;  // Nothing queued or being encoded
+	std::deque<CaptureFrame> m_Queue;
+	uint32_t m_Reserved = 0; // Queue slots of frames still being copied by submit()
+	uint32_t m_Encoding = 0;
+	std::vector<std::vector<uint8_t>> m_FreeBuffers; // Pixel buffers of written frames, reused by submit()
+	uint64_t m_NextSequence = 0;
+	bool m_Stop = false;
+
+	// Output, under its own mutex: file writes never hold up submit() or the queue
+	std::mutex m_WriteMutex;
+	std::condition_variable m_WriteCondition; // Y4M: the next frame in sequence may be written
+	uint64_t m_NextWriteSequence = 0;
+	bool m_DirectoryCreated = false;
+
+	// Y4M stream, only written by the worker whose frame is next in sequence
+	std::ofstream m_Video;
+	uint32_t m_VideoWidth = 0;
+	uint32_t m_VideoHeight = 0;
+	bool m_VideoSizeMismatch = false; // A frame was dropped for it, reported again every 60th frame
+
+	Stats m_Stats;
+	std::chrono::steady_clock::time_point m_FirstSubmit;
+	std::chrono::steady_clock::time_point m_LastWrite;
+
+	std::vector<std::thread> m_Workers;
+
+};
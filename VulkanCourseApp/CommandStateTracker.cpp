@@ -0,0 +1,196 @@
+#include "CommandStateTracker.h"
+
+#include <cstring>
+
+
+uint32_t CommandStateTracker::Stats::totalIssued() const
+{
+	return pipelines.issued + descriptorSets.issued + vertexBuffers.issued + indexBuffers.issued + pushConstants.issued;
+}
+
+uint32_t CommandStateTracker::Stats::totalElided() const
+{
+	return pipelines.elided + descriptorSets.elided + vertexBuffers.elided + indexBuffers.elided + pushConstants.elided;
+}
+
+bool CommandStateTracker::Stats::operator==(const Stats& other) const
+{
+	const Counter* a[] = { &pipelines, &descriptorSets, &vertexBuffers, &indexBuffers, &pushConstants };
+	const Counter* b[] = { &other.pipelines, &other.descriptorSets, &other.vertexBuffers, &other.indexBuffers, &other.pushConstants };
+
+	for (size_t i = 0; i < 5; i++)
+	{
+		if (a[i]->issued != b[i]->issued || a[i]->elided != b[i]->elided) return false;
+	}
+
+	return true;
+}
+
+CommandStateTracker::Stats& CommandStateTracker::Stats::operator+=(const Stats& other)
+{
+	Counter* a[] = { &pipelines, &descriptorSets, &vertexBuffers, &indexBuffers, &pushConstants };
+	const Counter* b[] = { &other.pipelines, &other.descriptorSets, &other.vertexBuffers, &other.indexBuffers, &other.pushConstants };
+
+	for (size_t i = 0; i < 5; i++)
+	{
+		a[i]->issued += b[i]->issued;
+		a[i]->elided += b[i]->elided;
+	}
+
+	return *this;
+}
+
+void CommandStateTracker::begin(VkCommandBuffer commandBuffer)
+{
+	// State does not carry over between command buffers (or recordings of the same one)
+	m_CommandBuffer = commandBuffer;
+
+	m_Pipelines.fill(VK_NULL_HANDLE);
+
+	for (auto& bindPointSets : m_DescriptorSets)
+	{
+		bindPointSets.fill(BoundDescriptorSet());
+	}
+
+	m_VertexBuffers.fill(BoundVertexBuffer());
+
+	m_IndexBuffer = VK_NULL_HANDLE;
+	m_IndexOffset = 0;
+	m_IndexType = VK_INDEX_TYPE_UINT32;
+
+	m_PushConstantLayout = VK_NULL_HANDLE;
+	m_PushConstantStages.fill(0);
+
+	m_Stats = Stats();
+}
+
+void CommandStateTracker::bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline)
+{
+	VkPipeline& bound = m_Pipelines[bindPointIndex(bindPoint)];
+
+	if (bound == pipeline)
+	{
+		m_Stats.pipelines.elided++;
+		return;
+	}
+
+	vkCmdBindPipeline(m_CommandBuffer, bindPoint, pipeline);
+	bound = pipeline;
+	m_Stats.pipelines.issued++;
+}
+
+void CommandStateTracker::bindDescriptorSet(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex, VkDescriptorSet descriptorSet,
+	uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets)
+{
+	auto& bindPointSets = m_DescriptorSets[bindPointIndex(bindPoint)];
+
+	if (setIndex < MAX_DESCRIPTOR_SETS)
+	{
+		BoundDescriptorSet& bound = bindPointSets[setIndex];
+
+		bool sameOffsets = bound.dynamicOffsets.size() == dynamicOffsetCount &&
+			(dynamicOffsetCount == 0 || memcmp(bound.dynamicOffsets.data(), dynamicOffsets, dynamicOffsetCount * sizeof(uint32_t)) == 0);
+
+		// Only an identical bind through the same pipeline layout is guaranteed to be a no-op
+		if (bound.layout == layout && bound.descriptorSet == descriptorSet && sameOffsets)
+		{
+			m_Stats.descriptorSets.elided++;
+			return;
+		}
+	}
+
+	vkCmdBindDescriptorSets(m_CommandBuffer, bindPoint, layout, setIndex, 1, &descriptorSet, dynamicOffsetCount, dynamicOffsets);
+	m_Stats.descriptorSets.issued++;
+
+	// Binding through a different layout may disturb the other slots, stop trusting them
+	for (uint32_t i = 0; i < MAX_DESCRIPTOR_SETS; i++)
+	{
+		if (i != setIndex && bindPointSets[i].layout != layout)
+		{
+			bindPointSets[i] = BoundDescriptorSet();
+		}
+	}
+
+	if (setIndex < MAX_DESCRIPTOR_SETS)
+	{
+		BoundDescriptorSet& bound = bindPointSets[setIndex];
+		bound.layout = layout;
+		bound.descriptorSet = descriptorSet;
+		bound.dynamicOffsets.assign(dynamicOffsets, dynamicOffsets + dynamicOffsetCount);
+	}
+}
+
+void CommandStateTracker::bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset)
+{
+	if (binding < MAX_VERTEX_BINDINGS)
+	{
+		BoundVertexBuffer& bound = m_VertexBuffers[binding];
+
+		if (bound.buffer == buffer && bound.offset == offset)
+		{
+			m_Stats.vertexBuffers.elided++;
+			return;
+		}
+
+		bound.buffer = buffer;
+		bound.offset = offset;
+	}
+
+	vkCmdBindVertexBuffers(m_CommandBuffer, binding, 1, &buffer, &offset);
+	m_Stats.vertexBuffers.issued++;
+}
+
+void CommandStateTracker::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+	if (m_IndexBuffer == buffer && m_IndexOffset == offset && m_IndexType == indexType)
+	{
+		m_Stats.indexBuffers.elided++;
+		return;
+	}
+
+	vkCmdBindIndexBuffer(m_CommandBuffer, buffer, offset, indexType);
+	m_IndexBuffer = buffer;
+	m_IndexOffset = offset;
+	m_IndexType = indexType;
+	m_Stats.indexBuffers.issued++;
+}
+
+void CommandStateTracker::pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* data)
+{
+	bool tracked = offset + size <= MAX_PUSH_CONSTANT_BYTES;
+
+	if (tracked && layout == m_PushConstantLayout)
+	{
+		bool same = memcmp(&m_PushConstantData[offset], data, size) == 0;
+
+		for (uint32_t i = offset; same && i < offset + size; i++)
+		{
+			same = m_PushConstantStages[i] == stageFlags;
+		}
+
+		if (same)
+		{
+			m_Stats.pushConstants.elided++;
+			return;
+		}
+	}
+
+	vkCmdPushConstants(m_CommandBuffer, layout, stageFlags, offset, size, data);
+	m_Stats.pushConstants.issued++;
+
+	// Push constants pushed through another layout are not guaranteed to survive
+	if (layout != m_PushConstantLayout)
+	{
+		m_PushConstantLayout = layout;
+		m_PushConstantStages.fill(0);
+	}
+
+	if (tracked)
+	{
+		memcpy(&m_PushConstantData[offset], data, size);
+		for (uint32_t i = offset; i < offset + size; i++)
+		{
+			m_PushConstantStages[i] = stageFlags;
+		}
+	}
+}
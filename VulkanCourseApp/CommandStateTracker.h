@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+
+// Thin wrapper around command buffer recording that remembers the bound state
+// (pipeline, descriptor sets per slot, vertex/index buffers, push constant bytes)
+// and skips bind calls that would not change it. Counts issued and elided calls per recording.
+class CommandStateTracker
+{
+public:
+	static constexpr uint32_t MAX_DESCRIPTOR_SETS = 8;
+	static constexpr uint32_t MAX_VERTEX_BINDINGS = 16;
+	static constexpr uint32_t MAX_PUSH_CONSTANT_BYTES = 128; // guaranteed minimum of maxPushConstantsSize
+
+	struct Counter
+	{
+		uint32_t issued = 0;
+		uint32_t elided = 0;
+	};
+
+	struct Stats
+	{
+		Counter pipelines;
+		Counter descriptorSets;
+		Counter vertexBuffers;
+		Counter indexBuffers;
+		Counter pushConstants;
+
+		uint32_t totalIssued() const;
+		uint32_t totalElided() const;
+		bool operator==(const Stats& other) const;
+		bool operator!=(const Stats& other) const { return !(*this == other); }
+		Stats& operator+=(const Stats& other); // Totals over several command buffers (parallel recording)
+	};
+
+	// Starts tracking a freshly begun command buffer (nothing is bound yet)
+	void begin(VkCommandBuffer commandBuffer);
+
+	void bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+
+	// One set at a time, so each set is compared (and skipped) on its own
+	void bindDescriptorSet(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex, VkDescriptorSet descriptorSet,
+		uint32_t dynamicOffsetCount = 0, const uint32_t* dynamicOffsets = nullptr);
+
+	void bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset);
+	void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+
+	void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* data);
+
+	VkCommandBuffer getCommandBuffer() { return m_CommandBuffer; }
+	const Stats& getStats() { return m_Stats; }
+
+private:
+	struct BoundDescriptorSet
+	{
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		std::vector<uint32_t> dynamicOffsets;
+	};
+
+	struct BoundVertexBuffer
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+	};
+
+	// Graphics and compute have separate pipeline and descriptor set state
+	static uint32_t bindPointIndex(VkPipelineBindPoint bindPoint) { return bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? 1 : 0; }
+
+	VkCommandBuffer m_CommandBuffer = VK_NULL_HANDLE;
+
+	std::array<VkPipeline, 2> m_Pipelines;
+	std::array<std::array<BoundDescriptorSet, MAX_DESCRIPTOR_SETS>, 2> m_DescriptorSets;
+
+	std::array<BoundVertexBuffer, MAX_VERTEX_BINDINGS> m_VertexBuffers;
+
+	VkBuffer m_IndexBuffer = VK_NULL_HANDLE;
+	VkDeviceSize m_IndexOffset = 0;
+	VkIndexType m_IndexType = VK_INDEX_TYPE_UINT32;
+
+	// Push constant shadow copy, only valid for m_PushConstantLayout
+	VkPipelineLayout m_PushConstantLayout = VK_NULL_HANDLE;
+	std::array<uint8_t, MAX_PUSH_CONSTANT_BYTES> m_PushConstantData;
+	std::array<VkShaderStageFlags, MAX_PUSH_CONSTANT_BYTES> m_PushConstantStages; // 0 = byte not pushed yet
+
+	Stats m_Stats;
+
+};
@@ -0,0 +1,115 @@
+#include "DescriptorAllocator.h"
+
+#include <stdexcept>
+
+
+DescriptorAllocator::DescriptorAllocator(std::shared_ptr<DeviceLVE> device, uint32_t setsPerPool, PoolSizes poolSizes)
+	: m_Device{ device }, m_SetsPerPool{ setsPerPool }, m_PoolSizes{ poolSizes }
+{
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+	for (auto pool : m_UsedPools)
+	{
+		vkDestroyDescriptorPool(m_Device->device(), pool, nullptr);
+	}
+
+	for (auto pool : m_FreePools)
+	{
+		vkDestroyDescriptorPool(m_Device->device(), pool, nullptr);
+	}
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+	if (m_CurrentPool == VK_NULL_HANDLE)
+	{
+		m_CurrentPool = grabPool();
+		m_UsedPools.push_back(m_CurrentPool);
+	}
+
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = m_CurrentPool;
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet descriptorSet;
+	VkResult result = vkAllocateDescriptorSets(m_Device->device(), &setAllocInfo, &descriptorSet);
+
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+	{
+		// Current pool is full, continue in a fresh one
+		m_CurrentPool = grabPool();
+		m_UsedPools.push_back(m_CurrentPool);
+
+		setAllocInfo.descriptorPool = m_CurrentPool;
+		result = vkAllocateDescriptorSets(m_Device->device(), &setAllocInfo, &descriptorSet);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate a Descriptor Set!");
+	}
+
+	return descriptorSet;
+}
+
+void DescriptorAllocator::resetPools()
+{
+	for (auto pool : m_UsedPools)
+	{
+		vkResetDescriptorPool(m_Device->device(), pool, 0);
+		m_FreePools.push_back(pool);
+	}
+
+	m_UsedPools.clear();
+	m_CurrentPool = VK_NULL_HANDLE;
+}
+
+VkDescriptorPool DescriptorAllocator::grabPool()
+{
+	// Reuse a pool released by resetPools() if there is one
+	if (!m_FreePools.empty())
+	{
+		VkDescriptorPool pool = m_FreePools.back();
+		m_FreePools.pop_back();
+		return pool;
+	}
+
+	return createPool(m_SetsPerPool);
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount)
+{
+	std::vector<VkDescriptorPoolSize> descriptorPoolSizes;
+	descriptorPoolSizes.reserve(m_PoolSizes.sizes.size());
+
+	for (auto& size : m_PoolSizes.sizes)
+	{
+		VkDescriptorPoolSize poolSize = {};
+		poolSize.type = size.first;
+		poolSize.descriptorCount = static_cast<uint32_t>(size.second * setCount);
+		descriptorPoolSizes.push_back(poolSize);
+	}
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = 0; // Sets are only ever released all at once with vkResetDescriptorPool
+	poolCreateInfo.maxSets = setCount;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());
+	poolCreateInfo.pPoolSizes = descriptorPoolSizes.data();
+
+	VkDescriptorPool pool;
+	VkResult result = vkCreateDescriptorPool(m_Device->device(), &poolCreateInfo, nullptr, &pool);
+
+	printf("---- vkCreateDescriptorPool pool DescriptorAllocator::createPool()\n");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Pool!");
+	}
+
+	return pool;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "DeviceLVE.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+// Allocates descriptor sets from a chain of pools, a new pool is added whenever the current one runs out.
+// Pools are never freed one set at a time: either keep the sets for the lifetime of the allocator
+// (persistent sets, e.g. textures) or call resetPools() once per frame (transient sets).
+class DescriptorAllocator
+{
+public:
+	// Descriptors of each type reserved per set, multiplied by the number of sets in a pool
+	struct PoolSizes
+	{
+		std::vector<std::pair<VkDescriptorType, float>> sizes =
+		{
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 2.0f },
+		};
+	};
+
+	DescriptorAllocator(std::shared_ptr<DeviceLVE> device, uint32_t setsPerPool = 32, PoolSizes poolSizes = PoolSizes());
+	~DescriptorAllocator();
+
+	DescriptorAllocator(const DescriptorAllocator&) = delete;
+	DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+	// Returns every set allocated so far to the pools (sets must no longer be in use by the GPU)
+	void resetPools();
+
+	size_t getPoolCount() { return m_UsedPools.size() + m_FreePools.size(); }
+
+private:
+	VkDescriptorPool grabPool();
+	VkDescriptorPool createPool(uint32_t setCount);
+
+	std::shared_ptr<DeviceLVE> m_Device;
+
+	uint32_t m_SetsPerPool;
+	PoolSizes m_PoolSizes;
+
+	VkDescriptorPool m_CurrentPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorPool> m_UsedPools;
+	std::vector<VkDescriptorPool> m_FreePools;
+
+};
@@ -0,0 +1,159 @@
+#include "DescriptorLayoutCache.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+
+DescriptorLayoutCache::DescriptorLayoutCache(std::shared_ptr<DeviceLVE> device)
+	: m_Device{ device }
+{
+}
+
+DescriptorLayoutCache::~DescriptorLayoutCache()
+{
+	for (auto& updateTemplate : m_UpdateTemplates)
+	{
+		vkDestroyDescriptorUpdateTemplate(m_Device->device(), updateTemplate.second, nullptr);
+	}
+
+	for (auto& layout : m_LayoutCache)
+	{
+		vkDestroyDescriptorSetLayout(m_Device->device(), layout.second, nullptr);
+	}
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::createDescriptorLayout(const VkDescriptorSetLayoutCreateInfo* createInfo)
+{
+	DescriptorLayoutInfo layoutInfo;
+	layoutInfo.bindings.assign(createInfo->pBindings, createInfo->pBindings + createInfo->bindingCount);
+
+	for (auto& binding : layoutInfo.bindings)
+	{
+		// Immutable samplers would have to be part of the key, none of our layouts use them
+		if (binding.pImmutableSamplers != nullptr)
+		{
+			throw std::runtime_error("DescriptorLayoutCache does not support immutable samplers!");
+		}
+	}
+
+	// Same bindings in a different order describe the same layout
+	std::sort(layoutInfo.bindings.begin(), layoutInfo.bindings.end(),
+		[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+	auto it = m_LayoutCache.find(layoutInfo);
+	if (it != m_LayoutCache.end())
+	{
+		return it->second;
+	}
+
+	VkDescriptorSetLayout layout;
+	VkResult result = vkCreateDescriptorSetLayout(m_Device->device(), createInfo, nullptr, &layout);
+
+	printf("---- vkCreateDescriptorSetLayout layout DescriptorLayoutCache::createDescriptorLayout()\n");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	m_LayoutCache[layoutInfo] = layout;
+	m_LayoutInfos[layout] = layoutInfo;
+
+	return layout;
+}
+
+VkDescriptorUpdateTemplate DescriptorLayoutCache::getUpdateTemplate(VkDescriptorSetLayout layout)
+{
+	auto it = m_UpdateTemplates.find(layout);
+	if (it != m_UpdateTemplates.end())
+	{
+		return it->second;
+	}
+
+	auto infoIt = m_LayoutInfos.find(layout);
+	if (infoIt == m_LayoutInfos.end())
+	{
+		throw std::runtime_error("Descriptor Set Layout was not created by the DescriptorLayoutCache!");
+	}
+
+	// One template entry per binding, each reading descriptorCount consecutive DescriptorUpdateEntry
+	std::vector<VkDescriptorUpdateTemplateEntry> templateEntries;
+	size_t entryIndex = 0;
+
+	for (auto& binding : infoIt->second.bindings)
+	{
+		VkDescriptorUpdateTemplateEntry templateEntry = {};
+		templateEntry.dstBinding = binding.binding;
+		templateEntry.dstArrayElement = 0;
+		templateEntry.descriptorCount = binding.descriptorCount;
+		templateEntry.descriptorType = binding.descriptorType;
+		templateEntry.offset = entryIndex * sizeof(DescriptorUpdateEntry);
+		templateEntry.stride = sizeof(DescriptorUpdateEntry);
+		templateEntries.push_back(templateEntry);
+
+		entryIndex += binding.descriptorCount;
+	}
+
+	VkDescriptorUpdateTemplateCreateInfo templateCreateInfo = {};
+	templateCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+	templateCreateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(templateEntries.size());
+	templateCreateInfo.pDescriptorUpdateEntries = templateEntries.data();
+	templateCreateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+	templateCreateInfo.descriptorSetLayout = layout;
+
+	VkDescriptorUpdateTemplate updateTemplate;
+	VkResult result = vkCreateDescriptorUpdateTemplate(m_Device->device(), &templateCreateInfo, nullptr, &updateTemplate);
+
+	printf("---- vkCreateDescriptorUpdateTemplate updateTemplate DescriptorLayoutCache::getUpdateTemplate()\n");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Update Template!");
+	}
+
+	m_UpdateTemplates[layout] = updateTemplate;
+
+	return updateTemplate;
+}
+
+void DescriptorLayoutCache::updateDescriptorSet(VkDescriptorSet descriptorSet, VkDescriptorSetLayout layout, const DescriptorUpdateEntry* entries)
+{
+	vkUpdateDescriptorSetWithTemplate(m_Device->device(), descriptorSet, getUpdateTemplate(layout), entries);
+}
+
+bool DescriptorLayoutCache::DescriptorLayoutInfo::operator==(const DescriptorLayoutInfo& other) const
+{
+	if (other.bindings.size() != bindings.size())
+	{
+		return false;
+	}
+
+	// Bindings are sorted, so they can be compared one by one
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		if (other.bindings[i].binding != bindings[i].binding ||
+			other.bindings[i].descriptorType != bindings[i].descriptorType ||
+			other.bindings[i].descriptorCount != bindings[i].descriptorCount ||
+			other.bindings[i].stageFlags != bindings[i].stageFlags)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+size_t DescriptorLayoutCache::DescriptorLayoutInfo::hash() const
+{
+	size_t result = std::hash<size_t>()(bindings.size());
+
+	for (const VkDescriptorSetLayoutBinding& b : bindings)
+	{
+		// Pack the binding description into 64 bits and mix it into the hash
+		size_t bindingHash = (size_t)b.binding | (size_t)b.descriptorType << 8 | (size_t)b.descriptorCount << 16 | (size_t)b.stageFlags << 24;
+		result ^= std::hash<size_t>()(bindingHash) + 0x9e3779b9 + (result << 6) + (result >> 2);
+	}
+
+	return result;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "DeviceLVE.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+// One descriptor worth of data for vkUpdateDescriptorSetWithTemplate.
+// Templates created by DescriptorLayoutCache read an array of these, one entry per descriptor,
+// in binding order (bindings with descriptorCount > 1 take that many consecutive entries).
+union DescriptorUpdateEntry
+{
+	VkDescriptorBufferInfo buffer;
+	VkDescriptorImageInfo image;
+	VkBufferView texelBufferView;
+};
+
+// Deduplicates descriptor set layouts by their bindings, so identical layouts requested again
+// (e.g. on every recreateSwapChain) return the same VkDescriptorSetLayout.
+// Also owns one descriptor update template per layout.
+class DescriptorLayoutCache
+{
+public:
+	DescriptorLayoutCache(std::shared_ptr<DeviceLVE> device);
+	~DescriptorLayoutCache();
+
+	DescriptorLayoutCache(const DescriptorLayoutCache&) = delete;
+	DescriptorLayoutCache& operator=(const DescriptorLayoutCache&) = delete;
+
+	VkDescriptorSetLayout createDescriptorLayout(const VkDescriptorSetLayoutCreateInfo* createInfo);
+
+	// Template for a layout returned by createDescriptorLayout, created on first use
+	VkDescriptorUpdateTemplate getUpdateTemplate(VkDescriptorSetLayout layout);
+
+	// Writes all bindings of the set from entries laid out as described above DescriptorUpdateEntry
+	void updateDescriptorSet(VkDescriptorSet descriptorSet, VkDescriptorSetLayout layout, const DescriptorUpdateEntry* entries);
+
+	size_t getLayoutCount() { return m_LayoutCache.size(); }
+
+private:
+	struct DescriptorLayoutInfo
+	{
+		// Sorted by binding number
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+		bool operator==(const DescriptorLayoutInfo& other) const;
+		size_t hash() const;
+	};
+
+	struct DescriptorLayoutHash
+	{
+		size_t operator()(const DescriptorLayoutInfo& info) const { return info.hash(); }
+	};
+
+	std::shared_ptr<DeviceLVE> m_Device;
+
+	std::unordered_map<DescriptorLayoutInfo, VkDescriptorSetLayout, DescriptorLayoutHash> m_LayoutCache;
+	std::unordered_map<VkDescriptorSetLayout, DescriptorLayoutInfo> m_LayoutInfos;
+	std::unordered_map<VkDescriptorSetLayout, VkDescriptorUpdateTemplate> m_UpdateTemplates;
+
+};
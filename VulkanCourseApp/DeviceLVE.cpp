@@ -1,11 +1,21 @@
 #include "DeviceLVE.h"
+#include "PipelineRegistry.h"
+#include "ShaderLibrary.h"
 
 // std headers
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
 
 // local callback functions
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
@@ -54,9 +64,19 @@ DeviceLVE::DeviceLVE(std::shared_ptr<WindowLVE> window) : m_Window{ window } {
     pickPhysicalDevice();
     createLogicalDevice();
     createCommandPool();
+    createPipelineCache();
+    pipelineRegistry_ = std::make_unique<PipelineRegistry>(device_, pipelineCache_);
+    shaderLibrary_ = std::make_unique<ShaderLibrary>(device_, *pipelineRegistry_);
 }
 
 DeviceLVE::~DeviceLVE() {
+    shaderLibrary_.reset();
+    pipelineRegistry_.reset();
+
+    // Everything compiled this run (new pipelines included) is there for the next start
+    savePipelineCache();
+    vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
+
     vkDestroyCommandPool(device_, commandPool, nullptr);
     vkDestroyDevice(device_, nullptr);
 
@@ -64,7 +84,9 @@ DeviceLVE::~DeviceLVE() {
         DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
     }
 
-    vkDestroySurfaceKHR(instance, surface_, nullptr);
+    if (surface_ != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(instance, surface_, nullptr);
+    }
     vkDestroyInstance(instance, nullptr);
 }
 
@@ -79,7 +101,7 @@ void DeviceLVE::createInstance() {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_1; // descriptor update templates are core in 1.1
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -134,6 +156,10 @@ void DeviceLVE::pickPhysicalDevice() {
 
     vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
     std::cout << "physical device: " << properties.deviceName << std::endl;
+    if (isHeadless()) {
+        // No present support needed, any device with a graphics queue will do (lavapipe included, VK_ICD_FILENAMES picks the driver)
+        std::cout << "headless: no surface, " << (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU ? "CPU" : "GPU") << " device" << std::endl;
+    }
 }
 
 void DeviceLVE::createLogicalDevice() {
@@ -155,13 +181,33 @@ void DeviceLVE::createLogicalDevice() {
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+    // Timeline semaphores drive frame completion (FrameScheduler)
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &timelineFeatures;
 
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
     createInfo.pEnabledFeatures = &deviceFeatures;
+    std::vector<const char*> deviceExtensions = getDeviceExtensions();
+
+    // Optional: per heap memory usage for the benchmark report
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionCount, availableExtensions.data());
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+            deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            memoryBudgetSupported_ = true;
+        }
+    }
+
     createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
     createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
@@ -201,15 +247,125 @@ void DeviceLVE::createCommandPool() {
     printf("---- vkCreateCommandPool commandPool DeviceLVE::createCommandPool()\n");
 }
 
-void DeviceLVE::createSurface() { m_Window->createWindowSurface(instance, &surface_); }
+void DeviceLVE::createPipelineCache() {
+    std::vector<char> initialData;
+
+    std::ifstream file(pipelineCacheFile(), std::ios::binary | std::ios::ate);
+    if (file.is_open()) {
+        initialData.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(initialData.data(), initialData.size());
+
+        // A cache from another GPU or driver version is useless (and some drivers do not reject it themselves)
+        if (!isPipelineCacheCompatible(initialData)) {
+            std::cout << "pipeline cache: " << pipelineCacheFile() << " was written by a different device or driver, starting empty" << std::endl;
+            initialData.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = initialData.size();
+    cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+    VkResult result = vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_);
+
+    // Corrupt data may still be refused, an empty cache is always fine
+    if (result != VK_SUCCESS && !initialData.empty()) {
+        initialData.clear();
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        result = vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_);
+    }
+
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+
+    pipelineCacheWarm_ = !initialData.empty();
+
+    printf("---- vkCreatePipelineCache pipelineCache DeviceLVE::createPipelineCache() (%s, %i bytes loaded)\n",
+        pipelineCacheWarm_ ? "warm" : "cold", (int)initialData.size());
+}
+
+bool DeviceLVE::isPipelineCacheCompatible(const std::vector<char>& data) {
+    // Header version one: header size, header version, vendor ID, device ID (uint32 each), pipeline cache UUID
+    const size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+    if (data.size() < headerSize) {
+        return false;
+    }
+
+    uint32_t header[4];
+    memcpy(header, data.data(), sizeof(header));
+
+    return header[0] >= headerSize &&
+        header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        header[2] == properties.vendorID &&
+        header[3] == properties.deviceID &&
+        memcmp(data.data() + sizeof(header), properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void DeviceLVE::savePipelineCache() {
+    if (pipelineCache_ == VK_NULL_HANDLE) {
+        return;
+    }
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device_, pipelineCache_, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return;
+    }
+
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device_, pipelineCache_, &size, data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    // Write a temporary file and swap it in, a crash while writing never leaves a truncated cache behind
+    std::string tempFile = std::string(pipelineCacheFile()) + ".tmp";
+    {
+        std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "pipeline cache: failed to write " << tempFile << std::endl;
+            return;
+        }
+        file.write(data.data(), size);
+        if (!file.good()) {
+            std::cerr << "pipeline cache: failed to write " << tempFile << std::endl;
+            return;
+        }
+    }
+
+#ifdef _WIN32
+    bool replaced = MoveFileExA(tempFile.c_str(), pipelineCacheFile(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    bool replaced = std::rename(tempFile.c_str(), pipelineCacheFile()) == 0;
+#endif
+
+    if (!replaced) {
+        std::cerr << "pipeline cache: failed to replace " << pipelineCacheFile() << std::endl;
+        std::remove(tempFile.c_str());
+        return;
+    }
+
+    printf("Pipeline cache saved: %i bytes.\n", (int)size);
+}
+
+void DeviceLVE::createSurface() {
+    // Headless renders to offscreen images only, nothing is presented
+    if (isHeadless()) {
+        return;
+    }
+
+    m_Window->createWindowSurface(instance, &surface_);
+}
 
 bool DeviceLVE::isDeviceSuitable(VkPhysicalDevice device) {
     QueueFamilyIndices indices = findQueueFamilies(device);
 
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    bool swapChainAdequate = isHeadless();
+    if (extensionsSupported && !isHeadless()) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
@@ -217,8 +373,23 @@ bool DeviceLVE::isDeviceSuitable(VkPhysicalDevice device) {
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    bool apiVersionSupported = deviceProperties.apiVersion >= VK_API_VERSION_1_1;
+
+    // The extension being listed is not enough, the feature has to be reported as well
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+    VkPhysicalDeviceFeatures2 supportedFeatures2 = {};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &timelineFeatures;
+    if (apiVersionSupported && extensionsSupported) {
+        vkGetPhysicalDeviceFeatures2(device, &supportedFeatures2);
+    }
+
     return indices.isValid() && extensionsSupported && swapChainAdequate &&
-        supportedFeatures.samplerAnisotropy;
+        supportedFeatures.samplerAnisotropy && apiVersionSupported && timelineFeatures.timelineSemaphore;
 }
 
 void DeviceLVE::populateDebugMessengerCreateInfo(
@@ -271,8 +442,10 @@ bool DeviceLVE::checkValidationLayerSupport() {
 
 std::vector<const char*> DeviceLVE::getRequiredExtensions() {
     uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char** glfwExtensions = nullptr;
+    if (!isHeadless()) {
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    }
 
     std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 
@@ -317,6 +490,7 @@ bool DeviceLVE::checkDeviceExtensionSupport(VkPhysicalDevice device) {
         &extensionCount,
         availableExtensions.data());
 
+    std::vector<const char*> deviceExtensions = getDeviceExtensions();
     std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
     for (const auto& extension : availableExtensions) {
@@ -326,6 +500,17 @@ bool DeviceLVE::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return requiredExtensions.empty();
 }
 
+std::vector<const char*> DeviceLVE::getDeviceExtensions() {
+    std::vector<const char*> extensions = { VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME };
+
+    // Headless devices need no present support, lavapipe without a display included
+    if (!isHeadless()) {
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    return extensions;
+}
+
 QueueFamilyIndices DeviceLVE::findQueueFamilies(VkPhysicalDevice device) {
     QueueFamilyIndices indices;
 
@@ -340,10 +525,16 @@ QueueFamilyIndices DeviceLVE::findQueueFamilies(VkPhysicalDevice device) {
         if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
             indices.graphicsFamily = i;
         }
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-        if (queueFamily.queueCount > 0 && presentSupport) {
-            indices.presentationFamily = i;
+        if (isHeadless()) {
+            // Nothing is presented, the "presentation" queue is the graphics queue
+            indices.presentationFamily = indices.graphicsFamily;
+        }
+        else {
+            VkBool32 presentSupport = false;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+            if (queueFamily.queueCount > 0 && presentSupport) {
+                indices.presentationFamily = i;
+            }
         }
         if (indices.isValid()) {
             break;
@@ -411,6 +602,33 @@ uint32_t DeviceLVE::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags pr
     throw std::runtime_error("failed to find suitable memory type!");
 }
 
+std::vector<DeviceLVE::HeapMemory> DeviceLVE::getHeapMemory() {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    // Core in Vulkan 1.1 (the instance API version)
+    VkPhysicalDeviceMemoryProperties2 memoryProperties = {};
+    memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties.pNext = memoryBudgetSupported_ ? &budgetProperties : nullptr;
+    vkGetPhysicalDeviceMemoryProperties2(m_PhysicalDevice, &memoryProperties);
+
+    std::vector<HeapMemory> heaps;
+    for (uint32_t i = 0; i < memoryProperties.memoryProperties.memoryHeapCount; i++) {
+        const VkMemoryHeap& heap = memoryProperties.memoryProperties.memoryHeaps[i];
+
+        HeapMemory heapMemory = {};
+        heapMemory.size = heap.size;
+        heapMemory.deviceLocal = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        if (memoryBudgetSupported_) {
+            heapMemory.budget = budgetProperties.heapBudget[i];
+            heapMemory.usage = budgetProperties.heapUsage[i];
+        }
+        heaps.push_back(heapMemory);
+    }
+
+    return heaps;
+}
+
 void DeviceLVE::createBuffer(
     VkDeviceSize size,
     VkBufferUsageFlags usage,
@@ -10,6 +10,9 @@
 #include <memory>
 
 
+class PipelineRegistry;
+class ShaderLibrary;
+
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkSurfaceFormatKHR> formats;
@@ -37,10 +40,36 @@ public:
     VkCommandPool getCommandPool() { return commandPool; }
     VkDevice& device() { return device_; }
     VkPhysicalDevice& getPhysicalDevice() { return m_PhysicalDevice; }
-    VkSurfaceKHR surface() { return surface_; }
+    VkSurfaceKHR surface() { return surface_; } // VK_NULL_HANDLE when headless
+    bool isHeadless() { return m_Window->isHeadless(); }
     VkQueue graphicsQueue() { return graphicsQueue_; }
     VkQueue presentationQueue() { return presentationQueue_; }
 
+    // Shared by every vkCreate*Pipelines call. Loaded from pipelineCacheFile() at startup (if it was written by the
+    // same driver for the same device) and written back at shutdown.
+    VkPipelineCache pipelineCache() { return pipelineCache_; }
+    bool isPipelineCacheWarm() { return pipelineCacheWarm_; }
+    void savePipelineCache();
+    static const char* pipelineCacheFile() { return "pipeline_cache.bin"; }
+
+    // Shared, deduplicated pipelines and pipeline layouts (compiled through pipelineCache())
+    PipelineRegistry& pipelineRegistry() { return *pipelineRegistry_; }
+
+    // Shared, reference counted shader modules with their reflection data
+    ShaderLibrary& shaderLibrary() { return *shaderLibrary_; }
+
+    // Memory of one heap. Budget and usage (of this process) come from VK_EXT_memory_budget, enabled when
+    // the device has it, otherwise they are 0.
+    struct HeapMemory {
+        VkDeviceSize size;
+        VkDeviceSize budget;
+        VkDeviceSize usage;
+        bool deviceLocal;
+    };
+
+    bool hasMemoryBudget() { return memoryBudgetSupported_; }
+    std::vector<HeapMemory> getHeapMemory();
+
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(m_PhysicalDevice); }
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(m_PhysicalDevice); }
@@ -75,6 +104,8 @@ private:
     void pickPhysicalDevice();
     void createLogicalDevice();
     void createCommandPool();
+    void createPipelineCache();
+    bool isPipelineCacheCompatible(const std::vector<char>& data);
 
     // helper functions
     bool isDeviceSuitable(VkPhysicalDevice device);
@@ -84,6 +115,7 @@ private:
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
     void hasGflwRequiredInstanceExtensions();
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+    std::vector<const char*> getDeviceExtensions();
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
     VkInstance instance;
@@ -93,11 +125,15 @@ private:
     VkCommandPool commandPool;
 
     VkDevice device_;
-    VkSurfaceKHR surface_;
+    VkSurfaceKHR surface_ = VK_NULL_HANDLE;
     VkQueue graphicsQueue_;
     VkQueue presentationQueue_;
+    VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+    bool pipelineCacheWarm_ = false;
+    bool memoryBudgetSupported_ = false;
+    std::unique_ptr<PipelineRegistry> pipelineRegistry_;
+    std::unique_ptr<ShaderLibrary> shaderLibrary_; // Unregisters its modules from pipelineRegistry_, destroyed first
 
     const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
-    const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
 };
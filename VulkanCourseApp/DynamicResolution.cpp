@@ -0,0 +1,86 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+
+void DynamicResolution::setSettings(const Settings& settings)
+{
+	std::lock_guard<std::mutex> lock(m_SettingsMutex);
+
+	m_Settings = settings;
+	m_Settings.maxScale = std::min(std::max(m_Settings.maxScale, 0.1f), 1.0f);
+	m_Settings.minScale = std::min(std::max(m_Settings.minScale, 0.1f), m_Settings.maxScale);
+
+	printf("Dynamic resolution: %s, target %.2f ms, scale %.2f - %.2f\n",
+		m_Settings.enabled ? "on" : "off", m_Settings.targetMs, m_Settings.minScale, m_Settings.maxScale);
+}
+
+DynamicResolution::Settings DynamicResolution::getSettings()
+{
+	std::lock_guard<std::mutex> lock(m_SettingsMutex);
+
+	return m_Settings;
+}
+
+bool DynamicResolution::update(double gpuMs, uint32_t framesInFlight)
+{
+	Settings settings = getSettings();
+
+	// Only this thread writes them, the atomics are for the readers
+	const float previousScale = m_Scale.load(std::memory_order_relaxed);
+	float scale = previousScale;
+	double smoothedGpuMs = m_SmoothedGpuMs.load(std::memory_order_relaxed);
+
+	// The first measurements after a change may still come from frames at the old scale (up to the frames in flight),
+	// the average starts over after them
+	bool stale = m_SamplesSinceChange < framesInFlight;
+	smoothedGpuMs = stale ? gpuMs : smoothedGpuMs + SMOOTHING * (gpuMs - smoothedGpuMs);
+	m_SmoothedGpuMs.store(smoothedGpuMs, std::memory_order_relaxed);
+	m_SamplesSinceChange++;
+
+	if (!settings.enabled)
+	{
+		scale = settings.maxScale;
+	}
+	else if (m_SamplesSinceChange >= framesInFlight + SETTLE_SAMPLES && settings.targetMs > 0.0 && smoothedGpuMs > 0.0)
+	{
+		double ratio = smoothedGpuMs / settings.targetMs;
+
+		// Within the dead band nothing changes, so the scale does not oscillate around the target
+		if (ratio > 1.0 + settings.hysteresis || ratio < 1.0 - settings.hysteresis)
+		{
+			// Pixel count proportional to GPU time: the per-axis scale goes with the square root
+			float wanted = scale * (float)std::sqrt(1.0 / ratio);
+			wanted = std::min(std::max(wanted, scale - MAX_STEP_DOWN), scale + MAX_STEP_UP);
+
+			// Whole percents, tiny changes are not worth a different image
+			scale = std::round(wanted * 100.0f) / 100.0f;
+		}
+	}
+
+	scale = std::min(std::max(scale, settings.minScale), settings.maxScale);
+
+	if (scale == previousScale) return false;
+
+	m_Scale.store(scale, std::memory_order_relaxed);
+
+	printf("Dynamic resolution: scale %.2f (GPU %.2f ms, target %.2f ms)\n", scale, smoothedGpuMs, settings.targetMs);
+
+	m_SamplesSinceChange = 0;
+	return true;
+}
+
+VkExtent2D DynamicResolution::getRenderExtent(VkExtent2D fullExtent)
+{
+	float scale = getScale();
+
+	VkExtent2D extent;
+	extent.width = std::max(1u, (uint32_t)std::lround(fullExtent.width * scale));
+	extent.height = std::max(1u, (uint32_t)std::lround(fullExtent.height * scale));
+	extent.width = std::min(extent.width, fullExtent.width);
+	extent.height = std::min(extent.height, fullExtent.height);
+
+	return extent;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+
+// Picks the fraction of the output resolution the scene is rendered at, from measured GPU frame times.
+// The scene attachments keep their full size, only the viewport within them shrinks, so a scale change
+// never recreates anything. GPU cost is taken as proportional to the pixel count (scale squared).
+// Settings and the getters are thread safe, update() belongs to the render thread.
+class DynamicResolution
+{
+public:
+	struct Settings
+	{
+		bool enabled = false;
+		double targetMs = 16.6;  // GPU frame time to converge to
+		float minScale = 0.5f;   // Bounds of the per-axis scale
+		float maxScale = 1.0f;   // At most 1, the attachments are the size of the swapchain
+		double hysteresis = 0.1; // No change while the GPU time is within this fraction of the target
+	};
+
+	DynamicResolution() = default;
+
+	DynamicResolution(const DynamicResolution&) = delete;
+	DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+	void setSettings(const Settings& settings);
+	Settings getSettings();
+
+	// One GPU frame time measurement, returns true if the scale changed.
+	// framesInFlight: frames recorded but not measured yet, after a change that many still show the old scale.
+	bool update(double gpuMs, uint32_t framesInFlight);
+
+	float getScale() { return m_Scale.load(std::memory_order_relaxed); }
+	double getSmoothedGpuMs() { return m_SmoothedGpuMs.load(std::memory_order_relaxed); }
+	// Scaled extent, at least 1x1
+	VkExtent2D getRenderExtent(VkExtent2D fullExtent);
+
+private:
+	// Measurements arrive a few frames late: after a change, wait for the ones rendered at the new scale,
+	// then for a few more before the next change
+	static constexpr uint32_t SETTLE_SAMPLES = 8;
+	// Weight of a new measurement in the smoothed GPU time
+	static constexpr double SMOOTHING = 0.2;
+	// Largest change per step, down and up (slower up, dropping frames is worse than a softer image)
+	static constexpr float MAX_STEP_DOWN = 0.15f;
+	static constexpr float MAX_STEP_UP = 0.05f;
+
+	std::mutex m_SettingsMutex;
+	Settings m_Settings;
+
+	// Written by update() only, read from any thread
+	std::atomic<float> m_Scale{ 1.0f };
+	std::atomic<double> m_SmoothedGpuMs{ 0.0 };
+	uint32_t m_SamplesSinceChange = 0;
+
+};
@@ -0,0 +1,65 @@
+#include "FrameCommandPool.h"
+
+#include <stdexcept>
+
+
+FrameCommandPool::FrameCommandPool(std::shared_ptr<DeviceLVE> device, uint32_t queueFamilyIndex)
+	: m_Device{ device }
+{
+	VkCommandPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // No RESET_COMMAND_BUFFER_BIT, buffers are only reset together with the pool
+	poolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+
+	VkResult result = vkCreateCommandPool(m_Device->device(), &poolCreateInfo, nullptr, &m_CommandPool);
+
+	printf("---- vkCreateCommandPool m_CommandPool FrameCommandPool::FrameCommandPool()\n");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Frame Command Pool!");
+	}
+}
+
+FrameCommandPool::~FrameCommandPool()
+{
+	// Also frees every command buffer allocated from the pool
+	vkDestroyCommandPool(m_Device->device(), m_CommandPool, nullptr);
+}
+
+void FrameCommandPool::reset()
+{
+	// Puts every buffer of the pool back into the initial state in one call
+	vkResetCommandPool(m_Device->device(), m_CommandPool, 0);
+
+	m_PrimaryUsed = 0;
+	m_SecondaryUsed = 0;
+}
+
+VkCommandBuffer FrameCommandPool::allocate(VkCommandBufferLevel level)
+{
+	bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	std::vector<VkCommandBuffer>& buffers = primary ? m_PrimaryBuffers : m_SecondaryBuffers;
+	uint32_t& used = primary ? m_PrimaryUsed : m_SecondaryUsed;
+
+	if (used == buffers.size())
+	{
+		VkCommandBufferAllocateInfo cbAllocInfo = {};
+		cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cbAllocInfo.commandPool = m_CommandPool;
+		cbAllocInfo.level = level;
+		cbAllocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		VkResult result = vkAllocateCommandBuffers(m_Device->device(), &cbAllocInfo, &commandBuffer);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate a Command Buffer from a Frame Command Pool!");
+		}
+
+		buffers.push_back(commandBuffer);
+	}
+
+	return buffers[used++];
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "DeviceLVE.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// Transient command pool owned by one frame in flight and one recording thread.
+// Command buffers are handed out linearly and all of them are recycled at once with vkResetCommandPool,
+// so there is no per-buffer reset and, as long as each thread only touches its own pool, no locking.
+class FrameCommandPool
+{
+public:
+	FrameCommandPool(std::shared_ptr<DeviceLVE> device, uint32_t queueFamilyIndex);
+	~FrameCommandPool();
+
+	FrameCommandPool(const FrameCommandPool&) = delete;
+	FrameCommandPool& operator=(const FrameCommandPool&) = delete;
+
+	// Only call once the GPU is done with every buffer from this pool (the frame's fence has signalled)
+	void reset();
+
+	// Next unused buffer of the given level, allocated the first time it is needed and reused after reset()
+	VkCommandBuffer allocate(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+	uint32_t getAllocatedCount() { return static_cast<uint32_t>(m_PrimaryBuffers.size() + m_SecondaryBuffers.size()); }
+
+private:
+	std::shared_ptr<DeviceLVE> m_Device;
+
+	VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+
+	std::vector<VkCommandBuffer> m_PrimaryBuffers;
+	std::vector<VkCommandBuffer> m_SecondaryBuffers;
+	uint32_t m_PrimaryUsed = 0;
+	uint32_t m_SecondaryUsed = 0;
+
+};
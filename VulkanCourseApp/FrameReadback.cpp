@@ -0,0 +1,432 @@
+#include "FrameReadback.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+// SSE2 is part of every x86-64 target, other architectures take the scalar path
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRAME_READBACK_SSE2 1
+#endif
+
+
+namespace
+{
+	// BGRA to RGBA: swap bytes 0 and 2 of every pixel, 4 pixels per SSE2 step
+	void swizzleRow(const uint8_t* src, uint8_t* dst, uint32_t width)
+	{
+		uint32_t x = 0;
+
+#ifdef FRAME_READBACK_SSE2
+		const __m128i greenAlphaMask = _mm_set1_epi32(0xFF00FF00);
+		const __m128i redBlueMask = _mm_set1_epi32(0x00FF00FF);
+
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+
+			// Rotating each pixel by 16 bits moves blue to red and red to blue, green and alpha are kept from the original
+			__m128i rotated = _mm_or_si128(_mm_slli_epi32(pixels, 16), _mm_srli_epi32(pixels, 16));
+			__m128i result = _mm_or_si128(_mm_and_si128(pixels, greenAlphaMask), _mm_and_si128(rotated, redBlueMask));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), result);
+		}
+#endif
+
+		for (; x < width; x++)
+		{
+			dst[x * 4 + 0] = src[x * 4 + 2];
+			dst[x * 4 + 1] = src[x * 4 + 1];
+			dst[x * 4 + 2] = src[x * 4 + 0];
+			dst[x * 4 + 3] = src[x * 4 + 3];
+		}
+	}
+}
+
+
+FrameReadback::FrameReadback(std::shared_ptr<DeviceLVE> device, std::shared_ptr<FrameScheduler> frameScheduler, uint32_t slotCount, Callback callback)
+	: m_Device{ device }, m_FrameScheduler{ frameScheduler }, m_Callback{ callback }
+{
+	m_Slots.resize(std::max(slotCount, 1u));
+
+	// Host cached memory makes the CPU reads fast (uncached write-combined memory is very slow to read),
+	// any host visible memory will do otherwise
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(m_Device->getPhysicalDevice(), &memoryProperties);
+
+	bool found = false;
+	for (VkMemoryPropertyFlags flags : { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT })
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && !found; i++)
+		{
+			if ((memoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+			{
+				m_MemoryTypeIndex = i;
+				m_MemoryCoherent = (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+				found = true;
+			}
+		}
+	}
+
+	if (!found)
+	{
+		throw std::runtime_error("Failed to find host visible memory for frame readback!");
+	}
+
+	// Rows of the copy are padded to the pitch the device copies fastest, whole pixels
+	uint32_t alignment = (uint32_t)std::max(m_Device->properties.limits.optimalBufferCopyRowPitchAlignment, (VkDeviceSize)1);
+	m_RowPitchAlignment = alignment % 4 == 0 ? alignment : alignment * 4;
+
+	m_Worker = std::thread(&FrameReadback::workerMain, this);
+
+	printf("Frame readback: %i buffers, %s memory, row pitch alignment %i.\n",
+		(int)m_Slots.size(), m_MemoryCoherent ? "coherent" : "cached", (int)m_RowPitchAlignment);
+}
+
+FrameReadback::~FrameReadback()
+{
+	// Frames already complete are still delivered
+	flush();
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_WorkCondition.notify_all();
+	m_Worker.join();
+
+	// The owner flushed the FrameScheduler, no copy is in flight any more
+	for (Slot& slot : m_Slots)
+	{
+		destroySlot(slot);
+	}
+}
+
+bool FrameReadback::isFormatSupported(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool FrameReadback::recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout layout, VkFormat format, VkExtent2D extent)
+{
+	uint32_t slotIndex = m_NextSlot;
+	Slot& slot = m_Slots[slotIndex];
+
+	if (m_WaitWhenFull && !waitForSlot(slotIndex))
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		// The oldest slot is still being read back or converted: the consumer is behind, this frame is skipped
+		// instead of waiting (the slots stay in turn, so frames are delivered in order)
+		if (slot.state != SlotState::Free)
+		{
+			m_Stats.dropped++;
+			return false;
+		}
+
+		slot.state = SlotState::InFlight;
+		m_Stats.copied++;
+	}
+
+	m_NextSlot = (m_NextSlot + 1) % getSlotCount();
+
+	uint32_t rowPitch = (extent.width * 4 + m_RowPitchAlignment - 1) / m_RowPitchAlignment * m_RowPitchAlignment;
+	VkDeviceSize size = (VkDeviceSize)rowPitch * extent.height;
+
+	// Free slots are not used by the GPU or the worker, a resize simply reallocates them
+	if (slot.size < size)
+	{
+		destroySlot(slot);
+		allocateSlot(slot, size);
+	}
+
+	slot.frameIndex = m_FrameScheduler->getRecordingFrame();
+	slot.extent = extent;
+	slot.rowPitch = rowPitch;
+	slot.swizzle = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+
+	// Rendering to the image (and the render pass's final layout transition) has to be done before the copy reads it.
+	// The render pass's external dependency ends at BOTTOM_OF_PIPE: only ALL_COMMANDS as the source stage chains
+	// with it (COLOR_ATTACHMENT_OUTPUT would not order the copy after the final layout transition).
+	VkImageMemoryBarrier imageBarrier = {};
+	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	imageBarrier.oldLayout = layout;
+	imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image = image;
+	imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = rowPitch / 4; // in pixels
+	region.bufferImageHeight = 0;
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+	// Back to the layout the image is expected in (presentation), the submission's semaphore orders the present after the copy
+	if (layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+	{
+		imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		imageBarrier.dstAccessMask = 0;
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		imageBarrier.newLayout = layout;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &imageBarrier);
+	}
+
+	// Make the copied data visible to the host once the frame has completed
+	VkBufferMemoryBarrier bufferBarrier = {};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = slot.buffer;
+	bufferBarrier.offset = 0;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+		0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+	// Handed to the worker once the timeline reports the frame complete, no wait on the render thread
+	m_FrameScheduler->onFrameComplete(slot.frameIndex, [this, slotIndex]()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Slots[slotIndex].state = SlotState::Converting;
+			m_ConvertQueue.push_back(slotIndex);
+		}
+		m_WorkCondition.notify_one();
+	});
+
+	return true;
+}
+
+bool FrameReadback::waitForSlot(uint32_t slotIndex)
+{
+	Slot& slot = m_Slots[slotIndex];
+	auto waitStart = std::chrono::steady_clock::now();
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (slot.state != SlotState::Free)
+	{
+		if (slot.state == SlotState::InFlight)
+		{
+			// Handed over by the FrameScheduler's completion callbacks, which only run on this (the render) thread
+			uint64_t frameIndex = slot.frameIndex;
+			lock.unlock();
+			if (m_FrameScheduler->waitForFrame(frameIndex, UINT64_MAX) != VK_SUCCESS)
+			{
+				return false;
+			}
+			m_FrameScheduler->collect();
+			lock.lock();
+		}
+		else
+		{
+			m_IdleCondition.wait(lock);
+		}
+	}
+
+	m_Stats.waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+	return true;
+}
+
+void FrameReadback::flush()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_IdleCondition.wait(lock, [this]()
+	{
+		return std::none_of(m_Slots.begin(), m_Slots.end(), [](const Slot& slot) { return slot.state == SlotState::Converting; });
+	});
+}
+
+FrameReadback::Stats FrameReadback::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	return m_Stats;
+}
+
+void FrameReadback::printStats()
+{
+	Stats stats = getStats();
+
+	printf("Frame readback: %llu copied, %llu delivered, %llu dropped, %llu failed, conversion %.3f ms/frame, render thread waited %.1f ms.\n",
+		(unsigned long long)stats.copied, (unsigned long long)stats.delivered, (unsigned long long)stats.dropped, (unsigned long long)stats.failed,
+		stats.delivered + stats.failed > 0 ? stats.convertMs / (stats.delivered + stats.failed) : 0.0, stats.waitMs);
+}
+
+void FrameReadback::allocateSlot(Slot& slot, VkDeviceSize size)
+{
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(m_Device->device(), &bufferInfo, nullptr, &slot.buffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Readback Buffer!");
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetBufferMemoryRequirements(m_Device->device(), slot.buffer, &memoryRequirements);
+
+	if ((memoryRequirements.memoryTypeBits & (1u << m_MemoryTypeIndex)) == 0)
+	{
+		throw std::runtime_error("Readback Buffer can not use host visible memory!");
+	}
+
+	VkMemoryAllocateInfo memoryAllocInfo = {};
+	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocInfo.allocationSize = memoryRequirements.size;
+	memoryAllocInfo.memoryTypeIndex = m_MemoryTypeIndex;
+
+	if (vkAllocateMemory(m_Device->device(), &memoryAllocInfo, nullptr, &slot.memory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Readback Buffer Memory!");
+	}
+
+	vkBindBufferMemory(m_Device->device(), slot.buffer, slot.memory, 0);
+
+	// Mapped for the lifetime of the buffer
+	if (vkMapMemory(m_Device->device(), slot.memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to map Readback Buffer Memory!");
+	}
+
+	slot.size = size;
+}
+
+void FrameReadback::destroySlot(Slot& slot)
+{
+	if (slot.buffer == VK_NULL_HANDLE) return;
+
+	// Freeing the memory also unmaps it
+	vkDestroyBuffer(m_Device->device(), slot.buffer, nullptr);
+	vkFreeMemory(m_Device->device(), slot.memory, nullptr);
+
+	slot.buffer = VK_NULL_HANDLE;
+	slot.memory = VK_NULL_HANDLE;
+	slot.mapped = nullptr;
+	slot.size = 0;
+}
+
+void FrameReadback::workerMain()
+{
+	while (true)
+	{
+		uint32_t slotIndex;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WorkCondition.wait(lock, [this]() { return m_Stop || !m_ConvertQueue.empty(); });
+
+			if (m_ConvertQueue.empty()) return; // Stopped
+
+			slotIndex = m_ConvertQueue.front();
+			m_ConvertQueue.pop_front();
+		}
+
+		// The render thread does not touch a converting slot, no lock needed
+		Slot& slot = m_Slots[slotIndex];
+
+		auto convertStart = std::chrono::steady_clock::now();
+
+		if (!m_MemoryCoherent)
+		{
+			VkMappedMemoryRange range = {};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = slot.memory;
+			range.offset = 0;
+			range.size = VK_WHOLE_SIZE;
+			vkInvalidateMappedMemoryRanges(m_Device->device(), 1, &range);
+		}
+
+		// Drop the row padding, swizzle if needed
+		uint32_t rowBytes = slot.extent.width * 4;
+		slot.pixels.resize((size_t)rowBytes * slot.extent.height);
+
+		const uint8_t* src = static_cast<const uint8_t*>(slot.mapped);
+		for (uint32_t y = 0; y < slot.extent.height; y++)
+		{
+			const uint8_t* srcRow = src + (size_t)y * slot.rowPitch;
+			uint8_t* dstRow = slot.pixels.data() + (size_t)y * rowBytes;
+
+			if (slot.swizzle)
+			{
+				swizzleRow(srcRow, dstRow, slot.extent.width);
+			}
+			else
+			{
+				memcpy(dstRow, srcRow, rowBytes);
+			}
+		}
+
+		double convertMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - convertStart).count();
+
+		Frame frame;
+		frame.frameIndex = slot.frameIndex;
+		frame.width = slot.extent.width;
+		frame.height = slot.extent.height;
+		frame.rgba = slot.pixels.data();
+
+		// An exception must not end the worker (and the process), the frame is dropped
+		bool failed = false;
+		try
+		{
+			m_Callback(frame);
+		}
+		catch (const std::exception& e)
+		{
+			printf("Frame readback: callback failed on frame %llu, dropped: %s\n", (unsigned long long)frame.frameIndex, e.what());
+			failed = true;
+		}
+		catch (...)
+		{
+			printf("Frame readback: callback failed on frame %llu, dropped.\n", (unsigned long long)frame.frameIndex);
+			failed = true;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			slot.state = SlotState::Free;
+			if (failed)
+			{
+				m_Stats.failed++;
+			}
+			else
+			{
+				m_Stats.delivered++;
+			}
+			m_Stats.convertMs += convertMs;
+		}
+		m_IdleCondition.notify_all();
+	}
+}
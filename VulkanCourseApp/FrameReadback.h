@@ -0,0 +1,123 @@
+#pragma once
+
+#include "DeviceLVE.h"
+#include "FrameScheduler.h"
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Copies finished frames into a ring of host visible buffers without stalling the GPU or the render thread.
+// The copy is recorded at the end of frame N, the buffer is read once the FrameScheduler timeline reports frame N
+// complete (a few frames later), while the GPU already renders the next frames. A worker thread converts the
+// pixels (BGRA swizzle, row pitch) to tightly packed RGBA8 and delivers them in frame order.
+// recordCopy() belongs to the render thread, the callback runs on the worker thread.
+class FrameReadback
+{
+public:
+	struct Frame
+	{
+		uint64_t frameIndex; // Timeline value of the frame (FrameScheduler)
+		uint32_t width;
+		uint32_t height;
+		const uint8_t* rgba; // width * height * 4 bytes, only valid during the callback
+	};
+
+	using Callback = std::function<void(const Frame& frame)>;
+
+	struct Stats
+	{
+		uint64_t copied = 0;    // Copies recorded
+		uint64_t delivered = 0; // Frames handed to the callback
+		uint64_t dropped = 0;   // Frames not copied because every buffer was still in use
+		uint64_t failed = 0;    // The callback threw, the frame was dropped
+		double convertMs = 0.0; // Total conversion time on the worker (callback excluded)
+		double waitMs = 0.0;    // Time the render thread waited for a buffer (wait when full)
+	};
+
+	FrameReadback(std::shared_ptr<DeviceLVE> device, std::shared_ptr<FrameScheduler> frameScheduler, uint32_t slotCount, Callback callback);
+	~FrameReadback();
+
+	FrameReadback(const FrameReadback&) = delete;
+	FrameReadback& operator=(const FrameReadback&) = delete;
+
+	// 8 bit RGBA or BGRA color formats
+	static bool isFormatSupported(VkFormat format);
+
+	// With every buffer in use: false drops the frame (default), true makes recordCopy() wait for the oldest buffer,
+	// which stalls the render thread as long as the consumer (callback) is behind. Thread safe.
+	void setWaitWhenFull(bool wait) { m_WaitWhenFull = wait; }
+
+	// Records the copy of image (in layout, written as color attachment) into a free buffer, outside of a render pass.
+	// The image is left in the same layout. Returns false (frame dropped) if every buffer is still in use.
+	bool recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout layout, VkFormat format, VkExtent2D extent);
+
+	// Waits until every frame handed to the worker has been delivered. Frames are handed over as the timeline
+	// reports them complete, flush the FrameScheduler first to include all submitted frames.
+	void flush();
+
+	uint32_t getSlotCount() { return static_cast<uint32_t>(m_Slots.size()); }
+	Stats getStats();
+	void printStats();
+
+private:
+	enum class SlotState
+	{
+		Free,       // Can take the next copy
+		InFlight,   // Copy recorded, frame not complete yet
+		Converting  // Queued for or being processed by the worker
+	};
+
+	struct Slot
+	{
+		SlotState state = SlotState::Free;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr;
+
+		// Copy recorded into this slot
+		uint64_t frameIndex = 0;
+		VkExtent2D extent = {};
+		uint32_t rowPitch = 0; // Bytes per row in the buffer (aligned for fast copies)
+		bool swizzle = false;  // BGRA source
+
+		std::vector<uint8_t> pixels; // Converted RGBA, reused
+	};
+
+	bool waitForSlot(uint32_t slotIndex);
+	void allocateSlot(Slot& slot, VkDeviceSize size);
+	void destroySlot(Slot& slot);
+	void workerMain();
+
+	std::shared_ptr<DeviceLVE> m_Device;
+	std::shared_ptr<FrameScheduler> m_FrameScheduler;
+	Callback m_Callback;
+
+	uint32_t m_MemoryTypeIndex = 0;
+	bool m_MemoryCoherent = true; // Cached memory usually is not, it is invalidated before reading
+	uint32_t m_RowPitchAlignment = 1;
+	std::atomic<bool> m_WaitWhenFull{ false };
+
+	std::vector<Slot> m_Slots;
+	uint32_t m_NextSlot = 0; // Slots are used in turn, so frames complete in slot order
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkCondition;
+	std::condition_variable m_IdleCondition;
+	std::deque<uint32_t> m_ConvertQueue; // Slots in frame order
+	bool m_Stop = false;
+	Stats m_Stats;
+
+	std::thread m_Worker;
+
+};
@@ -0,0 +1,190 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+
+FrameScheduler::FrameScheduler(std::shared_ptr<DeviceLVE> device)
+	: m_Device{ device }
+{
+	// Extension entry points are not exported by the loader, fetch them from the device
+	m_GetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(m_Device->device(), "vkGetSemaphoreCounterValueKHR");
+	m_WaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(m_Device->device(), "vkWaitSemaphoresKHR");
+
+	if (m_GetSemaphoreCounterValue == nullptr || m_WaitSemaphores == nullptr)
+	{
+		throw std::runtime_error("VK_KHR_timeline_semaphore functions are not available!");
+	}
+
+	VkSemaphoreTypeCreateInfoKHR semaphoreTypeInfo = {};
+	semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	semaphoreTypeInfo.initialValue = 0; // Frame 0 is "nothing submitted yet" and counts as complete
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreCreateInfo.pNext = &semaphoreTypeInfo;
+
+	VkResult result = vkCreateSemaphore(m_Device->device(), &semaphoreCreateInfo, nullptr, &m_TimelineSemaphore);
+
+	printf("---- vkCreateSemaphore m_TimelineSemaphore FrameScheduler::FrameScheduler()\n");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Timeline Semaphore!");
+	}
+}
+
+FrameScheduler::~FrameScheduler()
+{
+	flush();
+
+	vkDestroySemaphore(m_Device->device(), m_TimelineSemaphore, nullptr);
+}
+
+uint64_t FrameScheduler::submitFrame(VkQueue queue, const VkSubmitInfo& submitInfo)
+{
+	uint64_t frame = m_SubmittedFrame + 1;
+
+	// Append the timeline semaphore to the caller's signal semaphores
+	std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+	signalSemaphores.push_back(m_TimelineSemaphore);
+
+	// Values are ignored for binary semaphores, but the arrays must match the semaphore counts
+	std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+	signalValues.back() = frame;
+	std::vector<uint64_t> waitValues(submitInfo.waitSemaphoreCount, 0);
+
+	VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo = {};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineSubmitInfo.pNext = submitInfo.pNext;
+	timelineSubmitInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+	timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+	timelineSubmitInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+	timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+
+	VkSubmitInfo frameSubmitInfo = submitInfo;
+	frameSubmitInfo.pNext = &timelineSubmitInfo;
+	frameSubmitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+	frameSubmitInfo.pSignalSemaphores = signalSemaphores.data();
+
+	// No fence, completion is read from the timeline
+	VkResult result = vkQueueSubmit(queue, 1, &frameSubmitInfo, VK_NULL_HANDLE);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit draw command buffer!");
+	}
+
+	m_SubmittedFrame = frame;
+
+	collect();
+
+	return frame;
+}
+
+uint64_t FrameScheduler::getCompletedFrame()
+{
+	uint64_t value = 0;
+	if (m_GetSemaphoreCounterValue(m_Device->device(), m_TimelineSemaphore, &value) == VK_SUCCESS)
+	{
+		m_CompletedFrame = value;
+	}
+
+	return m_CompletedFrame;
+}
+
+bool FrameScheduler::isFrameComplete(uint64_t frame)
+{
+	// Cached value first, only query the semaphore if that is not enough
+	return frame <= m_CompletedFrame || frame <= getCompletedFrame();
+}
+
+VkResult FrameScheduler::waitForFrame(uint64_t frame, uint64_t timeoutNs)
+{
+	if (frame <= m_CompletedFrame)
+	{
+		return VK_SUCCESS;
+	}
+
+	if (frame > m_SubmittedFrame)
+	{
+		throw std::runtime_error("Waiting for a frame that has not been submitted!");
+	}
+
+	VkSemaphoreWaitInfoKHR waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &m_TimelineSemaphore;
+	waitInfo.pValues = &frame;
+
+	VkResult result = m_WaitSemaphores(m_Device->device(), &waitInfo, timeoutNs);
+
+	if (result == VK_SUCCESS)
+	{
+		m_CompletedFrame = std::max(m_CompletedFrame, frame);
+	}
+	else if (result != VK_TIMEOUT)
+	{
+		throw std::runtime_error("Failed to wait for a frame on the Timeline Semaphore!");
+	}
+
+	return result;
+}
+
+void FrameScheduler::onFrameComplete(uint64_t frame, std::function<void()> callback)
+{
+	// Keep the queue sorted so collect() can stop at the first frame that is still in flight
+	auto position = std::upper_bound(m_PendingCallbacks.begin(), m_PendingCallbacks.end(), frame,
+		[](uint64_t value, const PendingCallback& pending) { return value < pending.frame; });
+
+	m_PendingCallbacks.insert(position, PendingCallback{ frame, std::move(callback) });
+}
+
+void FrameScheduler::collect()
+{
+	if (m_PendingCallbacks.empty())
+	{
+		return;
+	}
+
+	uint64_t completedFrame = getCompletedFrame();
+
+	while (!m_PendingCallbacks.empty() && m_PendingCallbacks.front().frame <= completedFrame)
+	{
+		// Pop first, a callback may schedule further callbacks
+		std::function<void()> callback = std::move(m_PendingCallbacks.front().callback);
+		m_PendingCallbacks.pop_front();
+		callback();
+	}
+}
+
+void FrameScheduler::flush()
+{
+	if (m_SubmittedFrame > m_CompletedFrame)
+	{
+		VkSemaphoreWaitInfoKHR waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &m_TimelineSemaphore;
+		waitInfo.pValues = &m_SubmittedFrame;
+
+		m_WaitSemaphores(m_Device->device(), &waitInfo, UINT64_MAX);
+		m_CompletedFrame = m_SubmittedFrame;
+	}
+
+	// Work tagged with the frame being recorded was submitted outside a frame (uploads) or never used by the GPU.
+	// Wait for the queues so it is safe to release it as well.
+	if (!m_PendingCallbacks.empty())
+	{
+		vkDeviceWaitIdle(m_Device->device());
+	}
+
+	while (!m_PendingCallbacks.empty())
+	{
+		std::function<void()> callback = std::move(m_PendingCallbacks.front().callback);
+		m_PendingCallbacks.pop_front();
+		callback();
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "DeviceLVE.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+
+
+// Tracks GPU progress with one timeline semaphore (VK_KHR_timeline_semaphore).
+// Every frame submission signals the next value of the timeline, so "has frame N completed?" is a single
+// counter comparison, and any subsystem can tag work with a frame value instead of owning fences.
+// Work submitted to the same queue before frame N is complete once frame N is complete (submission order),
+// which is how uploads and deferred deletions are retired.
+class FrameScheduler
+{
+public:
+	// Bounded waits, a caller that times out skips the frame instead of blocking forever
+	static constexpr uint64_t DEFAULT_WAIT_TIMEOUT_NS = 100000000; // 100 ms
+
+	FrameScheduler(std::shared_ptr<DeviceLVE> device);
+	~FrameScheduler();
+
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+	// Submits one frame and makes it signal the next timeline value (binary semaphores in submitInfo are kept as they are).
+	// Returns the value of the submitted frame.
+	uint64_t submitFrame(VkQueue queue, const VkSubmitInfo& submitInfo);
+
+	// Value the frame currently being recorded will signal, use it to tag anything that frame touches
+	uint64_t getRecordingFrame() { return m_SubmittedFrame + 1; }
+	uint64_t getSubmittedFrame() { return m_SubmittedFrame; }
+	uint64_t getCompletedFrame();
+
+	bool isFrameComplete(uint64_t frame);
+
+	// VK_SUCCESS once the frame has completed, VK_TIMEOUT if it did not complete within timeoutNs
+	VkResult waitForFrame(uint64_t frame, uint64_t timeoutNs = DEFAULT_WAIT_TIMEOUT_NS);
+
+	// Runs callback once the given frame has completed on the GPU (upload completion, resource recycling)
+	void onFrameComplete(uint64_t frame, std::function<void()> callback);
+
+	// Destroys a resource once the frame currently being recorded (the last one that may reference it) has completed
+	void deferDestroy(std::function<void()> destroy) { onFrameComplete(getRecordingFrame(), std::move(destroy)); }
+
+	// Runs every callback whose frame has completed, called after each submission
+	void collect();
+
+	// Waits for everything submitted so far and runs all remaining callbacks (shutdown, swapchain recreation)
+	void flush();
+
+	VkSemaphore getTimelineSemaphore() { return m_TimelineSemaphore; }
+
+private:
+	struct PendingCallback
+	{
+		uint64_t frame;
+		std::function<void()> callback;
+	};
+
+	std::shared_ptr<DeviceLVE> m_Device;
+
+	VkSemaphore m_TimelineSemaphore = VK_NULL_HANDLE;
+
+	PFN_vkGetSemaphoreCounterValueKHR m_GetSemaphoreCounterValue = nullptr;
+	PFN_vkWaitSemaphoresKHR m_WaitSemaphores = nullptr;
+
+	uint64_t m_SubmittedFrame = 0;
+	uint64_t m_CompletedFrame = 0; // Last value read back from the semaphore
+
+	// Ordered by frame, callbacks are only ever tagged with the recording frame or earlier
+	std::deque<PendingCallback> m_PendingCallbacks;
+
+};
@@ -0,0 +1,88 @@
+#include "GpuTimer.h"
+
+#include <stdexcept>
+
+
+GpuTimer::GpuTimer(std::shared_ptr<DeviceLVE> device, uint32_t slotCount)
+	: m_Device{ device }, m_SlotCount{ slotCount }
+{
+	m_SlotWritten.resize(m_SlotCount, false);
+
+	// Timestamps are only usable if the graphics queue family reports valid bits
+	QueueFamilyIndices indices = m_Device->findPhysicalQueueFamilies();
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_Device->getPhysicalDevice(), &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_Device->getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[indices.graphicsFamily].timestampValidBits;
+	m_Supported = validBits > 0 && m_Device->properties.limits.timestampPeriod > 0.0f;
+
+	if (!m_Supported)
+	{
+		printf("GpuTimer: timestamp queries not supported on the graphics queue, GPU times will not be reported.\n");
+		return;
+	}
+
+	m_TimestampPeriod = (double)m_Device->properties.limits.timestampPeriod;
+	m_TimestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = m_SlotCount * 2; // begin + end timestamp per slot
+
+	VkResult result = vkCreateQueryPool(m_Device->device(), &queryPoolCreateInfo, nullptr, &m_QueryPool);
+
+	printf("---- vkCreateQueryPool m_QueryPool GpuTimer::GpuTimer()\n");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Timestamp Query Pool!");
+	}
+}
+
+GpuTimer::~GpuTimer()
+{
+	if (m_QueryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(m_Device->device(), m_QueryPool, nullptr);
+	}
+}
+
+void GpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	if (!m_Supported) return;
+
+	vkCmdResetQueryPool(commandBuffer, m_QueryPool, slot * 2, 2);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_QueryPool, slot * 2);
+}
+
+void GpuTimer::end(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	if (!m_Supported) return;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPool, slot * 2 + 1);
+	m_SlotWritten[slot] = true;
+}
+
+bool GpuTimer::getElapsedMs(uint32_t slot, double* elapsedMs)
+{
+	if (!m_Supported || !m_SlotWritten[slot]) return false;
+
+	// No VK_QUERY_RESULT_WAIT_BIT, VK_NOT_READY is returned while the GPU is still working on the slot
+	uint64_t timestamps[2] = {};
+	VkResult result = vkGetQueryPoolResults(m_Device->device(), m_QueryPool, slot * 2, 2,
+		sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	if (result != VK_SUCCESS) return false;
+
+	uint64_t ticks = (timestamps[1] & m_TimestampMask) - (timestamps[0] & m_TimestampMask);
+	*elapsedMs = (double)(ticks & m_TimestampMask) * m_TimestampPeriod / 1000000.0;
+
+	// Each measurement is reported once
+	m_SlotWritten[slot] = false;
+
+	return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "DeviceLVE.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// Measures GPU execution time of a command buffer with a pair of timestamp queries.
+// One query pair per slot (e.g. per swapchain image), results are read back without stalling.
+class GpuTimer
+{
+public:
+	GpuTimer(std::shared_ptr<DeviceLVE> device, uint32_t slotCount);
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	bool isSupported() { return m_Supported; }
+	uint32_t getSlotCount() { return m_SlotCount; }
+
+	// Record at the start/end of the command buffer (outside of a render pass)
+	void begin(VkCommandBuffer commandBuffer, uint32_t slot);
+	void end(VkCommandBuffer commandBuffer, uint32_t slot);
+
+	// Non-blocking, returns false if the slot has no finished measurement yet
+	bool getElapsedMs(uint32_t slot, double* elapsedMs);
+
+private:
+	std::shared_ptr<DeviceLVE> m_Device;
+
+	VkQueryPool m_QueryPool = VK_NULL_HANDLE;
+	uint32_t m_SlotCount;
+	bool m_Supported = false;
+	double m_TimestampPeriod = 1.0; // nanoseconds per timestamp tick
+	uint64_t m_TimestampMask = ~0ull;
+
+	std::vector<bool> m_SlotWritten;
+
+};
@@ -0,0 +1,390 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+
+thread_local JobSystem* JobSystem::s_CurrentSystem = nullptr;
+thread_local uint32_t JobSystem::s_QueueIndex = 0;
+
+JobSystem::JobSystem(uint32_t workerCount)
+	: m_MainThreadId{ std::this_thread::get_id() }
+{
+	if (workerCount == AUTO_WORKER_COUNT)
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+
+	for (uint32_t i = 0; i <= workerCount; i++)
+	{
+		m_Queues.push_back(std::make_unique<WorkQueue>());
+	}
+
+	for (uint32_t i = 1; i <= workerCount; i++)
+	{
+		m_Workers.emplace_back(&JobSystem::workerMain, this, i);
+	}
+
+	printf("Job system started: %i worker threads.\n", (int)workerCount);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+		m_Stop = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (auto& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+JobSystem::JobHandle JobSystem::createJob(std::function<void()> task, const JobHandle& parent)
+{
+	JobHandle job = std::make_shared<Job>();
+	job->task = std::move(task);
+	job->parent = parent;
+
+	// The parent can not complete before this child has
+	if (parent != nullptr)
+	{
+		parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+void JobSystem::run(const JobHandle& job)
+{
+	// Counted before it is visible, so a thief never decrements below zero
+	m_QueuedJobs.fetch_add(1, std::memory_order_release);
+
+	WorkQueue& queue = *m_Queues[currentQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+	}
+
+	wakeWorker();
+}
+
+JobSystem::JobHandle JobSystem::schedule(std::function<void()> task, const JobHandle& parent)
+{
+	JobHandle job = createJob(std::move(task), parent);
+	run(job);
+	return job;
+}
+
+JobSystem::LaneId JobSystem::createLane(const char* name, uint32_t maxWorkers)
+{
+	LaneId lane = m_LaneCount.load(std::memory_order_relaxed);
+	if (lane >= MAX_LANES)
+	{
+		throw std::runtime_error(std::string("Too many job lanes! (") + name + ")");
+	}
+
+	if (maxWorkers == 0)
+	{
+		maxWorkers = std::max(getWorkerCount() / 2, 1u);
+	}
+
+	m_Lanes[lane].name = name;
+	m_Lanes[lane].maxWorkers = maxWorkers;
+
+	// Published after it is set up, workers only look at lanes below the count
+	m_LaneCount.store(lane + 1, std::memory_order_release);
+
+	printf("Job lane '%s': up to %i workers.\n", name, (int)maxWorkers);
+
+	return lane;
+}
+
+JobSystem::JobHandle JobSystem::scheduleOnLane(LaneId lane, std::function<void()> task)
+{
+	JobHandle job = createJob(std::move(task));
+	job->lane = lane;
+
+	Lane& target = m_Lanes[lane];
+	{
+		std::lock_guard<std::mutex> lock(target.mutex);
+		target.jobs.push_back(job);
+		target.queued.fetch_add(1, std::memory_order_release);
+	}
+
+	wakeWorker();
+	return job;
+}
+
+void JobSystem::wait(const JobHandle& job)
+{
+	uint32_t queueIndex = currentQueueIndex();
+	bool mainThread = isMainThread();
+
+	// Nobody started it yet: run it here rather than wait for a worker (there may be none)
+	if (job->lane != NO_LANE && takeLaneJob(job))
+	{
+		execute(job);
+	}
+
+	while (!isComplete(job))
+	{
+		// The job may depend on the main thread lane
+		if (mainThread)
+		{
+			processMainThreadJobs();
+		}
+
+		JobHandle next = findJob(queueIndex);
+		if (next != nullptr)
+		{
+			execute(next);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	if (job->failed.load(std::memory_order_acquire))
+	{
+		std::rethrow_exception(job->exception);
+	}
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& body)
+{
+	if (count == 0) return;
+
+	if (batchSize == 0)
+	{
+		uint32_t batches = getThreadCount() * 4;
+		batchSize = (count + batches - 1) / batches;
+	}
+
+	// Nothing to split or nobody to share with, skip the scheduling overhead
+	if (batchSize >= count || m_Workers.empty())
+	{
+		body(0, count);
+		return;
+	}
+
+	// Empty root, only there to join the batches
+	JobHandle root = createJob(nullptr);
+
+	for (uint32_t begin = 0; begin < count; begin += batchSize)
+	{
+		uint32_t end = std::min(begin + batchSize, count);
+		schedule([&body, begin, end]() { body(begin, end); }, root);
+	}
+
+	// The root itself has nothing to run
+	finish(root);
+
+	wait(root);
+}
+
+JobSystem::JobHandle JobSystem::runOnMainThread(std::function<void()> task)
+{
+	JobHandle job = createJob(std::move(task));
+
+	if (isMainThread())
+	{
+		execute(job);
+		return job;
+	}
+
+	std::lock_guard<std::mutex> lock(m_MainThreadMutex);
+	m_MainThreadJobs.push_back(job);
+	return job;
+}
+
+void JobSystem::processMainThreadJobs()
+{
+	std::vector<JobHandle> jobs;
+	{
+		std::lock_guard<std::mutex> lock(m_MainThreadMutex);
+		jobs.swap(m_MainThreadJobs);
+	}
+
+	for (auto& job : jobs)
+	{
+		execute(job);
+	}
+}
+
+void JobSystem::workerMain(uint32_t queueIndex)
+{
+	s_CurrentSystem = this;
+	s_QueueIndex = queueIndex;
+
+	while (!m_Stop)
+	{
+		JobHandle job = findJob(queueIndex);
+		if (job != nullptr)
+		{
+			execute(job);
+			continue;
+		}
+
+		// Long jobs only when there is no short work
+		job = findLaneJob();
+		if (job != nullptr)
+		{
+			Lane& lane = m_Lanes[job->lane];
+			execute(job);
+			{
+				std::lock_guard<std::mutex> lock(lane.mutex);
+				lane.running.fetch_sub(1, std::memory_order_release);
+			}
+			// A worker may have gone to sleep on this lane's limit
+			if (lane.queued.load(std::memory_order_acquire) > 0)
+			{
+				wakeWorker();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_WakeMutex);
+		m_WakeCondition.wait(lock, [this]() { return m_Stop || m_QueuedJobs.load(std::memory_order_acquire) > 0 || hasRunnableLaneJob(); });
+	}
+}
+
+JobSystem::JobHandle JobSystem::findLaneJob()
+{
+	uint32_t laneCount = m_LaneCount.load(std::memory_order_acquire);
+	uint32_t start = m_NextLane.fetch_add(1, std::memory_order_relaxed);
+
+	for (uint32_t i = 0; i < laneCount; i++)
+	{
+		Lane& lane = m_Lanes[(start + i) % laneCount];
+		if (lane.queued.load(std::memory_order_acquire) == 0) continue;
+
+		std::lock_guard<std::mutex> lock(lane.mutex);
+		if (!lane.jobs.empty() && lane.running.load(std::memory_order_relaxed) < lane.maxWorkers)
+		{
+			JobHandle job = std::move(lane.jobs.front());
+			lane.jobs.pop_front();
+			lane.queued.fetch_sub(1, std::memory_order_relaxed);
+			lane.running.fetch_add(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+bool JobSystem::hasRunnableLaneJob()
+{
+	uint32_t laneCount = m_LaneCount.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < laneCount; i++)
+	{
+		const Lane& lane = m_Lanes[i];
+		if (lane.queued.load(std::memory_order_acquire) > 0 && lane.running.load(std::memory_order_acquire) < lane.maxWorkers)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool JobSystem::takeLaneJob(const JobHandle& job)
+{
+	Lane& lane = m_Lanes[job->lane];
+	std::lock_guard<std::mutex> lock(lane.mutex);
+
+	auto it = std::find(lane.jobs.begin(), lane.jobs.end(), job);
+	if (it == lane.jobs.end())
+	{
+		return false;
+	}
+
+	lane.jobs.erase(it);
+	lane.queued.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
+
+void JobSystem::wakeWorker()
+{
+	// Taking the lock orders the change against a worker that is about to sleep, so the wake up is never lost
+	{
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+	}
+	m_WakeCondition.notify_one();
+}
+
+JobSystem::JobHandle JobSystem::findJob(uint32_t queueIndex)
+{
+	JobHandle job;
+
+	// Own queue, newest first
+	{
+		WorkQueue& queue = *m_Queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+	}
+
+	// Steal the oldest job of another queue, starting with the next one so thieves spread out
+	for (size_t i = 1; job == nullptr && i < m_Queues.size(); i++)
+	{
+		WorkQueue& queue = *m_Queues[(queueIndex + i) % m_Queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+	}
+
+	if (job != nullptr)
+	{
+		m_QueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+void JobSystem::execute(const JobHandle& job)
+{
+	if (job->task)
+	{
+		try
+		{
+			job->task();
+		}
+		catch (...)
+		{
+			// Kept for wait() on the job or any of its parents, the first exception of a tree wins
+			std::exception_ptr exception = std::current_exception();
+			for (Job* failed = job.get(); failed != nullptr; failed = failed->parent.get())
+			{
+				bool expected = false;
+				if (failed->failed.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+				{
+					failed->exception = exception;
+				}
+			}
+		}
+		job->task = nullptr; // Release captured state right away, handles may outlive the job by a while
+	}
+
+	finish(job);
+}
+
+void JobSystem::finish(JobHandle job)
+{
+	// Walk up while the last unfinished count of a job drops to zero
+	while (job != nullptr && job->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		job = job->parent;
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Work-stealing task scheduler.
+// Every worker thread owns a deque: it pushes and pops its own jobs at the back (LIFO, cache warm) and idle
+// workers steal from the front of the others (FIFO, oldest and usually biggest work first).
+// Queue 0 is shared by the main thread and any other thread that is not a worker (e.g. the render thread).
+// A job counts itself plus its unfinished children, it is complete once the counter drops to zero, so waiting
+// on a parent waits for the whole tree. Threads that wait execute other jobs instead of blocking.
+// Long jobs (file imports, pipeline compiles) go to a lane instead: lane jobs are only taken by idle workers, at most
+// a lane's worker limit at once, and wait() never runs them (except the awaited job itself), so a thread waiting on
+// a parallelFor never ends up inside a long job.
+// A task that throws does not take the worker down: the exception is kept on the job (and its parents) and
+// rethrown by wait().
+class JobSystem
+{
+public:
+	using LaneId = uint32_t;
+	static constexpr LaneId NO_LANE = UINT32_MAX;
+	static constexpr uint32_t MAX_LANES = 4;
+
+	struct Job
+	{
+		std::function<void()> task;   // May be empty (pure join point)
+		std::shared_ptr<Job> parent;  // Notified when this job and all of its children are done
+		std::atomic<int32_t> unfinished{ 1 };
+		LaneId lane = NO_LANE;
+		std::atomic<bool> failed{ false };
+		std::exception_ptr exception; // First exception of the job or one of its children, written by whoever set failed
+	};
+
+	using JobHandle = std::shared_ptr<Job>;
+
+	// One worker per hardware thread, minus the main thread
+	static constexpr uint32_t AUTO_WORKER_COUNT = UINT32_MAX;
+
+	explicit JobSystem(uint32_t workerCount = AUTO_WORKER_COUNT);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// A child must be created before its parent is run (or from inside the parent's task)
+	JobHandle createJob(std::function<void()> task, const JobHandle& parent = nullptr);
+	void run(const JobHandle& job);
+	JobHandle schedule(std::function<void()> task, const JobHandle& parent = nullptr);
+
+	// Lanes are created up front (before jobs are scheduled on them), maxWorkers 0 = half of the workers
+	LaneId createLane(const char* name, uint32_t maxWorkers = 0);
+	JobHandle scheduleOnLane(LaneId lane, std::function<void()> task);
+
+	// Executes other jobs until job (and all of its children) has completed, then rethrows its exception if it failed.
+	// A lane job that no worker has started yet is run by the waiting thread.
+	void wait(const JobHandle& job);
+	static bool isComplete(const JobHandle& job) { return job->unfinished.load(std::memory_order_acquire) == 0; }
+
+	// Splits [0, count) into batches of batchSize, runs body(begin, end) for each batch in parallel and waits for all of them.
+	// batchSize 0 picks a few batches per thread.
+	void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& body);
+
+	// Main-thread-only lane (GLFW window calls). Runs inline when called from the main thread,
+	// otherwise the job is executed by the next processMainThreadJobs() call of the main thread.
+	JobHandle runOnMainThread(std::function<void()> task);
+	void processMainThreadJobs();
+
+	bool isMainThread() { return std::this_thread::get_id() == m_MainThreadId; }
+
+	uint32_t getWorkerCount() { return static_cast<uint32_t>(m_Workers.size()); }
+	uint32_t getThreadCount() { return getWorkerCount() + 1; } // workers + the thread that waits
+
+private:
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<JobHandle> jobs;
+	};
+
+	struct Lane
+	{
+		std::mutex mutex;
+		std::deque<JobHandle> jobs;       // FIFO
+		const char* name = "";
+		uint32_t maxWorkers = 1;
+		std::atomic<uint32_t> queued{ 0 };
+		std::atomic<uint32_t> running{ 0 }; // Workers inside a job of this lane, changed under mutex
+	};
+
+	void workerMain(uint32_t queueIndex);
+
+	// Own queue from the back, then the other queues from the front
+	JobHandle findJob(uint32_t queueIndex);
+	// Oldest job of a lane below its worker limit, counted as running
+	JobHandle findLaneJob();
+	bool hasRunnableLaneJob();
+	// Removes job from its lane if no worker has taken it yet
+	bool takeLaneJob(const JobHandle& job);
+	void wakeWorker();
+
+	void execute(const JobHandle& job);
+	void finish(JobHandle job);
+
+	uint32_t currentQueueIndex() { return s_CurrentSystem == this ? s_QueueIndex : 0; }
+
+	std::vector<std::unique_ptr<WorkQueue>> m_Queues; // [0] main and other non-worker threads, [1..] workers
+	std::vector<std::thread> m_Workers;
+
+	Lane m_Lanes[MAX_LANES];
+	std::atomic<uint32_t> m_LaneCount{ 0 };
+	std::atomic<uint32_t> m_NextLane{ 0 }; // Round robin start of the next lane search
+
+	std::atomic<bool> m_Stop{ false };
+	std::atomic<uint32_t> m_QueuedJobs{ 0 };
+	std::mutex m_WakeMutex;
+	std::condition_variable m_WakeCondition;
+
+	std::thread::id m_MainThreadId;
+	std::mutex m_MainThreadMutex;
+	std::vector<JobHandle> m_MainThreadJobs;
+
+	// Queue of the calling thread, set once per worker
+	static thread_local JobSystem* s_CurrentSystem;
+	static thread_local uint32_t s_QueueIndex;
+
+};
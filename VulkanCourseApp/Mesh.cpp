@@ -8,6 +8,8 @@ Mesh::Mesh()
 	indexCount = 0;
 	vertexBuffer = nullptr;
 	vertexBufferMemory = nullptr;
+	positionBuffer = nullptr;
+	positionBufferMemory = nullptr;
 	indexBuffer = nullptr;
 	indexBufferMemory = nullptr;
 	model = Model();
@@ -24,6 +26,7 @@ Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
 	physicalDevice = newPhysicalDevice;
 	device = newDevice;
 	createVertexBuffer(transferQueue, transferCommandPool, vertices);
+	createPositionBuffer(transferQueue, transferCommandPool, vertices);
 	createIndexBuffer(transferQueue, transferCommandPool, indices);
 
 	model.model = glm::mat4(1.0f);
@@ -55,6 +58,11 @@ VkBuffer Mesh::getVertexBuffer()
 	return vertexBuffer;
 }
 
+VkBuffer Mesh::getPositionBuffer()
+{
+	return positionBuffer;
+}
+
 int Mesh::getIndexCount()
 {
 	return indexCount;
@@ -71,6 +79,10 @@ void Mesh::destroyBuffers()
 	vkDestroyBuffer(device, vertexBuffer, nullptr);
 	vkFreeMemory(device, vertexBufferMemory, nullptr);
 
+	// Destroy Position Buffer
+	vkDestroyBuffer(device, positionBuffer, nullptr);
+	vkFreeMemory(device, positionBufferMemory, nullptr);
+
 	// Destroy Index Buffer
 	vkDestroyBuffer(device, indexBuffer, nullptr);
 	vkFreeMemory(device, indexBufferMemory, nullptr);
@@ -114,6 +126,41 @@ void Mesh::createVertexBuffer(VkQueue transferQueue, VkCommandPool transferComma
 	vkFreeMemory(device, stagingBufferMemory, nullptr);
 }
 
+void Mesh::createPositionBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices)
+{
+	// Split the positions out of the interleaved vertices (same order, so the index buffer applies to both)
+	std::vector<glm::vec3> positions(vertices->size());
+	for (size_t i = 0; i < vertices->size(); i++)
+	{
+		positions[i] = (*vertices)[i].pos;
+	}
+
+	VkDeviceSize bufferSize = sizeof(glm::vec3) * positions.size();
+
+	// Temporary buffer to "stage" position data before transferring to GPU
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+
+	VkBufferUsageFlags stagingBufferUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	VkMemoryPropertyFlags stagingBufferProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	createBuffer(physicalDevice, device, bufferSize, stagingBufferUsage, stagingBufferProperties, &stagingBuffer, &stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+	memcpy(data, positions.data(), (size_t)bufferSize);
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	// Vertex buffer on GPU access only area, like the interleaved one
+	VkBufferUsageFlags dstBufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	VkMemoryPropertyFlags dstBufferProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	createBuffer(physicalDevice, device, bufferSize, dstBufferUsage, dstBufferProperties, &positionBuffer, &positionBufferMemory);
+
+	copyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, positionBuffer, bufferSize);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
+
 void Mesh::createIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices)
 {
 	// Get size of buffer needed for indices
@@ -30,6 +30,9 @@ public:
 
 	int getVertexCount();
 	VkBuffer getVertexBuffer();
+	// Positions only (tightly packed glm::vec3, same vertex order), for passes that need nothing else (depth pre-pass):
+	// a third of the bytes per vertex of the interleaved buffer, so more vertices per fetched cache line
+	VkBuffer getPositionBuffer();
 
 	int getIndexCount();
 	VkBuffer getIndexBuffer();
@@ -46,6 +49,9 @@ private:
 	VkBuffer vertexBuffer;
 	VkDeviceMemory vertexBufferMemory;
 
+	VkBuffer positionBuffer;
+	VkDeviceMemory positionBufferMemory;
+
 	int indexCount;
 	VkBuffer indexBuffer;
 	VkDeviceMemory indexBufferMemory;
@@ -54,6 +60,7 @@ private:
 	VkDevice device;
 
 	void createVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices);
+	void createPositionBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices);
 	void createIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices);
 
 };
@@ -18,6 +18,8 @@ public:
 	Mesh* getMesh(size_t index);
 	glm::mat4& getModel();
 	void setModel(glm::mat4 newModel);
+	bool isVisible() { return visible; }
+	void setVisible(bool newVisible) { visible = newVisible; }
 	void destroyMeshModel();
 	~MeshModel();
 
@@ -33,5 +35,6 @@ public:
 private:
 	std::vector<Mesh> meshList;
 	glm::mat4 model;
+	bool visible = true;
 
 };
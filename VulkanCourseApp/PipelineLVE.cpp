@@ -1,6 +1,5 @@
 #include "PipelineLVE.h"
 
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <cassert>
@@ -18,32 +17,13 @@ PipelineLVE::PipelineLVE(
 
 PipelineLVE::~PipelineLVE()
 {
-    vkDestroyShaderModule(m_Device.device(), vertShaderModule, nullptr);
-    vkDestroyShaderModule(m_Device.device(), fragShaderModule, nullptr);
-    vkDestroyPipeline(m_Device.device(), graphicsPipeline, nullptr);
+    // Shader modules are destroyed by the ShaderLibrary with their last reference
+    // graphicsPipeline is destroyed by the registry once no other PipelineLVE shares it
 }
 
 void PipelineLVE::bind(VkCommandBuffer commandBuffer)
 {
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-}
-
-std::vector<char> PipelineLVE::readFile(const std::string& filepath)
-{
-    std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
-
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file: " + filepath);
-    }
-
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-
-    file.close();
-    return buffer;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->pipeline);
 }
 
 void PipelineLVE::createGraphicsPipeline(
@@ -59,29 +39,30 @@ void PipelineLVE::createGraphicsPipeline(
         configInfo.renderPass != VK_NULL_HANDLE &&
         "Cannot create graphics pipeline: no renderPass provided in configInfo!");
 
-    auto vertCode = readFile(vertFilepath);
-    auto fragCode = readFile(fragFilepath);
+    vertShaderModule = m_Device.shaderLibrary().loadShaderModule(vertFilepath);
+    fragShaderModule = m_Device.shaderLibrary().loadShaderModule(fragFilepath);
 
-    createShaderModule(vertCode, &vertShaderModule);
-    createShaderModule(fragCode, &fragShaderModule);
+    // Specialized variant of each stage (a pipeline per variant, shared through the registry)
+    VkSpecializationInfo vertSpecialization = configInfo.vertexVariant.getSpecializationInfo();
+    VkSpecializationInfo fragSpecialization = configInfo.fragmentVariant.getSpecializationInfo();
 
     VkPipelineShaderStageCreateInfo shaderStages[2];
 
     shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].module = vertShaderModule->module;
     shaderStages[0].pName = "main";
     shaderStages[0].flags = 0;
     shaderStages[0].pNext = nullptr;
-    shaderStages[0].pSpecializationInfo = nullptr;
+    shaderStages[0].pSpecializationInfo = configInfo.vertexVariant.empty() ? nullptr : &vertSpecialization;
 
     shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].module = fragShaderModule->module;
     shaderStages[1].pName = "main";
     shaderStages[1].flags = 0;
     shaderStages[1].pNext = nullptr;
-    shaderStages[1].pSpecializationInfo = nullptr;
+    shaderStages[1].pSpecializationInfo = configInfo.fragmentVariant.empty() ? nullptr : &fragSpecialization;
 
     // auto bindingDescriptions = LveModel::Vertex::getBindingDescriptions();
     // auto attributeDescriptions = LveModel::Vertex::getAttributeDescriptions();
@@ -113,30 +94,7 @@ void PipelineLVE::createGraphicsPipeline(
     pipelineInfo.basePipelineIndex = -1;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    if (vkCreateGraphicsPipelines(
-        m_Device.device(),
-        VK_NULL_HANDLE,
-        1,
-        &pipelineInfo,
-        nullptr,
-        &graphicsPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create graphics pipeline!");
-    }
-
-
-
-}
-
-void PipelineLVE::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
-{
-    VkShaderModuleCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-    if (vkCreateShaderModule(m_Device.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create shader module!");
-    }
+    graphicsPipeline = m_Device.pipelineRegistry().getGraphicsPipeline(&pipelineInfo);
 }
 
 void PipelineLVE::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "DeviceLVE.h"
+#include "PipelineRegistry.h"
+#include "ShaderLibrary.h"
+#include "ShaderVariant.h"
 
 #include <string>
 #include <vector>
@@ -22,6 +25,8 @@ struct PipelineConfigInfo {
 	VkPipelineLayout pipelineLayout = nullptr;
 	VkRenderPass renderPass = nullptr;
 	uint32_t subpass = 0;
+	ShaderVariant vertexVariant;   // Specialization constants per stage, empty = shader defaults
+	ShaderVariant fragmentVariant;
 };
 
 class PipelineLVE {
@@ -42,18 +47,14 @@ public:
 	static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
 private:
-	static std::vector<char> readFile(const std::string& filepath);
-
 	void createGraphicsPipeline(
 		const std::string& vertFilepath,
 		const std::string& fragFilepath,
 		const PipelineConfigInfo& configInfo);
 
-	void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
-
 	DeviceLVE& m_Device;
-	VkPipeline graphicsPipeline;
-	VkShaderModule vertShaderModule;
-	VkShaderModule fragShaderModule;
+	PipelineRegistry::PipelineRef graphicsPipeline; // Shared with every other pipeline of the same description
+	ShaderLibrary::ShaderModuleRef vertShaderModule; // Owned by the device's ShaderLibrary, shared with other pipelines
+	ShaderLibrary::ShaderModuleRef fragShaderModule;
 
 };
@@ -0,0 +1,988 @@
+#include "PipelineRegistry.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+
+// FNV-1a, used for the keys and to identify SPIR-V code
+static uint64_t hashBytes(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t result = 14695981039346656037ull;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		result ^= bytes[i];
+		result *= 1099511628211ull;
+	}
+
+	return result;
+}
+
+// Non-dispatchable handles are pointers on 64-bit and uint64_t on 32-bit builds
+template<typename Handle>
+static uint64_t handleValue(Handle handle)
+{
+	return (uint64_t)handle;
+}
+
+// -- EXTENSION STRUCTS --
+// The pNext structs below are part of the key and deep-copied for background compiles. Creation feedback only
+// reports back to the caller, it neither changes the pipeline nor can be written back after a background compile.
+// Any other struct makes the description unique: compiled, never shared, never compiled in the background.
+
+static bool isOutputOnlyExtension(VkStructureType sType)
+{
+#ifdef VK_EXT_pipeline_creation_feedback
+	if (sType == VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT) return true;
+#endif
+	return false;
+}
+
+static bool isKnownExtension(VkStructureType sType)
+{
+	switch (sType)
+	{
+	case VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_DOMAIN_ORIGIN_STATE_CREATE_INFO:
+#ifdef VK_KHR_dynamic_rendering
+	case VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR:
+#endif
+#ifdef VK_EXT_depth_clip_enable
+	case VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_DEPTH_CLIP_STATE_CREATE_INFO_EXT:
+#endif
+		return true;
+	default:
+		return isOutputOnlyExtension(sType);
+	}
+}
+
+static bool hasOnlyKnownExtensions(const void* next)
+{
+	for (const VkBaseInStructure* base = static_cast<const VkBaseInStructure*>(next); base != nullptr; base = base->pNext)
+	{
+		if (!isKnownExtension(base->sType)) return false;
+	}
+	return true;
+}
+
+static bool hasOnlyKnownExtensions(const VkGraphicsPipelineCreateInfo& createInfo)
+{
+	bool known = hasOnlyKnownExtensions(createInfo.pNext);
+	for (uint32_t i = 0; i < createInfo.stageCount; i++)
+	{
+		known = known && hasOnlyKnownExtensions(createInfo.pStages[i].pNext);
+	}
+
+	const void* stateChains[] = {
+		createInfo.pVertexInputState != nullptr ? createInfo.pVertexInputState->pNext : nullptr,
+		createInfo.pInputAssemblyState != nullptr ? createInfo.pInputAssemblyState->pNext : nullptr,
+		createInfo.pTessellationState != nullptr ? createInfo.pTessellationState->pNext : nullptr,
+		createInfo.pViewportState != nullptr ? createInfo.pViewportState->pNext : nullptr,
+		createInfo.pRasterizationState != nullptr ? createInfo.pRasterizationState->pNext : nullptr,
+		createInfo.pMultisampleState != nullptr ? createInfo.pMultisampleState->pNext : nullptr,
+		createInfo.pDepthStencilState != nullptr ? createInfo.pDepthStencilState->pNext : nullptr,
+		createInfo.pColorBlendState != nullptr ? createInfo.pColorBlendState->pNext : nullptr,
+		createInfo.pDynamicState != nullptr ? createInfo.pDynamicState->pNext : nullptr };
+	for (const void* chain : stateChains)
+	{
+		known = known && hasOnlyKnownExtensions(chain);
+	}
+
+	return known;
+}
+
+static bool isDynamicState(const VkPipelineDynamicStateCreateInfo* dynamicState, VkDynamicState state)
+{
+	if (dynamicState == nullptr) return false;
+	return std::find(dynamicState->pDynamicStates, dynamicState->pDynamicStates + dynamicState->dynamicStateCount, state) !=
+		dynamicState->pDynamicStates + dynamicState->dynamicStateCount;
+}
+
+// Deep copy of a VkGraphicsPipelineCreateInfo, so a job can compile it after the caller's structs are gone.
+// Only descriptions with known extension structs are copied (see hasOnlyKnownExtensions), creation feedback is dropped.
+struct GraphicsPipelineCreateInfoCopy
+{
+	VkGraphicsPipelineCreateInfo createInfo;
+
+	// Known extension structs, chained like in the source
+	std::vector<std::shared_ptr<void>> extensions;
+	std::vector<std::vector<VkFormat>> extensionFormats;
+
+	std::vector<VkPipelineShaderStageCreateInfo> stages;
+	std::vector<std::string> entryPoints;
+	std::vector<VkSpecializationInfo> specializations;
+	std::vector<std::vector<VkSpecializationMapEntry>> specializationEntries;
+	std::vector<std::vector<uint8_t>> specializationData;
+
+	VkPipelineVertexInputStateCreateInfo vertexInput;
+	std::vector<VkVertexInputBindingDescription> vertexBindings;
+	std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+	VkPipelineTessellationStateCreateInfo tessellation;
+	VkPipelineViewportStateCreateInfo viewportState;
+	std::vector<VkViewport> viewports;
+	std::vector<VkRect2D> scissors;
+	VkPipelineRasterizationStateCreateInfo rasterization;
+	VkPipelineMultisampleStateCreateInfo multisampling;
+	std::vector<VkSampleMask> sampleMask;
+	VkPipelineDepthStencilStateCreateInfo depthStencil;
+	VkPipelineColorBlendStateCreateInfo colorBlending;
+	std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+	VkPipelineDynamicStateCreateInfo dynamicState;
+	std::vector<VkDynamicState> dynamicStates;
+
+	explicit GraphicsPipelineCreateInfoCopy(const VkGraphicsPipelineCreateInfo& source);
+
+	const void* copyExtensions(const void* next);
+
+	// Points into itself
+	GraphicsPipelineCreateInfoCopy(const GraphicsPipelineCreateInfoCopy&) = delete;
+	GraphicsPipelineCreateInfoCopy& operator=(const GraphicsPipelineCreateInfoCopy&) = delete;
+};
+
+GraphicsPipelineCreateInfoCopy::GraphicsPipelineCreateInfoCopy(const VkGraphicsPipelineCreateInfo& source)
+	: createInfo(source)
+{
+	createInfo.pNext = copyExtensions(source.pNext);
+
+	// Reserved up front, the stages point into these
+	stages.assign(source.pStages, source.pStages + source.stageCount);
+	entryPoints.reserve(stages.size());
+	specializations.reserve(stages.size());
+	specializationEntries.reserve(stages.size());
+	specializationData.reserve(stages.size());
+
+	for (auto& stage : stages)
+	{
+		stage.pNext = copyExtensions(stage.pNext);
+		entryPoints.push_back(stage.pName);
+		stage.pName = entryPoints.back().c_str();
+
+		if (stage.pSpecializationInfo != nullptr)
+		{
+			const VkSpecializationInfo& specialization = *stage.pSpecializationInfo;
+			const uint8_t* data = static_cast<const uint8_t*>(specialization.pData);
+
+			specializationEntries.emplace_back(specialization.pMapEntries, specialization.pMapEntries + specialization.mapEntryCount);
+			specializationData.emplace_back(data, data + specialization.dataSize);
+
+			specializations.push_back(specialization);
+			specializations.back().pMapEntries = specializationEntries.back().data();
+			specializations.back().pData = specializationData.back().data();
+			stage.pSpecializationInfo = &specializations.back();
+		}
+	}
+	createInfo.pStages = stages.data();
+
+	if (source.pVertexInputState != nullptr)
+	{
+		vertexInput = *source.pVertexInputState;
+		vertexInput.pNext = copyExtensions(vertexInput.pNext);
+		vertexBindings.assign(vertexInput.pVertexBindingDescriptions, vertexInput.pVertexBindingDescriptions + vertexInput.vertexBindingDescriptionCount);
+		vertexAttributes.assign(vertexInput.pVertexAttributeDescriptions, vertexInput.pVertexAttributeDescriptions + vertexInput.vertexAttributeDescriptionCount);
+		vertexInput.pVertexBindingDescriptions = vertexBindings.data();
+		vertexInput.pVertexAttributeDescriptions = vertexAttributes.data();
+		createInfo.pVertexInputState = &vertexInput;
+	}
+
+	if (source.pInputAssemblyState != nullptr)
+	{
+		inputAssembly = *source.pInputAssemblyState;
+		inputAssembly.pNext = copyExtensions(inputAssembly.pNext);
+		createInfo.pInputAssemblyState = &inputAssembly;
+	}
+
+	if (source.pTessellationState != nullptr)
+	{
+		tessellation = *source.pTessellationState;
+		tessellation.pNext = copyExtensions(tessellation.pNext);
+		createInfo.pTessellationState = &tessellation;
+	}
+
+	if (source.pViewportState != nullptr)
+	{
+		viewportState = *source.pViewportState;
+		viewportState.pNext = copyExtensions(viewportState.pNext);
+
+		// Ignored (and possibly dangling) when the viewport/scissor are dynamic
+		if (isDynamicState(source.pDynamicState, VK_DYNAMIC_STATE_VIEWPORT) || viewportState.pViewports == nullptr)
+		{
+			viewportState.pViewports = nullptr;
+		}
+		else
+		{
+			viewports.assign(viewportState.pViewports, viewportState.pViewports + viewportState.viewportCount);
+			viewportState.pViewports = viewports.data();
+		}
+		if (isDynamicState(source.pDynamicState, VK_DYNAMIC_STATE_SCISSOR) || viewportState.pScissors == nullptr)
+		{
+			viewportState.pScissors = nullptr;
+		}
+		else
+		{
+			scissors.assign(viewportState.pScissors, viewportState.pScissors + viewportState.scissorCount);
+			viewportState.pScissors = scissors.data();
+		}
+		createInfo.pViewportState = &viewportState;
+	}
+
+	if (source.pRasterizationState != nullptr)
+	{
+		rasterization = *source.pRasterizationState;
+		rasterization.pNext = copyExtensions(rasterization.pNext);
+		createInfo.pRasterizationState = &rasterization;
+	}
+
+	if (source.pMultisampleState != nullptr)
+	{
+		multisampling = *source.pMultisampleState;
+		multisampling.pNext = copyExtensions(multisampling.pNext);
+		if (multisampling.pSampleMask != nullptr)
+		{
+			uint32_t maskWords = (static_cast<uint32_t>(multisampling.rasterizationSamples) + 31) / 32;
+			sampleMask.assign(multisampling.pSampleMask, multisampling.pSampleMask + maskWords);
+			multisampling.pSampleMask = sampleMask.data();
+		}
+		createInfo.pMultisampleState = &multisampling;
+	}
+
+	if (source.pDepthStencilState != nullptr)
+	{
+		depthStencil = *source.pDepthStencilState;
+		depthStencil.pNext = copyExtensions(depthStencil.pNext);
+		createInfo.pDepthStencilState = &depthStencil;
+	}
+
+	if (source.pColorBlendState != nullptr)
+	{
+		colorBlending = *source.pColorBlendState;
+		colorBlending.pNext = copyExtensions(colorBlending.pNext);
+		blendAttachments.assign(colorBlending.pAttachments, colorBlending.pAttachments + colorBlending.attachmentCount);
+		colorBlending.pAttachments = blendAttachments.data();
+		createInfo.pColorBlendState = &colorBlending;
+	}
+
+	if (source.pDynamicState != nullptr)
+	{
+		dynamicState = *source.pDynamicState;
+		dynamicState.pNext = copyExtensions(dynamicState.pNext);
+		dynamicStates.assign(dynamicState.pDynamicStates, dynamicState.pDynamicStates + dynamicState.dynamicStateCount);
+		dynamicState.pDynamicStates = dynamicStates.data();
+		createInfo.pDynamicState = &dynamicState;
+	}
+}
+
+const void* GraphicsPipelineCreateInfoCopy::copyExtensions(const void* next)
+{
+	const void* head = nullptr;
+	VkBaseOutStructure* tail = nullptr;
+
+	for (const VkBaseInStructure* base = static_cast<const VkBaseInStructure*>(next); base != nullptr; base = base->pNext)
+	{
+		std::shared_ptr<void> copy;
+		switch (base->sType)
+		{
+		case VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_DOMAIN_ORIGIN_STATE_CREATE_INFO:
+			copy = std::make_shared<VkPipelineTessellationDomainOriginStateCreateInfo>(*reinterpret_cast<const VkPipelineTessellationDomainOriginStateCreateInfo*>(base));
+			break;
+#ifdef VK_KHR_dynamic_rendering
+		case VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR:
+		{
+			const VkPipelineRenderingCreateInfoKHR* source = reinterpret_cast<const VkPipelineRenderingCreateInfoKHR*>(base);
+			auto rendering = std::make_shared<VkPipelineRenderingCreateInfoKHR>(*source);
+			if (source->pColorAttachmentFormats != nullptr)
+			{
+				// Moving the outer vector keeps the inner buffers where they are
+				extensionFormats.emplace_back(source->pColorAttachmentFormats, source->pColorAttachmentFormats + source->colorAttachmentCount);
+				rendering->pColorAttachmentFormats = extensionFormats.back().data();
+			}
+			copy = rendering;
+			break;
+		}
+#endif
+#ifdef VK_EXT_depth_clip_enable
+		case VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_DEPTH_CLIP_STATE_CREATE_INFO_EXT:
+			copy = std::make_shared<VkPipelineRasterizationDepthClipStateCreateInfoEXT>(*reinterpret_cast<const VkPipelineRasterizationDepthClipStateCreateInfoEXT*>(base));
+			break;
+#endif
+		default:
+			continue; // Creation feedback
+		}
+
+		VkBaseOutStructure* structure = static_cast<VkBaseOutStructure*>(copy.get());
+		structure->pNext = nullptr;
+		if (tail != nullptr)
+		{
+			tail->pNext = structure;
+		}
+		else
+		{
+			head = structure;
+		}
+		tail = structure;
+		extensions.push_back(copy);
+	}
+
+	return head;
+}
+
+PipelineRegistry::PipelineRegistry(VkDevice device, VkPipelineCache pipelineCache)
+	: m_Device{ device }, m_PipelineCache{ pipelineCache }
+{
+}
+
+PipelineRegistry::~PipelineRegistry()
+{
+	// Owners release their references before the device goes away, anything left here would be destroyed through a dangling registry
+	Stats stats = getStats();
+	if (stats.livePipelines > 0 || stats.liveLayouts > 0 || stats.pendingPipelines > 0)
+	{
+		printf("PipelineRegistry destroyed with %i pipelines and %i pipeline layouts still referenced, %i still compiling!\n",
+			(int)stats.livePipelines, (int)stats.liveLayouts, (int)stats.pendingPipelines);
+	}
+}
+
+void PipelineRegistry::registerShaderModule(VkShaderModule module, const void* code, size_t codeSize)
+{
+	uint64_t codeHash = hashBytes(code, codeSize);
+	codeHash ^= codeSize + 0x9e3779b9 + (codeHash << 6) + (codeHash >> 2);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_ShaderHashes[module] = codeHash;
+}
+
+void PipelineRegistry::unregisterShaderModule(VkShaderModule module)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_ShaderHashes.erase(module);
+}
+
+PipelineRegistry::PipelineLayoutRef PipelineRegistry::getPipelineLayout(const VkPipelineLayoutCreateInfo* createInfo)
+{
+	PipelineKey key = makeLayoutKey(createInfo);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Stats.layoutRequests++;
+
+	auto it = m_Layouts.find(key);
+	if (it != m_Layouts.end())
+	{
+		PipelineLayoutRef existing = it->second.lock();
+		if (existing != nullptr)
+		{
+			m_Stats.layoutsShared++;
+			return existing;
+		}
+	}
+
+	VkPipelineLayout layout;
+	VkResult result = vkCreatePipelineLayout(m_Device, createInfo, nullptr, &layout);
+
+	printf("---- vkCreatePipelineLayout layout PipelineRegistry::getPipelineLayout()\n");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Pipeline Layout!");
+	}
+
+	PipelineLayout* layoutObject = new PipelineLayout();
+	layoutObject->layout = layout;
+
+	PipelineLayoutRef layoutRef(layoutObject, [this, key](PipelineLayout* object) { releaseLayout(key, object); });
+
+	m_Layouts[key] = layoutRef;
+	m_LayoutsByHandle[layout] = layoutRef;
+
+	return layoutRef;
+}
+
+PipelineRegistry::PipelineRef PipelineRegistry::getGraphicsPipeline(const VkGraphicsPipelineCreateInfo* createInfo, uint64_t renderPassKey)
+{
+	PipelineKey key;
+	PipelineLayoutRef layoutRef; // Declared outside the lock, dropping a reference may take it
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		key = makePipelineKey(createInfo, renderPassKey);
+		m_Stats.pipelineRequests++;
+
+		auto it = m_Pipelines.find(key);
+		if (it != m_Pipelines.end())
+		{
+			PipelineRef existing = it->second.lock();
+			if (existing != nullptr)
+			{
+				m_Stats.pipelinesShared++;
+				return existing;
+			}
+		}
+
+		// Layouts created elsewhere stay owned (and kept alive) by their creator
+		auto layoutIt = m_LayoutsByHandle.find(createInfo->layout);
+		if (layoutIt != m_LayoutsByHandle.end())
+		{
+			layoutRef = layoutIt->second.lock();
+		}
+	}
+
+	// A job may be compiling the same description right now. It is compiled here anyway (mostly a pipeline
+	// cache hit by then), waiting for it could stall a thread that does not run jobs.
+	return compilePipeline(createInfo, key, layoutRef);
+}
+
+PipelineRegistry::PipelineRequestRef PipelineRegistry::requestGraphicsPipeline(const VkGraphicsPipelineCreateInfo* createInfo, JobSystem& jobSystem,
+	JobSystem::LaneId compileLane, uint64_t renderPassKey)
+{
+	PipelineRequestRef request = std::make_shared<PipelineRequest>();
+
+	// Unknown extension structs can not be copied for a job, compiled right here instead
+	if (!hasOnlyKnownExtensions(*createInfo))
+	{
+		try
+		{
+			request->pipeline = getGraphicsPipeline(createInfo, renderPassKey);
+		}
+		catch (const std::exception& e)
+		{
+			// Requesters keep using their fallback
+			printf("ERROR: pipeline compilation: %s\n", e.what());
+		}
+		request->complete.store(true, std::memory_order_release);
+		return request;
+	}
+
+	PipelineKey key;
+	PipelineLayoutRef layoutRef;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		key = makePipelineKey(createInfo, renderPassKey);
+		m_Stats.pipelineRequests++;
+
+		auto it = m_Pipelines.find(key);
+		if (it != m_Pipelines.end())
+		{
+			PipelineRef existing = it->second.lock();
+			if (existing != nullptr)
+			{
+				m_Stats.pipelinesShared++;
+				request->pipeline = existing;
+				request->complete.store(true, std::memory_order_release);
+				return request;
+			}
+		}
+
+		auto pendingIt = m_PendingRequests.find(key);
+		if (pendingIt != m_PendingRequests.end())
+		{
+			m_Stats.pipelinesShared++;
+			return pendingIt->second;
+		}
+
+		auto layoutIt = m_LayoutsByHandle.find(createInfo->layout);
+		if (layoutIt != m_LayoutsByHandle.end())
+		{
+			layoutRef = layoutIt->second.lock();
+		}
+
+		// The job only owns copies, the caller's structs may go away right after this call
+		std::shared_ptr<GraphicsPipelineCreateInfoCopy> createInfoCopy = std::make_shared<GraphicsPipelineCreateInfoCopy>(*createInfo);
+
+		// On the compile lane: only idle workers pick it up, never a thread waiting on its frame's jobs
+		request->job = jobSystem.scheduleOnLane(compileLane, [this, request, createInfoCopy, key, layoutRef]()
+		{
+			PipelineRef pipeline;
+			try
+			{
+				pipeline = compilePipeline(&createInfoCopy->createInfo, key, layoutRef);
+			}
+			catch (const std::exception& e)
+			{
+				// Requesters keep using their fallback
+				printf("ERROR: background pipeline compilation: %s\n", e.what());
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_PendingRequests.erase(key);
+				m_Stats.pipelinesCompiledAsync++;
+			}
+
+			request->pipeline = pipeline;
+			request->complete.store(true, std::memory_order_release);
+		});
+
+		// Entered before it can complete (the job takes the lock), so identical requests from now on wait for this one
+		m_PendingRequests[key] = request;
+	}
+
+	// Without workers nobody would pick the job up until someone waits, compile it right here instead
+	if (jobSystem.getWorkerCount() == 0)
+	{
+		jobSystem.wait(request->job);
+	}
+
+	return request;
+}
+
+void PipelineRegistry::waitForPendingPipelines(JobSystem& jobSystem)
+{
+	std::vector<JobSystem::JobHandle> jobs;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto& pending : m_PendingRequests)
+		{
+			jobs.push_back(pending.second->job);
+		}
+	}
+
+	for (auto& job : jobs)
+	{
+		jobSystem.wait(job);
+	}
+}
+
+uint32_t PipelineRegistry::getPendingPipelineCount()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return static_cast<uint32_t>(m_PendingRequests.size());
+}
+
+PipelineRegistry::PipelineRef PipelineRegistry::compilePipeline(const VkGraphicsPipelineCreateInfo* createInfo, const PipelineKey& key, const PipelineLayoutRef& layoutRef)
+{
+	// Compiled without holding the lock, other threads keep looking up and compiling meanwhile
+	VkPipeline pipeline;
+	VkResult result = vkCreateGraphicsPipelines(m_Device, m_PipelineCache, 1, createInfo, nullptr, &pipeline);
+
+	printf("---- vkCreateGraphicsPipelines pipeline PipelineRegistry::compilePipeline()\n");
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Graphics Pipeline!");
+	}
+
+	Pipeline* pipelineObject = new Pipeline();
+	pipelineObject->pipeline = pipeline;
+	pipelineObject->layout = layoutRef;
+
+	PipelineRef pipelineRef(pipelineObject, [this, key](Pipeline* object) { releasePipeline(key, object); });
+	PipelineRef existing;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		auto& entry = m_Pipelines[key];
+		existing = entry.lock();
+
+		if (existing == nullptr)
+		{
+			entry = pipelineRef;
+			return pipelineRef;
+		}
+
+		m_Stats.pipelinesShared++;
+	}
+
+	// Another thread compiled the same description first, keep theirs (ours is released on return)
+	return existing;
+}
+
+PipelineRegistry::Stats PipelineRegistry::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	Stats stats = m_Stats;
+	stats.pendingPipelines = static_cast<uint32_t>(m_PendingRequests.size());
+	stats.liveLayouts = static_cast<uint32_t>(std::count_if(m_Layouts.begin(), m_Layouts.end(),
+		[](const std::pair<const PipelineKey, std::weak_ptr<const PipelineLayout>>& entry) { return !entry.second.expired(); }));
+	stats.livePipelines = static_cast<uint32_t>(std::count_if(m_Pipelines.begin(), m_Pipelines.end(),
+		[](const std::pair<const PipelineKey, std::weak_ptr<const Pipeline>>& entry) { return !entry.second.expired(); }));
+
+	return stats;
+}
+
+PipelineRegistry::PipelineKey PipelineRegistry::makeLayoutKey(const VkPipelineLayoutCreateInfo* createInfo)
+{
+	PipelineKey key;
+	key.write(createInfo->flags);
+
+	// Set layouts are deduplicated by DescriptorLayoutCache, so their handles identify them
+	key.write(createInfo->setLayoutCount);
+	for (uint32_t i = 0; i < createInfo->setLayoutCount; i++)
+	{
+		key.write(handleValue(createInfo->pSetLayouts[i]));
+	}
+
+	key.write(createInfo->pushConstantRangeCount);
+	for (uint32_t i = 0; i < createInfo->pushConstantRangeCount; i++)
+	{
+		key.write(createInfo->pPushConstantRanges[i].stageFlags);
+		key.write(createInfo->pPushConstantRanges[i].offset);
+		key.write(createInfo->pPushConstantRanges[i].size);
+	}
+
+	return key;
+}
+
+PipelineRegistry::PipelineKey PipelineRegistry::makePipelineKey(const VkGraphicsPipelineCreateInfo* createInfo, uint64_t renderPassKey)
+{
+	PipelineKey key;
+	bool extensionsKnown = writeExtensions(key, createInfo->pNext);
+	key.write(createInfo->flags);
+
+	// -- SHADER STAGES --
+	key.write(createInfo->stageCount);
+	for (uint32_t i = 0; i < createInfo->stageCount; i++)
+	{
+		const VkPipelineShaderStageCreateInfo& stage = createInfo->pStages[i];
+		extensionsKnown = writeExtensions(key, stage.pNext) && extensionsKnown;
+		key.write(stage.flags);
+		key.write(stage.stage);
+
+		// SPIR-V hash when known, otherwise the module handle
+		auto hashIt = m_ShaderHashes.find(stage.module);
+		key.write(hashIt != m_ShaderHashes.end());
+		key.write(hashIt != m_ShaderHashes.end() ? hashIt->second : handleValue(stage.module));
+
+		key.writeBytes(stage.pName, strlen(stage.pName) + 1);
+
+		const VkSpecializationInfo* specialization = stage.pSpecializationInfo;
+		key.write(specialization != nullptr);
+		if (specialization != nullptr)
+		{
+			key.write(specialization->mapEntryCount);
+			for (uint32_t j = 0; j < specialization->mapEntryCount; j++)
+			{
+				key.write(specialization->pMapEntries[j].constantID);
+				key.write(specialization->pMapEntries[j].offset);
+				key.write(static_cast<uint64_t>(specialization->pMapEntries[j].size));
+			}
+			key.write(static_cast<uint64_t>(specialization->dataSize));
+			key.writeBytes(specialization->pData, specialization->dataSize);
+		}
+	}
+
+	// -- DYNAMIC STATES -- (first, they decide which of the fixed values below matter)
+	std::vector<VkDynamicState> dynamicStates;
+	if (createInfo->pDynamicState != nullptr)
+	{
+		dynamicStates.assign(createInfo->pDynamicState->pDynamicStates,
+			createInfo->pDynamicState->pDynamicStates + createInfo->pDynamicState->dynamicStateCount);
+		std::sort(dynamicStates.begin(), dynamicStates.end());
+	}
+
+	auto isDynamic = [&dynamicStates](VkDynamicState state) { return std::binary_search(dynamicStates.begin(), dynamicStates.end(), state); };
+
+	key.write(static_cast<uint32_t>(dynamicStates.size()));
+	for (VkDynamicState state : dynamicStates)
+	{
+		key.write(state);
+	}
+	if (createInfo->pDynamicState != nullptr)
+	{
+		extensionsKnown = writeExtensions(key, createInfo->pDynamicState->pNext) && extensionsKnown;
+	}
+
+	// -- VERTEX INPUT --
+	const VkPipelineVertexInputStateCreateInfo* vertexInput = createInfo->pVertexInputState;
+	key.write(vertexInput != nullptr);
+	if (vertexInput != nullptr)
+	{
+		extensionsKnown = writeExtensions(key, vertexInput->pNext) && extensionsKnown;
+		key.write(vertexInput->vertexBindingDescriptionCount);
+		for (uint32_t i = 0; i < vertexInput->vertexBindingDescriptionCount; i++)
+		{
+			key.write(vertexInput->pVertexBindingDescriptions[i].binding);
+			key.write(vertexInput->pVertexBindingDescriptions[i].stride);
+			key.write(vertexInput->pVertexBindingDescriptions[i].inputRate);
+		}
+
+		key.write(vertexInput->vertexAttributeDescriptionCount);
+		for (uint32_t i = 0; i < vertexInput->vertexAttributeDescriptionCount; i++)
+		{
+			key.write(vertexInput->pVertexAttributeDescriptions[i].location);
+			key.write(vertexInput->pVertexAttributeDescriptions[i].binding);
+			key.write(vertexInput->pVertexAttributeDescriptions[i].format);
+			key.write(vertexInput->pVertexAttributeDescriptions[i].offset);
+		}
+	}
+
+	// -- INPUT ASSEMBLY / TESSELLATION --
+	const VkPipelineInputAssemblyStateCreateInfo* inputAssembly = createInfo->pInputAssemblyState;
+	key.write(inputAssembly != nullptr);
+	if (inputAssembly != nullptr)
+	{
+		extensionsKnown = writeExtensions(key, inputAssembly->pNext) && extensionsKnown;
+		key.write(inputAssembly->topology);
+		key.write(inputAssembly->primitiveRestartEnable);
+	}
+
+	key.write(createInfo->pTessellationState != nullptr);
+	if (createInfo->pTessellationState != nullptr)
+	{
+		extensionsKnown = writeExtensions(key, createInfo->pTessellationState->pNext) && extensionsKnown;
+		key.write(createInfo->pTessellationState->patchControlPoints);
+	}
+
+	// -- VIEWPORT & SCISSOR -- (dynamic values are set while recording, only the counts are baked in, unless those are dynamic too)
+	bool viewportCountDynamic = false;
+	bool scissorCountDynamic = false;
+#ifdef VK_EXT_extended_dynamic_state
+	viewportCountDynamic = isDynamic(VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT_EXT);
+	scissorCountDynamic = isDynamic(VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT_EXT);
+#endif
+
+	const VkPipelineViewportStateCreateInfo* viewportState = createInfo->pViewportState;
+	key.write(viewportState != nullptr);
+	if (viewportState != nullptr)
+	{
+		extensionsKnown = writeExtensions(key, viewportState->pNext) && extensionsKnown;
+
+		if (!viewportCountDynamic)
+		{
+			key.write(viewportState->viewportCount);
+		}
+		if (!viewportCountDynamic && !isDynamic(VK_DYNAMIC_STATE_VIEWPORT))
+		{
+			for (uint32_t i = 0; i < viewportState->viewportCount; i++)
+			{
+				const VkViewport& viewport = viewportState->pViewports[i];
+				key.write(viewport.x);
+				key.write(viewport.y);
+				key.write(viewport.width);
+				key.write(viewport.height);
+				key.write(viewport.minDepth);
+				key.write(viewport.maxDepth);
+			}
+		}
+
+		if (!scissorCountDynamic)
+		{
+			key.write(viewportState->scissorCount);
+		}
+		if (!scissorCountDynamic && !isDynamic(VK_DYNAMIC_STATE_SCISSOR))
+		{
+			for (uint32_t i = 0; i < viewportState->scissorCount; i++)
+			{
+				const VkRect2D& scissor = viewportState->pScissors[i];
+				key.write(scissor.offset.x);
+				key.write(scissor.offset.y);
+				key.write(scissor.extent.width);
+				key.write(scissor.extent.height);
+			}
+		}
+	}
+
+	// -- RASTERIZER --
+	const VkPipelineRasterizationStateCreateInfo* rasterizer = createInfo->pRasterizationState;
+	extensionsKnown = writeExtensions(key, rasterizer->pNext) && extensionsKnown;
+	key.write(rasterizer->depthClampEnable);
+	key.write(rasterizer->rasterizerDiscardEnable);
+	key.write(rasterizer->polygonMode);
+	key.write(rasterizer->cullMode);
+	key.write(rasterizer->frontFace);
+	key.write(rasterizer->depthBiasEnable);
+	if (rasterizer->depthBiasEnable && !isDynamic(VK_DYNAMIC_STATE_DEPTH_BIAS))
+	{
+		key.write(rasterizer->depthBiasConstantFactor);
+		key.write(rasterizer->depthBiasClamp);
+		key.write(rasterizer->depthBiasSlopeFactor);
+	}
+	if (!isDynamic(VK_DYNAMIC_STATE_LINE_WIDTH))
+	{
+		key.write(rasterizer->lineWidth);
+	}
+
+	// -- MULTISAMPLING --
+	const VkPipelineMultisampleStateCreateInfo* multisampling = createInfo->pMultisampleState;
+	key.write(multisampling != nullptr);
+	if (multisampling != nullptr)
+	{
+		extensionsKnown = writeExtensions(key, multisampling->pNext) && extensionsKnown;
+		key.write(multisampling->rasterizationSamples);
+		key.write(multisampling->sampleShadingEnable);
+		key.write(multisampling->minSampleShading);
+		key.write(multisampling->pSampleMask != nullptr);
+		if (multisampling->pSampleMask != nullptr)
+		{
+			uint32_t maskWords = (static_cast<uint32_t>(multisampling->rasterizationSamples) + 31) / 32;
+			key.writeBytes(multisampling->pSampleMask, maskWords * sizeof(VkSampleMask));
+		}
+		key.write(multisampling->alphaToCoverageEnable);
+		key.write(multisampling->alphaToOneEnable);
+	}
+
+	// -- DEPTH STENCIL --
+	const VkPipelineDepthStencilStateCreateInfo* depthStencil = createInfo->pDepthStencilState;
+	key.write(depthStencil != nullptr);
+	if (depthStencil != nullptr)
+	{
+		extensionsKnown = writeExtensions(key, depthStencil->pNext) && extensionsKnown;
+		key.write(depthStencil->depthTestEnable);
+		key.write(depthStencil->depthWriteEnable);
+		key.write(depthStencil->depthCompareOp);
+		key.write(depthStencil->depthBoundsTestEnable);
+		if (!isDynamic(VK_DYNAMIC_STATE_DEPTH_BOUNDS))
+		{
+			key.write(depthStencil->minDepthBounds);
+			key.write(depthStencil->maxDepthBounds);
+		}
+		key.write(depthStencil->stencilTestEnable);
+
+		for (const VkStencilOpState* op : { &depthStencil->front, &depthStencil->back })
+		{
+			key.write(op->failOp);
+			key.write(op->passOp);
+			key.write(op->depthFailOp);
+			key.write(op->compareOp);
+			if (!isDynamic(VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK)) key.write(op->compareMask);
+			if (!isDynamic(VK_DYNAMIC_STATE_STENCIL_WRITE_MASK)) key.write(op->writeMask);
+			if (!isDynamic(VK_DYNAMIC_STATE_STENCIL_REFERENCE)) key.write(op->reference);
+		}
+	}
+
+	// -- BLENDING --
+	const VkPipelineColorBlendStateCreateInfo* colorBlending = createInfo->pColorBlendState;
+	key.write(colorBlending != nullptr);
+	if (colorBlending != nullptr)
+	{
+		extensionsKnown = writeExtensions(key, colorBlending->pNext) && extensionsKnown;
+		key.write(colorBlending->logicOpEnable);
+		key.write(colorBlending->logicOp);
+		key.write(colorBlending->attachmentCount);
+		for (uint32_t i = 0; i < colorBlending->attachmentCount; i++)
+		{
+			const VkPipelineColorBlendAttachmentState& attachment = colorBlending->pAttachments[i];
+			key.write(attachment.blendEnable);
+			key.write(attachment.srcColorBlendFactor);
+			key.write(attachment.dstColorBlendFactor);
+			key.write(attachment.colorBlendOp);
+			key.write(attachment.srcAlphaBlendFactor);
+			key.write(attachment.dstAlphaBlendFactor);
+			key.write(attachment.alphaBlendOp);
+			key.write(attachment.colorWriteMask);
+		}
+		if (!isDynamic(VK_DYNAMIC_STATE_BLEND_CONSTANTS))
+		{
+			for (float constant : colorBlending->blendConstants)
+			{
+				key.write(constant);
+			}
+		}
+	}
+
+	// -- LAYOUT & RENDER PASS --
+	key.write(handleValue(createInfo->layout));
+	key.write(renderPassKey != 0 ? renderPassKey : handleValue(createInfo->renderPass));
+	key.write(createInfo->subpass);
+
+	// Unknown extension structs may change anything: a key no other description has
+	if (!extensionsKnown)
+	{
+		key.write(++m_UniqueKeyCount);
+	}
+
+	return key;
+}
+
+bool PipelineRegistry::writeExtensions(PipelineKey& key, const void* next)
+{
+	bool known = true;
+
+	for (const VkBaseInStructure* base = static_cast<const VkBaseInStructure*>(next); base != nullptr; base = base->pNext)
+	{
+		if (isOutputOnlyExtension(base->sType)) continue;
+
+		key.write(base->sType);
+		switch (base->sType)
+		{
+		case VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_DOMAIN_ORIGIN_STATE_CREATE_INFO:
+			key.write(reinterpret_cast<const VkPipelineTessellationDomainOriginStateCreateInfo*>(base)->domainOrigin);
+			break;
+#ifdef VK_KHR_dynamic_rendering
+		case VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR:
+		{
+			const VkPipelineRenderingCreateInfoKHR* rendering = reinterpret_cast<const VkPipelineRenderingCreateInfoKHR*>(base);
+			key.write(rendering->viewMask);
+			key.write(rendering->colorAttachmentCount);
+			if (rendering->pColorAttachmentFormats != nullptr)
+			{
+				key.writeBytes(rendering->pColorAttachmentFormats, rendering->colorAttachmentCount * sizeof(VkFormat));
+			}
+			key.write(rendering->depthAttachmentFormat);
+			key.write(rendering->stencilAttachmentFormat);
+			break;
+		}
+#endif
+#ifdef VK_EXT_depth_clip_enable
+		case VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_DEPTH_CLIP_STATE_CREATE_INFO_EXT:
+		{
+			const VkPipelineRasterizationDepthClipStateCreateInfoEXT* depthClip = reinterpret_cast<const VkPipelineRasterizationDepthClipStateCreateInfoEXT*>(base);
+			key.write(depthClip->flags);
+			key.write(depthClip->depthClipEnable);
+			break;
+		}
+#endif
+		default:
+			known = false;
+			break;
+		}
+	}
+
+	return known;
+}
+
+void PipelineRegistry::releaseLayout(const PipelineKey& key, PipelineLayout* layout)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		// The description may have been requested (and created) again in the meantime, only drop stale entries
+		auto it = m_Layouts.find(key);
+		if (it != m_Layouts.end() && it->second.expired())
+		{
+			m_Layouts.erase(it);
+		}
+
+		auto handleIt = m_LayoutsByHandle.find(layout->layout);
+		if (handleIt != m_LayoutsByHandle.end() && handleIt->second.expired())
+		{
+			m_LayoutsByHandle.erase(handleIt);
+		}
+	}
+
+	vkDestroyPipelineLayout(m_Device, layout->layout, nullptr);
+	delete layout;
+}
+
+void PipelineRegistry::releasePipeline(const PipelineKey& key, Pipeline* pipeline)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		auto it = m_Pipelines.find(key);
+		if (it != m_Pipelines.end() && it->second.expired())
+		{
+			m_Pipelines.erase(it);
+		}
+	}
+
+	vkDestroyPipeline(m_Device, pipeline->pipeline, nullptr);
+	delete pipeline; // Releases the layout reference, outside of the lock
+}
+
+void PipelineRegistry::PipelineKey::writeBytes(const void* data, size_t size)
+{
+	const uint8_t* begin = static_cast<const uint8_t*>(data);
+	bytes.insert(bytes.end(), begin, begin + size);
+}
+
+size_t PipelineRegistry::PipelineKey::hash() const
+{
+	return static_cast<size_t>(hashBytes(bytes.data(), bytes.size()));
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+// Deduplicates pipeline layouts and graphics pipelines by their full description, so every caller asking for
+// identical state (shaders, vertex layout, raster, blend, depth, dynamic state, layout, render pass compatibility,
+// subpass) shares one VkPipeline. Sharing the handle also means CommandStateTracker skips the bind when
+// consecutive draws use it.
+// Returned objects are reference counted: the Vulkan object is destroyed when the last reference is released,
+// which must only happen once the GPU is done with it (e.g. after FrameScheduler::flush()) and before the
+// registry itself is destroyed. Thread safe, pipelines may be requested from any thread, and compiled in the
+// background on a JobSystem lane (requestGraphicsPipeline).
+class PipelineRegistry
+{
+public:
+	struct PipelineLayout
+	{
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+	};
+
+	struct Pipeline
+	{
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::shared_ptr<const PipelineLayout> layout; // Kept alive as long as the pipeline (empty if not from the registry)
+	};
+
+	using PipelineLayoutRef = std::shared_ptr<const PipelineLayout>;
+	using PipelineRef = std::shared_ptr<const Pipeline>;
+
+	// Pipeline compiled by a job. Identical requests made while it compiles share the same request.
+	struct PipelineRequest
+	{
+		JobSystem::JobHandle job;            // Empty if the pipeline already existed
+		PipelineRef pipeline;                // Written before complete is set, empty if compilation failed
+		std::atomic<bool> complete{ false };
+
+		bool isComplete() const { return complete.load(std::memory_order_acquire); }
+	};
+
+	using PipelineRequestRef = std::shared_ptr<PipelineRequest>;
+
+	struct Stats
+	{
+		uint32_t layoutRequests = 0;
+		uint32_t layoutsShared = 0;   // Requests answered with an existing layout
+		uint32_t pipelineRequests = 0;
+		uint32_t pipelinesShared = 0; // Requests answered with an existing (or already compiling) pipeline
+		uint32_t pipelinesCompiledAsync = 0;
+		uint32_t pendingPipelines = 0;
+		uint32_t liveLayouts = 0;
+		uint32_t livePipelines = 0;
+	};
+
+	PipelineRegistry(VkDevice device, VkPipelineCache pipelineCache);
+	~PipelineRegistry();
+
+	PipelineRegistry(const PipelineRegistry&) = delete;
+	PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+	// Identifies shader modules by their SPIR-V instead of their handle, so modules loaded twice from the same
+	// file still share pipelines. Unregister before the module is destroyed (handles get reused).
+	void registerShaderModule(VkShaderModule module, const void* code, size_t codeSize);
+	void unregisterShaderModule(VkShaderModule module);
+
+	PipelineLayoutRef getPipelineLayout(const VkPipelineLayoutCreateInfo* createInfo);
+
+	// A layout from getPipelineLayout is kept alive by the pipeline, any other layout must outlive it.
+	// Known extension structs (dynamic rendering, tessellation domain origin, depth clip) are part of the key,
+	// a description with any other pNext struct is compiled but not shared.
+	// renderPassKey identifies the render pass compatibility class (e.g. derived from the attachment formats),
+	// so a recreated but compatible render pass keeps its pipelines. 0 keys on the VkRenderPass handle itself.
+	PipelineRef getGraphicsPipeline(const VkGraphicsPipelineCreateInfo* createInfo, uint64_t renderPassKey = 0);
+
+	// Same as getGraphicsPipeline, but returns right away and compiles on a job of compileLane (through the shared
+	// pipeline cache), so only idle workers compile and threads waiting on their own jobs never do.
+	// Creation feedback is not written back; descriptions with unknown extension structs compile right here.
+	// The create info is copied, the shader modules, layout and render pass must stay alive until the request completes.
+	PipelineRequestRef requestGraphicsPipeline(const VkGraphicsPipelineCreateInfo* createInfo, JobSystem& jobSystem,
+		JobSystem::LaneId compileLane, uint64_t renderPassKey = 0);
+
+	// Waits until every pipeline requested so far has been compiled (compiling those no worker has started)
+	void waitForPendingPipelines(JobSystem& jobSystem);
+	uint32_t getPendingPipelineCount();
+
+	Stats getStats();
+
+private:
+	// Flattened description, every field that affects the created object written one after another
+	struct PipelineKey
+	{
+		std::vector<uint8_t> bytes;
+
+		template<typename T>
+		void write(const T& value) { writeBytes(&value, sizeof(T)); }
+		void writeBytes(const void* data, size_t size);
+
+		bool operator==(const PipelineKey& other) const { return bytes == other.bytes; }
+		size_t hash() const;
+	};
+
+	struct PipelineKeyHash
+	{
+		size_t operator()(const PipelineKey& key) const { return key.hash(); }
+	};
+
+	PipelineKey makeLayoutKey(const VkPipelineLayoutCreateInfo* createInfo);
+	// Descriptions with unknown extension structs get a key of their own (never shared)
+	PipelineKey makePipelineKey(const VkGraphicsPipelineCreateInfo* createInfo, uint64_t renderPassKey);
+	// False if the chain holds a struct the registry does not know
+	static bool writeExtensions(PipelineKey& key, const void* next);
+
+	// Creates the pipeline and enters it, unless another thread entered the same key first
+	PipelineRef compilePipeline(const VkGraphicsPipelineCreateInfo* createInfo, const PipelineKey& key, const PipelineLayoutRef& layoutRef);
+
+	// Called by the last reference
+	void releaseLayout(const PipelineKey& key, PipelineLayout* layout);
+	void releasePipeline(const PipelineKey& key, Pipeline* pipeline);
+
+	VkDevice m_Device;
+	VkPipelineCache m_PipelineCache;
+
+	std::mutex m_Mutex;
+	std::unordered_map<PipelineKey, std::weak_ptr<const PipelineLayout>, PipelineKeyHash> m_Layouts;
+	std::unordered_map<VkPipelineLayout, std::weak_ptr<const PipelineLayout>> m_LayoutsByHandle;
+	std::unordered_map<PipelineKey, std::weak_ptr<const Pipeline>, PipelineKeyHash> m_Pipelines;
+	std::unordered_map<PipelineKey, PipelineRequestRef, PipelineKeyHash> m_PendingRequests;
+	std::unordered_map<VkShaderModule, uint64_t> m_ShaderHashes;
+	uint64_t m_UniqueKeyCount = 0;
+
+	Stats m_Stats;
+
+};
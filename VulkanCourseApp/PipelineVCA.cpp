@@ -1,7 +1,6 @@
 #include "PipelineVCA.h"
 #include "Utilities.h"
 
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <cassert>
@@ -22,31 +21,12 @@ PipelineVCA::PipelineVCA(
 
 PipelineVCA::~PipelineVCA()
 {
-	delete m_Shader.get();
-    vkDestroyPipeline(m_Device->device(), m_GraphicsPipeline, nullptr);
+    // m_GraphicsPipeline and m_PipelineLayout are released to the PipelineRegistry
 }
 
 void PipelineVCA::bind(VkCommandBuffer commandBuffer)
 {
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
-}
-
-std::vector<char> PipelineVCA::readFile(const std::string& filepath)
-{
-    std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
-
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file: " + filepath);
-    }
-
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-
-    file.close();
-    return buffer;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline->pipeline);
 }
 
 void PipelineVCA::createGraphicsPipeline(
@@ -56,12 +36,6 @@ void PipelineVCA::createGraphicsPipeline(
 {
     m_Shader = std::make_shared<Shader>(m_Device, filepathVertex, filepathFragment);
 
-	// Read in SPIR-V code of shaders
-	auto vertexShaderCode = readFile("Shaders/vert.spv");
-	auto fragmentShaderCode = readFile("Shaders/frag.spv");
-
-	printf("Vulkan SPIR-V shader code successfully loaded.\n");
-
 	// -- SHADER STAGE CREATION INFORMATION --
 	// Vertex Stage creation information
 	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
@@ -77,6 +51,12 @@ void PipelineVCA::createGraphicsPipeline(
 	fragmentShaderCreateInfo.module = m_Shader->getShaderModuleFragment(); // Shader module to be used by stage
 	fragmentShaderCreateInfo.pName = "main";                               // Entry point into shader
 
+	// Specialized variant of each stage (a pipeline per variant, shared through the registry)
+	VkSpecializationInfo vertexSpecialization = configInfo.vertexVariant.getSpecializationInfo();
+	VkSpecializationInfo fragmentSpecialization = configInfo.fragmentVariant.getSpecializationInfo();
+	vertexShaderCreateInfo.pSpecializationInfo = configInfo.vertexVariant.empty() ? nullptr : &vertexSpecialization;
+	fragmentShaderCreateInfo.pSpecializationInfo = configInfo.fragmentVariant.empty() ? nullptr : &fragmentSpecialization;
+
 	// Put shader stage creation info into an array
 	// Graphics Pipeline creation info requires array of shader stage creates
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
@@ -215,12 +195,8 @@ void PipelineVCA::createGraphicsPipeline(
 	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 	pipelineLayoutCreateInfo.pPushConstantRanges = &m_PushConstantRange;
 
-	// Create Pipeline Layout
-	VkResult result = vkCreatePipelineLayout(m_Device->device(), &pipelineLayoutCreateInfo, nullptr, &m_PipelineLayout);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create Pipeline Layout (1st Subpass)!");
-	}
+	// Create Pipeline Layout (or share an identical one)
+	m_PipelineLayout = m_Device->pipelineRegistry().getPipelineLayout(&pipelineLayoutCreateInfo);
 
 	printf("Vulkan Pipeline Layout (1st Subpass) successfully created.\n");
 
@@ -246,7 +222,7 @@ void PipelineVCA::createGraphicsPipeline(
 	pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
 	pipelineCreateInfo.pColorBlendState = &colorBlendingCreateInfo;
 	pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
-	pipelineCreateInfo.layout = m_PipelineLayout;   // Pipeline Layout the pipeline should use
+	pipelineCreateInfo.layout = m_PipelineLayout->layout; // Pipeline Layout the pipeline should use
 	pipelineCreateInfo.renderPass = m_RenderPass; // Render Pass description the pipeline is compatible with (Pipeline is used by the Render Pass)
 	pipelineCreateInfo.subpass = 0;               // Subpass of Render Pass to use with the pipeline
 
@@ -255,16 +231,12 @@ void PipelineVCA::createGraphicsPipeline(
 	pipelineCreateInfo.basePipelineIndex = -1; // or index of pipeline being created to derive from (in case creating multiple at once)
 
 	// Create Graphics Pipeline
-	result = vkCreateGraphicsPipelines(m_Device->device(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &m_GraphicsPipeline);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a Graphics Pipeline (1st Subpass)!");
-	}
+	m_GraphicsPipeline = m_Device->pipelineRegistry().getGraphicsPipeline(&pipelineCreateInfo);
 
 	printf("Vulkan Graphics Pipeline (1st Subpass) successfully created.\n");
 
-	// Destroy Shader Modules, no longer needed after Pipeline created
-	delete m_Shader.get();
+	// Release the Shader Modules, no longer needed after Pipeline created (the ShaderLibrary destroys them once unused)
+	m_Shader.reset();
 }
 
 void PipelineVCA::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
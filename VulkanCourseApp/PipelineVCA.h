@@ -1,7 +1,9 @@
 #pragma once
 
 #include "DeviceLVE.h"
+#include "PipelineRegistry.h"
 #include "Shader.h"
+#include "ShaderVariant.h"
 #include "SwapChainLVE.h"
 
 #include <string>
@@ -24,6 +26,8 @@ struct PipelineConfigInfo {
 	VkPipelineLayout pipelineLayout = nullptr;
 	VkRenderPass renderPass = nullptr;
 	uint32_t subpass = 0;
+	ShaderVariant vertexVariant;   // Specialization constants per stage, empty = shader defaults
+	ShaderVariant fragmentVariant;
 };
 
 class PipelineVCA {
@@ -46,7 +50,6 @@ public:
 	static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
 private:
-	static std::vector<char> readFile(const std::string& filepath);
 
 	void createGraphicsPipeline(
 		const std::string& filepathVertex,
@@ -58,8 +61,8 @@ private:
 	std::shared_ptr<SwapChainLVE> m_SwapChain;
 	VkRenderPass m_RenderPass; // TODO: create RenderPassVCA class
 
-	VkPipeline m_GraphicsPipeline;
-	VkPipelineLayout m_PipelineLayout;
+	PipelineRegistry::PipelineRef m_GraphicsPipeline;
+	PipelineRegistry::PipelineLayoutRef m_PipelineLayout;
 
 	VkDescriptorSetLayout m_DescriptorSetLayout;
 	VkDescriptorSetLayout m_SamplerSetLayout;
@@ -0,0 +1,768 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+
+// Passed by reference (std::vector fill values), needs a definition before C++17
+constexpr uint32_t RenderGraph::NONE;
+
+RenderGraph::RenderGraph(VkDevice device)
+	: m_Device(device)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+	destroy();
+}
+
+RenderGraph::ResourceId RenderGraph::createAttachment(const std::string& name, VkFormat format, VkClearValue clearValue)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.format = format;
+	resource.clearValue = clearValue;
+	resource.imported = false;
+	resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	m_Resources.push_back(resource);
+
+	return static_cast<ResourceId>(m_Resources.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::importAttachment(const std::string& name, VkFormat format, VkImageLayout finalLayout, VkClearValue clearValue)
+{
+	ResourceId id = createAttachment(name, format, clearValue);
+	m_Resources[id].imported = true;
+	m_Resources[id].finalLayout = finalLayout;
+
+	return id;
+}
+
+RenderGraph::PassId RenderGraph::addPass(const std::string& name, VkSubpassContents contents)
+{
+	Pass pass;
+	pass.name = name;
+	pass.contents = contents;
+
+	m_Passes.push_back(pass);
+
+	return static_cast<PassId>(m_Passes.size() - 1);
+}
+
+void RenderGraph::writeColor(PassId pass, ResourceId attachment)
+{
+	addUse(pass, attachment, Access::ColorWrite);
+}
+
+void RenderGraph::writeDepth(PassId pass, ResourceId attachment)
+{
+	addUse(pass, attachment, Access::DepthWrite);
+}
+
+void RenderGraph::readInput(PassId pass, ResourceId attachment)
+{
+	addUse(pass, attachment, Access::InputRead);
+}
+
+void RenderGraph::readTexture(PassId pass, ResourceId attachment)
+{
+	addUse(pass, attachment, Access::TextureRead);
+}
+
+void RenderGraph::addUse(PassId pass, ResourceId attachment, Access access)
+{
+	// Reading and writing the same attachment in one pass would be a feedback loop
+	for (const Use& use : m_Passes[pass].uses)
+	{
+		if (use.resource == attachment)
+		{
+			throw std::runtime_error("Render graph pass '" + m_Passes[pass].name + "' uses '" + m_Resources[attachment].name + "' twice!");
+		}
+	}
+
+	m_Passes[pass].uses.push_back({ attachment, access });
+}
+
+void RenderGraph::compile()
+{
+	destroy();
+
+	// Every read needs an earlier write, passes run in declaration order
+	std::vector<bool> written(m_Resources.size(), false);
+	for (const Pass& pass : m_Passes)
+	{
+		for (const Use& use : pass.uses)
+		{
+			if (!isWrite(use.access) && !written[use.resource])
+			{
+				throw std::runtime_error("Render graph pass '" + pass.name + "' reads '" + m_Resources[use.resource].name + "' before any pass writes it!");
+			}
+		}
+		for (const Use& use : pass.uses)
+		{
+			written[use.resource] = written[use.resource] || isWrite(use.access);
+		}
+	}
+
+	cullPasses();
+	mergePasses();
+
+	for (Resource& resource : m_Resources)
+	{
+		resource.usage = 0;
+		resource.transient = !resource.imported;
+		resource.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		resource.lastWrite = nullptr;
+		resource.readStages = 0;
+	}
+
+	// Transient: every use in the same render pass
+	std::vector<uint32_t> renderPassOfResource(m_Resources.size(), NONE);
+	for (const Pass& pass : m_Passes)
+	{
+		if (pass.culled) continue;
+
+		for (const Use& use : pass.uses)
+		{
+			uint32_t& renderPass = renderPassOfResource[use.resource];
+			m_Resources[use.resource].transient = m_Resources[use.resource].transient && (renderPass == NONE || renderPass == pass.renderPass);
+			renderPass = pass.renderPass;
+		}
+	}
+
+	for (const Pass& pass : m_Passes)
+	{
+		if (pass.culled) continue;
+
+		for (const Use& use : pass.uses)
+		{
+			switch (use.access)
+			{
+			case Access::ColorWrite:  m_Resources[use.resource].usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; break;
+			case Access::DepthWrite:  m_Resources[use.resource].usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; break;
+			case Access::InputRead:   m_Resources[use.resource].usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT; break;
+			case Access::TextureRead: m_Resources[use.resource].usage |= VK_IMAGE_USAGE_SAMPLED_BIT; break;
+			}
+		}
+	}
+
+	for (Resource& resource : m_Resources)
+	{
+		if (resource.transient && resource.usage != 0)
+		{
+			resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+	}
+
+	assignMemorySlots();
+
+	for (uint32_t i = 0; i < m_RenderPasses.size(); i++)
+	{
+		createRenderPass(i);
+	}
+
+	uint32_t culledPasses = 0;
+	for (const Pass& pass : m_Passes)
+	{
+		if (pass.culled)
+		{
+			culledPasses++;
+			printf("Render graph pass '%s' culled, nothing it writes is used.\n", pass.name.c_str());
+		}
+	}
+
+	printf("Render graph compiled: %i passes (%i culled) in %i render passes, %i attachment memory slots.\n",
+		(int)m_Passes.size(), (int)culledPasses, (int)m_RenderPasses.size(), (int)m_MemorySlotCount);
+}
+
+void RenderGraph::cullPasses()
+{
+	// Walking backwards from the imported attachments: a pass is needed when a later needed pass (or the
+	// outside world) uses something it writes. Writes load what earlier passes wrote, so they count as uses too.
+	std::vector<bool> needed(m_Resources.size(), false);
+	for (size_t i = 0; i < m_Resources.size(); i++)
+	{
+		needed[i] = m_Resources[i].imported;
+	}
+
+	for (size_t p = m_Passes.size(); p-- > 0;)
+	{
+		Pass& pass = m_Passes[p];
+
+		pass.culled = true;
+		for (const Use& use : pass.uses)
+		{
+			if (isWrite(use.access) && needed[use.resource])
+			{
+				pass.culled = false;
+			}
+		}
+
+		if (!pass.culled)
+		{
+			for (const Use& use : pass.uses)
+			{
+				needed[use.resource] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::mergePasses()
+{
+	m_RenderPasses.clear();
+
+	for (PassId p = 0; p < m_Passes.size(); p++)
+	{
+		Pass& pass = m_Passes[p];
+		pass.renderPass = NONE;
+		pass.subpass = NONE;
+
+		if (pass.culled) continue;
+
+		// A render pass can go on as long as nothing is sampled that it renders to (or rendered to after being sampled):
+		// that needs the attachment written out to memory and transitioned, i.e. the render pass has to end first
+		bool split = m_RenderPasses.empty();
+
+		for (size_t i = 0; !split && i < pass.uses.size(); i++)
+		{
+			for (PassId earlier : m_RenderPasses.back().passes)
+			{
+				for (const Use& earlierUse : m_Passes[earlier].uses)
+				{
+					if (earlierUse.resource != pass.uses[i].resource) continue;
+
+					bool sampledAfterWrite = pass.uses[i].access == Access::TextureRead && isWrite(earlierUse.access);
+					bool writtenAfterSample = isWrite(pass.uses[i].access) && earlierUse.access == Access::TextureRead;
+					split = split || sampledAfterWrite || writtenAfterSample;
+				}
+			}
+		}
+
+		if (split)
+		{
+			m_RenderPasses.push_back(RenderPass());
+		}
+
+		pass.renderPass = static_cast<uint32_t>(m_RenderPasses.size() - 1);
+		pass.subpass = static_cast<uint32_t>(m_RenderPasses.back().passes.size());
+		m_RenderPasses.back().passes.push_back(p);
+	}
+}
+
+void RenderGraph::assignMemorySlots()
+{
+	// Lifetime of each attachment: first to last pass using it, in execution order
+	std::vector<uint32_t> firstPass(m_Resources.size(), NONE);
+	std::vector<uint32_t> lastPass(m_Resources.size(), NONE);
+	uint32_t order = 0;
+	for (PassId p = 0; p < m_Passes.size(); p++)
+	{
+		if (m_Passes[p].culled) continue;
+
+		for (const Use& use : m_Passes[p].uses)
+		{
+			if (firstPass[use.resource] == NONE) firstPass[use.resource] = order;
+			lastPass[use.resource] = order;
+		}
+		order++;
+	}
+
+	std::vector<ResourceId> byFirstUse;
+	for (ResourceId r = 0; r < m_Resources.size(); r++)
+	{
+		m_Resources[r].memorySlot = NONE;
+		if (!m_Resources[r].imported && firstPass[r] != NONE)
+		{
+			byFirstUse.push_back(r);
+		}
+	}
+	std::stable_sort(byFirstUse.begin(), byFirstUse.end(), [&](ResourceId a, ResourceId b) { return firstPass[a] < firstPass[b]; });
+
+	// Interval partitioning: an attachment reuses the first slot whose attachments are all done before it starts
+	std::vector<uint32_t> slotLastPass;
+	for (ResourceId r : byFirstUse)
+	{
+		uint32_t slot = 0;
+		while (slot < slotLastPass.size() && slotLastPass[slot] >= firstPass[r]) slot++;
+
+		if (slot == slotLastPass.size())
+		{
+			slotLastPass.push_back(0);
+		}
+
+		slotLastPass[slot] = lastPass[r];
+		m_Resources[r].memorySlot = slot;
+	}
+
+	m_MemorySlotCount = static_cast<uint32_t>(slotLastPass.size());
+}
+
+void RenderGraph::createRenderPass(uint32_t index)
+{
+	RenderPass& renderPass = m_RenderPasses[index];
+	uint32_t subpassCount = static_cast<uint32_t>(renderPass.passes.size());
+
+	// ATTACHMENTS: everything rendered to or read as an input attachment, in order of first use.
+	// Sampled attachments are plain descriptors of the subpass.
+	std::vector<uint32_t> attachmentIndex(m_Resources.size(), VK_ATTACHMENT_UNUSED);
+	for (PassId p : renderPass.passes)
+	{
+		for (const Use& use : m_Passes[p].uses)
+		{
+			if (use.access != Access::TextureRead && attachmentIndex[use.resource] == VK_ATTACHMENT_UNUSED)
+			{
+				attachmentIndex[use.resource] = static_cast<uint32_t>(renderPass.attachments.size());
+				renderPass.attachments.push_back(use.resource);
+			}
+		}
+	}
+
+	std::vector<VkAttachmentDescription> attachments;
+	std::vector<bool> leavesGraph; // Imported and not used by a later render pass
+	for (ResourceId r : renderPass.attachments)
+	{
+		const Resource& resource = m_Resources[r];
+
+		// First and last use in this render pass, first use in a later one
+		const Use* firstUse = nullptr;
+		const Use* lastUse = nullptr;
+		const Use* nextUse = nullptr;
+		for (uint32_t i = index; i < m_RenderPasses.size() && nextUse == nullptr; i++)
+		{
+			for (PassId p : m_RenderPasses[i].passes)
+			{
+				for (const Use& use : m_Passes[p].uses)
+				{
+					if (use.resource != r) continue;
+
+					if (i > index && nextUse == nullptr) nextUse = &use;
+					if (i == index && firstUse == nullptr) firstUse = &use;
+					if (i == index) lastUse = &use;
+				}
+			}
+		}
+
+		// Contents written by an earlier render pass are loaded, the first write clears.
+		// Only what a later render pass or the outside world reads is stored, intermediates stay on-chip.
+		bool loaded = resource.lastWrite != nullptr;
+		bool stored = resource.imported || nextUse != nullptr;
+
+		VkAttachmentDescription attachment = {};
+		attachment.flags = 0;
+		attachment.format = resource.format;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = loaded ? VK_ATTACHMENT_LOAD_OP_LOAD : isWrite(firstUse->access) ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.storeOp = stored ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = loaded ? resource.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+		attachment.finalLayout = nextUse != nullptr ? getLayout(*nextUse) : resource.imported ? resource.finalLayout : getLayout(*lastUse);
+
+		// Another attachment of this render pass lives in the same memory (at another time)
+		for (ResourceId other : renderPass.attachments)
+		{
+			if (other != r && sharesMemory(other, r))
+			{
+				attachment.flags = VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT;
+			}
+		}
+
+		attachments.push_back(attachment);
+		leavesGraph.push_back(resource.imported && nextUse == nullptr);
+		renderPass.clearValues.push_back(resource.clearValue);
+	}
+
+	// SUBPASSES
+	std::vector<std::vector<VkAttachmentReference>> colorReferences(subpassCount);
+	std::vector<std::vector<VkAttachmentReference>> inputReferences(subpassCount);
+	std::vector<VkAttachmentReference> depthReferences(subpassCount, { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+	std::vector<VkSubpassDescription> subpasses(subpassCount);
+
+	for (uint32_t s = 0; s < subpassCount; s++)
+	{
+		for (const Use& use : m_Passes[renderPass.passes[s]].uses)
+		{
+			VkAttachmentReference reference = { attachmentIndex[use.resource], getLayout(use) };
+
+			switch (use.access)
+			{
+			case Access::ColorWrite: colorReferences[s].push_back(reference); break;
+			case Access::DepthWrite: depthReferences[s] = reference; break;
+			case Access::InputRead:  inputReferences[s].push_back(reference); break;
+			case Access::TextureRead: break;
+			}
+		}
+
+		subpasses[s].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpasses[s].colorAttachmentCount = static_cast<uint32_t>(colorReferences[s].size());
+		subpasses[s].pColorAttachments = colorReferences[s].data();
+		subpasses[s].pDepthStencilAttachment = depthReferences[s].attachment != VK_ATTACHMENT_UNUSED ? &depthReferences[s] : nullptr;
+		subpasses[s].inputAttachmentCount = static_cast<uint32_t>(inputReferences[s].size());
+		subpasses[s].pInputAttachments = inputReferences[s].data();
+	}
+
+	// SUBPASS DEPENDENCIES, one per subpass pair with the masks of every resource they share merged
+	std::vector<VkSubpassDependency> dependencies;
+	auto addDependency = [&](uint32_t srcSubpass, uint32_t dstSubpass, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, VkDependencyFlags flags)
+	{
+		for (VkSubpassDependency& dependency : dependencies)
+		{
+			if (dependency.srcSubpass == srcSubpass && dependency.dstSubpass == dstSubpass)
+			{
+				dependency.srcStageMask |= srcStage;
+				dependency.srcAccessMask |= srcAccess;
+				dependency.dstStageMask |= dstStage;
+				dependency.dstAccessMask |= dstAccess;
+				dependency.dependencyFlags &= flags; // By region only if every merged dependency is
+				return;
+			}
+		}
+
+		VkSubpassDependency dependency = {};
+		dependency.srcSubpass = srcSubpass;
+		dependency.dstSubpass = dstSubpass;
+		dependency.srcStageMask = srcStage;
+		dependency.srcAccessMask = srcAccess;
+		dependency.dstStageMask = dstStage;
+		dependency.dstAccessMask = dstAccess;
+		dependency.dependencyFlags = flags;
+		dependencies.push_back(dependency);
+	};
+
+	// Only writes have to be made available, reads only need execution order (write after read)
+	const VkAccessFlags writeAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	for (uint32_t s = 0; s < subpassCount; s++)
+	{
+		for (const Use& use : m_Passes[renderPass.passes[s]].uses)
+		{
+			VkPipelineStageFlags stage;
+			VkAccessFlags access;
+			getStageAndAccess(use.access, &stage, &access);
+
+			// Within the render pass: against every earlier subpass using the resource (or its memory), unless both only read.
+			// Attachments are only accessed at the same pixel, so the dependencies are by region (no flush on tilers).
+			bool usedEarlier = false;
+			for (uint32_t e = 0; e < s; e++)
+			{
+				for (const Use& earlierUse : m_Passes[renderPass.passes[e]].uses)
+				{
+					if (!sharesMemory(earlierUse.resource, use.resource)) continue;
+					usedEarlier = true;
+
+					if (isWrite(earlierUse.access) || isWrite(use.access))
+					{
+						VkPipelineStageFlags earlierStage;
+						VkAccessFlags earlierAccess;
+						getStageAndAccess(earlierUse.access, &earlierStage, &earlierAccess);
+
+						addDependency(e, s, earlierStage, earlierAccess & writeAccess, stage, access, VK_DEPENDENCY_BY_REGION_BIT);
+					}
+				}
+			}
+
+			if (usedEarlier) continue;
+
+			// First use in this render pass: against the earlier render passes (write and the reads since), or on first use
+			// in the frame against every use of its memory (aliased attachments, and the previous frame's uses of the same
+			// images). For the swapchain image that is its own use, the acquire semaphore waits at that stage.
+			const Resource& resource = m_Resources[use.resource];
+			if (resource.lastWrite != nullptr)
+			{
+				VkPipelineStageFlags writeStage;
+				VkAccessFlags writeAccessMask;
+				getStageAndAccess(resource.lastWrite->access, &writeStage, &writeAccessMask);
+
+				addDependency(VK_SUBPASS_EXTERNAL, s, writeStage | resource.readStages, writeAccessMask & writeAccess, stage, access, 0);
+			}
+			else
+			{
+				VkPipelineStageFlags memoryStage;
+				VkAccessFlags memoryAccess;
+				getMemoryStageAndAccess(use.resource, &memoryStage, &memoryAccess);
+
+				addDependency(VK_SUBPASS_EXTERNAL, s, memoryStage, memoryAccess & writeAccess, stage, access, 0);
+			}
+		}
+	}
+
+	// Imported attachments leaving the graph here: everything is written before whatever comes after the render pass
+	// (present waits on a semaphore, so no access needs to be made visible to it)
+	for (uint32_t a = 0; a < renderPass.attachments.size(); a++)
+	{
+		if (!leavesGraph[a]) continue;
+
+		for (uint32_t s = subpassCount; s-- > 0;)
+		{
+			const Use* lastUse = nullptr;
+			for (const Use& use : m_Passes[renderPass.passes[s]].uses)
+			{
+				if (use.resource == renderPass.attachments[a]) lastUse = &use;
+			}
+			if (lastUse == nullptr) continue;
+
+			VkPipelineStageFlags stage;
+			VkAccessFlags access;
+			getStageAndAccess(lastUse->access, &stage, &access);
+
+			addDependency(s, VK_SUBPASS_EXTERNAL, stage, access & writeAccess, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0);
+			break;
+		}
+	}
+
+	// State the following render passes start from
+	for (uint32_t s = 0; s < subpassCount; s++)
+	{
+		for (const Use& use : m_Passes[renderPass.passes[s]].uses)
+		{
+			Resource& resource = m_Resources[use.resource];
+			if (isWrite(use.access))
+			{
+				resource.lastWrite = &use;
+				resource.readStages = 0;
+			}
+			else
+			{
+				VkPipelineStageFlags stage;
+				VkAccessFlags access;
+				getStageAndAccess(use.access, &stage, &access);
+				resource.readStages |= stage;
+			}
+		}
+	}
+	for (uint32_t a = 0; a < renderPass.attachments.size(); a++)
+	{
+		m_Resources[renderPass.attachments[a]].layout = attachments[a].finalLayout;
+	}
+
+	// Create info for Render Pass
+	VkRenderPassCreateInfo renderPassCreateInfo = {};
+	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	renderPassCreateInfo.pAttachments = attachments.data();
+	renderPassCreateInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+	renderPassCreateInfo.pSubpasses = subpasses.data();
+	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassCreateInfo.pDependencies = dependencies.data();
+
+	VkResult result = vkCreateRenderPass(m_Device, &renderPassCreateInfo, nullptr, &renderPass.renderPass);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Render Pass!");
+	}
+
+	std::string passNames;
+	for (PassId p : renderPass.passes)
+	{
+		passNames += (passNames.empty() ? "" : " -> ") + m_Passes[p].name;
+	}
+
+	printf("Vulkan Render Pass successfully created: %s (%i attachments, %i dependencies).\n",
+		passNames.c_str(), (int)attachments.size(), (int)dependencies.size());
+}
+
+void RenderGraph::createFramebuffers(uint32_t count, VkExtent2D extent, const ViewFunction& getView)
+{
+	destroyFramebuffers();
+
+	m_Extent = extent;
+
+	for (RenderPass& renderPass : m_RenderPasses)
+	{
+		renderPass.framebuffers.resize(count);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			std::vector<VkImageView> views;
+			for (ResourceId r : renderPass.attachments)
+			{
+				views.push_back(getView(r, i));
+			}
+
+			VkFramebufferCreateInfo framebufferCreateInfo = {};
+			framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferCreateInfo.renderPass = renderPass.renderPass;                   // Render Pass layout the Framebuffer will be used with
+			framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(views.size());
+			framebufferCreateInfo.pAttachments = views.data();                          // List of attachments (1:1 with Render Pass)
+			framebufferCreateInfo.width = extent.width;                                 // Framebuffer width
+			framebufferCreateInfo.height = extent.height;                               // Framebuffer height
+			framebufferCreateInfo.layers = 1;                                           // Framebuffer layers
+
+			VkResult result = vkCreateFramebuffer(m_Device, &framebufferCreateInfo, nullptr, &renderPass.framebuffers[i]);
+
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create a Framebuffer!");
+			}
+		}
+	}
+
+	printf("Vulkan Framebuffers successfully created (%i per render pass).\n", (int)count);
+}
+
+void RenderGraph::destroyFramebuffers()
+{
+	for (RenderPass& renderPass : m_RenderPasses)
+	{
+		for (VkFramebuffer framebuffer : renderPass.framebuffers)
+		{
+			vkDestroyFramebuffer(m_Device, framebuffer, nullptr);
+		}
+		renderPass.framebuffers.clear();
+	}
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t framebufferIndex, const RecordFunction& record)
+{
+	for (RenderPass& renderPass : m_RenderPasses)
+	{
+		VkRenderPassBeginInfo renderPassBeginInfo = {};
+		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBeginInfo.renderPass = renderPass.renderPass;                 // Render Pass to begin
+		renderPassBeginInfo.renderArea.offset = { 0, 0 };                       // Start point of render pass in pixels
+		renderPassBeginInfo.renderArea.extent = m_Extent;                       // Size of region to run render pass on (starting at offset)
+		if (renderPass.renderArea.width > 0 && renderPass.renderArea.height > 0)
+		{
+			renderPassBeginInfo.renderArea.extent.width = std::min(renderPass.renderArea.width, m_Extent.width);
+			renderPassBeginInfo.renderArea.extent.height = std::min(renderPass.renderArea.height, m_Extent.height);
+		}
+		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(renderPass.clearValues.size());
+		renderPassBeginInfo.pClearValues = renderPass.clearValues.data();       // One per attachment, only used by the cleared ones
+		renderPassBeginInfo.framebuffer = renderPass.framebuffers[framebufferIndex];
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, m_Passes[renderPass.passes[0]].contents);
+
+		for (size_t s = 0; s < renderPass.passes.size(); s++)
+		{
+			if (s > 0)
+			{
+				vkCmdNextSubpass(commandBuffer, m_Passes[renderPass.passes[s]].contents);
+			}
+
+			record(renderPass.passes[s], commandBuffer);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+}
+
+void RenderGraph::setRenderArea(PassId pass, VkExtent2D extent)
+{
+	if (m_Passes[pass].culled) return;
+
+	m_RenderPasses[m_Passes[pass].renderPass].renderArea = extent;
+}
+
+VkRenderPass RenderGraph::getRenderPass(PassId pass)
+{
+	return m_Passes[pass].culled ? VK_NULL_HANDLE : m_RenderPasses[m_Passes[pass].renderPass].renderPass;
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(PassId pass, uint32_t framebufferIndex)
+{
+	return m_Passes[pass].culled ? VK_NULL_HANDLE : m_RenderPasses[m_Passes[pass].renderPass].framebuffers[framebufferIndex];
+}
+
+VkImageLayout RenderGraph::getReadLayout(ResourceId attachment)
+{
+	return isDepthFormat(m_Resources[attachment].format) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+bool RenderGraph::sharesMemory(ResourceId a, ResourceId b)
+{
+	return a == b || (m_Resources[a].memorySlot != NONE && m_Resources[a].memorySlot == m_Resources[b].memorySlot);
+}
+
+void RenderGraph::getMemoryStageAndAccess(ResourceId attachment, VkPipelineStageFlags* stage, VkAccessFlags* accessMask)
+{
+	*stage = 0;
+	*accessMask = 0;
+
+	for (const Pass& pass : m_Passes)
+	{
+		if (pass.culled) continue;
+
+		for (const Use& use : pass.uses)
+		{
+			if (!sharesMemory(use.resource, attachment)) continue;
+
+			VkPipelineStageFlags useStage;
+			VkAccessFlags useAccess;
+			getStageAndAccess(use.access, &useStage, &useAccess);
+
+			*stage |= useStage;
+			*accessMask |= useAccess;
+		}
+	}
+}
+
+bool RenderGraph::isDepthFormat(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void RenderGraph::getStageAndAccess(Access access, VkPipelineStageFlags* stage, VkAccessFlags* accessMask)
+{
+	switch (access)
+	{
+	case Access::ColorWrite:
+		*stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		*accessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		break;
+	case Access::DepthWrite:
+		*stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		*accessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		break;
+	case Access::InputRead:
+		*stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		*accessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+		break;
+	case Access::TextureRead:
+		*stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		*accessMask = VK_ACCESS_SHADER_READ_BIT;
+		break;
+	}
+}
+
+VkImageLayout RenderGraph::getLayout(const Use& use)
+{
+	switch (use.access)
+	{
+	case Access::ColorWrite: return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	case Access::DepthWrite: return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	default:                 return getReadLayout(use.resource);
+	}
+}
+
+void RenderGraph::destroy()
+{
+	destroyFramebuffers();
+
+	for (RenderPass& renderPass : m_RenderPasses)
+	{
+		if (renderPass.renderPass != VK_NULL_HANDLE)
+		{
+			vkDestroyRenderPass(m_Device, renderPass.renderPass, nullptr);
+		}
+	}
+
+	m_RenderPasses.clear();
+	m_MemorySlotCount = 0;
+}
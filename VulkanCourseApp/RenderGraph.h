@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// Frame described as passes that declare the attachments they write and read, instead of hand written render passes.
+// compile() derives everything that used to be written by hand:
+// - passes whose results never reach an imported attachment (e.g. the swapchain image) are culled
+// - consecutive passes that only read each other's output at the same pixel (input attachments) are merged into
+//   subpasses of one render pass, so tiled GPUs keep the intermediate attachments on-chip
+// - load/store ops, initial/final/subpass layouts, and the subpass dependencies (as narrow as the declared usage)
+// A pass that samples an attachment written earlier ends the render pass that wrote it, the layout transition and
+// the dependency between the two render passes are derived the same way.
+// Attachments created by the graph are assigned memory slots: attachments whose lifetimes don't overlap share one
+// (aliased memory). The first use of a slot in a frame is ordered after its uses in the previous frame, so a single set
+// of images can serve every frame in flight submitted to the same queue.
+// Passes run in declaration order, a resource must be written before a later pass reads it.
+class RenderGraph
+{
+public:
+	using ResourceId = uint32_t;
+	using PassId = uint32_t;
+	static constexpr uint32_t NONE = ~0u;
+
+	// Records the commands of one pass, called inside its subpass
+	using RecordFunction = std::function<void(PassId pass, VkCommandBuffer commandBuffer)>;
+	// Image view of an attachment in the given framebuffer (e.g. per swapchain image)
+	using ViewFunction = std::function<VkImageView(ResourceId attachment, uint32_t framebufferIndex)>;
+
+	RenderGraph(VkDevice device);
+	~RenderGraph();
+
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	// Attachment that only lives inside the graph, its contents are discarded after the last pass using it
+	ResourceId createAttachment(const std::string& name, VkFormat format, VkClearValue clearValue);
+	// Attachment whose contents leave the graph (e.g. the swapchain image), left in finalLayout
+	ResourceId importAttachment(const std::string& name, VkFormat format, VkImageLayout finalLayout, VkClearValue clearValue);
+
+	// contents: how the pass records its commands (VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS = only vkCmdExecuteCommands)
+	PassId addPass(const std::string& name, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+	void writeColor(PassId pass, ResourceId attachment);
+	void writeDepth(PassId pass, ResourceId attachment);  // Depth test and write, loads what earlier passes wrote
+	void readInput(PassId pass, ResourceId attachment);   // Input attachment (same pixel only), keeps the render pass going
+	void readTexture(PassId pass, ResourceId attachment); // Sampled anywhere, needs the writer's render pass to have ended
+
+	// Culls, merges and creates the render passes. Throws on an invalid graph (read before write, feedback loop).
+	void compile();
+
+	// One framebuffer per render pass and index, sized extent. Replaces the previous ones.
+	void createFramebuffers(uint32_t count, VkExtent2D extent, const ViewFunction& getView);
+	void destroyFramebuffers();
+
+	// Records every pass that was not culled, beginning/advancing/ending the render passes around them
+	void execute(VkCommandBuffer commandBuffer, uint32_t framebufferIndex, const RecordFunction& record);
+	// Limits the render pass of the pass to the top left corner of the framebuffers (clears and stores only cover it),
+	// until changed. {0, 0} = whole framebuffer.
+	void setRenderArea(PassId pass, VkExtent2D extent);
+
+	bool isCulled(PassId pass) { return m_Passes[pass].culled; }
+	// Render pass, subpass and framebuffer a pass runs in, for pipelines and secondary command buffer inheritance
+	VkRenderPass getRenderPass(PassId pass);
+	uint32_t getSubpass(PassId pass) { return m_Passes[pass].subpass; }
+	VkFramebuffer getFramebuffer(PassId pass, uint32_t framebufferIndex);
+	uint32_t getRenderPassCount() { return static_cast<uint32_t>(m_RenderPasses.size()); }
+
+	// Image usage an attachment needs for the passes that use it (create its images with these flags).
+	// Includes VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT for transient attachments.
+	VkImageUsageFlags getAttachmentUsage(ResourceId attachment) { return m_Resources[attachment].usage; }
+	// Created by the graph and used within a single render pass only: never loaded or stored, so its contents never
+	// have to reach memory (lazily allocated memory is enough)
+	bool isTransient(ResourceId attachment) { return m_Resources[attachment].transient; }
+	// Attachments with the same slot may be bound to the same memory. NONE for imported or unused attachments.
+	uint32_t getMemorySlot(ResourceId attachment) { return m_Resources[attachment].memorySlot; }
+	uint32_t getMemorySlotCount() { return m_MemorySlotCount; }
+	VkFormat getAttachmentFormat(ResourceId attachment) { return m_Resources[attachment].format; }
+	// Layout the attachment is in while read as an input attachment or texture (for its descriptors)
+	VkImageLayout getReadLayout(ResourceId attachment);
+
+private:
+	enum class Access
+	{
+		ColorWrite,
+		DepthWrite,
+		InputRead,
+		TextureRead,
+	};
+
+	struct Use
+	{
+		ResourceId resource;
+		Access access;
+	};
+
+	struct Resource
+	{
+		std::string name;
+		VkFormat format;
+		VkClearValue clearValue;
+		bool imported;
+		VkImageLayout finalLayout; // Imported only
+		VkImageUsageFlags usage = 0;
+		bool transient = false;
+		uint32_t memorySlot = NONE;
+
+		// State between render passes while compiling
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		const Use* lastWrite = nullptr;
+		VkPipelineStageFlags readStages = 0; // Reads since lastWrite
+	};
+
+	struct Pass
+	{
+		std::string name;
+		VkSubpassContents contents;
+		std::vector<Use> uses;
+		bool culled = false;
+		uint32_t renderPass = NONE;
+		uint32_t subpass = NONE;
+	};
+
+	struct RenderPass
+	{
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		std::vector<PassId> passes;          // Subpass order
+		std::vector<ResourceId> attachments; // Attachment index order
+		std::vector<VkClearValue> clearValues;
+		std::vector<VkFramebuffer> framebuffers;
+		VkExtent2D renderArea = {};
+	};
+
+	static bool isWrite(Access access) { return access == Access::ColorWrite || access == Access::DepthWrite; }
+	static bool isDepthFormat(VkFormat format);
+	static void getStageAndAccess(Access access, VkPipelineStageFlags* stage, VkAccessFlags* accessMask);
+	VkImageLayout getLayout(const Use& use);
+	bool sharesMemory(ResourceId a, ResourceId b);
+	void getMemoryStageAndAccess(ResourceId attachment, VkPipelineStageFlags* stage, VkAccessFlags* accessMask);
+
+	void addUse(PassId pass, ResourceId attachment, Access access);
+	void cullPasses();
+	void mergePasses();
+	void assignMemorySlots();
+	void createRenderPass(uint32_t index);
+	void destroy();
+
+	VkDevice m_Device;
+
+	std::vector<Resource> m_Resources;
+	std::vector<Pass> m_Passes;
+	std::vector<RenderPass> m_RenderPasses;
+	uint32_t m_MemorySlotCount = 0;
+
+	VkExtent2D m_Extent = {};
+
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DeviceLVE.h"
+#include "ShaderLibrary.h"
 
 #include <string>
 #include <vector>
@@ -11,22 +12,25 @@ class Shader {
 public:
 	Shader() = default;
 	Shader(std::shared_ptr<DeviceLVE> device, const std::string& filepathVertex, const std::string& filepathFragment);
+	// Modules already in the device's ShaderLibrary (e.g. created from ShaderCompiler output)
+	Shader(std::shared_ptr<DeviceLVE> device, ShaderLibrary::ShaderModuleRef vertex, ShaderLibrary::ShaderModuleRef fragment);
 	~Shader();
 
 	Shader(const Shader&) = delete;
 	Shader& operator=(const Shader&) = delete;
 
-	VkShaderModule& getShaderModuleVertex() { return m_ShaderModuleVertex; };
-	VkShaderModule& getShaderModuleFragment() { return m_ShaderModuleFragment; };
+	VkShaderModule getShaderModuleVertex() { return m_Vertex->module; };
+	VkShaderModule getShaderModuleFragment() { return m_Fragment->module; };
 
-private:
-	static std::vector<char> readFile(const std::string& filepath);
-	VkShaderModule createShaderModule(const std::vector<char>& code);
+	// Interface of each stage, to check or build pipeline layouts and vertex input descriptions
+	const ShaderReflection& getReflectionVertex() { return m_Vertex->reflection; }
+	const ShaderReflection& getReflectionFragment() { return m_Fragment->reflection; }
 
 private:
 	std::shared_ptr<DeviceLVE> m_Device;
 
-	VkShaderModule m_ShaderModuleVertex;
-	VkShaderModule m_ShaderModuleFragment;
+	// Shared with every other Shader/pipeline using the same SPIR-V
+	ShaderLibrary::ShaderModuleRef m_Vertex;
+	ShaderLibrary::ShaderModuleRef m_Fragment;
 
 };
@@ -0,0 +1,501 @@
+#include "ShaderCompiler.h"
+
+#include <shaderc/shaderc.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#include <sys/stat.h>
+#endif
+
+
+// Bump when anything that affects the output changes without showing up in the key (e.g. new compile options)
+static const uint32_t SHADER_CACHE_VERSION = 1;
+
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+// FNV-1a, chained over every part of the cache key
+static void hashBytes(uint64_t* hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	for (size_t i = 0; i < size; i++)
+	{
+		*hash ^= bytes[i];
+		*hash *= 1099511628211ull;
+	}
+}
+
+static void hashString(uint64_t* hash, const std::string& text)
+{
+	uint64_t size = text.size();
+	hashBytes(hash, &size, sizeof(size));
+	hashBytes(hash, text.data(), text.size());
+}
+
+static bool stageFromExtension(const std::string& file, shaderc_shader_kind* kind)
+{
+	size_t dot = file.find_last_of('.');
+	std::string extension = dot == std::string::npos ? "" : file.substr(dot + 1);
+
+	if (extension == "vert") { *kind = shaderc_glsl_vertex_shader;          return true; }
+	if (extension == "frag") { *kind = shaderc_glsl_fragment_shader;        return true; }
+	if (extension == "comp") { *kind = shaderc_glsl_compute_shader;         return true; }
+	if (extension == "geom") { *kind = shaderc_glsl_geometry_shader;        return true; }
+	if (extension == "tesc") { *kind = shaderc_glsl_tess_control_shader;    return true; }
+	if (extension == "tese") { *kind = shaderc_glsl_tess_evaluation_shader; return true; }
+	return false;
+}
+
+// Options of every compilation, except the includer and the defines of the request
+static void setCommonOptions(shaderc::CompileOptions* options)
+{
+	options->SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
+	options->SetOptimizationLevel(shaderc_optimization_level_performance);
+}
+
+// Size and modification time of the shared library shaderc was loaded from. Nothing when it is linked into the
+// executable (shaderc_combined), the probe compile in identifyCompiler covers that case.
+static void hashCompilerLibrary(uint64_t* hash)
+{
+	const void* function = reinterpret_cast<const void*>(&shaderc_compiler_initialize);
+	std::string libraryPath;
+
+#ifdef _WIN32
+	HMODULE module = nullptr;
+	if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, static_cast<LPCSTR>(function), &module) ||
+		module == GetModuleHandleA(nullptr))
+	{
+		return;
+	}
+
+	char modulePath[MAX_PATH];
+	DWORD length = GetModuleFileNameA(module, modulePath, MAX_PATH);
+	if (length == 0 || length == MAX_PATH) return;
+	libraryPath.assign(modulePath, length);
+
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(libraryPath.c_str(), GetFileExInfoStandard, &attributes)) return;
+
+	uint64_t size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	uint64_t modified = (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+	Dl_info library;
+	Dl_info executable;
+	void* mainHandle = dlopen(nullptr, RTLD_NOW);
+	void* mainSymbol = mainHandle != nullptr ? dlsym(mainHandle, "main") : nullptr;
+	bool linkedIn = mainSymbol != nullptr && dladdr(mainSymbol, &executable) != 0 && dladdr(function, &library) != 0 &&
+		executable.dli_fbase == library.dli_fbase;
+	if (mainHandle != nullptr)
+	{
+		dlclose(mainHandle);
+	}
+	if (linkedIn || dladdr(function, &library) == 0 || library.dli_fname == nullptr)
+	{
+		return;
+	}
+	libraryPath = library.dli_fname;
+
+	struct stat attributes;
+	if (stat(libraryPath.c_str(), &attributes) != 0) return;
+
+	uint64_t size = static_cast<uint64_t>(attributes.st_size);
+	uint64_t modified = static_cast<uint64_t>(attributes.st_mtime);
+#endif
+
+	hashString(hash, libraryPath);
+	hashBytes(hash, &size, sizeof(size));
+	hashBytes(hash, &modified, sizeof(modified));
+}
+
+static std::string directoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+// #include "file" is relative to the including file, #include <file> to the source directory
+static std::string resolveInclude(const std::string& requested, bool relative, const std::string& requesting, const std::string& sourceDirectory)
+{
+	return (relative ? directoryOf(requesting) : sourceDirectory) + requested;
+}
+
+// Resolves includes for shaderc the same way hashIncludes finds them
+class FileIncluder : public shaderc::CompileOptions::IncluderInterface
+{
+public:
+	FileIncluder(const std::string& sourceDirectory) : m_SourceDirectory(sourceDirectory) {}
+
+	shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override
+	{
+		IncludeData* data = new IncludeData();
+		data->path = resolveInclude(requestedSource, type == shaderc_include_type_relative, requestingSource, m_SourceDirectory);
+
+		std::ifstream file(data->path, std::ios::binary);
+		if (file.is_open())
+		{
+			std::stringstream contents;
+			contents << file.rdbuf();
+			data->content = contents.str();
+		}
+		else
+		{
+			// An empty source name reports an error, the content is the message
+			data->content = "Cannot open include file: " + data->path;
+			data->path.clear();
+		}
+
+		data->result.source_name = data->path.c_str();
+		data->result.source_name_length = data->path.size();
+		data->result.content = data->content.c_str();
+		data->result.content_length = data->content.size();
+		data->result.user_data = data;
+
+		return &data->result;
+	}
+
+	void ReleaseInclude(shaderc_include_result* result) override
+	{
+		delete static_cast<IncludeData*>(result->user_data);
+	}
+
+private:
+	struct IncludeData
+	{
+		shaderc_include_result result;
+		std::string path;
+		std::string content;
+	};
+
+	std::string m_SourceDirectory;
+};
+
+ShaderCompiler::ShaderCompiler(const std::string& sourceDirectory, const std::string& cacheDirectory)
+	: m_SourceDirectory(sourceDirectory), m_CacheDirectory(cacheDirectory), m_Compiler(std::make_unique<shaderc::Compiler>())
+{
+	if (!m_Compiler->IsValid())
+	{
+		throw std::runtime_error("Failed to initialize the shader compiler!");
+	}
+
+	m_CompilerIdentity = identifyCompiler();
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+}
+
+std::vector<char> ShaderCompiler::compile(const Request& request)
+{
+	shaderc_shader_kind kind;
+	if (!stageFromExtension(request.sourceFile, &kind))
+	{
+		throw std::runtime_error("Unknown shader stage (file extension): " + request.sourceFile);
+	}
+
+	std::string path = m_SourceDirectory + request.sourceFile;
+	std::string source;
+	if (!readSource(path, &source))
+	{
+		throw std::runtime_error("Failed to open file: " + path);
+	}
+
+	uint64_t key = makeCacheKey(request, (int)kind, source);
+
+	std::vector<char> spirv;
+	if (m_CacheReadEnabled && readCache(key, &spirv))
+	{
+		std::lock_guard<std::mutex> lock(m_StatsMutex);
+		m_Stats.cacheHits++;
+		return spirv;
+	}
+
+	auto compileStart = std::chrono::steady_clock::now();
+
+	// Everything set here has to be part of the cache key (or SHADER_CACHE_VERSION)
+	shaderc::CompileOptions options;
+	setCommonOptions(&options);
+	options.SetIncluder(std::make_unique<FileIncluder>(m_SourceDirectory));
+	for (const auto& define : request.defines)
+	{
+		options.AddMacroDefinition(define.first, define.second);
+	}
+
+	shaderc::SpvCompilationResult result = m_Compiler->CompileGlslToSpv(source, kind, path.c_str(), "main", options);
+
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+	{
+		throw std::runtime_error("Failed to compile shader " + path + ":\n" + result.GetErrorMessage());
+	}
+
+	if (result.GetNumWarnings() > 0)
+	{
+		std::cerr << "shader compiler: " << result.GetErrorMessage();
+	}
+
+	spirv.assign(reinterpret_cast<const char*>(result.cbegin()), reinterpret_cast<const char*>(result.cend()));
+
+	writeCache(key, spirv);
+
+	double compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count();
+
+	printf("Shader compiled: %s (%i defines) in %.3f ms.\n", request.sourceFile.c_str(), (int)request.defines.size(), compileMs);
+
+	std::lock_guard<std::mutex> lock(m_StatsMutex);
+	m_Stats.compiled++;
+	m_Stats.compileMs += compileMs;
+
+	return spirv;
+}
+
+std::vector<std::vector<char>> ShaderCompiler::compileAll(const std::vector<Request>& requests, JobSystem& jobSystem)
+{
+	// Identical requests (e.g. a fragment shader shared by several programs) are compiled once
+	std::vector<Request> unique;
+	std::vector<uint32_t> uniqueIndex(requests.size());
+
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		auto it = std::find(unique.begin(), unique.end(), requests[i]);
+		uniqueIndex[i] = static_cast<uint32_t>(it - unique.begin());
+
+		if (it == unique.end())
+		{
+			unique.push_back(requests[i]);
+		}
+	}
+
+	std::vector<std::vector<char>> uniqueResults(unique.size());
+	std::vector<std::string> errors(unique.size());
+
+	// One shader per batch, exceptions must not escape a job
+	jobSystem.parallelFor(static_cast<uint32_t>(unique.size()), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			try
+			{
+				uniqueResults[i] = compile(unique[i]);
+			}
+			catch (const std::exception& e)
+			{
+				errors[i] = e.what();
+			}
+		}
+	});
+
+	for (const std::string& error : errors)
+	{
+		if (!error.empty())
+		{
+			throw std::runtime_error(error);
+		}
+	}
+
+	std::vector<std::vector<char>> results(requests.size());
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		results[i] = uniqueResults[uniqueIndex[i]];
+	}
+
+	return results;
+}
+
+ShaderCompiler::Stats ShaderCompiler::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_StatsMutex);
+
+	return m_Stats;
+}
+
+bool ShaderCompiler::readSource(const std::string& path, std::string* source)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file.is_open()) return false;
+
+	std::stringstream contents;
+	contents << file.rdbuf();
+	*source = contents.str();
+
+	return true;
+}
+
+void ShaderCompiler::hashIncludes(const std::string& path, const std::string& source, uint64_t* hash, std::vector<std::string>* visited)
+{
+	// Every #include line, in order. Conditional includes are hashed as well, which at worst causes a needless recompile.
+	std::istringstream lines(source);
+	std::string line;
+
+	while (std::getline(lines, line))
+	{
+		// '#', optional blanks, then the directive ("# include" is valid GLSL)
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line[start] != '#') continue;
+		start = line.find_first_not_of(" \t", start + 1);
+		if (start == std::string::npos || line.compare(start, 7, "include") != 0) continue;
+
+		size_t open = line.find_first_of("\"<", start + 7);
+		if (open == std::string::npos) continue;
+
+		size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+		if (close == std::string::npos) continue;
+
+		std::string includePath = resolveInclude(line.substr(open + 1, close - open - 1), line[open] == '"', path, m_SourceDirectory);
+
+		// Include guards make repeated includes legal, the contents only need to be hashed once
+		if (std::find(visited->begin(), visited->end(), includePath) != visited->end()) continue;
+		visited->push_back(includePath);
+
+		std::string includeSource;
+		bool found = readSource(includePath, &includeSource);
+
+		hashString(hash, includePath);
+		hashBytes(hash, &found, sizeof(found)); // A missing include fails to compile, adding it later changes the key
+
+		if (found)
+		{
+			hashString(hash, includeSource);
+			hashIncludes(includePath, includeSource, hash, visited);
+		}
+	}
+}
+
+uint64_t ShaderCompiler::identifyCompiler()
+{
+	// Touches the usual parts (blocks, samplers, control flow, math) so optimizer changes show up too
+	static const char* PROBE_SOURCE =
+		"#version 450\n"
+		"layout(set = 0, binding = 0) uniform Probe { mat4 transform; vec4 tint; int count; } probe;\n"
+		"layout(set = 1, binding = 0) uniform sampler2D probeTexture;\n"
+		"layout(constant_id = 0) const bool PROBE_BRANCH = true;\n"
+		"layout(location = 0) in vec2 uv;\n"
+		"layout(location = 0) out vec4 color;\n"
+		"vec4 shade(vec4 value) { return PROBE_BRANCH ? value * probe.tint : value.bgra; }\n"
+		"void main()\n"
+		"{\n"
+		"	vec4 sum = vec4(0.0);\n"
+		"	for (int i = 0; i < probe.count; i++) { sum += texture(probeTexture, uv + float(i) * 0.01); }\n"
+		"	color = shade(probe.transform * sum) + vec4(sin(uv.x), cos(uv.y), inversesqrt(1.0 + uv.x * uv.y), 1.0);\n"
+		"}\n";
+
+	shaderc::CompileOptions options;
+	setCommonOptions(&options);
+
+	shaderc::SpvCompilationResult result = m_Compiler->CompileGlslToSpv(PROBE_SOURCE, shaderc_glsl_fragment_shader, "probe.frag", "main", options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+	{
+		throw std::runtime_error("Failed to compile the shader compiler probe:\n" + result.GetErrorMessage());
+	}
+
+	uint64_t hash = 14695981039346656037ull;
+	hashBytes(&hash, result.cbegin(), (result.cend() - result.cbegin()) * sizeof(uint32_t));
+	hashCompilerLibrary(&hash);
+
+	return hash;
+}
+
+uint64_t ShaderCompiler::makeCacheKey(const Request& request, int stage, const std::string& source)
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	// Compiler and options
+	hashBytes(&hash, &SHADER_CACHE_VERSION, sizeof(SHADER_CACHE_VERSION));
+	hashBytes(&hash, &m_CompilerIdentity, sizeof(m_CompilerIdentity));
+	hashBytes(&hash, &stage, sizeof(stage));
+
+	uint32_t defineCount = static_cast<uint32_t>(request.defines.size());
+	hashBytes(&hash, &defineCount, sizeof(defineCount));
+	for (const auto& define : request.defines)
+	{
+		hashString(&hash, define.first);
+		hashString(&hash, define.second);
+	}
+
+	// Source and includes
+	std::string path = m_SourceDirectory + request.sourceFile;
+	hashString(&hash, path);
+	hashString(&hash, source);
+
+	std::vector<std::string> visited;
+	hashIncludes(path, source, &hash, &visited);
+
+	return hash;
+}
+
+std::string ShaderCompiler::cacheFile(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.spv", (unsigned long long)key);
+
+	return m_CacheDirectory + name;
+}
+
+bool ShaderCompiler::readCache(uint64_t key, std::vector<char>* spirv)
+{
+	std::ifstream file(cacheFile(key), std::ios::binary | std::ios::ate);
+
+	if (!file.is_open()) return false;
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	spirv->resize(fileSize);
+
+	file.seekg(0);
+	file.read(spirv->data(), fileSize);
+
+	// Truncated or foreign files are compiled again (and overwritten)
+	uint32_t magic = 0;
+	if (!file.good() || fileSize < 20 || fileSize % 4 != 0) return false;
+	memcpy(&magic, spirv->data(), sizeof(magic));
+
+	return magic == SPIRV_MAGIC;
+}
+
+void ShaderCompiler::writeCache(uint64_t key, const std::vector<char>& spirv)
+{
+	// Create the cache directory on first use (an existing one is fine)
+	std::string directory = m_CacheDirectory.substr(0, m_CacheDirectory.find_last_not_of("/\\") + 1);
+#ifdef _WIN32
+	CreateDirectoryA(directory.c_str(), nullptr);
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+
+	// Write a temporary file and swap it in, a crash while writing never leaves a truncated entry behind
+	std::string file = cacheFile(key);
+	std::string tempFile = file + ".tmp";
+	{
+		std::ofstream output(tempFile, std::ios::binary | std::ios::trunc);
+		output.write(spirv.data(), spirv.size());
+
+		if (!output.good())
+		{
+			std::cerr << "shader cache: failed to write " << tempFile << std::endl;
+			return;
+		}
+	}
+
+#ifdef _WIN32
+	bool replaced = MoveFileExA(tempFile.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool replaced = std::rename(tempFile.c_str(), file.c_str()) == 0;
+#endif
+
+	if (!replaced)
+	{
+		std::cerr << "shader cache: failed to replace " << file << std::endl;
+		std::remove(tempFile.c_str());
+	}
+}
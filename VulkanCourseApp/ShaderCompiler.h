@@ -0,0 +1,81 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace shaderc { class Compiler; }
+
+// Compiles the GLSL sources under Shaders/ to SPIR-V in-process (shaderc), replacing the offline compile_shaders.bat step.
+// Results are stored in a content-addressed cache: the file name is a hash of the source, the contents of every file it
+// includes, the defines, the stage and the compiler version/options. A cache hit only reads the file, so an unchanged
+// tree compiles nothing at startup, and any edit (including to an included file) produces a new entry.
+// Thread safe, independent shaders are compiled in parallel on the JobSystem (compileAll).
+class ShaderCompiler
+{
+public:
+	struct Request
+	{
+		std::string sourceFile; // Relative to the source directory, the stage follows from the extension (.vert, .frag, .comp, ...)
+		std::vector<std::pair<std::string, std::string>> defines; // -DNAME=VALUE
+
+		bool operator==(const Request& other) const { return sourceFile == other.sourceFile && defines == other.defines; }
+	};
+
+	struct Stats
+	{
+		uint32_t cacheHits = 0;
+		uint32_t compiled = 0;
+		double compileMs = 0.0; // Summed over all threads
+	};
+
+	ShaderCompiler(const std::string& sourceDirectory = "Shaders/", const std::string& cacheDirectory = "Shaders/cache/");
+	~ShaderCompiler();
+
+	ShaderCompiler(const ShaderCompiler&) = delete;
+	ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+	// SPIR-V of the request, from the cache or freshly compiled. Throws with the compiler log on errors.
+	std::vector<char> compile(const Request& request);
+
+	// Same as compile for every request, identical requests are compiled once and the rest in parallel.
+	// Results are in request order.
+	std::vector<std::vector<char>> compileAll(const std::vector<Request>& requests, JobSystem& jobSystem);
+
+	// Ignore existing cache entries (they are still written), e.g. to measure a cold start
+	void setCacheReadEnabled(bool enabled) { m_CacheReadEnabled = enabled; }
+
+	Stats getStats();
+
+private:
+	// Source text of the file and of everything it includes (recursively), hashed into the cache key
+	bool readSource(const std::string& path, std::string* source);
+	void hashIncludes(const std::string& path, const std::string& source, uint64_t* hash, std::vector<std::string>* visited);
+
+	// shaderc has no version query (shaderc_get_spv_version is the SPIR-V version, it stays the same across upgrades).
+	// Hash of a probe shader's SPIR-V, compiled with the common options: its header carries glslang's generator
+	// version and any change in code generation shows in the words. Plus the shaderc library file, if it is one.
+	uint64_t identifyCompiler();
+	uint64_t makeCacheKey(const Request& request, int stage, const std::string& source);
+	std::string cacheFile(uint64_t key);
+
+	bool readCache(uint64_t key, std::vector<char>* spirv);
+	void writeCache(uint64_t key, const std::vector<char>& spirv);
+
+	std::string m_SourceDirectory;
+	std::string m_CacheDirectory;
+	bool m_CacheReadEnabled = true;
+
+	std::unique_ptr<shaderc::Compiler> m_Compiler; // Thread safe, shared by all compilations
+	uint64_t m_CompilerIdentity = 0;
+
+	std::mutex m_StatsMutex;
+	Stats m_Stats;
+
+};
@@ -0,0 +1,247 @@
+#include "ShaderLibrary.h"
+#include "PipelineRegistry.h"
+
+#include <cstdio>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// FNV-1a of the SPIR-V
+static uint64_t hashBytes(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t result = 14695981039346656037ull;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		result ^= bytes[i];
+		result *= 1099511628211ull;
+	}
+
+	return result;
+}
+
+// Read-only view of a whole file, unmapped when it goes out of scope. Page aligned, so it can be handed
+// to vkCreateShaderModule (pCode has to be 4 byte aligned) without a copy.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path)
+	{
+#ifdef _WIN32
+		m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_File == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(m_File, &fileSize) || fileSize.QuadPart == 0) return false;
+		m_Size = static_cast<size_t>(fileSize.QuadPart);
+
+		m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_Mapping == nullptr) return false;
+
+		m_Data = MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		m_File = ::open(path.c_str(), O_RDONLY);
+		if (m_File < 0) return false;
+
+		struct stat fileStat;
+		if (fstat(m_File, &fileStat) != 0 || fileStat.st_size == 0) return false;
+		m_Size = static_cast<size_t>(fileStat.st_size);
+
+		void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0);
+		m_Data = data == MAP_FAILED ? nullptr : data;
+#endif
+		return m_Data != nullptr;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (m_Data != nullptr) UnmapViewOfFile(m_Data);
+		if (m_Mapping != nullptr) CloseHandle(m_Mapping);
+		if (m_File != INVALID_HANDLE_VALUE) CloseHandle(m_File);
+		m_Mapping = nullptr;
+		m_File = INVALID_HANDLE_VALUE;
+#else
+		if (m_Data != nullptr) munmap(m_Data, m_Size);
+		if (m_File >= 0) ::close(m_File);
+		m_File = -1;
+#endif
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+
+	const void* data() const { return m_Data; }
+	size_t size() const { return m_Size; }
+
+private:
+#ifdef _WIN32
+	HANDLE m_File = INVALID_HANDLE_VALUE;
+	HANDLE m_Mapping = nullptr;
+#else
+	int m_File = -1;
+#endif
+	void* m_Data = nullptr;
+	size_t m_Size = 0;
+};
+
+ShaderLibrary::ShaderLibrary(VkDevice device, PipelineRegistry& pipelineRegistry)
+	: m_Device(device), m_PipelineRegistry(pipelineRegistry)
+{
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+	// Modules still referenced here would be destroyed through a dangling library
+	Stats stats = getStats();
+	if (stats.liveModules > 0)
+	{
+		printf("ShaderLibrary destroyed with %i shader modules still referenced!\n", (int)stats.liveModules);
+	}
+}
+
+ShaderLibrary::ShaderModuleRef ShaderLibrary::loadShaderModule(const std::string& path)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		auto it = m_ModulesByPath.find(path);
+		if (it != m_ModulesByPath.end())
+		{
+			ShaderModuleRef module = it->second.lock();
+			if (module != nullptr)
+			{
+				m_Stats.pathHits++;
+				return module;
+			}
+		}
+	}
+
+	// Mapped only while the module is created, Vulkan keeps its own copy of the code
+	MappedFile file;
+	if (!file.open(path))
+	{
+		throw std::runtime_error("Failed to open file: " + path);
+	}
+
+	ShaderModuleRef module = getOrCreate(file.data(), file.size(), path);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_ModulesByPath[path] = module;
+	m_Stats.filesMapped++;
+
+	return module;
+}
+
+ShaderLibrary::ShaderModuleRef ShaderLibrary::createShaderModule(const void* code, size_t codeSize, const std::string& name)
+{
+	return getOrCreate(code, codeSize, name);
+}
+
+ShaderLibrary::Stats ShaderLibrary::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	return m_Stats;
+}
+
+ShaderLibrary::ShaderModuleRef ShaderLibrary::getOrCreate(const void* code, size_t codeSize, const std::string& name)
+{
+	uint64_t contentHash = hashBytes(code, codeSize);
+
+	// Declared before the lock: if it turns out to be the last reference it must be released after unlocking
+	ShaderModuleRef existing;
+
+	// Creation is cheap next to pipeline compilation, the lock is held throughout so the same code is never created twice
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto it = m_ModulesByHash.find(contentHash);
+	if (it != m_ModulesByHash.end())
+	{
+		existing = it->second.lock();
+		if (existing != nullptr && existing->codeSize == codeSize)
+		{
+			m_Stats.contentShared++;
+			return existing;
+		}
+	}
+
+	std::unique_ptr<ShaderModule> module = std::make_unique<ShaderModule>();
+	module->name = name;
+	module->contentHash = contentHash;
+	module->codeSize = codeSize;
+
+	// Malformed code never reaches the driver
+	std::string error;
+	if (!ShaderReflection::reflect(code, codeSize, MAX_SPIRV_VERSION, &module->reflection, &error))
+	{
+		throw std::runtime_error("Invalid shader module " + name + ": " + error);
+	}
+
+	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCreateInfo.codeSize = codeSize;                                 // Size of code
+	shaderModuleCreateInfo.pCode = static_cast<const uint32_t*>(code);          // Pointer to code (of uint32_t pointer type)
+
+	VkResult result = vkCreateShaderModule(m_Device, &shaderModuleCreateInfo, nullptr, &module->module);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Shader Module!");
+	}
+
+	// Pipelines built from the same SPIR-V are shared
+	m_PipelineRegistry.registerShaderModule(module->module, code, codeSize);
+
+	printf("Vulkan Shader Module successfully created: %s (%i bytes, %i descriptor bindings, %i bytes of push constants).\n",
+		name.c_str(), (int)codeSize, (int)module->reflection.bindings.size(), (int)module->reflection.pushConstantSize);
+
+	ShaderModuleRef ref(module.release(), [this](ShaderModule* released) { releaseShaderModule(released); });
+	m_ModulesByHash[contentHash] = ref;
+	m_Stats.modulesCreated++;
+	m_Stats.liveModules++;
+
+	return ref;
+}
+
+void ShaderLibrary::releaseShaderModule(ShaderModule* module)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		// The entries may already point at a newer module with the same key
+		auto it = m_ModulesByHash.find(module->contentHash);
+		if (it != m_ModulesByHash.end() && it->second.expired())
+		{
+			m_ModulesByHash.erase(it);
+		}
+
+		for (auto pathIt = m_ModulesByPath.begin(); pathIt != m_ModulesByPath.end();)
+		{
+			pathIt = pathIt->second.expired() ? m_ModulesByPath.erase(pathIt) : std::next(pathIt);
+		}
+
+		m_Stats.liveModules--;
+	}
+
+	m_PipelineRegistry.unregisterShaderModule(module->module);
+	vkDestroyShaderModule(m_Device, module->module, nullptr);
+	delete module;
+}
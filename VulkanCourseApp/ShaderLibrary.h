@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ShaderReflection.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+class PipelineRegistry;
+
+// Device-wide cache of shader modules. Each SPIR-V blob is read once (memory-mapped), validated and reflected,
+// and every user of the same file or the same code gets the same reference counted VkShaderModule.
+// Modules are keyed by path (no file access when it is already loaded) and by a hash of their code
+// (the same SPIR-V from two files or from memory shares the module). The module is destroyed with its last
+// reference, which must go before the library. Thread safe.
+class ShaderLibrary
+{
+public:
+	struct ShaderModule
+	{
+		VkShaderModule module = VK_NULL_HANDLE;
+		std::string name;         // File path, or the name given to createShaderModule
+		uint64_t contentHash = 0; // FNV-1a of the SPIR-V
+		size_t codeSize = 0;
+		ShaderReflection reflection;
+	};
+
+	using ShaderModuleRef = std::shared_ptr<const ShaderModule>;
+
+	struct Stats
+	{
+		uint32_t filesMapped = 0;    // SPIR-V files read from disk
+		uint32_t pathHits = 0;       // loadShaderModule calls answered without touching the file
+		uint32_t contentShared = 0;  // New files or blobs that matched an existing module's code
+		uint32_t modulesCreated = 0;
+		uint32_t liveModules = 0;
+	};
+
+	// Vulkan 1.1 consumes SPIR-V up to 1.3
+	static const uint32_t MAX_SPIRV_VERSION = 0x00010300;
+
+	ShaderLibrary(VkDevice device, PipelineRegistry& pipelineRegistry);
+	~ShaderLibrary();
+
+	ShaderLibrary(const ShaderLibrary&) = delete;
+	ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+	// Files are assumed not to change while a module loaded from them is alive. Throws if the file is missing or invalid.
+	ShaderModuleRef loadShaderModule(const std::string& path);
+	// SPIR-V already in memory (e.g. from ShaderCompiler), name is only used in messages
+	ShaderModuleRef createShaderModule(const void* code, size_t codeSize, const std::string& name);
+
+	Stats getStats();
+
+private:
+	ShaderModuleRef getOrCreate(const void* code, size_t codeSize, const std::string& name);
+
+	// Called by the last reference
+	void releaseShaderModule(ShaderModule* module);
+
+	VkDevice m_Device;
+	PipelineRegistry& m_PipelineRegistry;
+
+	std::mutex m_Mutex;
+	std::unordered_map<std::string, std::weak_ptr<const ShaderModule>> m_ModulesByPath;
+	std::unordered_map<uint64_t, std::weak_ptr<const ShaderModule>> m_ModulesByHash;
+
+	Stats m_Stats;
+
+};
@@ -0,0 +1,640 @@
+#include "ShaderReflection.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+// The handful of SPIR-V enumerants the reflection needs (see the SPIR-V specification, section 3)
+namespace
+{
+	const uint32_t SPIRV_MAGIC = 0x07230203;
+	const uint32_t SPIRV_HEADER_WORDS = 5;
+
+	enum Op : uint32_t
+	{
+		OpEntryPoint = 15,
+		OpTypeBool = 20,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpSpecConstant = 50,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+	};
+
+	enum Decoration : uint32_t
+	{
+		DecorationBlock = 2,
+		DecorationBufferBlock = 3,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBuiltIn = 11,
+		DecorationLocation = 30,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35,
+	};
+
+	enum StorageClass : uint32_t
+	{
+		StorageClassUniformConstant = 0,
+		StorageClassInput = 1,
+		StorageClassUniform = 2,
+		StorageClassPushConstant = 9,
+		StorageClassStorageBuffer = 12,
+	};
+
+	const uint32_t DimBuffer = 5;
+	const uint32_t DimSubpassData = 6;
+
+	const uint32_t NONE = UINT32_MAX;
+
+	// Deeper type nesting is rejected, it bounds the recursion of typeSize
+	const uint32_t MAX_TYPE_DEPTH = 64;
+
+	struct IdInfo
+	{
+		uint32_t offset = 0;    // Word index of the instruction defining the id, 0 = not defined (yet)
+		uint32_t typeDepth = 0; // Types: 1 for scalars and opaque types, otherwise 1 + the deepest component
+		bool usedAsComponent = false; // Component of a type before any definition (a type the reflection does not know)
+	};
+
+	struct Decorations
+	{
+		uint32_t set = NONE;
+		uint32_t binding = NONE;
+		uint32_t location = NONE;
+		uint32_t arrayStride = 0;
+		bool builtIn = false;
+		bool bufferBlock = false;
+		std::vector<uint32_t> memberOffsets;
+		std::vector<uint32_t> memberMatrixStrides;
+	};
+
+	// Parsed module, ids are indices into the tables (bounded by the header)
+	struct Module
+	{
+		const uint32_t* words = nullptr;
+		std::vector<IdInfo> ids;
+		std::vector<Decorations> decorations;
+
+		const uint32_t* instruction(uint32_t id) const { return id < ids.size() && ids[id].offset != 0 ? words + ids[id].offset : nullptr; }
+		uint32_t opcode(uint32_t id) const { const uint32_t* inst = instruction(id); return inst != nullptr ? (inst[0] & 0xffff) : 0; }
+		uint32_t wordCount(uint32_t id) const { const uint32_t* inst = instruction(id); return inst != nullptr ? (inst[0] >> 16) : 0; }
+
+		uint32_t constantValue(uint32_t id) const
+		{
+			uint32_t op = opcode(id);
+			return (op == OpConstant || op == OpSpecConstant) && wordCount(id) > 3 ? instruction(id)[3] : 1;
+		}
+
+		// Byte size of a type inside a block (explicit layout), matrixStride comes from the struct member.
+		// Components are defined before the types using them (checked by reflect), so this ends within MAX_TYPE_DEPTH.
+		uint32_t typeSize(uint32_t type, uint32_t matrixStride) const
+		{
+			const uint32_t* inst = instruction(type);
+			if (inst == nullptr) return 0;
+
+			switch (opcode(type))
+			{
+			case OpTypeBool:
+				return 4;
+			case OpTypeInt:
+			case OpTypeFloat:
+				return inst[2] / 8;
+			case OpTypeVector:
+				return inst[3] * typeSize(inst[2], 0);
+			case OpTypeMatrix:
+				return inst[3] * (matrixStride != 0 ? matrixStride : typeSize(inst[2], 0));
+			case OpTypeArray:
+			{
+				uint32_t stride = decorations[type].arrayStride;
+				return constantValue(inst[3]) * (stride != 0 ? stride : typeSize(inst[2], matrixStride));
+			}
+			case OpTypeStruct:
+			{
+				uint32_t size = 0;
+				const Decorations& members = decorations[type];
+				for (uint32_t i = 0; i + 2 < wordCount(type); i++)
+				{
+					uint32_t offset = i < members.memberOffsets.size() && members.memberOffsets[i] != NONE ? members.memberOffsets[i] : size;
+					uint32_t stride = i < members.memberMatrixStrides.size() && members.memberMatrixStrides[i] != NONE ? members.memberMatrixStrides[i] : 0;
+					size = std::max(size, offset + typeSize(inst[2 + i], stride));
+				}
+				return size;
+			}
+			default:
+				return 0; // Runtime arrays and opaque types have no size
+			}
+		}
+	};
+
+	bool fail(std::string* error, const std::string& message)
+	{
+		if (error != nullptr) *error = message;
+		return false;
+	}
+
+	const char* stageName(VkShaderStageFlagBits stage)
+	{
+		switch (stage)
+		{
+		case VK_SHADER_STAGE_VERTEX_BIT:                  return "vertex";
+		case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:    return "tessellation control";
+		case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT: return "tessellation evaluation";
+		case VK_SHADER_STAGE_GEOMETRY_BIT:                return "geometry";
+		case VK_SHADER_STAGE_FRAGMENT_BIT:                return "fragment";
+		case VK_SHADER_STAGE_COMPUTE_BIT:                 return "compute";
+		default:                                          return "unknown";
+		}
+	}
+
+	// 'f' float, 'i' signed int, 'u' unsigned int, 0 unknown
+	char formatNumericType(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R32_SFLOAT: case VK_FORMAT_R32G32_SFLOAT: case VK_FORMAT_R32G32B32_SFLOAT: case VK_FORMAT_R32G32B32A32_SFLOAT:
+		case VK_FORMAT_R16_SFLOAT: case VK_FORMAT_R16G16_SFLOAT: case VK_FORMAT_R16G16B16A16_SFLOAT:
+		case VK_FORMAT_R8_UNORM: case VK_FORMAT_R8G8_UNORM: case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R8G8B8A8_SNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB: case VK_FORMAT_B8G8R8A8_UNORM: case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+		case VK_FORMAT_R16G16_UNORM: case VK_FORMAT_R16G16B16A16_UNORM: case VK_FORMAT_R16G16_SNORM: case VK_FORMAT_R16G16B16A16_SNORM:
+			return 'f';
+		case VK_FORMAT_R32_SINT: case VK_FORMAT_R32G32_SINT: case VK_FORMAT_R32G32B32_SINT: case VK_FORMAT_R32G32B32A32_SINT:
+		case VK_FORMAT_R8G8B8A8_SINT: case VK_FORMAT_R16G16B16A16_SINT:
+			return 'i';
+		case VK_FORMAT_R32_UINT: case VK_FORMAT_R32G32_UINT: case VK_FORMAT_R32G32B32_UINT: case VK_FORMAT_R32G32B32A32_UINT:
+		case VK_FORMAT_R8G8B8A8_UINT: case VK_FORMAT_R16G16B16A16_UINT:
+			return 'u';
+		default:
+			return 0;
+		}
+	}
+
+	VkFormat vertexFormat(char numericType, uint32_t components)
+	{
+		static const VkFormat floatFormats[4] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+		static const VkFormat sintFormats[4]  = { VK_FORMAT_R32_SINT,   VK_FORMAT_R32G32_SINT,   VK_FORMAT_R32G32B32_SINT,   VK_FORMAT_R32G32B32A32_SINT };
+		static const VkFormat uintFormats[4]  = { VK_FORMAT_R32_UINT,   VK_FORMAT_R32G32_UINT,   VK_FORMAT_R32G32B32_UINT,   VK_FORMAT_R32G32B32A32_UINT };
+
+		if (components < 1 || components > 4) return VK_FORMAT_UNDEFINED;
+
+		switch (numericType)
+		{
+		case 'f': return floatFormats[components - 1];
+		case 'i': return sintFormats[components - 1];
+		case 'u': return uintFormats[components - 1];
+		default:  return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	// Scalar or vector input type to a format, UNDEFINED if not a 32-bit numeric type
+	VkFormat inputFormat(const Module& module, uint32_t type)
+	{
+		uint32_t components = 1;
+		if (module.opcode(type) == OpTypeVector)
+		{
+			components = module.instruction(type)[3];
+			type = module.instruction(type)[2];
+		}
+
+		const uint32_t* scalar = module.instruction(type);
+		if (scalar == nullptr || scalar[2] != 32) return VK_FORMAT_UNDEFINED;
+
+		if (module.opcode(type) == OpTypeFloat) return vertexFormat('f', components);
+		if (module.opcode(type) == OpTypeInt)   return vertexFormat(scalar[3] != 0 ? 'i' : 'u', components);
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	bool descriptorTypesCompatible(VkDescriptorType shaderType, VkDescriptorType layoutType)
+	{
+		if (shaderType == layoutType) return true;
+
+		// Dynamic offsets are invisible to the shader
+		return (shaderType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && layoutType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) ||
+			(shaderType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && layoutType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+	}
+}
+
+bool ShaderReflection::reflect(const void* code, size_t codeSize, uint32_t maxSpirvVersion, ShaderReflection* reflection, std::string* error)
+{
+	*reflection = ShaderReflection();
+
+	// -- HEADER --
+	if (codeSize % 4 != 0 || codeSize < SPIRV_HEADER_WORDS * 4)
+	{
+		return fail(error, "not SPIR-V (size " + std::to_string(codeSize) + " bytes)");
+	}
+
+	// Shader modules must be 4 byte aligned (vkCreateShaderModule takes uint32_t), file mappings and vectors are
+	const uint32_t* words = static_cast<const uint32_t*>(code);
+	size_t wordCount = codeSize / 4;
+
+	if (words[0] != SPIRV_MAGIC)
+	{
+		return fail(error, "not SPIR-V (wrong magic number)");
+	}
+
+	reflection->spirvVersion = words[1];
+	if (words[1] > maxSpirvVersion)
+	{
+		return fail(error, "SPIR-V version " + std::to_string((words[1] >> 16) & 0xff) + "." + std::to_string((words[1] >> 8) & 0xff) + " is not supported");
+	}
+
+	uint32_t bound = words[3];
+	if (bound == 0 || bound > wordCount * 2 + 64) // Every id needs an instruction, anything bigger is corrupt
+	{
+		return fail(error, "invalid id bound " + std::to_string(bound));
+	}
+
+	Module module;
+	module.words = words;
+	module.ids.resize(bound);
+	module.decorations.resize(bound);
+
+	std::vector<uint32_t> variables; // Word offsets of the OpVariable instructions
+	bool hasEntryPoint = false;
+
+	// -- INSTRUCTIONS --
+	for (size_t offset = SPIRV_HEADER_WORDS; offset < wordCount;)
+	{
+		uint32_t instructionWords = words[offset] >> 16;
+		uint32_t op = words[offset] & 0xffff;
+
+		if (instructionWords == 0 || offset + instructionWords > wordCount)
+		{
+			return fail(error, "truncated instruction at word " + std::to_string(offset));
+		}
+
+		const uint32_t* inst = words + offset;
+
+		// Operand count checks, ids are checked against the bound before they index the tables
+		auto requireWords = [&](uint32_t count) { return instructionWords >= count; };
+		auto validId = [&](uint32_t id) { return id != 0 && id < bound; };
+		auto definedId = [&](uint32_t id) { return validId(id) && module.ids[id].offset != 0; };
+		// Components must be defined earlier: no type can contain itself, directly or through others.
+		// Types outside the reflected range (e.g. acceleration structures) are not tracked, they count as depth 1
+		// and may never be defined as a tracked type afterwards.
+		uint32_t componentDepth = 0;
+		auto componentType = [&](uint32_t id)
+		{
+			if (!validId(id)) return false;
+			if (!definedId(id))
+			{
+				module.ids[id].usedAsComponent = true;
+				componentDepth = std::max(componentDepth, 1u);
+				return true;
+			}
+			if (module.ids[id].typeDepth == 0) return false; // A constant or variable
+			componentDepth = std::max(componentDepth, module.ids[id].typeDepth);
+			return true;
+		};
+
+		if (op == OpEntryPoint && !hasEntryPoint)
+		{
+			if (!requireWords(4)) return fail(error, "invalid OpEntryPoint");
+
+			switch (inst[1])
+			{
+			case 0: reflection->stage = VK_SHADER_STAGE_VERTEX_BIT; break;
+			case 1: reflection->stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; break;
+			case 2: reflection->stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; break;
+			case 3: reflection->stage = VK_SHADER_STAGE_GEOMETRY_BIT; break;
+			case 4: reflection->stage = VK_SHADER_STAGE_FRAGMENT_BIT; break;
+			case 5: reflection->stage = VK_SHADER_STAGE_COMPUTE_BIT; break;
+			default: return fail(error, "unsupported execution model " + std::to_string(inst[1]));
+			}
+
+			// Literal string, nul terminated within the instruction
+			const char* name = reinterpret_cast<const char*>(inst + 3);
+			size_t maxLength = (instructionWords - 3) * 4;
+			size_t length = strnlen(name, maxLength);
+			if (length == maxLength) return fail(error, "unterminated entry point name");
+
+			reflection->entryPoint.assign(name, length);
+			hasEntryPoint = true;
+		}
+		else if (op >= OpTypeBool && op <= OpTypePointer)
+		{
+			if (!requireWords(2) || !validId(inst[1])) return fail(error, "invalid type instruction");
+			if (definedId(inst[1])) return fail(error, "id " + std::to_string(inst[1]) + " defined twice");
+			if (module.ids[inst[1]].usedAsComponent) return fail(error, "type " + std::to_string(inst[1]) + " used before its definition");
+
+			// Operands read by the reflection. Pointers may point at types declared later (OpTypeForwardPointer),
+			// nothing recurses through them.
+			bool valid = true;
+			switch (op)
+			{
+			case OpTypeInt:
+			case OpTypeFloat:        valid = requireWords(3) && (op == OpTypeFloat || requireWords(4)); break;
+			case OpTypeVector:
+			case OpTypeMatrix:       valid = requireWords(4) && componentType(inst[2]); break;
+			case OpTypeImage:        valid = requireWords(9); break;
+			case OpTypeArray:        valid = requireWords(4) && componentType(inst[2]) && validId(inst[3]); break;
+			case OpTypeRuntimeArray: valid = requireWords(3) && componentType(inst[2]); break;
+			case OpTypePointer:      valid = requireWords(4) && validId(inst[3]); break;
+			case OpTypeStruct:
+				for (uint32_t i = 2; i < instructionWords; i++) valid = valid && componentType(inst[i]);
+				break;
+			default: break;
+			}
+			if (!valid) return fail(error, "invalid type instruction at word " + std::to_string(offset));
+			if (componentDepth >= MAX_TYPE_DEPTH) return fail(error, "types nested too deeply at word " + std::to_string(offset));
+
+			module.ids[inst[1]].offset = static_cast<uint32_t>(offset);
+			module.ids[inst[1]].typeDepth = componentDepth + 1;
+		}
+		else if (op == OpConstant || op == OpSpecConstant)
+		{
+			if (!requireWords(3) || !validId(inst[2])) return fail(error, "invalid constant");
+			if (definedId(inst[2])) return fail(error, "id " + std::to_string(inst[2]) + " defined twice");
+			module.ids[inst[2]].offset = static_cast<uint32_t>(offset);
+		}
+		else if (op == OpVariable)
+		{
+			if (!requireWords(4) || !validId(inst[1]) || !validId(inst[2])) return fail(error, "invalid OpVariable");
+			if (definedId(inst[2])) return fail(error, "id " + std::to_string(inst[2]) + " defined twice");
+			module.ids[inst[2]].offset = static_cast<uint32_t>(offset);
+			variables.push_back(static_cast<uint32_t>(offset));
+		}
+		else if (op == OpDecorate && requireWords(3))
+		{
+			if (!validId(inst[1])) return fail(error, "invalid OpDecorate");
+
+			Decorations& decorations = module.decorations[inst[1]];
+			uint32_t value = instructionWords > 3 ? inst[3] : 0;
+
+			switch (inst[2])
+			{
+			case DecorationBufferBlock:   decorations.bufferBlock = true; break;
+			case DecorationArrayStride:   decorations.arrayStride = value; break;
+			case DecorationBuiltIn:       decorations.builtIn = true; break;
+			case DecorationLocation:      decorations.location = value; break;
+			case DecorationBinding:       decorations.binding = value; break;
+			case DecorationDescriptorSet: decorations.set = value; break;
+			default: break;
+			}
+		}
+		else if (op == OpMemberDecorate && requireWords(5))
+		{
+			if (!validId(inst[1]) || inst[2] > 0xffff) return fail(error, "invalid OpMemberDecorate");
+
+			Decorations& decorations = module.decorations[inst[1]];
+			uint32_t member = inst[2];
+
+			if (inst[3] == DecorationOffset || inst[3] == DecorationMatrixStride)
+			{
+				std::vector<uint32_t>& values = inst[3] == DecorationOffset ? decorations.memberOffsets : decorations.memberMatrixStrides;
+				if (values.size() <= member) values.resize(member + 1, NONE);
+				values[member] = inst[4];
+			}
+		}
+
+		offset += instructionWords;
+	}
+
+	if (!hasEntryPoint)
+	{
+		return fail(error, "no entry point");
+	}
+
+	// -- INTERFACE --
+	uint32_t pushConstantEnd = 0;
+	reflection->pushConstantOffset = NONE;
+
+	for (uint32_t variableOffset : variables)
+	{
+		const uint32_t* variable = words + variableOffset;
+		uint32_t id = variable[2];
+		uint32_t storageClass = variable[3];
+
+		const uint32_t* pointer = module.instruction(variable[1]);
+		if (pointer == nullptr || module.opcode(variable[1]) != OpTypePointer) continue;
+
+		uint32_t type = pointer[3];
+		const Decorations& decorations = module.decorations[id];
+
+		if (storageClass == StorageClassInput)
+		{
+			if (reflection->stage != VK_SHADER_STAGE_VERTEX_BIT || decorations.builtIn || decorations.location == NONE) continue;
+
+			// Arrays and matrices take consecutive locations
+			uint32_t locations = 1;
+			if (module.opcode(type) == OpTypeArray)
+			{
+				locations = module.constantValue(module.instruction(type)[3]);
+				type = module.instruction(type)[2];
+			}
+			if (module.opcode(type) == OpTypeMatrix)
+			{
+				locations *= module.instruction(type)[3];
+				type = module.instruction(type)[2];
+			}
+
+			for (uint32_t i = 0; i < locations && i < 64; i++)
+			{
+				VertexInput input;
+				input.location = decorations.location + i;
+				input.format = inputFormat(module, type);
+				reflection->vertexInputs.push_back(input);
+			}
+		}
+		else if (storageClass == StorageClassPushConstant)
+		{
+			const Decorations& members = module.decorations[type];
+			for (uint32_t offset : members.memberOffsets)
+			{
+				if (offset != NONE) reflection->pushConstantOffset = std::min(reflection->pushConstantOffset, offset);
+			}
+			pushConstantEnd = std::max(pushConstantEnd, module.typeSize(type, 0));
+		}
+		else if (storageClass == StorageClassUniformConstant || storageClass == StorageClassUniform || storageClass == StorageClassStorageBuffer)
+		{
+			if (decorations.set == NONE || decorations.binding == NONE) continue;
+
+			DescriptorBinding binding;
+			binding.set = decorations.set;
+			binding.binding = decorations.binding;
+
+			// Arrays of descriptors
+			for (int depth = 0; depth < 8; depth++)
+			{
+				if (module.opcode(type) == OpTypeArray)
+				{
+					binding.descriptorCount *= module.constantValue(module.instruction(type)[3]);
+				}
+				else if (module.opcode(type) == OpTypeRuntimeArray)
+				{
+					binding.descriptorCount = 0;
+				}
+				else
+				{
+					break;
+				}
+				type = module.instruction(type)[2];
+			}
+
+			const uint32_t* typeInstruction = module.instruction(type);
+			switch (module.opcode(type))
+			{
+			case OpTypeSampledImage:
+				binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				break;
+			case OpTypeSampler:
+				binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+				break;
+			case OpTypeImage:
+			{
+				uint32_t dim = typeInstruction[3];
+				bool storage = typeInstruction[7] == 2; // Sampled operand: 1 = sampled, 2 = storage (read/write)
+
+				if (dim == DimSubpassData)  binding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				else if (dim == DimBuffer)  binding.descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				else                        binding.descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				break;
+			}
+			case OpTypeStruct:
+				// Before SPIR-V 1.3 storage buffers are Uniform blocks decorated BufferBlock
+				binding.descriptorType = storageClass == StorageClassStorageBuffer || module.decorations[type].bufferBlock ?
+					VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				break;
+			default:
+				continue;
+			}
+
+			reflection->bindings.push_back(binding);
+		}
+	}
+
+	if (pushConstantEnd > 0)
+	{
+		if (reflection->pushConstantOffset == NONE) reflection->pushConstantOffset = 0;
+		reflection->pushConstantSize = pushConstantEnd - std::min(reflection->pushConstantOffset, pushConstantEnd);
+	}
+	else
+	{
+		reflection->pushConstantOffset = 0;
+	}
+
+	std::sort(reflection->bindings.begin(), reflection->bindings.end(), [](const DescriptorBinding& a, const DescriptorBinding& b)
+	{
+		return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+	});
+
+	std::sort(reflection->vertexInputs.begin(), reflection->vertexInputs.end(), [](const VertexInput& a, const VertexInput& b)
+	{
+		return a.location < b.location;
+	});
+
+	return true;
+}
+
+bool ShaderReflection::checkSetLayout(const std::vector<const ShaderReflection*>& stages, uint32_t set, const VkDescriptorSetLayoutCreateInfo& setLayout, std::string* error)
+{
+	for (const ShaderReflection* stage : stages)
+	{
+		for (const DescriptorBinding& binding : stage->bindings)
+		{
+			if (binding.set != set) continue;
+
+			std::string name = std::string(stageName(stage->stage)) + " shader set " + std::to_string(set) + " binding " + std::to_string(binding.binding);
+
+			const VkDescriptorSetLayoutBinding* layoutBinding = nullptr;
+			for (uint32_t i = 0; i < setLayout.bindingCount; i++)
+			{
+				if (setLayout.pBindings[i].binding == binding.binding) layoutBinding = &setLayout.pBindings[i];
+			}
+
+			if (layoutBinding == nullptr)
+			{
+				return fail(error, name + " is missing from the set layout");
+			}
+			if (!descriptorTypesCompatible(binding.descriptorType, layoutBinding->descriptorType))
+			{
+				return fail(error, name + ": descriptor type " + std::to_string(binding.descriptorType) + " in the shader, " +
+					std::to_string(layoutBinding->descriptorType) + " in the set layout");
+			}
+			if (binding.descriptorCount > layoutBinding->descriptorCount)
+			{
+				return fail(error, name + ": " + std::to_string(binding.descriptorCount) + " descriptors in the shader, " +
+					std::to_string(layoutBinding->descriptorCount) + " in the set layout");
+			}
+			if ((layoutBinding->stageFlags & stage->stage) == 0)
+			{
+				return fail(error, name + " is not visible to the stage (stageFlags)");
+			}
+		}
+	}
+
+	return true;
+}
+
+bool ShaderReflection::checkPushConstantRanges(const std::vector<const ShaderReflection*>& stages, const VkPipelineLayoutCreateInfo& pipelineLayout, std::string* error)
+{
+	for (const ShaderReflection* stage : stages)
+	{
+		uint32_t position = stage->pushConstantOffset;
+		uint32_t end = stage->pushConstantOffset + stage->pushConstantSize;
+
+		// Walk the block, every byte has to be in a range that includes the stage
+		while (position < end)
+		{
+			uint32_t next = position;
+			for (uint32_t i = 0; i < pipelineLayout.pushConstantRangeCount; i++)
+			{
+				const VkPushConstantRange& range = pipelineLayout.pPushConstantRanges[i];
+				if ((range.stageFlags & stage->stage) != 0 && range.offset <= position && position < range.offset + range.size)
+				{
+					next = std::max(next, range.offset + range.size);
+				}
+			}
+
+			if (next == position)
+			{
+				return fail(error, std::string(stageName(stage->stage)) + " shader push constant bytes [" + std::to_string(position) + ", " +
+					std::to_string(end) + ") are not covered by a push constant range of the stage");
+			}
+
+			position = next;
+		}
+	}
+
+	return true;
+}
+
+bool ShaderReflection::checkVertexInput(const ShaderReflection& vertexStage, const VkPipelineVertexInputStateCreateInfo& vertexInput, std::string* error)
+{
+	for (const VertexInput& input : vertexStage.vertexInputs)
+	{
+		const VkVertexInputAttributeDescription* attribute = nullptr;
+		for (uint32_t i = 0; i < vertexInput.vertexAttributeDescriptionCount; i++)
+		{
+			if (vertexInput.pVertexAttributeDescriptions[i].location == input.location) attribute = &vertexInput.pVertexAttributeDescriptions[i];
+		}
+
+		if (attribute == nullptr)
+		{
+			return fail(error, "vertex shader input location " + std::to_string(input.location) + " has no vertex attribute");
+		}
+
+		char shaderType = formatNumericType(input.format);
+		char attributeType = formatNumericType(attribute->format);
+		if (shaderType != 0 && attributeType != 0 && shaderType != attributeType)
+		{
+			return fail(error, "vertex shader input location " + std::to_string(input.location) + ": attribute format " +
+				std::to_string(attribute->format) + " does not match the shader's numeric type");
+		}
+	}
+
+	return true;
+}
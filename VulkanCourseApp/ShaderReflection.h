@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Interface of a SPIR-V shader stage, read straight from the module: descriptor bindings, push constant block and
+// vertex inputs. Used to check hand written pipeline layouts and vertex input descriptions against the shaders.
+// Every resource the module declares is listed, used by the entry point or not.
+struct ShaderReflection
+{
+	struct DescriptorBinding
+	{
+		uint32_t set = 0;
+		uint32_t binding = 0;
+		VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // Never *_DYNAMIC, the shader can't tell
+		uint32_t descriptorCount = 1;                                        // 0 = runtime sized array
+	};
+
+	struct VertexInput
+	{
+		uint32_t location = 0;
+		VkFormat format = VK_FORMAT_UNDEFINED; // 32-bit per component, matrices take one location per column
+	};
+
+	VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+	std::string entryPoint;
+	uint32_t spirvVersion = 0;
+
+	std::vector<DescriptorBinding> bindings; // Sorted by set, then binding
+	uint32_t pushConstantOffset = 0;         // First byte used by the push constant block
+	uint32_t pushConstantSize = 0;           // 0 = no push constant block
+	std::vector<VertexInput> vertexInputs;   // Vertex stage only, sorted by location (built-ins excluded)
+
+	// Validates the module (header, version up to maxSpirvVersion, instruction stream, an entry point) and reflects it.
+	// Returns false with a description on malformed or unsupported code.
+	static bool reflect(const void* code, size_t codeSize, uint32_t maxSpirvVersion, ShaderReflection* reflection, std::string* error);
+
+	// Layout checks, false with a description of the first mismatch.
+	// A set layout must declare every binding the stages use, with a matching type, enough descriptors and the stage flags.
+	static bool checkSetLayout(const std::vector<const ShaderReflection*>& stages, uint32_t set, const VkDescriptorSetLayoutCreateInfo& setLayout, std::string* error);
+	// Every stage's push constant block has to be covered by ranges visible to that stage
+	static bool checkPushConstantRanges(const std::vector<const ShaderReflection*>& stages, const VkPipelineLayoutCreateInfo& pipelineLayout, std::string* error);
+	// Every vertex input needs an attribute of the same numeric type (float, int or uint)
+	static bool checkVertexInput(const ShaderReflection& vertexStage, const VkPipelineVertexInputStateCreateInfo& vertexInput, std::string* error);
+};
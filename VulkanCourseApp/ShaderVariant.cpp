@@ -0,0 +1,77 @@
+#include "ShaderVariant.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+ShaderVariant& ShaderVariant::set(uint32_t constantId, uint32_t value)
+{
+	auto it = std::lower_bound(m_Entries.begin(), m_Entries.end(), constantId,
+		[](const VkSpecializationMapEntry& entry, uint32_t id) { return entry.constantID < id; });
+
+	size_t index = it - m_Entries.begin();
+
+	if (it != m_Entries.end() && it->constantID == constantId)
+	{
+		m_Data[index] = value;
+		return *this;
+	}
+
+	VkSpecializationMapEntry entry = {};
+	entry.constantID = constantId;
+	entry.size = sizeof(uint32_t);
+
+	m_Entries.insert(it, entry);
+	m_Data.insert(m_Data.begin() + index, value);
+
+	// Entries after the new one moved up by one slot
+	for (size_t i = index; i < m_Entries.size(); i++)
+	{
+		m_Entries[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+	}
+
+	return *this;
+}
+
+ShaderVariant& ShaderVariant::set(uint32_t constantId, int32_t value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return set(constantId, bits);
+}
+
+ShaderVariant& ShaderVariant::set(uint32_t constantId, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return set(constantId, bits);
+}
+
+ShaderVariant& ShaderVariant::set(uint32_t constantId, bool value)
+{
+	return set(constantId, static_cast<uint32_t>(value ? VK_TRUE : VK_FALSE));
+}
+
+VkSpecializationInfo ShaderVariant::getSpecializationInfo() const
+{
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(m_Entries.size());
+	specializationInfo.pMapEntries = m_Entries.data();
+	specializationInfo.dataSize = m_Data.size() * sizeof(uint32_t);
+	specializationInfo.pData = m_Data.data();
+
+	return specializationInfo;
+}
+
+bool ShaderVariant::operator==(const ShaderVariant& other) const
+{
+	if (m_Data != other.m_Data || m_Entries.size() != other.m_Entries.size()) return false;
+
+	// Offsets and sizes follow from the order, only the IDs can differ
+	for (size_t i = 0; i < m_Entries.size(); i++)
+	{
+		if (m_Entries[i].constantID != other.m_Entries[i].constantID) return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+
+// Variant key of a shader stage: the values of its specialization constants (layout(constant_id = N) in GLSL).
+// Values are baked in when the pipeline is created, so the driver folds them and drops the dead branches,
+// unlike push constants or uniforms that are read on every invocation.
+// Every constant is a 32-bit scalar (bool, int, uint or float). Constants not set keep the default from the shader.
+// Two variants with the same constants compare equal, and PipelineRegistry keys pipelines on the same data,
+// so each variant is compiled once and shared.
+class ShaderVariant
+{
+public:
+	ShaderVariant() = default;
+
+	ShaderVariant& set(uint32_t constantId, uint32_t value);
+	ShaderVariant& set(uint32_t constantId, int32_t value);
+	ShaderVariant& set(uint32_t constantId, float value);
+	ShaderVariant& set(uint32_t constantId, bool value); // VkBool32, as expected for a GLSL bool
+
+	bool empty() const { return m_Entries.empty(); }
+
+	// Points into this variant, which has to stay alive (and unchanged) until the pipeline is created
+	VkSpecializationInfo getSpecializationInfo() const;
+
+	bool operator==(const ShaderVariant& other) const;
+	bool operator!=(const ShaderVariant& other) const { return !(*this == other); }
+
+private:
+	// Sorted by constantID, entry i is stored in m_Data[i]
+	std::vector<VkSpecializationMapEntry> m_Entries;
+	std::vector<uint32_t> m_Data;
+
+};
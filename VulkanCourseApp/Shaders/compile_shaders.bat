@@ -1,7 +1,15 @@
-D:/VulkanSDK/1.1.130.0/Bin32/glslangValidator.exe -o vert.spv -V shader.vert
+REM Offline build of the SPIR-V files. The renderer compiles the GLSL sources itself at startup (ShaderCompiler,
+REM cached in Shaders/cache/), these are only needed by code that still loads .spv files directly.
+D:/VulkanSDK/1.1.130.0/Bin32/glslangValidator.exe -o vert_push_constant.spv   -V -DOBJECT_DATA_PATH=0 shader.vert
+D:/VulkanSDK/1.1.130.0/Bin32/glslangValidator.exe -o vert_dynamic_uniform.spv -V -DOBJECT_DATA_PATH=1 shader.vert
+D:/VulkanSDK/1.1.130.0/Bin32/glslangValidator.exe -o vert_storage_buffer.spv  -V -DOBJECT_DATA_PATH=2 shader.vert
+D:/VulkanSDK/1.1.130.0/Bin32/glslangValidator.exe -o vert_push_constant_position_only.spv   -V -DOBJECT_DATA_PATH=0 -DPOSITION_ONLY=1 shader.vert
+D:/VulkanSDK/1.1.130.0/Bin32/glslangValidator.exe -o vert_dynamic_uniform_position_only.spv -V -DOBJECT_DATA_PATH=1 -DPOSITION_ONLY=1 shader.vert
+D:/VulkanSDK/1.1.130.0/Bin32/glslangValidator.exe -o vert_storage_buffer_position_only.spv  -V -DOBJECT_DATA_PATH=2 -DPOSITION_ONLY=1 shader.vert
 D:/VulkanSDK/1.1.130.0/Bin32/glslangValidator.exe -o frag.spv -V shader.frag
 
 D:/VulkanSDK/1.1.130.0/Bin32/glslangValidator.exe -o second_vert.spv -V second.vert
 D:/VulkanSDK/1.1.130.0/Bin32/glslangValidator.exe -o second_frag.spv -V second.frag
+D:/VulkanSDK/1.1.130.0/Bin32/glslangValidator.exe -o second_frag_sampled_scene.spv -V -DSAMPLED_SCENE=1 second.frag
 
 pause
@@ -1,39 +1,103 @@
 #version 450 // Use GLSL 4.5
 
-layout(input_attachment_index = 0, binding = 0) uniform subpassInput inputColor; // Color output from subpass 1
-layout(input_attachment_index = 1, binding = 1) uniform subpassInput inputDepth; // Depth output from subpass 1
+// SAMPLED_SCENE: dynamic resolution variant, the scene attachments are sampled and upscaled from the part the
+// geometry pass rendered to (separate render passes). Without it they are input attachments read at the same
+// pixel, in a subpass of the geometry pass's render pass.
+#ifndef SAMPLED_SCENE
+#define SAMPLED_SCENE 0
+#endif
 
-const int ViewportWidth = 1366; // TODO: expose as an uniform variable or a push constant
+#if SAMPLED_SCENE
+layout(set = 0, binding = 0) uniform sampler2D sceneColor; // Color output of the geometry pass
+layout(set = 0, binding = 1) uniform sampler2D sceneDepth; // Depth output of the geometry pass
+#else
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput inputColor; // Color output from the geometry subpass
+layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput inputDepth; // Depth output from the geometry subpass
+#endif
 
-//	layout (std140, binding = 1) uniform UniformVariables
-//	{
-//		int ViewportWidth;
-//	} uniformVariables;
+// Constant per pipeline, baked in with specialization constants (see ShaderVariant and
+// VulkanRenderer::ShadingOptions) instead of being pushed every frame
+layout(constant_id = 0) const float SplitFraction = 0.5;     // Left of the split shows color, right of it depth
+layout(constant_id = 1) const float DepthLowerBound = 0.98;  // Depth range mapped from white to black
+layout(constant_id = 2) const float DepthUpperBound = 1.0;
 
-layout(push_constant) uniform UniformVariables
+#if SAMPLED_SCENE
+// Changes every frame with dynamic resolution: the geometry pass only rendered to the top left
+// renderSize pixels of the scene attachments
+layout(push_constant) uniform Composite
 {
-	int ViewportWidth;
-} uniformVariables;
+	vec2 renderSize;
+} composite;
+#endif
 
+layout(location = 0) in vec2 fragScreenPos; // 0..1 across the viewport
 
 layout(location = 0) out vec4 color;
 
+#if SAMPLED_SCENE
+// Catmull-Rom upscale of the rendered region: the 4x4 texel neighbourhood in 9 bilinear taps (pairs of
+// the middle texels folded into one tap each). Taps are kept inside the rendered region.
+vec3 sampleSceneColor(vec2 pixel)
+{
+	vec2 textureSizeInv = 1.0 / vec2(textureSize(sceneColor, 0));
+	vec2 minPixel = vec2(0.5);
+	vec2 maxPixel = composite.renderSize - 0.5;
+
+	vec2 texel1 = floor(pixel - 0.5) + 0.5;
+	vec2 f = pixel - texel1;
+
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+	vec2 w12 = w1 + w2;
+	vec2 texel0 = clamp(texel1 - 1.0, minPixel, maxPixel) * textureSizeInv;
+	vec2 texel12 = clamp(texel1 + w2 / w12, minPixel, maxPixel) * textureSizeInv;
+	vec2 texel3 = clamp(texel1 + 2.0, minPixel, maxPixel) * textureSizeInv;
+
+	vec3 result = vec3(0.0);
+	result += texture(sceneColor, vec2(texel0.x,  texel0.y)).rgb  * w0.x  * w0.y;
+	result += texture(sceneColor, vec2(texel12.x, texel0.y)).rgb  * w12.x * w0.y;
+	result += texture(sceneColor, vec2(texel3.x,  texel0.y)).rgb  * w3.x  * w0.y;
+	result += texture(sceneColor, vec2(texel0.x,  texel12.y)).rgb * w0.x  * w12.y;
+	result += texture(sceneColor, vec2(texel12.x, texel12.y)).rgb * w12.x * w12.y;
+	result += texture(sceneColor, vec2(texel3.x,  texel12.y)).rgb * w3.x  * w12.y;
+	result += texture(sceneColor, vec2(texel0.x,  texel3.y)).rgb  * w0.x  * w3.y;
+	result += texture(sceneColor, vec2(texel12.x, texel3.y)).rgb  * w12.x * w3.y;
+	result += texture(sceneColor, vec2(texel3.x,  texel3.y)).rgb  * w3.x  * w3.y;
+
+	// The negative lobes can overshoot at hard edges
+	return max(result, vec3(0.0));
+}
+#endif
+
 void main()
 {
-	int xHalf = uniformVariables.ViewportWidth / 2;
+#if SAMPLED_SCENE
+	// Pixel of the rendered region under this fragment
+	vec2 pixel = fragScreenPos * composite.renderSize;
+#endif
 
-	if (gl_FragCoord.x > xHalf)
+	// Resolution independent, a resize keeps the pipeline
+	if (fragScreenPos.x > SplitFraction)
 	{
-		float lowerBound = 0.98;
-		float upperBound = 1.0;
-
+#if SAMPLED_SCENE
+		// Depth is not filtered (nearest texel, no linear filtering needed for the depth format)
+		float depth = texelFetch(sceneDepth, ivec2(min(pixel, composite.renderSize - 1.0)), 0).r;
+#else
 		float depth = subpassLoad(inputDepth).r;
-		float depthColorScaled = 1.0f - ((depth - lowerBound) / (upperBound - lowerBound));
+#endif
+		float depthColorScaled = 1.0f - ((depth - DepthLowerBound) / (DepthUpperBound - DepthLowerBound));
 
 		color = vec4(depthColorScaled, depthColorScaled, depthColorScaled, 1.0);
 	}
 	else
 	{
+#if SAMPLED_SCENE
+		color = vec4(sampleSceneColor(pixel), 1.0);
+#else
 		color = subpassLoad(inputColor).rgba;
+#endif
 	}
 }
@@ -8,7 +8,10 @@ vec2 positions[3] = vec2[]
 	vec2(-1.0,  3.0)
 );
 
+layout(location = 0) out vec2 fragScreenPos; // 0..1 across the viewport (used for the split in second.frag)
+
 void main()
 {
 	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+	fragScreenPos = positions[gl_VertexIndex] * 0.5 + 0.5;
 }
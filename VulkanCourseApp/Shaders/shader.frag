@@ -5,9 +5,19 @@ layout(location = 1) in vec2 fragTex;
 
 layout(set = 1, binding = 0) uniform sampler2D textureSampler;
 
+// Feature toggle baked in with a specialization constant (see ShaderVariant), the unused branch is dropped
+layout(constant_id = 0) const bool Textured = true; // Sample the model texture, or output the vertex color
+
 layout(location = 0) out vec4 outColor; // Final output color (must also have location)
 
 void main()
 {
-	outColor = texture(textureSampler, fragTex);
+	if (Textured)
+	{
+		outColor = texture(textureSampler, fragTex);
+	}
+	else
+	{
+		outColor = vec4(fragCol, 1.0);
+	}
 }
@@ -1,8 +1,22 @@
 #version 450 // Use GLSL 4.5
 
+// Per-object data path, selected at compile time (see compile_shaders.bat)
+// 0 = push constant, 1 = dynamic uniform buffer, 2 = storage buffer (default)
+#ifndef OBJECT_DATA_PATH
+#define OBJECT_DATA_PATH 2
+#endif
+
+// POSITION_ONLY: depth pre-pass variant, reads only the position stream (Mesh::getPositionBuffer)
+// and has no outputs besides gl_Position
+#ifndef POSITION_ONLY
+#define POSITION_ONLY 0
+#endif
+
 layout(location = 0) in vec3 pos;
+#if !POSITION_ONLY
 layout(location = 1) in vec3 col;
 layout(location = 2) in vec2 tex;
+#endif
 
 layout(set = 0, binding = 0) uniform UboViewProjection
 {
@@ -10,23 +24,45 @@ layout(set = 0, binding = 0) uniform UboViewProjection
 	mat4 view;
 } uboViewProjection;
 
-// Not in use, left for reference
+// Model matrix selected with a dynamic offset per model
 layout(set = 0, binding = 1) uniform UboModel
 {
 	mat4 model;
 } uboModel;
 
+// Model matrices of all objects for this frame, indexed with firstInstance of the draw
+layout(std430, set = 0, binding = 2) readonly buffer ObjectTransforms
+{
+	mat4 models[];
+} objectTransforms;
+
 layout(push_constant) uniform PushModel
 {
 	mat4 model;
 } pushModel;
 
+#if !POSITION_ONLY
 layout(location = 0) out vec3 fragCol;
 layout(location = 1) out vec2 fragTex;
+#endif
+
+// Same operations on the same inputs give the same depth in every variant, so the color pass can test
+// against the pre-pass depth with EQUAL
+invariant gl_Position;
 
 void main()
 {
-	gl_Position = uboViewProjection.projection * uboViewProjection.view * pushModel.model * vec4(pos, 1.0);
+#if OBJECT_DATA_PATH == 0
+	mat4 model = pushModel.model;
+#elif OBJECT_DATA_PATH == 1
+	mat4 model = uboModel.model;
+#else
+	mat4 model = objectTransforms.models[gl_InstanceIndex];
+#endif
+
+	gl_Position = uboViewProjection.projection * uboViewProjection.view * model * vec4(pos, 1.0);
+#if !POSITION_ONLY
 	fragCol = col;
 	fragTex = tex;
+#endif
 }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+
+// Bounded lock-free single-producer / single-consumer ring.
+// push() must only be called from one thread and pop() from one other thread, neither of them ever blocks.
+// Capacity must be a power of two, the indices run freely and are masked on access.
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+	SpscQueue() = default;
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Producer. Returns false (and leaves item untouched) if the queue is full.
+	bool push(T&& item)
+	{
+		size_t tail = m_Tail.load(std::memory_order_relaxed);
+
+		// Acquire: the consumer must be done moving out of the slot before it is overwritten
+		if (tail - m_Head.load(std::memory_order_acquire) == Capacity)
+		{
+			return false;
+		}
+
+		m_Items[tail & (Capacity - 1)] = std::move(item);
+
+		// Release: the item is fully written before the consumer can see it
+		m_Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer. Returns false if the queue is empty.
+	bool pop(T& item)
+	{
+		size_t head = m_Head.load(std::memory_order_relaxed);
+
+		if (head == m_Tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		item = std::move(m_Items[head & (Capacity - 1)]);
+
+		m_Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Approximate when called concurrently, exact from either side for its own view
+	size_t size() const { return m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_acquire); }
+	bool empty() const { return size() == 0; }
+
+private:
+	// Head and tail on separate cache lines, so producer and consumer do not invalidate each other's line.
+	// Padding instead of alignas, over-aligned types are not heap allocated correctly before C++17.
+	std::atomic<size_t> m_Head{ 0 }; // next slot the consumer reads
+	char m_PadHead[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> m_Tail{ 0 }; // next slot the producer writes
+	char m_PadTail[64 - sizeof(std::atomic<size_t>)];
+
+	std::array<T, Capacity> m_Items;
+
+};
@@ -1,8 +1,10 @@
 #include "SwapChain.h"
 
+#include "FrameReadback.h"
 #include "Utilities.h"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -12,8 +14,13 @@
 #include <stdexcept>
 
 
-SwapChain::SwapChain(std::shared_ptr<DeviceLVE> device, VkExtent2D extent, std::shared_ptr<SwapChain> previous, std::shared_ptr<WindowLVE> window)
-    : m_Device{ device }, m_WindowExtent{ extent }, m_SwapChainOld{ previous }, m_Window{ window }
+SwapChain::SwapChain(std::shared_ptr<DeviceLVE> device, VkExtent2D extent, std::shared_ptr<SwapChain> previous, std::shared_ptr<WindowLVE> window,
+    std::shared_ptr<FrameScheduler> frameScheduler, uint32_t framesInFlight, VkPresentModeKHR presentMode, uint32_t imageCount, bool transferSource,
+    bool sampledScene)
+    : m_Device{ device }, m_WindowExtent{ extent }, m_SwapChainOld{ previous }, m_Window{ window },
+    m_FrameScheduler{ frameScheduler }, m_FramesInFlight{ clampFramesInFlight(framesInFlight) },
+    m_RequestedPresentMode{ presentMode }, m_RequestedImageCount{ imageCount }, m_TransferSourceRequested{ transferSource },
+    m_SampledScene{ sampledScene }
 {
     init();
 
@@ -21,7 +28,32 @@ SwapChain::SwapChain(std::shared_ptr<DeviceLVE> device, VkExtent2D extent, std::
     m_SwapChainOld = nullptr;
 }
 
+uint32_t SwapChain::clampFramesInFlight(uint32_t count)
+{
+    if (count < MIN_FRAMES_IN_FLIGHT) return MIN_FRAMES_IN_FLIGHT;
+    if (count > MAX_FRAMES_IN_FLIGHT) return MAX_FRAMES_IN_FLIGHT;
+    return count;
+}
+
 void SwapChain::init()
+{
+    if (m_Device->isHeadless())
+    {
+        // No surface: offscreen color images take the place of the swapchain images
+        createOffscreenImages();
+    }
+    else
+    {
+        createSwapChainImages();
+    }
+
+    createRenderPass();
+    createAttachmentImages();
+    createFramebuffers();
+    createSyncObjects();
+}
+
+void SwapChain::createSwapChainImages()
 {
     // Get SwapChain details so we can pick best settings
     SwapChainDetails swapChainDetails = getSwapChainDetails();
@@ -34,8 +66,13 @@ void SwapChain::init()
     // 3. CHOOSE SWAP CHAIN RESOLUTION
     VkExtent2D extent = chooseSwapExtent(swapChainDetails.surfaceCapabilities);
 
-    // How many images are in the swap chain? Get 1 more than the minimum to allow triple buffering
+    // How many images are in the swap chain? By default get 1 more than the minimum to allow triple buffering,
+    // an explicitly requested count can not go below the minimum
     m_SwapChainImageCount = swapChainDetails.surfaceCapabilities.minImageCount + 1;
+    if (m_RequestedImageCount > 0)
+    {
+        m_SwapChainImageCount = std::max(m_RequestedImageCount, swapChainDetails.surfaceCapabilities.minImageCount);
+    }
 
     // If image count higher than max, then clamp down to max
     // If 0, then limitless
@@ -56,6 +93,12 @@ void SwapChain::init()
     swapChainCreateInfo.minImageCount = m_SwapChainImageCount;                                // Minimum images in swapchain
     swapChainCreateInfo.imageArrayLayers = 1;                                                 // Number of layers for each image in chain
     swapChainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;                     // What attachment images will be used as
+    // Copied from for frame readback, only when requested (and the surface allows it)
+    m_ImageTransferSource = m_TransferSourceRequested && (swapChainDetails.surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    if (m_ImageTransferSource)
+    {
+        swapChainCreateInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
     swapChainCreateInfo.preTransform = swapChainDetails.surfaceCapabilities.currentTransform; // Transform to perform to swap chain images
     swapChainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR; // How to handle blending images with external graphics (e.g. other windows)
     swapChainCreateInfo.clipped = VK_TRUE; // Whether to clip parts of image not in view (e.g. behind another window, off screen)
@@ -84,7 +127,7 @@ void SwapChain::init()
     }
 
     // If old swap chain been destroyed and this one replaces it, then link old one to quickly hand over responsibilities
-    swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+    swapChainCreateInfo.oldSwapchain = m_SwapChainOld != nullptr ? m_SwapChainOld->m_SwapchainKHR : VK_NULL_HANDLE;
 
     // Create Swapchain
     VkResult result = vkCreateSwapchainKHR(m_Device->device(), &swapChainCreateInfo, nullptr, &m_SwapchainKHR);
@@ -98,7 +141,10 @@ void SwapChain::init()
 
     printf("Vulkan Swapchain successfully created.\n");
 
+    printf("Present mode %s, %u images requested.\n", getPresentModeName(presentMode), m_SwapChainImageCount);
+
     // Store for later reference
+    m_PresentMode = presentMode;
     m_SwapChainImageFormat = surfaceFormat.format;
     m_SwapChainExtent = extent;
 
@@ -117,44 +163,110 @@ void SwapChain::init()
         m_SwapChainImages.push_back(image);
         m_SwapChainImageViews.push_back(imageView);
     }
+}
 
-    createRenderPass();
-    createColorBufferImage();
-    createDepthResources();
-    createFramebuffers();
-    createSyncObjects();
+void SwapChain::createOffscreenImages()
+{
+    // The format a surface would most likely have, if it can be rendered to and copied from (readback)
+    m_SwapChainImageFormat = chooseSupportedFormat(
+        { VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM },
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT);
+
+    // Nothing is presented, so nothing paces the frames but the GPU
+    m_SwapchainKHR = VK_NULL_HANDLE;
+    m_PresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    m_SwapChainExtent = m_WindowExtent;
+
+    // No presentation engine holds on to images, one per frame in flight is enough unless more are asked for
+    m_SwapChainImageCount = m_RequestedImageCount > 0 ? m_RequestedImageCount : m_FramesInFlight;
+    m_ImageTransferSource = true; // Always, the images end every frame in TRANSFER_SRC_OPTIMAL (nothing presents them)
+
+    for (uint32_t i = 0; i < m_SwapChainImageCount; i++)
+    {
+        VkImage image = createImage(m_SwapChainExtent.width, m_SwapChainExtent.height, m_SwapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+        VkMemoryRequirements memoryRequirements;
+        vkGetImageMemoryRequirements(m_Device->device(), image, &memoryRequirements);
+
+        VkMemoryAllocateInfo memoryAllocInfo = {};
+        memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memoryAllocInfo.allocationSize = memoryRequirements.size;
+        memoryAllocInfo.memoryTypeIndex = m_Device->findMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(m_Device->device(), &memoryAllocInfo, nullptr, &memory) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate memory for an offscreen image!");
+        }
+        vkBindImageMemory(m_Device->device(), image, memory, 0);
+
+        m_SwapChainImages.push_back(image);
+        m_SwapChainImageViews.push_back(createImageView(image, m_SwapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT));
+        m_OffscreenImageMemory.push_back(memory);
+    }
+
+    printf("Vulkan Offscreen Images successfully created: %u images %ux%u (headless, no swapchain).\n",
+        m_SwapChainImageCount, m_SwapChainExtent.width, m_SwapChainExtent.height);
 }
 
 VkResult SwapChain::acquireNextImage(uint32_t* imageIndex) {
-    vkWaitForFences(
-        m_Device->device(),
-        1,
-        &m_InFlightFences[currentFrame],
-        VK_TRUE,
-        std::numeric_limits<uint64_t>::max());
+    // The semaphores of this slot can be reused once its last submission has completed
+    VkResult result = m_FrameScheduler->waitForFrame(m_FrameSlotFrames[currentFrame]);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
 
-    VkResult result = vkAcquireNextImageKHR(
+    if (m_Device->isHeadless()) {
+        // Offscreen images in turn, submitCommandBuffers waits for the last frame rendered to the image
+        *imageIndex = m_NextOffscreenImage;
+        m_NextOffscreenImage = (m_NextOffscreenImage + 1) % getImageCount();
+        return VK_SUCCESS;
+    }
+
+    result = vkAcquireNextImageKHR(
         m_Device->device(),
         m_SwapchainKHR,
-        std::numeric_limits<uint64_t>::max(),
+        FrameScheduler::DEFAULT_WAIT_TIMEOUT_NS,
         m_ImageAvailableSemaphores[currentFrame],  // must be a not signaled semaphore
         VK_NULL_HANDLE,
         imageIndex);
 
+    if (result == VK_NOT_READY) {
+        result = VK_TIMEOUT;
+    }
+
     return result;
 }
 
-VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex)
+VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, uint64_t* submittedFrame)
 {
-    if (m_ImagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-        vkWaitForFences(m_Device->device(), 1, &m_ImagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-    }
-    
-    m_ImagesInFlight[*imageIndex] = m_InFlightFences[currentFrame];
+    // The per image attachments may still be in use by an older frame that rendered to this image.
+    // The image is already acquired and has to be presented, so this wait can not be skipped.
+    m_FrameScheduler->waitForFrame(m_ImageFrames[*imageIndex], UINT64_MAX);
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+    if (m_Device->isHeadless()) {
+        // Nothing to acquire or present: the timeline value is all there is to wait for
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = buffers;
+
+        uint64_t frame = m_FrameScheduler->submitFrame(m_Device->graphicsQueue(), submitInfo);
+        m_FrameSlotFrames[currentFrame] = frame;
+        m_ImageFrames[*imageIndex] = frame;
+
+        if (submittedFrame != nullptr) {
+            *submittedFrame = frame;
+        }
+
+        currentFrame = (currentFrame + 1) % m_FramesInFlight;
+
+        return VK_SUCCESS;
+    }
+
     VkSemaphore waitSemaphores[] = { m_ImageAvailableSemaphores[currentFrame] };
     VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
     submitInfo.waitSemaphoreCount = 1;
@@ -168,12 +280,13 @@ VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    vkResetFences(m_Device->device(), 1, &m_InFlightFences[currentFrame]);
-
-    VkResult result = vkQueueSubmit(m_Device->graphicsQueue(), 1, &submitInfo, m_InFlightFences[currentFrame]);
+    // Also signals the next timeline value, no fence needed
+    uint64_t frame = m_FrameScheduler->submitFrame(m_Device->graphicsQueue(), submitInfo);
+    m_FrameSlotFrames[currentFrame] = frame;
+    m_ImageFrames[*imageIndex] = frame;
 
-    if (result != VK_SUCCESS) {
-        throw std::runtime_error("Failed to submit draw command buffer!");
+    if (submittedFrame != nullptr) {
+        *submittedFrame = frame;
     }
 
     VkPresentInfoKHR presentInfo = {};
@@ -188,13 +301,18 @@ VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_
 
     presentInfo.pImageIndices = imageIndex;
 
-    result = vkQueuePresentKHR(m_Device->presentationQueue(), &presentInfo);
+    VkResult result = vkQueuePresentKHR(m_Device->presentationQueue(), &presentInfo);
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % m_FramesInFlight;
 
     return result;
 }
 
+bool SwapChain::isReadbackSupported()
+{
+    return m_ImageTransferSource && FrameReadback::isFormatSupported(m_SwapChainImageFormat);
+}
+
 SwapChain::SwapChainDetails SwapChain::getSwapChainDetails()
 {
     SwapChainDetails swapChainDetails;
@@ -257,111 +375,209 @@ VkSurfaceFormatKHR SwapChain::chooseBestSurfaceFormat(const std::vector<VkSurfac
     return formats[0];
 }
 
-void SwapChain::createColorBufferImage()
+void SwapChain::createAttachmentImages()
 {
-    // Resize supported format for color attachment
-    m_ColorBufferImages.resize(m_SwapChainImages.size());
-    m_ColorBufferImageMemory.resize(m_SwapChainImages.size());
-    m_ColorBufferImageViews.resize(m_SwapChainImages.size());
+    // One image per attachment, not per swapchain image: the render graph orders each frame's first use of an
+    // attachment's memory after the previous frame's uses (all frames go through the same queue)
+    for (RenderGraph::ResourceId attachment : { m_ColorAttachment, m_DepthAttachment })
+    {
+        AttachmentImage attachmentImage;
+        attachmentImage.attachment = attachment;
+        attachmentImage.image = createImage(m_SwapChainExtent.width, m_SwapChainExtent.height, m_RenderGraph->getAttachmentFormat(attachment),
+            VK_IMAGE_TILING_OPTIMAL,
+            m_RenderGraph->getAttachmentUsage(attachment)); // As used by the passes: rendered to, input attachment, transient
+        m_AttachmentImages.push_back(attachmentImage);
+    }
 
-    // Get supported format for color attachment
-    VkFormat colorBufferImageFormat = chooseSupportedFormat(
-        { VK_FORMAT_R8G8B8A8_UNORM }, // VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM
-        VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    std::vector<AttachmentMemory> memoryBlocks = planAttachmentMemory(m_AttachmentImages);
 
-    for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+    VkDeviceSize allocatedSize = 0;
+    VkDeviceSize lazySize = 0;
+    for (const AttachmentMemory& memoryBlock : memoryBlocks)
     {
-        // Create Color Buffer Image
-        m_ColorBufferImages[i] = createImage(m_SwapChainExtent.width, m_SwapChainExtent.height, colorBufferImageFormat,
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            &m_ColorBufferImageMemory[i]);
+        VkMemoryAllocateInfo memoryAllocInfo = {};
+        memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memoryAllocInfo.allocationSize = memoryBlock.size;
+        memoryAllocInfo.memoryTypeIndex = memoryBlock.memoryTypeIndex;
+
+        VkDeviceMemory memory;
+        VkResult result = vkAllocateMemory(m_Device->device(), &memoryAllocInfo, nullptr, &memory);
 
-        // Create Color Buffer Image View
-        m_ColorBufferImageViews[i] = createImageView(m_ColorBufferImages[i], colorBufferImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate memory for image!");
+        }
+
+        m_AttachmentMemory.push_back(memory);
+        allocatedSize += memoryBlock.size;
+        lazySize += memoryBlock.lazilyAllocated ? memoryBlock.size : 0;
     }
+
+    for (AttachmentImage& attachmentImage : m_AttachmentImages)
+    {
+        // Aliased images all start at the beginning of their block
+        vkBindImageMemory(m_Device->device(), attachmentImage.image, m_AttachmentMemory[attachmentImage.memory], 0);
+
+        VkImageAspectFlags aspect = attachmentImage.attachment == m_DepthAttachment ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        attachmentImage.imageView = createImageView(attachmentImage.image, m_RenderGraph->getAttachmentFormat(attachmentImage.attachment), aspect);
+    }
+
+    printf("Vulkan Attachment Memory successfully allocated: %i KiB in %i blocks (%i KiB lazily allocated) for %i attachments.\n",
+        (int)(allocatedSize / 1024), (int)memoryBlocks.size(), (int)(lazySize / 1024), (int)m_AttachmentImages.size());
+
+    reportAttachmentMemory();
 }
 
-void SwapChain::createDepthResources()
+std::vector<SwapChain::AttachmentMemory> SwapChain::planAttachmentMemory(std::vector<AttachmentImage>& images)
 {
-    m_DepthBufferImages.resize(m_SwapChainImages.size());
-    m_DepthBufferImageMemorys.resize(m_SwapChainImages.size());
-    m_DepthBufferImageViews.resize(m_SwapChainImages.size());
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(m_Device->getPhysicalDevice(), &memoryProperties);
 
-    // Get supported format for depth buffer
-    VkFormat depthBufferImageFormat = chooseSupportedFormat(
-        { VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT },
-        VK_IMAGE_TILING_OPTIMAL,
-        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    // Memory block of each render graph memory slot
+    std::vector<uint32_t> slotMemory(m_RenderGraph->getMemorySlotCount(), RenderGraph::NONE);
+    std::vector<AttachmentMemory> memoryBlocks;
 
-    for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+    for (AttachmentImage& attachmentImage : images)
     {
-        // Create Depth Buffer Image
-        m_DepthBufferImages[i] = createImage(m_SwapChainExtent.width, m_SwapChainExtent.height, depthBufferImageFormat,
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            &m_DepthBufferImageMemorys[i]);
+        VkMemoryRequirements memoryRequirements;
+        vkGetImageMemoryRequirements(m_Device->device(), attachmentImage.image, &memoryRequirements);
+
+        // Shares the block of its slot unless the images have no memory type in common
+        uint32_t slot = m_RenderGraph->getMemorySlot(attachmentImage.attachment);
+        uint32_t memory = slot != RenderGraph::NONE ? slotMemory[slot] : RenderGraph::NONE;
+        if (memory == RenderGraph::NONE || (memoryBlocks[memory].memoryTypeBits & memoryRequirements.memoryTypeBits) == 0)
+        {
+            memory = static_cast<uint32_t>(memoryBlocks.size());
+            memoryBlocks.push_back(AttachmentMemory());
+            memoryBlocks[memory].lazilyAllocated = true;
+
+            if (slot != RenderGraph::NONE) slotMemory[slot] = memory;
+        }
+
+        AttachmentMemory& memoryBlock = memoryBlocks[memory];
+        memoryBlock.size = std::max(memoryBlock.size, memoryRequirements.size);
+        memoryBlock.memoryTypeBits &= memoryRequirements.memoryTypeBits;
+        memoryBlock.lazilyAllocated = memoryBlock.lazilyAllocated && m_RenderGraph->isTransient(attachmentImage.attachment);
+        attachmentImage.memory = memory;
+    }
 
-        // Create Depth Buffer Image View
-        m_DepthBufferImageViews[i] = createImageView(m_DepthBufferImages[i], depthBufferImageFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+    for (AttachmentMemory& memoryBlock : memoryBlocks)
+    {
+        // Lazily allocated memory (tiled GPUs) if everything in the block is transient and the device has it
+        bool lazyTypeFound = false;
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && memoryBlock.lazilyAllocated; i++)
+        {
+            VkMemoryPropertyFlags lazyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+            if ((memoryBlock.memoryTypeBits & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & lazyFlags) == lazyFlags)
+            {
+                memoryBlock.memoryTypeIndex = i;
+                lazyTypeFound = true;
+                break;
+            }
+        }
+
+        memoryBlock.lazilyAllocated = lazyTypeFound;
+        if (!lazyTypeFound)
+        {
+            memoryBlock.memoryTypeIndex = findMemoryTypeIndex(m_Device->getPhysicalDevice(), memoryBlock.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
     }
+
+    return memoryBlocks;
 }
 
-void SwapChain::createFramebuffers()
+void SwapChain::reportAttachmentMemory()
 {
-    // Resize framebuffer count to equal swapchain image count
-    m_SwapChainFramebuffers.resize(m_SwapChainImages.size());
+    // Once per run: what the attachments cost at common resolutions against the former one color and depth image
+    // per swapchain image in plain device local memory
+    static bool reported = false;
+    if (reported) return;
+    reported = true;
 
-    // Create a framebuffer for each swapchain image
-    for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+    for (VkExtent2D extent : { VkExtent2D{ 1920, 1080 }, VkExtent2D{ 3840, 2160 } })
     {
-        std::array<VkImageView, 3> attachments =
+        std::vector<AttachmentImage> images;
+        VkDeviceSize perImageSize = 0;
+        for (const AttachmentImage& attachmentImage : m_AttachmentImages)
         {
-            m_SwapChainImageViews[i],
-            m_ColorBufferImageViews[i],
-            m_DepthBufferImageViews[i],
-        };
-
-        VkFramebufferCreateInfo framebufferCreateInfo = {};
-        framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferCreateInfo.renderPass = m_RenderPass;         // Render Pass layout the Framebuffer will be used with
-        framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        framebufferCreateInfo.pAttachments = attachments.data(); // List of attachments (1:1 with Render Pass)
-        framebufferCreateInfo.width = m_SwapChainExtent.width;     // Framebuffer width
-        framebufferCreateInfo.height = m_SwapChainExtent.height;   // Framebuffer height
-        framebufferCreateInfo.layers = 1;                        // Framebuffer layers
-
-        VkResult result = vkCreateFramebuffer(m_Device->device(), &framebufferCreateInfo, nullptr, &m_SwapChainFramebuffers[i]);
+            AttachmentImage image;
+            image.attachment = attachmentImage.attachment;
+            image.image = createImage(extent.width, extent.height, m_RenderGraph->getAttachmentFormat(image.attachment),
+                VK_IMAGE_TILING_OPTIMAL, m_RenderGraph->getAttachmentUsage(image.attachment));
+            images.push_back(image);
+
+            VkMemoryRequirements memoryRequirements;
+            vkGetImageMemoryRequirements(m_Device->device(), image.image, &memoryRequirements);
+            perImageSize += memoryRequirements.size;
+        }
 
-        printf("---- vkCreateFramebuffer m_SwapChainFramebuffers[i] SwapChain::createFramebuffers()\n");
+        VkDeviceSize committedSize = 0;
+        for (const AttachmentMemory& memoryBlock : planAttachmentMemory(images))
+        {
+            committedSize += memoryBlock.lazilyAllocated ? 0 : memoryBlock.size;
+        }
 
-        if (result != VK_SUCCESS)
+        for (const AttachmentImage& image : images)
         {
-            throw std::runtime_error("Failed to create a Framebuffer!");
+            vkDestroyImage(m_Device->device(), image.image, nullptr);
         }
 
-        printf("Vulkan Framebuffer successfully created.\n");
+        printf("Attachment memory at %ix%i: %.1f MiB before (%i swapchain images), %.1f MiB now (excluding lazily allocated).\n",
+            (int)extent.width, (int)extent.height, (double)(perImageSize * m_SwapChainImages.size()) / (1024.0 * 1024.0),
+            (int)m_SwapChainImages.size(), (double)committedSize / (1024.0 * 1024.0));
     }
 }
 
+SwapChain::AttachmentImage& SwapChain::getAttachmentImage(RenderGraph::ResourceId attachment)
+{
+    for (AttachmentImage& attachmentImage : m_AttachmentImages)
+    {
+        if (attachmentImage.attachment == attachment) return attachmentImage;
+    }
+
+    throw std::runtime_error("No image for render graph attachment!");
+}
+
+void SwapChain::createFramebuffers()
+{
+    // A framebuffer for each swapchain image (and render pass of the graph)
+    m_RenderGraph->createFramebuffers(static_cast<uint32_t>(m_SwapChainImages.size()), m_SwapChainExtent,
+        [this](RenderGraph::ResourceId attachment, uint32_t index)
+        {
+            if (attachment == m_SwapChainAttachment) return m_SwapChainImageViews[index];
+            return getAttachmentImage(attachment).imageView;
+        });
+}
+
 VkPresentModeKHR SwapChain::chooseBestPresentationMode(const std::vector<VkPresentModeKHR>& presentationModes)
 {
-    // Look for VK_PRESENT_MODE_MAILBOX_KHR
+    // Look for the requested mode (MAILBOX by default)
     for (const auto& presentationMode : presentationModes)
     {
-        if (presentationMode == VK_PRESENT_MODE_MAILBOX_KHR)
+        if (presentationMode == m_RequestedPresentMode)
         {
             return presentationMode;
         }
     }
 
+    printf("Present mode %s not supported by the surface, falling back to FIFO.\n", getPresentModeName(m_RequestedPresentMode));
+
     // If can't find, use FIFO as Vulkan spec says it must be present
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+const char* SwapChain::getPresentModeName(VkPresentModeKHR presentMode)
+{
+    switch (presentMode)
+    {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:    return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:      return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:         return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+    default:                               return "UNKNOWN";
+    }
+}
+
 VkFormat SwapChain::findDepthFormat()
 {
     return m_Device->findSupportedFormat(
@@ -438,156 +654,66 @@ VkImageView SwapChain::createImageView(VkImage image, VkFormat format, VkImageAs
 
 void SwapChain::createRenderPass()
 {
-    // Array of our subpasses
-    std::array<VkSubpassDescription, 2> subpasses = {};
-
-    // ATTACHMENTS
-
-    // -- SUBPASS 1 ATTACHMENTS + REFERENCES (INPUT ATTACHMENTS)
+    // The frame as a render graph: passes declare what they render to and read, the graph derives the render passes
+    // (load/store ops, layouts, dependencies). By default the composite pass reads the scene attachments as input
+    // attachments, the graph merges all passes into subpasses of one render pass and color/depth stay transient
+    // (tile memory only). Only with dynamic resolution the composite samples them to upscale, then the depth pre-pass
+    // and geometry pass get a render pass of their own and color/depth are stored in between.
+    m_RenderGraph = std::make_unique<RenderGraph>(m_Device->device());
 
-    // -- -- Color Attachment (Input Attachment)
     VkFormat colorBufferImageFormat = chooseSupportedFormat(
         { VK_FORMAT_R8G8B8A8_UNORM }, // VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM
         VK_IMAGE_TILING_OPTIMAL,
         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-    VkAttachmentDescription colorAttachment = {};
-    colorAttachment.format = colorBufferImageFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    // -- -- Depth Attachment (Input Attachment)
     VkFormat depthBufferImageFormat = chooseSupportedFormat(
         { VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT },
         VK_IMAGE_TILING_OPTIMAL,
-        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
-
-    VkAttachmentDescription depthAttachment = {};
-    depthAttachment.format = depthBufferImageFormat;
-    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    // -- -- Color Attachment (Input Attachment) Reference
-    VkAttachmentReference colorAttachmentReference = {};
-    colorAttachmentReference.attachment = 1; // ID of attachments array in createFramebuffers
-    colorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    // -- -- Depth Attachment (Input Attachment) Reference
-    VkAttachmentReference depthAttachmentReference = {};
-    depthAttachmentReference.attachment = 2; // ID of attachments array in createFramebuffers
-    depthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    // Set up Subpass 1
-    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpasses[0].colorAttachmentCount = 1;
-    subpasses[0].pColorAttachments = &colorAttachmentReference;
-    subpasses[0].pDepthStencilAttachment = &depthAttachmentReference;
-
-    // -- SUBPASS 2 ATTACHMENTS + REFERENCES (INPUT ATTACHMENTS)
-
-    // -- -- Swapchain Color Attachment
-    VkAttachmentDescription swapchainColorAttachment = {};
-    swapchainColorAttachment.format = m_SwapChainImageFormat;                     // Format to use for attachment
-    swapchainColorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;                   // Number of samples to write for multisampling
-    swapchainColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;              // Describes what to do with attachment before rendering
-    swapchainColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;            // Describes what to do with attachment after rendering
-    swapchainColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;   // Describes what to do with stencil before rendering
-    swapchainColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // Describes what to do with stencil after rendering
-
-    // Framebuffer data will be stored as an image, but images can be given different data layouts
-    // to give optimal use for certain operations
-    swapchainColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;         // Image data layout before Render Pass starts
-    swapchainColorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;     // Image data layout after Render Pass (to change to)
-
-    // Attachment reference uses an attachment index that refers to index in the attachment list passed to renderPassCreateInfo
-    VkAttachmentReference swapchainColorAttachmentReference = {};
-    swapchainColorAttachmentReference.attachment = 0; // First one from the render pass attachments list
-    swapchainColorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    // References to attachments that subpass will take input from
-    std::array<VkAttachmentReference, 2> inputReferences;
-    inputReferences[0].attachment = 1;
-    inputReferences[0].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    inputReferences[1].attachment = 2;
-    inputReferences[1].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    // Set up Subpass 2
-    subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpasses[1].colorAttachmentCount = 1;
-    subpasses[1].pColorAttachments = &swapchainColorAttachmentReference;
-    subpasses[1].inputAttachmentCount = static_cast<uint32_t>(inputReferences.size());
-    subpasses[1].pInputAttachments = inputReferences.data();
-
-    // SUBPASS DEPENDENCIES
-
-    // Need to determine when layout transitions occur using subpass dependencies
-    std::array<VkSubpassDependency, 3> subpassDependencies;
-
-    // Conversion from VK_IMAGE_LAYOUT_UNDEFINED (colorAttachment.initialLayout) to 
-    // VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL (colorAttachmentReference.layout)
-    // Transition must happen after:
-    subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL; // Subpass index (VK_SUBPASS_EXTERNAL = Special value meaning outside of Render Pass)
-    subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT; // Pipeline stage
-    subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;           // Stage access mask (memory access)
-    // But must happen before:
-    subpassDependencies[0].dstSubpass = 0; // First subpass (?)
-    subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subpassDependencies[0].dependencyFlags = 0;
-
-    // Subpass 1 layout (color/depth) to Subpass 2 layout
-    subpassDependencies[1].srcSubpass = 0;
-    subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subpassDependencies[1].dstSubpass = 1;
-    subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    subpassDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    subpassDependencies[1].dependencyFlags = 0;
-
-    // Conversion from VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL (colorAttachmentReference.layout) to 
-    // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR (colorAttachment.finalLayout)
-    // Transition must happen after:
-    subpassDependencies[2].srcSubpass = 0; // Subpass index
-    subpassDependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    // But must happen before:
-    subpassDependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
-    subpassDependencies[2].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    subpassDependencies[2].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    subpassDependencies[2].dependencyFlags = 0;
-
-    std::array<VkAttachmentDescription, 3> renderPassAttachments = { swapchainColorAttachment, colorAttachment, depthAttachment };
-
-    // Create info for Render Pass
-    VkRenderPassCreateInfo renderPassCreateInfo = {};
-    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(renderPassAttachments.size());
-    renderPassCreateInfo.pAttachments = renderPassAttachments.data();
-    renderPassCreateInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
-    renderPassCreateInfo.pSubpasses = subpasses.data();
-    renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
-    renderPassCreateInfo.pDependencies = subpassDependencies.data();
-
-    VkResult result = vkCreateRenderPass(m_Device->device(), &renderPassCreateInfo, nullptr, &m_RenderPass);
-
-    printf("---- vkCreateRenderPass m_RenderPass SwapChain::createRenderPass()\n");
-
-    if (result != VK_SUCCESS)
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | (m_SampledScene ? VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT : 0));
+
+    // -- ATTACHMENTS
+    VkClearValue swapchainClear = {};
+    swapchainClear.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+    VkClearValue colorClear = {};
+    colorClear.color = { 0.29f, 0.14f, 0.35f, 1.0f };
+
+    VkClearValue depthClear = {};
+    depthClear.depthStencil.depth = 1.0f;
+
+    // Swapchain image leaves the graph to be presented (headless: to be copied from), color and depth only live within the frame
+    m_ImageFinalLayout = m_Device->isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    m_SwapChainAttachment = m_RenderGraph->importAttachment("swapchain", m_SwapChainImageFormat, m_ImageFinalLayout, swapchainClear);
+    m_ColorAttachment = m_RenderGraph->createAttachment("color", colorBufferImageFormat, colorClear);
+    m_DepthAttachment = m_RenderGraph->createAttachment("depth", depthBufferImageFormat, depthClear);
+
+    // -- PASSES
+    // Models are recorded into secondary command buffers by the recording jobs.
+    // Depth only first, so the geometry pass shades each pixel once (depth test EQUAL). Merged into the geometry
+    // pass's render pass as its first subpass, which is simply left empty while the pre-pass is switched off.
+    m_DepthPrepass = m_RenderGraph->addPass("depth prepass", VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    m_RenderGraph->writeDepth(m_DepthPrepass, m_DepthAttachment);
+
+    m_GeometryPass = m_RenderGraph->addPass("geometry", VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    m_RenderGraph->writeColor(m_GeometryPass, m_ColorAttachment);
+    m_RenderGraph->writeDepth(m_GeometryPass, m_DepthAttachment);
+
+    // Fullscreen triangle showing color and depth side by side: the same pixel (input attachments), or with dynamic
+    // resolution upscaled from the part of the attachments the geometry pass rendered to (sampled)
+    m_CompositePass = m_RenderGraph->addPass("depth visualization");
+    if (m_SampledScene)
+    {
+        m_RenderGraph->readTexture(m_CompositePass, m_ColorAttachment);
+        m_RenderGraph->readTexture(m_CompositePass, m_DepthAttachment);
+    }
+    else
     {
-        throw std::runtime_error("Failed to create a Render Pass!");
+        m_RenderGraph->readInput(m_CompositePass, m_ColorAttachment);
+        m_RenderGraph->readInput(m_CompositePass, m_DepthAttachment);
     }
+    m_RenderGraph->writeColor(m_CompositePass, m_SwapChainAttachment);
 
-    printf("Vulkan Render Pass successfully created.\n");
+    m_RenderGraph->compile();
 }
 
 VkFormat SwapChain::chooseSupportedFormat(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags)
@@ -614,31 +740,32 @@ VkFormat SwapChain::chooseSupportedFormat(const std::vector<VkFormat>& formats,
 }
 
 void SwapChain::createSyncObjects() {
-    m_ImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_RenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_InFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    m_ImagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+    m_ImageAvailableSemaphores.resize(m_FramesInFlight);
+    m_RenderFinishedSemaphores.resize(m_FramesInFlight);
+
+    // Everything submitted before this swapchain existed counts as done for its slots and images
+    m_FrameSlotFrames.assign(m_FramesInFlight, m_FrameScheduler->getCompletedFrame());
+    m_ImageFrames.assign(imageCount(), m_FrameScheduler->getCompletedFrame());
+
+    // Headless submissions wait on nothing but the timeline
+    if (m_Device->isHeadless()) {
+        return;
+    }
 
     VkSemaphoreCreateInfo semaphoreInfo = {};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < m_FramesInFlight; i++) {
         if (vkCreateSemaphore(m_Device->device(), &semaphoreInfo, nullptr, &m_ImageAvailableSemaphores[i]) !=
             VK_SUCCESS ||
             vkCreateSemaphore(m_Device->device(), &semaphoreInfo, nullptr, &m_RenderFinishedSemaphores[i]) !=
-            VK_SUCCESS ||
-            vkCreateFence(m_Device->device(), &fenceInfo, nullptr, &m_InFlightFences[i]) != VK_SUCCESS) {
+            VK_SUCCESS) {
             throw std::runtime_error("failed to create synchronization objects for a frame!");
         }
     }
 }
 
-VkImage SwapChain::createImage(uint32_t width, uint32_t height, VkFormat format,
-    VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory* imageMemory)
+VkImage SwapChain::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags)
 {
     // CREATE IMAGE
     // Image Creation Info
@@ -669,30 +796,7 @@ VkImage SwapChain::createImage(uint32_t width, uint32_t height, VkFormat format,
 
     printf("Vulkan Image successfully created.\n");
 
-    // CREATE MEMORY FOR IMAGE
-
-    // Get memory requirements for a type of image
-    VkMemoryRequirements memoryRequirements;
-    vkGetImageMemoryRequirements(m_Device->device(), image, &memoryRequirements);
-
-    // Allocate memory using image requirements and user defined properties
-    VkMemoryAllocateInfo memoryAllocInfo = {};
-    memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memoryAllocInfo.allocationSize = memoryRequirements.size;
-    memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(m_Device->getPhysicalDevice(), memoryRequirements.memoryTypeBits, propFlags);
-
-    result = vkAllocateMemory(m_Device->device(), &memoryAllocInfo, nullptr, imageMemory);
-
-    if (result != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to allocate memory for image!");
-    }
-
-    printf("Vulkan Image Memory successfully allocated.\n");
-
-    // Connect memory to image
-    vkBindImageMemory(m_Device->device(), image, *imageMemory, 0);
-
+    // Memory is bound by the caller, aliased images share it
     return image;
 }
 
@@ -706,35 +810,33 @@ SwapChain::~SwapChain()
         vkDestroySemaphore(m_Device->device(), semaphore, nullptr);
     }
 
-    for (auto fence : m_InFlightFences) {
-        vkDestroyFence(m_Device->device(), fence, nullptr);
+    for (auto& attachmentImage : m_AttachmentImages) {
+        vkDestroyImageView(m_Device->device(), attachmentImage.imageView, nullptr);
+        vkDestroyImage(m_Device->device(), attachmentImage.image, nullptr);
     }
 
-    for (auto image : m_ColorBufferImages) {
-        vkDestroyImage(m_Device->device(), image, nullptr);
+    for (auto deviceMemory : m_AttachmentMemory) {
+        vkFreeMemory(m_Device->device(), deviceMemory, nullptr);
     }
 
-    for (auto image : m_DepthBufferImages) {
-        vkDestroyImage(m_Device->device(), image, nullptr);
-    }
+    // Also owns the render graph (render passes and framebuffers), the swapchain image views and the swapchain itself.
+    // Destroyed after its replacement was created from it (oldSwapchain), the GPU must be done with it.
+    m_RenderGraph.reset();
 
-    for (auto imageView : m_ColorBufferImageViews) {
+    for (auto imageView : m_SwapChainImageViews) {
         vkDestroyImageView(m_Device->device(), imageView, nullptr);
     }
 
-    for (auto imageView : m_DepthBufferImageViews) {
-        vkDestroyImageView(m_Device->device(), imageView, nullptr);
-    }
-
-    for (auto deviceMemory : m_ColorBufferImageMemory) {
-        vkFreeMemory(m_Device->device(), deviceMemory, nullptr);
-    }
-
-    for (auto deviceMemory : m_DepthBufferImageMemorys) {
-        vkFreeMemory(m_Device->device(), deviceMemory, nullptr);
+    // Headless: the images are ours, not the swapchain's
+    if (m_SwapchainKHR == VK_NULL_HANDLE) {
+        for (auto image : m_SwapChainImages) {
+            vkDestroyImage(m_Device->device(), image, nullptr);
+        }
+        for (auto deviceMemory : m_OffscreenImageMemory) {
+            vkFreeMemory(m_Device->device(), deviceMemory, nullptr);
+        }
+        return;
     }
 
-    for (auto framebuffer : m_SwapChainFramebuffers) {
-        vkDestroyFramebuffer(m_Device->device(), framebuffer, nullptr);
-    }
+    vkDestroySwapchainKHR(m_Device->device(), m_SwapchainKHR, nullptr);
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "DeviceLVE.h"
+#include "FrameScheduler.h"
+#include "RenderGraph.h"
 
 #include <vulkan/vulkan.h>
 
@@ -20,40 +22,86 @@ public:
     };
 
 public:
-    static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-    SwapChain(std::shared_ptr<DeviceLVE> device, VkExtent2D extent, std::shared_ptr<SwapChain> previous, std::shared_ptr<WindowLVE> window);
+    // Frames the CPU may record ahead of the GPU, chosen at runtime within these bounds
+    static constexpr uint32_t MIN_FRAMES_IN_FLIGHT = 1;
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+    static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+    static uint32_t clampFramesInFlight(uint32_t count);
+
+    static const char* getPresentModeName(VkPresentModeKHR presentMode);
+
+    SwapChain(std::shared_ptr<DeviceLVE> device, VkExtent2D extent, std::shared_ptr<SwapChain> previous, std::shared_ptr<WindowLVE> window,
+        std::shared_ptr<FrameScheduler> frameScheduler, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT,
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR, uint32_t imageCount = 0, bool transferSource = false,
+        bool sampledScene = false);
     ~SwapChain();
 
     void init();
 
     VkExtent2D getSwapChainExtent() { return m_SwapChainExtent; }
-    VkResult acquireNextImage(uint32_t* imageIndex);
-    VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+    VkResult acquireNextImage(uint32_t* imageIndex); // VK_TIMEOUT if the frame slot or an image did not free up in time
+    VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, uint64_t* submittedFrame = nullptr);
+    uint32_t getFramesInFlight() { return m_FramesInFlight; }
+    VkPresentModeKHR getPresentMode() { return m_PresentMode; } // mode actually in use (the requested one may be unsupported)
+    uint32_t getImageCount() { return static_cast<uint32_t>(m_SwapChainImages.size()); }
+    uint32_t getCurrentFrame() { return static_cast<uint32_t>(currentFrame); } // frame-in-flight used by the next acquire/submit
     VkSwapchainKHR& getSwapChainKHR() { return m_SwapchainKHR; }
     std::vector<VkImage>& getSwapChainImages() { return m_SwapChainImages; }
     std::vector<VkImageView>& getSwapChainImageViews() { return m_SwapChainImageViews; }
     VkFormat getSwapChainImageFormat() { return m_SwapChainImageFormat; }
+    VkImageLayout getImageFinalLayout() { return m_ImageFinalLayout; } // Layout the images are left in at the end of a frame
+    bool isReadbackSupported();                                        // Images can be copied from (FrameReadback)
+    bool isTransferSourceRequested() { return m_TransferSourceRequested; }
+    // The composite pass samples color and depth (dynamic resolution) instead of reading them as input attachments
+    bool isSceneSampled() { return m_SampledScene; }
     SwapChainDetails getSwapChainDetails();
-    VkRenderPass& getRenderPass() { return m_RenderPass; }
-    VkFramebuffer& getFrameBuffer(int index) { return m_SwapChainFramebuffers[index]; }
-    std::vector<VkFramebuffer>& getFrameBuffers() { return m_SwapChainFramebuffers; }
+    // Render passes and framebuffers (one per swapchain image) of the frame's passes
+    RenderGraph& getRenderGraph() { return *m_RenderGraph; }
+    RenderGraph::PassId getDepthPrepass() { return m_DepthPrepass; }   // Models into the depth attachment only (optional, may stay empty)
+    RenderGraph::PassId getGeometryPass() { return m_GeometryPass; }   // Models into the color and depth attachments
+    RenderGraph::PassId getCompositePass() { return m_CompositePass; } // Color/depth visualization into the swapchain image
+    VkImageLayout getColorBufferReadLayout() { return m_RenderGraph->getReadLayout(m_ColorAttachment); }
+    VkImageLayout getDepthBufferReadLayout() { return m_RenderGraph->getReadLayout(m_DepthAttachment); }
     VkFormat findDepthFormat();
     VkFormat chooseSupportedFormat(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags);
-    std::vector<VkImageView>& getColorBufferImageViews() { return m_ColorBufferImageViews; }
-    std::vector<VkImageView>& getDepthBufferImageViews() { return m_DepthBufferImageViews; }
+    // One color and depth image shared by every swapchain image and frame in flight (the render graph orders each
+    // frame's use after the previous one's)
+    VkImageView getColorBufferImageView() { return getAttachmentImage(m_ColorAttachment).imageView; }
+    VkImageView getDepthBufferImageView() { return getAttachmentImage(m_DepthAttachment).imageView; }
+
+private:
+    // Image of a render graph attachment, bound to one of the attachment memory blocks
+    struct AttachmentImage
+    {
+        RenderGraph::ResourceId attachment;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        uint32_t memory = 0; // Index into the memory blocks
+    };
+
+    // Memory shared by the attachments of one render graph memory slot
+    struct AttachmentMemory
+    {
+        VkDeviceSize size = 0;
+        uint32_t memoryTypeBits = ~0u;
+        uint32_t memoryTypeIndex = 0;
+        bool lazilyAllocated = false; // Only transient attachments: tile memory only, may never be committed
+    };
 
 private:
     VkSurfaceFormatKHR chooseBestSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& formats);
     VkPresentModeKHR chooseBestPresentationMode(const std::vector<VkPresentModeKHR>& presentationModes);
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities);
     VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+    void createSwapChainImages();
+    void createOffscreenImages(); // Headless: own images in place of the swapchain's, nothing is presented
     size_t imageCount() { return m_SwapChainImages.size(); }
-    VkImage createImage(uint32_t width, uint32_t height, VkFormat format,
-        VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory* imageMemory);
+    VkImage createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags);
     void createRenderPass();
-    void createColorBufferImage();
-    void createDepthResources();
+    void createAttachmentImages();
+    std::vector<AttachmentMemory> planAttachmentMemory(std::vector<AttachmentImage>& images);
+    void reportAttachmentMemory();
+    AttachmentImage& getAttachmentImage(RenderGraph::ResourceId attachment);
     void createFramebuffers();
     void createSyncObjects();
 
@@ -62,37 +110,49 @@ private:
     VkExtent2D m_WindowExtent;
     std::shared_ptr<SwapChain> m_SwapChainOld;
     std::shared_ptr<WindowLVE> m_Window; // lveWindow
+    std::shared_ptr<FrameScheduler> m_FrameScheduler;
 
-    VkSwapchainKHR m_SwapchainKHR;
+    VkSwapchainKHR m_SwapchainKHR = VK_NULL_HANDLE; // Stays VK_NULL_HANDLE when headless
     VkFormat m_SwapChainImageFormat;
     VkFormat m_SwapChainDepthFormat;
     VkExtent2D m_SwapChainExtent;
+    VkImageLayout m_ImageFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    bool m_ImageTransferSource = false;
 
-    std::vector<VkFramebuffer> m_SwapChainFramebuffers;
-    VkRenderPass m_RenderPass;
+    std::unique_ptr<RenderGraph> m_RenderGraph;
+    RenderGraph::ResourceId m_SwapChainAttachment;
+    RenderGraph::ResourceId m_ColorAttachment;
+    RenderGraph::ResourceId m_DepthAttachment;
+    RenderGraph::PassId m_DepthPrepass;
+    RenderGraph::PassId m_GeometryPass;
+    RenderGraph::PassId m_CompositePass;
 
     SwapChainDetails m_SwapChainDetails;
 
     size_t currentFrame = 0;
+    uint32_t m_FramesInFlight;
+
+    VkPresentModeKHR m_RequestedPresentMode;
+    uint32_t m_RequestedImageCount; // 0 = minImageCount + 1
+    bool m_TransferSourceRequested; // Swapchain images get TRANSFER_SRC usage (only for readback, it can cost compression)
+    bool m_SampledScene;            // Composite pass in a render pass of its own, scene attachments stored and sampled
+    VkPresentModeKHR m_PresentMode;
 
     uint32_t m_SwapChainImageCount;
 
     std::vector<VkImage> m_SwapChainImages;
     std::vector<VkImageView> m_SwapChainImageViews;
+    std::vector<VkDeviceMemory> m_OffscreenImageMemory; // Headless only, one per image
+    uint32_t m_NextOffscreenImage = 0;
 
-    std::vector<VkImage> m_ColorBufferImages;
-    std::vector<VkDeviceMemory> m_ColorBufferImageMemory;
-    std::vector<VkImageView> m_ColorBufferImageViews;
-
-    // framebuffers / depth resources
-    std::vector<VkImage> m_DepthBufferImages;
-    std::vector<VkDeviceMemory> m_DepthBufferImageMemorys;
-    std::vector<VkImageView> m_DepthBufferImageViews;
+    // Color and depth attachments, aliased where the render graph allows it
+    std::vector<AttachmentImage> m_AttachmentImages;
+    std::vector<VkDeviceMemory> m_AttachmentMemory;
 
-    // synchronization
+    // synchronization, binary semaphores only for acquire/present, GPU progress is tracked on the FrameScheduler timeline
     std::vector<VkSemaphore> m_ImageAvailableSemaphores;
     std::vector<VkSemaphore> m_RenderFinishedSemaphores;
-    std::vector<VkFence> m_InFlightFences;
-    std::vector<VkFence> m_ImagesInFlight;
+    std::vector<uint64_t> m_FrameSlotFrames; // per frame in flight: timeline value of its last submission
+    std::vector<uint64_t> m_ImageFrames;     // per swapchain image: timeline value of the last frame rendered to it
 
 };
@@ -201,12 +201,8 @@ static void copyBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool tra
 	endAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
 }
 
-static void copyImageBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool,
-	VkBuffer srcBuffer, VkImage dstImage, uint32_t width, uint32_t height)
+static void recordCopyImageBuffer(VkCommandBuffer transferCommandBuffer, VkBuffer srcBuffer, VkImage dstImage, uint32_t width, uint32_t height)
 {
-	// Create buffer
-	VkCommandBuffer transferCommandBuffer = beginCommandBuffer(device, transferCommandPool);
-
 	VkBufferImageCopy imageRegion = {};
 	imageRegion.bufferOffset = 0;                                        // Offset into data
 	imageRegion.bufferRowLength = 0;                                     // Row length of data to calculate data spacing
@@ -220,15 +216,21 @@ static void copyImageBuffer(VkDevice device, VkQueue transferQueue, VkCommandPoo
 
 	// Command to copy src buffer to given dst image
 	vkCmdCopyBufferToImage(transferCommandBuffer, srcBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageRegion);
-
-	endAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
 }
 
-static void transitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool commandPool, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
+static void copyImageBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool,
+	VkBuffer srcBuffer, VkImage dstImage, uint32_t width, uint32_t height)
 {
 	// Create buffer
-	VkCommandBuffer commandBuffer = beginCommandBuffer(device, commandPool);
+	VkCommandBuffer transferCommandBuffer = beginCommandBuffer(device, transferCommandPool);
 
+	recordCopyImageBuffer(transferCommandBuffer, srcBuffer, dstImage, width, height);
+
+	endAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
+}
+
+static void recordTransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
 	VkImageMemoryBarrier imageMemoryBarrier = {};
 	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	imageMemoryBarrier.oldLayout = oldLayout;                                   // Layout to transition FROM
@@ -271,6 +273,14 @@ static void transitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool
 		0, nullptr,            // Buffer Memory Barrier count + data
 		1, &imageMemoryBarrier // Image Memory Barrier count + data
 	);
+}
+
+static void transitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool commandPool, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+	// Create buffer
+	VkCommandBuffer commandBuffer = beginCommandBuffer(device, commandPool);
+
+	recordTransitionImageLayout(commandBuffer, image, oldLayout, newLayout);
 
 	endAndSubmitCommandBuffer(device, commandPool, queue, commandBuffer);
 }
@@ -8,14 +8,57 @@
 #include "assimp/postprocess.h"
 
 #include <stdexcept>
+#include <cassert>
 #include <set>
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <thread>
 
 
-VulkanRenderer::VulkanRenderer(std::shared_ptr<WindowLVE> window)
-	: m_Window{ window }
+// Assimp import of one model file. Parsing is CPU only, so it runs as a job while the simulation and the render
+// thread carry on. The render thread waits for the job when it consumes the model load and does the GPU upload.
+struct MeshModelImport
 {
+	std::string fileName;
+	Assimp::Importer importer; // Owns scene
+	const aiScene* scene = nullptr;
+	std::vector<std::string> textureNames; // Materials with 1:1 ID placement
+	JobSystem::JobHandle job;
+};
+
+// The layouts below are written by hand, the shaders' reflection tells when they drift apart.
+// Only reported: the validation layers (when enabled) name the exact call that breaks.
+static void reportShaderMismatch(bool matches, const char* what, const std::string& error)
+{
+	if (!matches)
+	{
+		printf("Shader interface mismatch (%s): %s\n", what, error.c_str());
+	}
+}
+
+const char* getObjectDataPathName(ObjectDataPath path)
+{
+	switch (path)
+	{
+	case ObjectDataPath::PushConstant:   return "Push Constant";
+	case ObjectDataPath::DynamicUniform: return "Dynamic Uniform Buffer";
+	case ObjectDataPath::StorageBuffer:  return "Storage Buffer";
+	}
+
+	return "Unknown";
+}
+
+VulkanRenderer::VulkanRenderer(std::shared_ptr<WindowLVE> window, std::shared_ptr<JobSystem> jobSystem)
+	: m_Window{ window }, m_JobSystem{ jobSystem }
+{
+	// One 1st subpass recording job per thread that can pick one up
+	recordingJobCount = m_JobSystem->getThreadCount();
+	m_JobCommandStates.resize(recordingJobCount);
+	m_JobDrawStats.resize(recordingJobCount * 2);
+
+	importLane = m_JobSystem->createLane("Model import");
+	compileLane = m_JobSystem->createLane("Pipeline compile");
 }
 
 int VulkanRenderer::init()
@@ -25,11 +68,35 @@ int VulkanRenderer::init()
 		createInstance();
 		createDebugCallback();
 		createDevice();
+		allocateDynamicBufferTransferSpace();
+
+		m_FrameScheduler = std::make_shared<FrameScheduler>(m_Device);
+
+		// Live for the whole renderer, unlike the per swapchain image allocators
+		m_DescriptorLayoutCache = std::make_unique<DescriptorLayoutCache>(m_Device);
+		m_DescriptorAllocator = std::make_unique<DescriptorAllocator>(m_Device);
+
 		createShaders();
+
+		// Policy and shading options requested before init (command line)
+		applyLatencyPolicy();
+		applyShadingOptions();
 		// createSurface();
 		// getPhysicalDevice();
 		// createLogicalDevice();
-		recreateSwapChain();
+
+		// Size independent resources are created once, a resize only rebuilds the swapchain (see recreateSwapChain).
+		// The readback first: the swapchain images only get TRANSFER_SRC usage if they are read back.
+		createFrameReadback();
+		sceneSampled = dynamicResolution.getSettings().enabled;
+		m_SwapChain = std::make_unique<SwapChain>(m_Device, m_Window->getExtent(), nullptr, m_Window, m_FrameScheduler, framesInFlight,
+			latencyPolicy.presentMode, latencyPolicy.swapchainImageCount, m_FrameReadback != nullptr, sceneSampled);
+		reportReadbackSupport();
+		createDescriptorSetLayout();
+		createPushConstantRange();
+		createGraphicsPipeline();
+		createTextureSampler();
+		createFrameResources();
 		// createRenderPass();
 		// createDescriptorSetLayout();
 		// createPushConstantRange();
@@ -40,21 +107,15 @@ int VulkanRenderer::init()
 		// createCommandPool();
 		// createCommandBuffers();
 		// createTextureSampler();
-		// allocateDynamicBufferTransferSpace();
 		// createUniformBuffers();
 		// createDescriptorPool();
 		// createDescriptorSets();
 		// createInputDescriptorSets();
 		// createSynchronization();
 
-		float aspectRatio = (float)m_SwapChain->getSwapChainExtent().width / (float)m_SwapChain->getSwapChainExtent().height;
-
-		uboViewProjection.projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 100.f);
+		updateProjection();
 		uboViewProjection.view = glm::lookAt(glm::vec3(0.0f, 25.0f, 25.0f), glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
-		// Vulkan inverts Y axis
-		uboViewProjection.projection[1][1] *= -1;
-
 		// Create our default "no texture" texture
 		createTexture("plain.png");
 	}
@@ -100,22 +161,183 @@ void VulkanRenderer::drawFrameLVE()
 
 void VulkanRenderer::updateModel(int modelId, glm::mat4 newModel)
 {
-	if (modelId >= modelList.size()) return;
+	if (modelId < 0 || modelId >= (int)producerSnapshot.modelTransforms.size()) return;
+
+	producerSnapshot.modelTransforms[modelId] = newModel;
+}
+
+void VulkanRenderer::setModelVisible(int modelId, bool visible)
+{
+	if (modelId < 0 || modelId >= (int)producerSnapshot.modelVisibility.size()) return;
 
-	modelList[modelId].setModel(newModel);
+	producerSnapshot.modelVisibility[modelId] = visible;
 }
 
 void VulkanRenderer::update(float deltaTime, std::shared_ptr<Camera> camera)
 {
-	uboViewProjection.view = camera->GetViewMatrix();
+	producerSnapshot.view = camera->GetViewMatrix();
+	producerSnapshot.hasView = true;
 	// uboViewProjection.view = glm::translate(uboViewProjection.view, glm::vec3(0, 0, -0.01f));
 	// uboViewProjection.view = glm::lookAt(glm::vec3(0.0f, 25.0f, 25.0f), glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 }
 
+void VulkanRenderer::publishSnapshot()
+{
+	producerSnapshot.sequence++;
+	producerSnapshot.publishTime = std::chrono::steady_clock::now();
+
+	// Copy, the producer keeps its transforms and camera for the next tick. Once pushed the copy belongs to the render thread.
+	SceneSnapshot snapshot = producerSnapshot;
+
+	if (snapshotQueue.push(std::move(snapshot)))
+	{
+		producerSnapshot.modelLoads.clear();
+	}
+	// else: queue full, the render thread is stalled. The pending model loads stay in producerSnapshot.
+}
+
+bool VulkanRenderer::consumeSnapshots()
+{
+	SceneSnapshot snapshot;
+	bool consumed = false;
+
+	while (snapshotQueue.pop(snapshot))
+	{
+		// Structural changes of every snapshot, in order, so model ids line up with modelList
+		for (const auto& modelLoad : snapshot.modelLoads)
+		{
+			int modelId = loadMeshModel(modelLoad);
+
+			if (modelId != modelLoad.modelId)
+			{
+				throw std::runtime_error("Model id mismatch while loading " + modelLoad.fileName + "!");
+			}
+		}
+
+		consumed = true;
+	}
+
+	if (!consumed) return false;
+
+	// Transforms and camera from the newest snapshot only, older states are simply skipped
+	size_t modelCount = std::min(modelList.size(), snapshot.modelTransforms.size());
+	for (size_t i = 0; i < modelCount; i++)
+	{
+		modelList[i].setModel(snapshot.modelTransforms[i]);
+		modelList[i].setVisible(snapshot.modelVisibility[i]);
+	}
+
+	if (snapshot.hasView)
+	{
+		uboViewProjection.view = snapshot.view;
+	}
+
+	consumedSequence = snapshot.sequence;
+	consumedPublishTime = snapshot.publishTime;
+
+	return true;
+}
+
+void VulkanRenderer::sampleScene(std::chrono::steady_clock::time_point* inputTime)
+{
+	// Single threaded: the owner polls input and publishes a snapshot right here (test hooks use it on the render thread)
+	if (inputSampler)
+	{
+		inputSampler();
+	}
+
+	consumeSnapshots();
+
+	// The input that reaches this frame is the one sampled when the newest snapshot was published
+	*inputTime = consumedSequence > 0 ? consumedPublishTime : std::chrono::steady_clock::now();
+}
+
 void VulkanRenderer::draw()
 {
+	applyLatencyPolicy();
+	applyShadingOptions();
+
+	// Frame-rate cap, pace the start of each frame
+	if (latencyPolicy.frameRateCap > 0.0f)
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (now < nextFrameStart)
+		{
+			std::this_thread::sleep_until(nextFrameStart);
+		}
+		auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / latencyPolicy.frameRateCap));
+		nextFrameStart = std::max(nextFrameStart, now) + period;
+	}
+
+	updateResizeBenchmark();
+
+	// Coalesce bursts of resize events: every event restarts the timer, the swapchain is recreated
+	// once the window has settled. Until then the old swapchain keeps presenting (possibly suboptimal).
+	auto now = std::chrono::steady_clock::now();
+	if (m_Window->wasWindowResized())
+	{
+		m_Window->resetWindowResizedFlag();
+		resizePending = true;
+		lastResizeEvent = now;
+	}
+
+	// Headless resizes are requested by code (one per batch job), not dragged: nothing to coalesce
+	bool resizeSettled = resizePending &&
+		(m_Window->isHeadless() || std::chrono::duration<double, std::milli>(now - lastResizeEvent).count() >= RESIZE_COALESCE_MS);
+
+	// Readback set up while running (capture started): its copies need a swapchain recreated with TRANSFER_SRC images
+	if (readbackRequested)
+	{
+		createFrameReadback();
+		if (m_FrameReadback != nullptr && !m_SwapChain->isTransferSourceRequested())
+		{
+			swapChainPolicyChanged = true;
+		}
+	}
+
+	// Dynamic resolution switched on or off: the render graph is laid out for it (sampled composite) or not
+	if (dynamicResolution.getSettings().enabled != sceneSampled)
+	{
+		swapChainPolicyChanged = true;
+	}
+
+	if (swapChainPolicyChanged || resizeSettled)
+	{
+		recreateSwapChain();
+	}
+
+	std::chrono::steady_clock::time_point inputTime = std::chrono::steady_clock::now();
+	if (!latencyPolicy.justInTimeInput)
+	{
+		sampleScene(&inputTime);
+	}
+
+	uint32_t frameIndex = m_SwapChain->getCurrentFrame();
+	FrameContext& frame = frames[frameIndex];
+
+	auto waitStart = std::chrono::steady_clock::now();
+
+	// The FrameContext is free to reuse once the last frame recorded with it has completed on the GPU.
+	// Waits are bounded, on a timeout the frame is skipped and tried again on the next loop iteration.
+	auto result = m_FrameScheduler->waitForFrame(frame.lastFrame);
+	if (result == VK_TIMEOUT) {
+		return;
+	}
+
 	uint32_t imageIndex;
-	auto result = m_SwapChain->acquireNextImage(&imageIndex);
+	result = m_SwapChain->acquireNextImage(&imageIndex);
+
+	if (result == VK_TIMEOUT) {
+		return;
+	}
+
+	lastFrameLatency.acquireWaitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+
+	// Just-in-time input: the slot is free, so the input sampled (or snapshot taken) now makes it to the GPU with the least delay
+	if (latencyPolicy.justInTimeInput)
+	{
+		sampleScene(&inputTime);
+	}
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 		recreateSwapChain();
@@ -126,17 +348,62 @@ void VulkanRenderer::draw()
 		throw std::runtime_error("Failed to acquire swap chain image!");
 	}
 
-	recordCommands(imageIndex);
-	updateUniformBuffers(imageIndex);
+	// Read back the GPU time of the previous submission of this frame before its command buffer is re-recorded
+	collectGpuTime(frameIndex);
 
-	result = m_SwapChain->submitCommandBuffers(&commandBuffers[imageIndex], &imageIndex);
+	// Resolution the scene is rendered at this frame, from the GPU times so far
+	// (full resolution unless the render graph is laid out for dynamic resolution, input attachments read the same pixel)
+	frame.renderExtent = sceneSampled ? dynamicResolution.getRenderExtent(m_SwapChain->getSwapChainExtent()) : m_SwapChain->getSwapChainExtent();
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_Window->wasWindowResized()) {
-		m_Window->resetWindowResizedFlag();
+	// Every command buffer of this frame is done. Recycle them all in one go
+	// and take the primary buffer linearly from the start of the pool again
+	for (auto& commandPool : frame.commandPools)
+	{
+		commandPool->reset();
+	}
+	frame.commandBuffer = frame.commandPools[0]->allocate(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+	createFrameDescriptorSets(frameIndex);
+
+	// Pipelines finished in the background are picked up between frames
+	updatePipelineRequests();
+
+	auto recordStart = std::chrono::high_resolution_clock::now();
+
+	recordCommands(frameIndex, imageIndex);
+	updateUniformBuffers(frameIndex);
+
+	double recordCpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+	lastFrameStats.recordCpuMs = recordCpuMs;
+	updateObjectDataBenchmark(frameIndex, recordCpuMs);
+
+	result = m_SwapChain->submitCommandBuffers(&frame.commandBuffer, &imageIndex, &frame.lastFrame);
+
+	renderedFrames++;
+
+	// Present happens right after submit, so the submit time is the closest CPU-side end point
+	lastFrameLatency.inputToSubmitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inputTime).count();
+
+	latencyTotals.frames++;
+	latencyTotals.acquireWaitMs += lastFrameLatency.acquireWaitMs;
+	latencyTotals.acquireWaitMaxMs = std::max(latencyTotals.acquireWaitMaxMs, lastFrameLatency.acquireWaitMs);
+	latencyTotals.inputToSubmitMs += lastFrameLatency.inputToSubmitMs;
+	latencyTotals.inputToSubmitMaxMs = std::max(latencyTotals.inputToSubmitMaxMs, lastFrameLatency.inputToSubmitMs);
+
+	// Out of date can not be presented any more, recreate right away. Suboptimal still works and waits for the resize to settle.
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 		recreateSwapChain();
 		return;
 	}
 
+	if (result == VK_SUBOPTIMAL_KHR) {
+		if (!resizePending) {
+			resizePending = true;
+			lastResizeEvent = std::chrono::steady_clock::now();
+		}
+		return;
+	}
+
 	if (result != VK_SUCCESS) {
 		throw std::runtime_error("Failed to present swap chain image!");
 	}
@@ -208,20 +475,41 @@ void VulkanRenderer::cleanup()
 {
 	printf("-------- BEGIN VulkanRenderer::cleanup()\n");
 
+	// Nothing may draw while the resources go away
+	stopRenderThread();
+
 	// Wait until no actions being run on device before destroying
 	vkDeviceWaitIdle(m_Device->device());
 
-	cleanupOnRecreateSwapChain();
+	// Release everything still waiting on the timeline (deferred deletions, upload staging buffers)
+	m_FrameScheduler->flush();
 
-	// _aligned_free(modelTransferSpace);
+	printLatencyReport();
 
-	for (size_t i = 0; i < modelList.size(); i++)
+	// The flush handed the last frames to the readback worker, they are delivered before it goes away
+	if (m_FrameReadback != nullptr)
 	{
-		modelList[i].destroyMeshModel();
+		m_FrameReadback->flush();
+		m_FrameReadback->printStats();
+		m_FrameReadback.reset();
 	}
+
+	destroyFrameResources();
+	destroyGraphicsPipelines();
+
+	// _aligned_free(modelTransferSpace);
+
+	// The models only share the cached meshes, the cache owns their buffers
 	modelList.clear();
+	for (auto& cachedModel : meshCache)
+	{
+		cachedModel.second.destroyMeshModel();
+	}
+	meshCache.clear();
+	textureCache.clear();
 
 	vkDestroySampler(m_Device->device(), textureSampler, nullptr);
+	vkDestroySampler(m_Device->device(), compositeSampler, nullptr);
 
 	for (size_t i = 0; i < textureImages.size(); i++)
 	{
@@ -248,12 +536,9 @@ void VulkanRenderer::cleanup()
 	//		vkFreeMemory(m_Device->device(), colorBufferImageMemory[i], nullptr);
 	//	}
 
-	// vkDestroyDescriptorPool(m_Device->device(), descriptorPool, nullptr);           // moved to cleanupOnRecreateSwapChain
-	vkDestroyDescriptorPool(m_Device->device(), samplerDescriptorPool, nullptr);
-	// vkDestroyDescriptorPool(m_Device->device(), inputDescriptorPool, nullptr);      // moved to cleanupOnRecreateSwapChain
-	// vkDestroyDescriptorSetLayout(m_Device->device(), descriptorSetLayout, nullptr); // moved to cleanupOnRecreateSwapChain
-	// vkDestroyDescriptorSetLayout(m_Device->device(), samplerSetLayout, nullptr);    // moved to cleanupOnRecreateSwapChain
-	// vkDestroyDescriptorSetLayout(m_Device->device(), inputSetLayout, nullptr);      // moved to cleanupOnRecreateSwapChain
+	// Destroys the descriptor pools (sampler sets) and the cached descriptor set layouts / update templates
+	m_DescriptorAllocator.reset();
+	m_DescriptorLayoutCache.reset();
 
 	// moved to cleanupOnRecreateSwapChain
 	//	for (size_t i = 0; i < m_SwapChain->getSwapChainImages().size(); i++)
@@ -295,7 +580,7 @@ void VulkanRenderer::cleanup()
 	//		vkDestroyImageView(m_Device->device(), imageView, nullptr);
 	//	}
 
-	vkDestroySwapchainKHR(m_Device->device(), m_SwapChain->getSwapChainKHR(), nullptr);
+	m_SwapChain.reset();
 	// vkDestroySurfaceKHR(instance, m_Device->surface(), nullptr);
 	// vkDestroyDevice(m_Device->device(), nullptr);
 	if (validationEnabled)
@@ -305,69 +590,101 @@ void VulkanRenderer::cleanup()
 	printf("-------- END VulkanRenderer::cleanup()\n");
 }
 
-void VulkanRenderer::cleanupOnRecreateSwapChain()
+void VulkanRenderer::destroyGraphicsPipelines()
 {
-	printf("-------- BEGIN VulkanRenderer::cleanupOnRecreateSwapChain()\n");
+	// Background compilations still use the render pass and shader modules
+	m_Device->pipelineRegistry().waitForPendingPipelines(*m_JobSystem);
 
-	vkDeviceWaitIdle(m_Device->device());
+	for (int i = 0; i < OBJECT_DATA_PATH_COUNT; i++)
+	{
+		graphicsPipelineRequests[i].reset();
+		depthPrepassPipelineRequests[i].reset();
+		depthEqualPipelineRequests[i].reset();
+	}
+	pipelinesPending = 0;
+
+	// Descriptor set layouts are owned by m_DescriptorLayoutCache, pipelines and their layouts by the
+	// PipelineRegistry, which destroys them once the last reference is gone
+	for (int i = 0; i < OBJECT_DATA_PATH_COUNT; i++)
+	{
+		graphicsPipelines[i].reset();
+		depthPrepassPipelines[i].reset();
+		depthEqualPipelines[i].reset();
+	}
+	pipelineLayout.reset();
 
-	freeCommandBuffers();
+	secondPipeline.reset();
+	secondPipelineLayout.reset();
+}
 
-	vkDestroyDescriptorSetLayout(m_Device->device(), descriptorSetLayout, nullptr);
-	vkDestroyDescriptorSetLayout(m_Device->device(), samplerSetLayout, nullptr);
+void VulkanRenderer::updatePipelineRequests()
+{
+	uint32_t pending = 0;
 
-	vkDestroyDescriptorPool(m_Device->device(), descriptorPool, nullptr);
-	vkDestroyDescriptorPool(m_Device->device(), inputDescriptorPool, nullptr);
-	// vkDestroyDescriptorPool(m_Device->device(), samplerDescriptorPool, nullptr);
+	auto update = [&](std::array<PipelineRegistry::PipelineRef, OBJECT_DATA_PATH_COUNT>& pipelines,
+		std::array<PipelineRegistry::PipelineRequestRef, OBJECT_DATA_PATH_COUNT>& requests, const char* name)
+	{
+		for (int i = 0; i < OBJECT_DATA_PATH_COUNT; i++)
+		{
+			auto& request = requests[i];
+			if (request == nullptr) continue;
 
-	vkDestroyDescriptorSetLayout(m_Device->device(), inputSetLayout, nullptr);
+			if (!request->isComplete())
+			{
+				pending++;
+				continue;
+			}
 
-	vkDestroyPipeline(m_Device->device(), graphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(m_Device->device(), pipelineLayout, nullptr);
+			// A failed compilation leaves the slot empty, that path keeps using the fallback policy
+			// (or, for the depth pre-pass pipelines, is drawn without the pre-pass)
+			pipelines[i] = request->pipeline;
+			request.reset();
 
-	vkDestroyPipeline(m_Device->device(), secondPipeline, nullptr);
-	vkDestroyPipelineLayout(m_Device->device(), secondPipelineLayout, nullptr);
+			printf("Vulkan Graphics Pipeline (%s, %s) %s.\n", name, getObjectDataPathName((ObjectDataPath)i),
+				pipelines[i] != nullptr ? "ready (compiled in the background)" : "failed to compile");
+		}
+	};
 
-	vkDestroyRenderPass(m_Device->device(), m_SwapChain->getRenderPass(), nullptr);
+	update(graphicsPipelines, graphicsPipelineRequests, "1st Subpass");
+	update(depthPrepassPipelines, depthPrepassPipelineRequests, "Depth Pre-pass");
+	update(depthEqualPipelines, depthEqualPipelineRequests, "1st Subpass, Depth Equal");
 
-	for (auto& imageView : m_SwapChain->getSwapChainImageViews())
+	if (pending != pipelinesPending)
 	{
-		vkDestroyImageView(m_Device->device(), imageView, nullptr);
+		printf("Pipelines pending: %i\n", (int)pending);
 	}
+	pipelinesPending = pending;
+}
 
-	for (size_t i = 0; i < m_SwapChain->getSwapChainImages().size(); i++)
+void VulkanRenderer::waitForPendingPipelines()
+{
+	m_Device->pipelineRegistry().waitForPendingPipelines(*m_JobSystem);
+	updatePipelineRequests();
+}
+
+void VulkanRenderer::destroyFrameResources()
+{
+	// Frame command pools (and their buffers) are destroyed together with the FrameContexts
+	for (auto& frame : frames)
 	{
-		vkDestroyBuffer(m_Device->device(), vpUniformBuffer[i], nullptr);
-		vkFreeMemory(m_Device->device(), vpUniformBufferMemory[i], nullptr);
+		vkDestroyBuffer(m_Device->device(), frame.vpUniformBuffer, nullptr);
+		vkFreeMemory(m_Device->device(), frame.vpUniformBufferMemory, nullptr);
 
 		// vkDestroyBuffer(m_Device->device(), vpUniformBufferUniVar[i], nullptr);
 		// vkFreeMemory(m_Device->device(), vpUniformBufferMemoryUniVar[i], nullptr);
 
-		// vkDestroyBuffer(m_Device->device(), modelDynUniformBuffer[i], nullptr);
-		// vkFreeMemory(m_Device->device(), modelDynUniformBufferMemory[i], nullptr);
-	}
-
-	// VK_OBJECT_TYPE_BUFFER			VkBuffer
-	// VK_OBJECT_TYPE_BUFFER			VkBuffer
-	// VK_OBJECT_TYPE_BUFFER			VkBuffer
-	// VK_OBJECT_TYPE_DEVICE_MEMORY		VkDeviceMemory
-	// VK_OBJECT_TYPE_DEVICE_MEMORY		VkDeviceMemory
-	// VK_OBJECT_TYPE_DEVICE_MEMORY		VkDeviceMemory
-	// VK_OBJECT_TYPE_IMAGE_VIEW		VkImageView
-	// VK_OBJECT_TYPE_IMAGE_VIEW		VkImageView
-	// VK_OBJECT_TYPE_IMAGE_VIEW		VkImageView
-	// VK_OBJECT_TYPE_PIPELINE_LAYOUT	VkPipelineLayout
-	// VK_OBJECT_TYPE_PIPELINE_LAYOUT	VkPipelineLayout
-	// VK_OBJECT_TYPE_PIPELINE			VkPipeline
-	// VK_OBJECT_TYPE_PIPELINE			VkPipeline
-	// VK_OBJECT_TYPE_RENDER_PASS		VkRenderPass
-	// VK_OBJECT_TYPE_SAMPLER			VkSampler
-	// VK_OBJECT_TYPE_DESCRIPTOR_SET	VkDescriptorSet
-	// VK_OBJECT_TYPE_DESCRIPTOR_SET	VkDescriptorSet
-	// VK_OBJECT_TYPE_DESCRIPTOR_SET	VkDescriptorSet
-	// VK_OBJECT_TYPE_DESCRIPTOR_POOL	VkDescriptorPool
-
-	printf("-------- END VulkanRenderer::cleanupOnRecreateSwapChain()\n");
+		// Freeing the memory also unmaps it
+		vkDestroyBuffer(m_Device->device(), frame.modelDynUniformBuffer, nullptr);
+		vkFreeMemory(m_Device->device(), frame.modelDynUniformBufferMemory, nullptr);
+
+		vkDestroyBuffer(m_Device->device(), frame.modelStorageBuffer, nullptr);
+		vkFreeMemory(m_Device->device(), frame.modelStorageBufferMemory, nullptr);
+	}
+
+	// Also destroys the per-frame descriptor allocators
+	frames.clear();
+
+	m_GpuTimer.reset();
 }
 
 VulkanRenderer::~VulkanRenderer()
@@ -406,8 +723,8 @@ void VulkanRenderer::createInstance()
 	uint32_t glfwExtensionCount = 0;    // GLFW may require multiple extensions
 	const char** glfwExtensions;        // Extensions passed as array of cstrings, so need pointer (the array) to pointer (the string)
 
-	// Get GLFW extensions
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	// Get GLFW extensions (none headless, GLFW is not initialized and there is no surface)
+	glfwExtensions = m_Window->isHeadless() ? nullptr : glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
 	// Add GLFW extensions to list of extensions
 	for (size_t i = 0; i < glfwExtensionCount; i++)
@@ -821,8 +1138,60 @@ void VulkanRenderer::createRenderPass()
 
 void VulkanRenderer::createShaders()
 {
-	m_ShaderFirst = std::make_unique<Shader>(m_Device, "Shaders/vert.spv", "Shaders/frag.spv");
-	m_ShaderSecond = std::make_unique<Shader>(m_Device, "Shaders/second_vert.spv", "Shaders/second_frag.spv");
+	auto shaderStart = std::chrono::steady_clock::now();
+
+	m_ShaderCompiler = std::make_unique<ShaderCompiler>();
+	m_ShaderCompiler->setCacheReadEnabled(!recompileShaders);
+
+	// Vertex shader variants share the fragment shader, they only differ in where the model matrix comes from
+	// (the OBJECT_DATA_PATH values match the ObjectDataPath enum). Compiled in parallel, unless the SPIR-V cache has them.
+	std::vector<ShaderCompiler::Request> requests = {
+		{ "shader.vert", { { "OBJECT_DATA_PATH", "0" } } },
+		{ "shader.vert", { { "OBJECT_DATA_PATH", "1" } } },
+		{ "shader.vert", { { "OBJECT_DATA_PATH", "2" } } },
+		{ "shader.frag", {} },
+		{ "second.vert", {} },
+		{ "second.frag", {} },
+		// Depth pre-pass: position stream only, no fragment shader
+		{ "shader.vert", { { "OBJECT_DATA_PATH", "0" }, { "POSITION_ONLY", "1" } } },
+		{ "shader.vert", { { "OBJECT_DATA_PATH", "1" }, { "POSITION_ONLY", "1" } } },
+		{ "shader.vert", { { "OBJECT_DATA_PATH", "2" }, { "POSITION_ONLY", "1" } } },
+		// Composite with dynamic resolution: samples and upscales the scene attachments
+		{ "second.frag", { { "SAMPLED_SCENE", "1" } } },
+	};
+
+	std::vector<std::vector<char>> spirv = m_ShaderCompiler->compileAll(requests, *m_JobSystem);
+
+	// One VkShaderModule per distinct SPIR-V, the fragment shader module is shared by the three first subpass shaders
+	ShaderLibrary& shaderLibrary = m_Device->shaderLibrary();
+	std::vector<ShaderLibrary::ShaderModuleRef> modules;
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		std::string name = requests[i].sourceFile;
+		for (const auto& define : requests[i].defines)
+		{
+			name += " " + define.first + "=" + define.second;
+		}
+		modules.push_back(shaderLibrary.createShaderModule(spirv[i].data(), spirv[i].size(), name));
+	}
+
+	m_ShaderFirst[(int)ObjectDataPath::PushConstant]   = std::make_unique<Shader>(m_Device, modules[0], modules[3]);
+	m_ShaderFirst[(int)ObjectDataPath::DynamicUniform] = std::make_unique<Shader>(m_Device, modules[1], modules[3]);
+	m_ShaderFirst[(int)ObjectDataPath::StorageBuffer]  = std::make_unique<Shader>(m_Device, modules[2], modules[3]);
+	m_ShaderSecond = std::make_unique<Shader>(m_Device, modules[4], modules[5]);
+	m_ShaderSecondSampled = std::make_unique<Shader>(m_Device, modules[4], modules[9]);
+	m_DepthPrepassVertex[(int)ObjectDataPath::PushConstant]   = modules[6];
+	m_DepthPrepassVertex[(int)ObjectDataPath::DynamicUniform] = modules[7];
+	m_DepthPrepassVertex[(int)ObjectDataPath::StorageBuffer]  = modules[8];
+
+	double shaderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count();
+	ShaderCompiler::Stats shaderStats = m_ShaderCompiler->getStats();
+	printf("Shaders ready in %.3f ms: %i compiled (%.3f ms of compile time), %i from the SPIR-V cache.\n",
+		shaderMs, (int)shaderStats.compiled, shaderStats.compileMs, (int)shaderStats.cacheHits);
+
+	ShaderLibrary::Stats libraryStats = shaderLibrary.getStats();
+	printf("Shader modules: %i live, %i created, %i shared by content.\n",
+		(int)libraryStats.liveModules, (int)libraryStats.modulesCreated, (int)libraryStats.contentShared);
 }
 
 void VulkanRenderer::createDescriptorSetLayout()
@@ -836,15 +1205,24 @@ void VulkanRenderer::createDescriptorSetLayout()
 	vpLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;            // Shader stage to bind to
 	vpLayoutBinding.pImmutableSamplers = nullptr;                       // For Texture: Can make sampler data unchangeable (immutable) by specifying in layout
 
-	// Model Binding Info (Model struct)
-	// VkDescriptorSetLayoutBinding modelLayoutBinding = {};
-	// modelLayoutBinding.binding = 1;
-	// modelLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-	// modelLayoutBinding.descriptorCount = 1;
-	// modelLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	// modelLayoutBinding.pImmutableSamplers = nullptr;
-
-	std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { vpLayoutBinding }; // vpLayoutBinding, modelLayoutBinding
+	// Model Binding Info (Model struct, ObjectDataPath::DynamicUniform)
+	VkDescriptorSetLayoutBinding modelLayoutBinding = {};
+	modelLayoutBinding.binding = 1;
+	modelLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	modelLayoutBinding.descriptorCount = 1;
+	modelLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	modelLayoutBinding.pImmutableSamplers = nullptr;
+
+	// Object Transforms Binding Info (array of model matrices, ObjectDataPath::StorageBuffer)
+	VkDescriptorSetLayoutBinding objectTransformsLayoutBinding = {};
+	objectTransformsLayoutBinding.binding = 2;
+	objectTransformsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	objectTransformsLayoutBinding.descriptorCount = 1;
+	objectTransformsLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	objectTransformsLayoutBinding.pImmutableSamplers = nullptr;
+
+	// All paths share one layout, so switching path only switches the pipeline
+	std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { vpLayoutBinding, modelLayoutBinding, objectTransformsLayoutBinding };
 
 	// Create Descriptor Set Layout with given bindings
 	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
@@ -852,14 +1230,17 @@ void VulkanRenderer::createDescriptorSetLayout()
 	layoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size()); // Number of binding infos
 	layoutCreateInfo.pBindings = layoutBindings.data();                           // Array of binding infos
 
-	// Create Descriptor Set Layout
-	VkResult result = vkCreateDescriptorSetLayout(m_Device->device(), &layoutCreateInfo, nullptr, &descriptorSetLayout);
+	// Get Descriptor Set Layout (only created the first time, recreateSwapChain gets the cached one)
+	descriptorSetLayout = m_DescriptorLayoutCache->createDescriptorLayout(&layoutCreateInfo);
 
-	printf("---- vkCreateDescriptorSetLayout descriptorSetLayout\n");
-
-	if (result != VK_SUCCESS)
+	std::string shaderError;
+	for (int i = 0; i < OBJECT_DATA_PATH_COUNT; i++)
 	{
-		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+		std::vector<const ShaderReflection*> stages = { &m_ShaderFirst[i]->getReflectionVertex(), &m_ShaderFirst[i]->getReflectionFragment() };
+		reportShaderMismatch(ShaderReflection::checkSetLayout(stages, 0, layoutCreateInfo, &shaderError), getObjectDataPathName((ObjectDataPath)i), shaderError);
+
+		std::vector<const ShaderReflection*> prepassStages = { &m_DepthPrepassVertex[i]->reflection };
+		reportShaderMismatch(ShaderReflection::checkSetLayout(prepassStages, 0, layoutCreateInfo, &shaderError), "depth pre-pass", shaderError);
 	}
 
 	printf("Vulkan Descriptor Set Layout (Uniforms) successfully created.\n");
@@ -879,53 +1260,57 @@ void VulkanRenderer::createDescriptorSetLayout()
 	textureLayoutCreateInfo.bindingCount = 1;
 	textureLayoutCreateInfo.pBindings = &samplerLayoutBinding;
 
-	// Create Descriptor Set Layout
-	result = vkCreateDescriptorSetLayout(m_Device->device(), &textureLayoutCreateInfo, nullptr, &samplerSetLayout);
-
-	printf("---- vkCreateDescriptorSetLayout samplerSetLayout\n");
+	// Get Descriptor Set Layout from the cache
+	samplerSetLayout = m_DescriptorLayoutCache->createDescriptorLayout(&textureLayoutCreateInfo);
 
-	if (result != VK_SUCCESS)
+	for (int i = 0; i < OBJECT_DATA_PATH_COUNT; i++)
 	{
-		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+		std::vector<const ShaderReflection*> stages = { &m_ShaderFirst[i]->getReflectionVertex(), &m_ShaderFirst[i]->getReflectionFragment() };
+		reportShaderMismatch(ShaderReflection::checkSetLayout(stages, 1, textureLayoutCreateInfo, &shaderError), getObjectDataPathName((ObjectDataPath)i), shaderError);
 	}
 
 	printf("Vulkan Descriptor Set Layout (Samplers) successfully created.\n");
 
-	// CREATE INPUT ATTACHMENT IMAGE DESCRIPTOR SET LAYOUT
+	createSceneSetLayout();
+}
+
+void VulkanRenderer::createSceneSetLayout()
+{
+	// CREATE SCENE ATTACHMENT DESCRIPTOR SET LAYOUT (composite pass)
+	// Input attachments, or sampled with dynamic resolution: then the composite reads other pixels than it writes
+	VkDescriptorType sceneDescriptorType = sceneSampled ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+
 	// Color Input Binding
 	VkDescriptorSetLayoutBinding colorInputLayoutBinding = {};
 	colorInputLayoutBinding.binding = 0;
-	colorInputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	colorInputLayoutBinding.descriptorType = sceneDescriptorType;
 	colorInputLayoutBinding.descriptorCount = 1;
 	colorInputLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
 	// Depth Input Binding
 	VkDescriptorSetLayoutBinding depthInputLayoutBinding = {};
 	depthInputLayoutBinding.binding = 1;
-	depthInputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	depthInputLayoutBinding.descriptorType = sceneDescriptorType;
 	depthInputLayoutBinding.descriptorCount = 1;
 	depthInputLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-	// Array of input attachment bindings
+	// Array of scene attachment bindings
 	std::vector<VkDescriptorSetLayoutBinding> inputBindings = { colorInputLayoutBinding, depthInputLayoutBinding };
 
-	// Create a descriptor set layout for input attachments
+	// Create a descriptor set layout for the scene attachments
 	VkDescriptorSetLayoutCreateInfo inputLayoutCreateInfo = {};
 	inputLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	inputLayoutCreateInfo.bindingCount = static_cast<uint32_t>(inputBindings.size());
 	inputLayoutCreateInfo.pBindings = inputBindings.data();
 
-	// Create Descriptor Set Layout
-	result = vkCreateDescriptorSetLayout(m_Device->device(), &inputLayoutCreateInfo, nullptr, &inputSetLayout);
-
-	printf("---- vkCreateDescriptorSetLayout inputSetLayout\n");
+	// Get Descriptor Set Layout from the cache
+	inputSetLayout = m_DescriptorLayoutCache->createDescriptorLayout(&inputLayoutCreateInfo);
 
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
-	}
+	std::string shaderError;
+	std::vector<const ShaderReflection*> secondStages = { &getCompositeShader().getReflectionVertex(), &getCompositeShader().getReflectionFragment() };
+	reportShaderMismatch(ShaderReflection::checkSetLayout(secondStages, 0, inputLayoutCreateInfo, &shaderError), "2nd subpass", shaderError);
 
-	printf("Vulkan Descriptor Set Layout (Input Attachments) successfully created.\n");
+	printf("Vulkan Descriptor Set Layout (Scene Attachments) successfully created.\n");
 }
 
 void VulkanRenderer::createPushConstantRange()
@@ -935,14 +1320,14 @@ void VulkanRenderer::createPushConstantRange()
 	pushConstantRange.offset = 0;                              // Offset into given data to pass to push constant
 	pushConstantRange.size = sizeof(Model);                    // Size of data being passed
 
-	// Define push constant values for 2nd shader (UniformVariables)
-	pushConstantRangeUniVar.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; // Shader stage push constant will go to
-	pushConstantRangeUniVar.offset = 0;                                // Offset into given data to pass to push constant
-	pushConstantRangeUniVar.size = sizeof(UniformVariables);           // Size of data being passed
+	// The 2nd subpass has no push constants anymore, its per-pipeline values are specialization constants
 }
 
 void VulkanRenderer::createGraphicsPipeline()
 {
+	// Cold (empty pipeline cache) versus warm (cache loaded from disk) creation time is reported at the end
+	auto pipelineStart = std::chrono::steady_clock::now();
+
 	// Read in SPIR-V code of shaders
 	// auto vertexShaderCode = readFile("Shaders/vert.spv");
 	// auto fragmentShaderCode = readFile("Shaders/frag.spv");
@@ -959,16 +1344,31 @@ void VulkanRenderer::createGraphicsPipeline()
 	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
 	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;  // Shader Stage name
-	vertexShaderCreateInfo.module = m_ShaderFirst->getShaderModuleVertex(); // Shader module to be used by stage
+	vertexShaderCreateInfo.module = m_ShaderFirst[0]->getShaderModuleVertex(); // Shader module to be used by stage
 	vertexShaderCreateInfo.pName = "main";                      // Entry point into shader
 
 	// Fragment Stage creation information
 	VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
 	fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT; // Shader Stage name
-	fragmentShaderCreateInfo.module = m_ShaderFirst->getShaderModuleFragment(); // Shader module to be used by stage
+	fragmentShaderCreateInfo.module = m_ShaderFirst[0]->getShaderModuleFragment(); // Shader module to be used by stage
 	fragmentShaderCreateInfo.pName = "main";                       // Entry point into shader
 
+	// -- SPECIALIZATION CONSTANTS --
+	// Values constant per pipeline are baked into the shader variant, the driver folds them and drops dead branches.
+	// Only referenced until the pipelines are created (background requests copy them).
+	ShaderVariant firstFragmentVariant;
+	firstFragmentVariant.set((uint32_t)FirstFragmentConstant::Textured, shadingOptions.textured);
+	VkSpecializationInfo firstFragmentSpecialization = firstFragmentVariant.getSpecializationInfo();
+
+	ShaderVariant secondFragmentVariant;
+	secondFragmentVariant.set((uint32_t)SecondFragmentConstant::SplitFraction, shadingOptions.splitFraction);
+	secondFragmentVariant.set((uint32_t)SecondFragmentConstant::DepthLowerBound, shadingOptions.depthLowerBound);
+	secondFragmentVariant.set((uint32_t)SecondFragmentConstant::DepthUpperBound, shadingOptions.depthUpperBound);
+	VkSpecializationInfo secondFragmentSpecialization = secondFragmentVariant.getSpecializationInfo();
+
+	fragmentShaderCreateInfo.pSpecializationInfo = &firstFragmentSpecialization;
+
 	// Put shader stage creation info into an array
 	// Graphics Pipeline creation info requires array of shader stage creates
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
@@ -1016,6 +1416,7 @@ void VulkanRenderer::createGraphicsPipeline()
 	inputAssembly.primitiveRestartEnable = VK_FALSE;              // Allow overriding of "strip" topology to start new primitives
 
 	// -- VIEWPORT & SCISSOR (think of GoldenEye 007 Nintendo 64) --
+	// Both are dynamic state (see below), these values are ignored and only the counts matter
 	// Create a viewport info struct
 	VkViewport viewport = {};
 	viewport.x = 0.0f;                                                 // x start coordinate
@@ -1107,18 +1508,21 @@ void VulkanRenderer::createGraphicsPipeline()
 	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
-	// Create Pipeline Layout
-	VkResult result = vkCreatePipelineLayout(m_Device->device(), &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+	// Create Pipeline Layout (or share an identical one)
+	PipelineRegistry& pipelineRegistry = m_Device->pipelineRegistry();
+	pipelineLayout = pipelineRegistry.getPipelineLayout(&pipelineLayoutCreateInfo);
 
-	printf("---- vkCreatePipelineLayout pipelineLayout\n");
+	printf("Vulkan Pipeline Layout (1st Subpass) successfully created.\n");
 
-	if (result != VK_SUCCESS)
+	std::string shaderError;
+	for (int i = 0; i < OBJECT_DATA_PATH_COUNT; i++)
 	{
-		throw std::runtime_error("Failed to create Pipeline Layout (1st Subpass)!");
+		const ShaderReflection& vertexReflection = m_ShaderFirst[i]->getReflectionVertex();
+		std::vector<const ShaderReflection*> stages = { &vertexReflection, &m_ShaderFirst[i]->getReflectionFragment() };
+		reportShaderMismatch(ShaderReflection::checkPushConstantRanges(stages, pipelineLayoutCreateInfo, &shaderError), getObjectDataPathName((ObjectDataPath)i), shaderError);
+		reportShaderMismatch(ShaderReflection::checkVertexInput(vertexReflection, vertexInputCreateInfo, &shaderError), getObjectDataPathName((ObjectDataPath)i), shaderError);
 	}
 
-	printf("Vulkan Pipeline Layout (1st Subpass) successfully created.\n");
-
 	// -- DEPTH STENCIL TESTING --
 	VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
 	depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
@@ -1136,30 +1540,123 @@ void VulkanRenderer::createGraphicsPipeline()
 	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo; // All the fixed function pipeline states
 	pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
 	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-	pipelineCreateInfo.pDynamicState = nullptr;
+	pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo; // Viewport/scissor are set while recording, a resize keeps the pipelines
 	pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
 	pipelineCreateInfo.pMultisampleState   = &multisamplingCreateInfo;
 	pipelineCreateInfo.pColorBlendState    = &colorBlendingCreateInfo;
 	pipelineCreateInfo.pDepthStencilState  = &depthStencilCreateInfo;
-	pipelineCreateInfo.layout = pipelineLayout;                   // Pipeline Layout the pipeline should use
-	pipelineCreateInfo.renderPass = m_SwapChain->getRenderPass(); // Render Pass description the pipeline is compatible with (Pipeline is used by the Render Pass)
-	pipelineCreateInfo.subpass = 0;                               // Subpass of Render Pass to use with the pipeline
+	RenderGraph& renderGraph = m_SwapChain->getRenderGraph();
+	pipelineCreateInfo.layout = pipelineLayout->layout;                                         // Pipeline Layout the pipeline should use
+	pipelineCreateInfo.renderPass = renderGraph.getRenderPass(m_SwapChain->getGeometryPass()); // Render Pass description the pipeline is compatible with (Pipeline is used by the Render Pass)
+	pipelineCreateInfo.subpass = renderGraph.getSubpass(m_SwapChain->getGeometryPass());      // Subpass of Render Pass to use with the pipeline
 
 	// Pipeline Derivatives: Can create multiple pipelines that derive from one another for optimization
 	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE; // Existing pipeline to derive from
 	pipelineCreateInfo.basePipelineIndex = -1; // or index of pipeline being created to derive from (in case creating multiple at once)
 
-	// Create Graphics Pipeline
-	result = vkCreateGraphicsPipelines(m_Device->device(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &graphicsPipeline);
+	// Only the swapchain format of the render pass can change at runtime, the color and depth attachment formats
+	// are fixed per device. Pipelines requested with the same key are shared across render pass recreation.
+	uint64_t renderPassKey = static_cast<uint64_t>(m_SwapChain->getSwapChainImageFormat()) + 1;
 
-	printf("---- vkCreateGraphicsPipelines graphicsPipeline\n");
+	// Create Graphics Pipeline (one per ObjectDataPath, only the vertex shader differs).
+	// Only the active path is needed right now and becomes the fallback, the others compile on the compile lane.
+	fallbackObjectDataPath = objectDataPath;
+	uint32_t backgroundPipelines = 0;
 
-	if (result != VK_SUCCESS)
+	for (int i = 0; i < OBJECT_DATA_PATH_COUNT; i++)
+	{
+		shaderStages[0].module = m_ShaderFirst[i]->getShaderModuleVertex();
+		shaderStages[1].module = m_ShaderFirst[i]->getShaderModuleFragment();
+
+		if (i == (int)fallbackObjectDataPath)
+		{
+			graphicsPipelines[i] = pipelineRegistry.getGraphicsPipeline(&pipelineCreateInfo, renderPassKey);
+
+			printf("Vulkan Graphics Pipeline (1st Subpass, %s) successfully created.\n", getObjectDataPathName((ObjectDataPath)i));
+		}
+		else
+		{
+			graphicsPipelines[i].reset();
+			graphicsPipelineRequests[i] = pipelineRegistry.requestGraphicsPipeline(&pipelineCreateInfo, *m_JobSystem, compileLane, renderPassKey);
+			backgroundPipelines++;
+
+			printf("Vulkan Graphics Pipeline (1st Subpass, %s) compiling in the background.\n", getObjectDataPathName((ObjectDataPath)i));
+		}
+	}
+
+	// DEPTH PRE-PASS PIPELINES
+	// Optional (switched at runtime), so never waited for: every pre-pass and depth equal pipeline compiles in the background
+	// Geometry pass after the pre-pass: depth is final already, only the nearest surface passes and nothing is written
+	depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	depthStencilCreateInfo.depthWriteEnable = VK_FALSE;
+
+	for (int i = 0; i < OBJECT_DATA_PATH_COUNT; i++)
+	{
+		shaderStages[0].module = m_ShaderFirst[i]->getShaderModuleVertex();
+		shaderStages[1].module = m_ShaderFirst[i]->getShaderModuleFragment();
+
+		depthEqualPipelines[i].reset();
+		depthEqualPipelineRequests[i] = pipelineRegistry.requestGraphicsPipeline(&pipelineCreateInfo, *m_JobSystem, compileLane, renderPassKey);
+		backgroundPipelines++;
+	}
+
+	// The pre-pass itself: vertex stage only, reading the tightly packed position stream
+	VkVertexInputBindingDescription positionBindingDescription = {};
+	positionBindingDescription.binding = 0;
+	positionBindingDescription.stride = sizeof(glm::vec3); // Mesh::getPositionBuffer
+	positionBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	VkVertexInputAttributeDescription positionAttributeDescription = {};
+	positionAttributeDescription.binding = 0;
+	positionAttributeDescription.location = 0;
+	positionAttributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+	positionAttributeDescription.offset = 0;
+
+	VkPipelineVertexInputStateCreateInfo positionInputCreateInfo = {};
+	positionInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	positionInputCreateInfo.vertexBindingDescriptionCount = 1;
+	positionInputCreateInfo.pVertexBindingDescriptions = &positionBindingDescription;
+	positionInputCreateInfo.vertexAttributeDescriptionCount = 1;
+	positionInputCreateInfo.pVertexAttributeDescriptions = &positionAttributeDescription;
+
+	// Its subpass has no color attachment
+	VkPipelineColorBlendStateCreateInfo prepassBlendingCreateInfo = {};
+	prepassBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	prepassBlendingCreateInfo.attachmentCount = 0;
+
+	// Same depth test as the geometry pass without pre-pass
+	VkPipelineDepthStencilStateCreateInfo prepassDepthStencilCreateInfo = depthStencilCreateInfo;
+	prepassDepthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+	prepassDepthStencilCreateInfo.depthWriteEnable = VK_TRUE;
+
+	// Same pipeline layout, so the pre-pass binds set 0 and pushes the model matrix exactly like the geometry pass
+	VkGraphicsPipelineCreateInfo prepassPipelineCreateInfo = pipelineCreateInfo;
+	prepassPipelineCreateInfo.stageCount = 1;
+	prepassPipelineCreateInfo.pVertexInputState = &positionInputCreateInfo;
+	prepassPipelineCreateInfo.pColorBlendState = &prepassBlendingCreateInfo;
+	prepassPipelineCreateInfo.pDepthStencilState = &prepassDepthStencilCreateInfo;
+	prepassPipelineCreateInfo.renderPass = renderGraph.getRenderPass(m_SwapChain->getDepthPrepass());
+	prepassPipelineCreateInfo.subpass = renderGraph.getSubpass(m_SwapChain->getDepthPrepass());
+
+	for (int i = 0; i < OBJECT_DATA_PATH_COUNT; i++)
 	{
-		throw std::runtime_error("Failed to create a Graphics Pipeline (1st Subpass)!");
+		VkPipelineShaderStageCreateInfo prepassShaderStage = vertexShaderCreateInfo;
+		prepassShaderStage.module = m_DepthPrepassVertex[i]->module;
+		prepassPipelineCreateInfo.pStages = &prepassShaderStage;
+
+		std::vector<const ShaderReflection*> prepassStages = { &m_DepthPrepassVertex[i]->reflection };
+		reportShaderMismatch(ShaderReflection::checkPushConstantRanges(prepassStages, pipelineLayoutCreateInfo, &shaderError), "depth pre-pass", shaderError);
+		reportShaderMismatch(ShaderReflection::checkVertexInput(m_DepthPrepassVertex[i]->reflection, positionInputCreateInfo, &shaderError), "depth pre-pass", shaderError);
+
+		// Copied by the request, the shader stage may go out of scope
+		depthPrepassPipelines[i].reset();
+		depthPrepassPipelineRequests[i] = pipelineRegistry.requestGraphicsPipeline(&prepassPipelineCreateInfo, *m_JobSystem, compileLane, renderPassKey);
+		backgroundPipelines++;
 	}
 
-	printf("Vulkan Graphics Pipeline (1st Subpass) successfully created.\n");
+	printf("Vulkan Graphics Pipelines (Depth Pre-pass) compiling in the background.\n");
+
+	depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
 
 	// Destroy Shader Modules, no longer needed after Pipeline created
 	// vkDestroyShaderModule(m_Device->device(), fragmentShaderModule, nullptr);
@@ -1175,8 +1672,9 @@ void VulkanRenderer::createGraphicsPipeline()
 	// VkShaderModule secondFragmentShaderModule = createShaderModule(secondFragmentShaderCode);
 
 	// Set new shaders
-	vertexShaderCreateInfo.module = m_ShaderSecond->getShaderModuleVertex();
-	fragmentShaderCreateInfo.module = m_ShaderSecond->getShaderModuleFragment();
+	vertexShaderCreateInfo.module = getCompositeShader().getShaderModuleVertex();
+	fragmentShaderCreateInfo.module = getCompositeShader().getShaderModuleFragment();
+	fragmentShaderCreateInfo.pSpecializationInfo = &secondFragmentSpecialization;
 
 	VkPipelineShaderStageCreateInfo secondShaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
 
@@ -1189,41 +1687,51 @@ void VulkanRenderer::createGraphicsPipeline()
 	// Don't want to write to depth buffer
 	depthStencilCreateInfo.depthWriteEnable = VK_FALSE;
 
+	// Rendered region of the scene attachments, changes every frame with dynamic resolution.
+	// Both variants share the layout, only the sampled one reads it.
+	VkPushConstantRange compositePushConstantRange = {};
+	compositePushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	compositePushConstantRange.offset = 0;
+	compositePushConstantRange.size = sizeof(CompositePushConstant);
+
 	// Create new pipeline layout
 	VkPipelineLayoutCreateInfo secondPipelineLayoutCreateInfo = {};
 	secondPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	secondPipelineLayoutCreateInfo.setLayoutCount = 1;
 	secondPipelineLayoutCreateInfo.pSetLayouts = &inputSetLayout;
-	secondPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-	secondPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRangeUniVar;
+	secondPipelineLayoutCreateInfo.pushConstantRangeCount = 1; // Viewport split and depth range are specialization constants
+	secondPipelineLayoutCreateInfo.pPushConstantRanges = &compositePushConstantRange;
 
 	// Create Pipeline Layout (2nd Subpass) 
-	result = vkCreatePipelineLayout(m_Device->device(), &secondPipelineLayoutCreateInfo, nullptr, &secondPipelineLayout);
-
-	printf("---- vkCreatePipelineLayout secondPipelineLayout\n");
-
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create Pipeline Layout (2nd Subpass)!");
-	}
+	secondPipelineLayout = pipelineRegistry.getPipelineLayout(&secondPipelineLayoutCreateInfo);
 
 	printf("Vulkan Pipeline Layout (2nd Subpass) successfully created.\n");
 
+	std::vector<const ShaderReflection*> secondStages = { &getCompositeShader().getReflectionVertex(), &getCompositeShader().getReflectionFragment() };
+	reportShaderMismatch(ShaderReflection::checkPushConstantRanges(secondStages, secondPipelineLayoutCreateInfo, &shaderError), "2nd subpass", shaderError);
+	reportShaderMismatch(ShaderReflection::checkVertexInput(*secondStages[0], vertexInputCreateInfo, &shaderError), "2nd subpass", shaderError);
+
 	pipelineCreateInfo.pStages = secondShaderStages;  // Update second shader stage list
-	pipelineCreateInfo.layout = secondPipelineLayout; // Change pipeline layout for input attachment descriptor sets
-	pipelineCreateInfo.subpass = 1;                   // Use 2nd Subpass (starting at 0)
+	pipelineCreateInfo.layout = secondPipelineLayout->layout; // Change pipeline layout for the scene attachment descriptor sets
+	pipelineCreateInfo.renderPass = renderGraph.getRenderPass(m_SwapChain->getCompositePass()); // As laid out by the render graph
+	pipelineCreateInfo.subpass = renderGraph.getSubpass(m_SwapChain->getCompositePass());
 
 	// Create second pipeline
-	result = vkCreateGraphicsPipelines(m_Device->device(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &secondPipeline);
+	secondPipeline = pipelineRegistry.getGraphicsPipeline(&pipelineCreateInfo, renderPassKey);
 
-	printf("---- vkCreateGraphicsPipelines secondPipeline\n");
+	printf("Vulkan Graphics Pipeline (2nd Subpass) successfully created.\n");
 
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a Graphics Pipeline (2nd Subpass)!");
-	}
+	// Render pass compatibility only depends on the formats, remember them to detect when a rebuild is needed
+	pipelineColorFormat = m_SwapChain->getSwapChainImageFormat();
 
-	printf("Vulkan Graphics Pipeline (2nd Subpass) successfully created.\n");
+	double pipelineMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelineStart).count();
+	printf("Graphics pipelines (%i) created in %.3f ms, %i more compiling in the background, pipeline cache %s.\n",
+		3 * OBJECT_DATA_PATH_COUNT + 1 - (int)backgroundPipelines, pipelineMs, (int)backgroundPipelines,
+		m_Device->isPipelineCacheWarm() ? "warm (loaded from disk)" : "cold");
+
+	PipelineRegistry::Stats registryStats = pipelineRegistry.getStats();
+	printf("Pipeline registry: %i of %i pipeline requests shared, %i pipelines and %i layouts alive.\n",
+		(int)registryStats.pipelinesShared, (int)registryStats.pipelineRequests, (int)registryStats.livePipelines, (int)registryStats.liveLayouts);
 
 	// Destroy second shader modules
 	// vkDestroyShaderModule(m_Device->device(), secondVertexShaderModule, nullptr);
@@ -1347,34 +1855,22 @@ void VulkanRenderer::createCommandPool()
 }
 ****/
 
-void VulkanRenderer::createCommandBuffers()
+void VulkanRenderer::createFrameCommandPools()
 {
-	// Resize command buffer count to have one for each framebuffer
-
-	auto swapChainFramebufferCount = m_SwapChain->getFrameBuffers().size();
-	commandBuffers.resize(swapChainFramebufferCount);
+	// Command buffers are no longer allocated up front from the device pool (which is kept for one-time uploads).
+	// Each frame in flight gets its own transient pools, one for the primary buffer and one per recording job, buffers are handed out each frame.
+	uint32_t graphicsFamily = static_cast<uint32_t>(m_Device->findPhysicalQueueFamilies().graphicsFamily);
 
-	VkCommandBufferAllocateInfo cbAllocInfo = {};
-	cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	cbAllocInfo.commandPool = m_Device->getCommandPool();
-	cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; // VK_COMMAND_BUFFER_LEVEL_PRIMARY   : Buffer you submit directly to queue. 
-	                                                     // Can't be called by other buffers.
-	                                                     // VK_COMMAND_BUFFER_LEVEL_SECONDARY : Buffer can't be called directly. 
-	                                                     // Can be called from other buffers via "vkCmdExecuteCommands(buffer)"
-	                                                     // when recording commands in primary buffer
-
-	cbAllocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
-
-	// Allocate Command Buffers and place handles in array of buffers
-	// Command Buffers are automatically deallocated when Command Pool is destroyed (on vkDestroyCommandPool)
-	VkResult result = vkAllocateCommandBuffers(m_Device->device(), &cbAllocInfo, commandBuffers.data());
-
-	if (result != VK_SUCCESS)
+	for (auto& frame : frames)
 	{
-		throw std::runtime_error("Failed to allocate Command Buffers!");
+		frame.commandPools.clear();
+		for (uint32_t i = 0; i < 1 + recordingJobCount; i++)
+		{
+			frame.commandPools.push_back(std::make_unique<FrameCommandPool>(m_Device, graphicsFamily));
+		}
 	}
 
-	printf("Vulkan Command Buffers successfully allocated from the Command Pool.\n");
+	printf("Vulkan Frame Command Pools successfully created.\n");
 }
 
 void VulkanRenderer::createUniformBuffers()
@@ -1385,26 +1881,22 @@ void VulkanRenderer::createUniformBuffers()
 	// UniformVariables buffer size
 	// VkDeviceSize vpBufferSizeUniVar = sizeof(UniformVariables);
 
-	// Model struct buffer size
-	// VkDeviceSize modelBufferSize = modelUniformAlignment * MAX_OBJECTS;
+	// Model struct buffer size (one aligned slot per object)
+	VkDeviceSize modelBufferSize = modelUniformAlignment * MAX_OBJECTS;
 
-	// One uniform buffer for each image (and by extension, command buffer)
-	vpUniformBuffer.resize(m_SwapChain->getSwapChainImages().size());
-	vpUniformBufferMemory.resize(m_SwapChain->getSwapChainImages().size());
+	// Object transforms buffer size (tightly packed std430 array of mat4)
+	VkDeviceSize objectTransformsBufferSize = sizeof(glm::mat4) * MAX_OBJECTS;
 
 	// vpUniformBufferUniVar.resize(m_SwapChain->getSwapChainImages().size());
 	// vpUniformBufferMemoryUniVar.resize(m_SwapChain->getSwapChainImages().size());
 
-	// modelDynUniformBuffer.resize(swapChainImages.size());
-	// modelDynUniformBufferMemory.resize(swapChainImages.size());
-
-	// Create Uniform buffer(s)
-	for (size_t i = 0; i < m_SwapChain->getSwapChainImages().size(); i++)
+	// Create Uniform buffer(s), one set for each frame in flight (and by extension, command buffer)
+	for (auto& frame : frames)
 	{
 		VkBufferUsageFlags bufferUsage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
 		VkMemoryPropertyFlags bufferProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
-		createBuffer(m_Device->getPhysicalDevice(), m_Device->device(), vpBufferSize, bufferUsage, bufferProperties, &vpUniformBuffer[i], &vpUniformBufferMemory[i]);
+		createBuffer(m_Device->getPhysicalDevice(), m_Device->device(), vpBufferSize, bufferUsage, bufferProperties, &frame.vpUniformBuffer, &frame.vpUniformBufferMemory);
 
 		// VkBufferUsageFlags bufferUsageUniVar = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
 		// VkMemoryPropertyFlags bufferPropertiesUniVar = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
@@ -1412,364 +1904,267 @@ void VulkanRenderer::createUniformBuffers()
 		// createBuffer(m_Device->getPhysicalDevice(), m_Device->device(), vpBufferSizeUniVar, bufferUsageUniVar, bufferPropertiesUniVar, &vpUniformBufferUniVar[i], &vpUniformBufferMemoryUniVar[i]);
 
 
-		// createBuffer(mainDevice.physicalDevice, m_Device->device(), modelBufferSize, bufferUsage, bufferProperties, &modelDynUniformBuffer[i], &modelDynUniformBufferMemory[i]);
+		createBuffer(m_Device->getPhysicalDevice(), m_Device->device(), modelBufferSize, bufferUsage, bufferProperties, &frame.modelDynUniformBuffer, &frame.modelDynUniformBufferMemory);
+
+		createBuffer(m_Device->getPhysicalDevice(), m_Device->device(), objectTransformsBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, bufferProperties, &frame.modelStorageBuffer, &frame.modelStorageBufferMemory);
+
+		// Model data is written every frame, so keep both buffers mapped for their whole lifetime
+		VkResult result = vkMapMemory(m_Device->device(), frame.modelDynUniformBufferMemory, 0, modelBufferSize, 0, &frame.modelDynUniformBufferMapped);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to map the model Dynamic Uniform Buffer!");
+		}
+		result = vkMapMemory(m_Device->device(), frame.modelStorageBufferMemory, 0, objectTransformsBufferSize, 0, &frame.modelStorageBufferMapped);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to map the model Storage Buffer!");
+		}
 	}
 }
 
-void VulkanRenderer::createDescriptorPool()
+void VulkanRenderer::createFrameContexts()
 {
-	// CREATE UNIFORM DESCRIPTOR POOL
+	// Independent of the swapchain image count: a swapchain with many images doesn't cost extra per-frame resources
+	frames.clear();
+	frames.resize(m_SwapChain->getFramesInFlight());
 
-	// Type of descriptors + how many DESCRIPTORS, not Descriptor Sets (combined makes the pool size)
-
-	// UboViewProjection Pool
-	VkDescriptorPoolSize vpPoolSize = {};
-	vpPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	vpPoolSize.descriptorCount = static_cast<uint32_t>(vpUniformBuffer.size());
-
-	// UniformVariables Pool
-	// VkDescriptorPoolSize vpPoolSizeUniVar = {};
-	// vpPoolSizeUniVar.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	// vpPoolSizeUniVar.descriptorCount = static_cast<uint32_t>(vpUniformBufferUniVar.size());
-
-	// Model struct Pool (DYNAMIC)
-	// VkDescriptorPoolSize modelPoolSize = {};
-	// modelPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-	// modelPoolSize.descriptorCount = static_cast<uint32_t>(modelDynUniformBuffer.size());
-
-	// List of Pool Sizes
-	std::vector<VkDescriptorPoolSize> descriptorPoolSizes = { vpPoolSize }; // vpPoolSize, vpPoolSizeUniVar // vpPoolSize, modelPoolSize
-
-	// Data to create Descriptor Pool
-	VkDescriptorPoolCreateInfo poolCreateInfo = {};
-	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolCreateInfo.maxSets = static_cast<uint32_t>(m_SwapChain->getSwapChainImages().size()); // Maximum number of Descriptor Sets that can be created from pool
-	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());         // Amount of Pool Sizes being passed
-	poolCreateInfo.pPoolSizes = descriptorPoolSizes.data();                                   // Pool SIzes to create pool with
-
-	// Create Descriptor Pool
-	VkResult result = vkCreateDescriptorPool(m_Device->device(), &poolCreateInfo, nullptr, &descriptorPool);
-
-	printf("---- vkCreateDescriptorPool descriptorPool\n");
+	printf("Vulkan Frame Contexts (%i frames in flight, %i swapchain images) successfully created.\n",
+		(int)frames.size(), (int)m_SwapChain->getSwapChainImages().size());
+}
 
-	if (result != VK_SUCCESS)
+void VulkanRenderer::createDescriptorAllocators()
+{
+	// Every frame in flight gets its own allocator, its pools are reset whenever the frame comes around again.
+	// Pools are chained on demand, so no sizing from the swapchain image count or MAX_TEXTURES is needed.
+	for (auto& frame : frames)
 	{
-		throw std::runtime_error("Failed to create a Descriptor Pool!");
+		frame.descriptorAllocator = std::make_unique<DescriptorAllocator>(m_Device, 8);
 	}
 
-	printf("Vulkan Descriptor Pool (Uniforms) successfully created.\n");
+	printf("Vulkan Descriptor Allocators (%i frames) successfully created.\n", (int)frames.size());
+}
 
+void VulkanRenderer::createFrameDescriptorSets(uint32_t frameIndex)
+{
+	FrameContext& frame = frames[frameIndex];
 
-	// CREATE SAMPLER DESCRIPTOR POOL
-	// Texture sampler pool
-	VkDescriptorPoolSize samplerPoolSize = {};
-	samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerPoolSize.descriptorCount = MAX_TEXTURES;
+	// Transient sets: everything allocated for this frame last time is released at once
+	frame.descriptorAllocator->resetPools();
 
-	VkDescriptorPoolCreateInfo samplerPoolCreateInfo = {};
-	samplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	samplerPoolCreateInfo.maxSets = MAX_TEXTURES;
-	samplerPoolCreateInfo.poolSizeCount = 1;
-	samplerPoolCreateInfo.pPoolSizes = &samplerPoolSize;
+	// UNIFORM VALUES DESCRIPTOR SET
+	frame.descriptorSet = frame.descriptorAllocator->allocate(descriptorSetLayout);
 
-	if (!samplerDescriptorPool) {
-		result = vkCreateDescriptorPool(m_Device->device(), &samplerPoolCreateInfo, nullptr, &samplerDescriptorPool);
-	}
+	// One entry per binding, in binding order (see DescriptorLayoutCache::getUpdateTemplate)
+	std::array<DescriptorUpdateEntry, 3> uniformEntries = {};
 
-	printf("---- vkCreateDescriptorPool samplerDescriptorPool\n");
+	// VIEW PROJECTION DESCRIPTOR UboViewProjection
+	uniformEntries[0].buffer.buffer = frame.vpUniformBuffer;    // Buffer to get data from
+	uniformEntries[0].buffer.offset = 0;                        // Position of start of data
+	uniformEntries[0].buffer.range = sizeof(UboViewProjection); // Size of data
 
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a Descriptor Pool!");
-	}
+	// MODEL DESCRIPTOR (Model struct, dynamic offset selects the object)
+	uniformEntries[1].buffer.buffer = frame.modelDynUniformBuffer;
+	uniformEntries[1].buffer.offset = 0;
+	uniformEntries[1].buffer.range = modelUniformAlignment;
 
-	printf("Vulkan Descriptor Pool (Samplers) successfully created.\n");
+	// OBJECT TRANSFORMS DESCRIPTOR
+	uniformEntries[2].buffer.buffer = frame.modelStorageBuffer;
+	uniformEntries[2].buffer.offset = 0;
+	uniformEntries[2].buffer.range = VK_WHOLE_SIZE;
 
+	m_DescriptorLayoutCache->updateDescriptorSet(frame.descriptorSet, descriptorSetLayout, uniformEntries.data());
 
-	// CREATE INPUT ATTACHMENT DESCRIPTOR POOL
-	// Color Attachment Pool Size
-	VkDescriptorPoolSize colorInputPoolSize = {};
-	colorInputPoolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-	colorInputPoolSize.descriptorCount = static_cast<uint32_t>(m_SwapChain->getColorBufferImageViews().size());
+	// INPUT ATTACHMENT DESCRIPTOR SET
+	// One set of attachments serves every frame, the set belongs to the frame
+	frame.inputDescriptorSet = frame.descriptorAllocator->allocate(inputSetLayout);
 
-	VkDescriptorPoolSize depthInputPoolSize = {};
-	depthInputPoolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-	depthInputPoolSize.descriptorCount = static_cast<uint32_t>(m_SwapChain->getDepthBufferImageViews().size());
+	std::array<DescriptorUpdateEntry, 2> inputEntries = {};
 
-	std::vector<VkDescriptorPoolSize> inputPoolSizes = { colorInputPoolSize, depthInputPoolSize };
+	// Color Attachment Descriptor
+	inputEntries[0].image.imageLayout = m_SwapChain->getColorBufferReadLayout(); // Layout the render graph reads it in
+	inputEntries[0].image.imageView = m_SwapChain->getColorBufferImageView();
+	inputEntries[0].image.sampler = sceneSampled ? compositeSampler : VK_NULL_HANDLE;
 
-	// Create input attachment pool
-	VkDescriptorPoolCreateInfo inputPoolCreateInfo = {};
-	inputPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	inputPoolCreateInfo.maxSets = static_cast<uint32_t>(m_SwapChain->getSwapChainImages().size());
-	inputPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(inputPoolSizes.size());
-	inputPoolCreateInfo.pPoolSizes = inputPoolSizes.data();
+	// Depth Attachment Descriptor
+	inputEntries[1].image.imageLayout = m_SwapChain->getDepthBufferReadLayout();
+	inputEntries[1].image.imageView = m_SwapChain->getDepthBufferImageView();
+	inputEntries[1].image.sampler = sceneSampled ? compositeSampler : VK_NULL_HANDLE;
 
-	result = vkCreateDescriptorPool(m_Device->device(), &inputPoolCreateInfo, nullptr, &inputDescriptorPool);
-
-	printf("---- vkCreateDescriptorPool inputDescriptorPool\n");
-
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a Descriptor Pool!");
-	}
-
-	printf("Vulkan Descriptor Pool (Input Attachments) successfully created.\n");
+	m_DescriptorLayoutCache->updateDescriptorSet(frame.inputDescriptorSet, inputSetLayout, inputEntries.data());
 }
 
-void VulkanRenderer::createDescriptorSets()
+void VulkanRenderer::recreateSwapChain()
 {
-	// Resize Descriptor Set list so one for every buffer
-	descriptorSets.resize(m_SwapChain->getSwapChainImages().size());
+	printf("-------- BEGIN recreateSwapChain\n");
 
-	std::vector<VkDescriptorSetLayout> setLayouts(m_SwapChain->getSwapChainImages().size(), descriptorSetLayout);
+	auto extent = m_Window->getExtent();
 
-	// Descriptor Set Allocation Info
-	VkDescriptorSetAllocateInfo setAllocInfo = {};
-	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocInfo.descriptorPool = descriptorPool;                                                      // Pool to allocate Descriptor Set from
-	setAllocInfo.descriptorSetCount = static_cast<uint32_t>(m_SwapChain->getSwapChainImages().size()); // Number of sets to allocate
-	setAllocInfo.pSetLayouts = setLayouts.data();                                                      // Layouts to use to allocate sets (1:1 relationship)
+	// Minimized. The render thread can not wait for GLFW events (main thread only), it polls the size instead.
+	while (extent.width == 0 || extent.height == 0) {
+		if (renderThreadRunning) {
+			if (renderThreadStop) {
+				return;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		else {
+			glfwWaitEvents();
+		}
+		extent = m_Window->getExtent();
+	}
 
-	// Allocate descriptor sets
-	VkResult result = vkAllocateDescriptorSets(m_Device->device(), &setAllocInfo, descriptorSets.data());
+	auto recreateStart = std::chrono::steady_clock::now();
 
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate Descriptor Sets!");
-	}
+	// Everything requested so far is handled by this recreation
+	resizePending = false;
+	swapChainPolicyChanged = false;
+	m_Window->resetWindowResizedFlag();
 
-	printf("Vulkan Descriptor Sets successfully allocated from the Descriptor Pool.\n");
+	// Only the extent dependent parts are rebuilt: swapchain images, color/depth attachments and framebuffers.
+	// The old swapchain is handed over (oldSwapchain), nothing waits for the GPU here: frames still in flight keep
+	// using the old images, attachments and framebuffers, which are destroyed once the last submitted frame completes.
+	// Input attachment descriptors point at the new attachments because they are written every frame.
+	bool sampled = dynamicResolution.getSettings().enabled;
+	std::shared_ptr<SwapChain> oldSwapChain = std::move(m_SwapChain);
+	m_SwapChain = std::make_unique<SwapChain>(m_Device, extent, oldSwapChain, m_Window, m_FrameScheduler, framesInFlight,
+		latencyPolicy.presentMode, latencyPolicy.swapchainImageCount, m_FrameReadback != nullptr, sampled);
+	reportReadbackSupport();
 
-	// Update all of descriptor set buffer bindings
-	// Connect descriptorSets and uniformBuffer(s)
-	for (size_t i = 0; i < m_SwapChain->getSwapChainImages().size(); i++)
+	// The old render pass goes away with the old swapchain, pipelines still compiling against it have to finish first
+	// (by then they usually have)
+	m_FrameScheduler->onFrameComplete(m_FrameScheduler->getSubmittedFrame(), [this, oldSwapChain]() mutable
 	{
-		// VIEW PROJECTION DESCRIPTOR UboViewProjection
-		// Buffer info and data offset info
-		VkDescriptorBufferInfo vpBufferInfo = {};
-		vpBufferInfo.buffer = vpUniformBuffer[i];       // Buffer to get data from
-		vpBufferInfo.offset = 0;                        // Position of start of data
-		vpBufferInfo.range = sizeof(UboViewProjection); // Size of data
-
-		// Data about connection between binding and buffer
-		VkWriteDescriptorSet vpSetWrite = {};
-		vpSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		vpSetWrite.dstSet = descriptorSets[i];                         // Descriptor Set to update
-		vpSetWrite.dstBinding = 0;                                     // Binding to update (matches with binding on layout/shader)
-		vpSetWrite.dstArrayElement = 0;                                // Index in array to update
-		vpSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // Type of descriptor
-		vpSetWrite.descriptorCount = 1;                                // Amount to update
-		vpSetWrite.pBufferInfo = &vpBufferInfo;                        // Information about buffer data to bind
-
-		//	// Buffer info and data offset info
-		//	VkDescriptorBufferInfo vpBufferInfoUniVar = {};
-		//	vpBufferInfoUniVar.buffer = vpUniformBufferUniVar[i];     // Buffer to get data from
-		//	vpBufferInfoUniVar.offset = 0;                        // Position of start of data
-		//	vpBufferInfoUniVar.range = sizeof(UniformVariables); // Size of data
-		//	
-		//	// Data about connection between binding and buffer
-		//	VkWriteDescriptorSet vpSetWriteUniVar = {};
-		//	vpSetWriteUniVar.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		//	vpSetWriteUniVar.dstSet = descriptorSets[i];                         // Descriptor Set to update
-		//	vpSetWriteUniVar.dstBinding = 0;                                     // Binding to update (matches with binding on layout/shader)
-		//	vpSetWriteUniVar.dstArrayElement = 0;                                // Index in array to update
-		//	vpSetWriteUniVar.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // Type of descriptor
-		//	vpSetWriteUniVar.descriptorCount = 1;                                // Amount to update
-		//	vpSetWriteUniVar.pBufferInfo = &vpBufferInfoUniVar;                        // Information about buffer data to bind
-
-		//	MODEL DESCRIPTOR
-		//	Model Buffer Binding Info (Model struct)
-		//	VkDescriptorBufferInfo modelBufferInfo = {};
-		//	modelBufferInfo.buffer = modelDynUniformBuffer[i]; // Buffer to get data from
-		//	modelBufferInfo.offset = 0;                        // Position of start of data
-		//	modelBufferInfo.range = modelUniformAlignment;     // Size of data
-		//	
-		//	VkWriteDescriptorSet modelSetWrite = {};
-		//	modelSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		//	modelSetWrite.dstSet = descriptorSets[i];                                 // Descriptor Set to update
-		//	modelSetWrite.dstBinding = 1;                                             // Binding to update (matches with binding on layout/shader)
-		//	modelSetWrite.dstArrayElement = 0;                                        // Index in array to update
-		//	modelSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC; // Type of descriptor
-		//	modelSetWrite.descriptorCount = 1;                                        // Amount to update
-		//	modelSetWrite.pBufferInfo = &modelBufferInfo;                             // Information about buffer data to bind
-
-		// List of Descriptor Set Writes
-		std::vector<VkWriteDescriptorSet> setWrites = { vpSetWrite }; // vpSetWrite, vpSetWriteUniVar, modelSetWrite
-
-		// Update the descriptor sets with new buffer/binding info
-		vkUpdateDescriptorSets(m_Device->device(), static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
-	}
-}
-
-void VulkanRenderer::createInputDescriptorSets()
-{
-	// Resize array to hold descriptor set for each swap chain image
-	inputDescriptorSets.resize(m_SwapChain->getSwapChainImages().size());
-
-	// Fill array of layouts ready for set creation
-	std::vector<VkDescriptorSetLayout> setLayouts(m_SwapChain->getSwapChainImages().size(), inputSetLayout);
-
-	// Input Attachment Descriptor Set Allocation Info
-	VkDescriptorSetAllocateInfo setAllocInfo = {};
-	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocInfo.descriptorPool = inputDescriptorPool;
-	setAllocInfo.descriptorSetCount = static_cast<uint32_t>(m_SwapChain->getSwapChainImages().size());
-	setAllocInfo.pSetLayouts = setLayouts.data();
-
-	// Allocate Descriptor Set
-	VkResult result = vkAllocateDescriptorSets(m_Device->device(), &setAllocInfo, inputDescriptorSets.data());
+		m_Device->pipelineRegistry().waitForPendingPipelines(*m_JobSystem);
+		oldSwapChain.reset();
+	});
 
-	if (result != VK_SUCCESS)
+	// Pipelines use dynamic viewport/scissor, they only need a rebuild if the render pass is no longer compatible:
+	// the surface format changed, or dynamic resolution was switched (other subpasses, other composite shader and set
+	// layout). Rare, the frames in flight still bind the old pipelines: drain them first.
+	if (m_SwapChain->getSwapChainImageFormat() != pipelineColorFormat || sampled != sceneSampled)
 	{
-		throw std::runtime_error("Failed to allocate Descriptor Sets (Input Attachments)!");
+		m_FrameScheduler->flush();
+		if (sampled != sceneSampled)
+		{
+			sceneSampled = sampled;
+			createSceneSetLayout();
+		}
+		destroyGraphicsPipelines();
+		createGraphicsPipeline();
 	}
 
-	printf("Vulkan Descriptor Sets (Input Attachments) successfully allocated from the Descriptor Pool.\n");
+	updateProjection();
 
-	// Update each descriptor set with input attachment
-	for (size_t i = 0; i < m_SwapChain->getSwapChainImages().size(); i++)
+	lastRecreateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recreateStart).count();
+
+	if (resizeBenchmark.running)
 	{
-		// Color Attachment Descriptor
-		VkDescriptorImageInfo colorAttachmentDescriptor = {};
-		colorAttachmentDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		colorAttachmentDescriptor.imageView = m_SwapChain->getColorBufferImageViews()[i];
-		colorAttachmentDescriptor.sampler = VK_NULL_HANDLE;
-
-		// Color Attachment Descriptor Write
-		VkWriteDescriptorSet colorWrite = {};
-		colorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		colorWrite.dstSet = inputDescriptorSets[i];
-		colorWrite.dstBinding = 0;
-		colorWrite.dstArrayElement = 0;
-		colorWrite.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-		colorWrite.descriptorCount = 1;
-		colorWrite.pImageInfo = &colorAttachmentDescriptor;
-
-		// Depth Attachment Descriptor
-		VkDescriptorImageInfo depthAttachmentDescriptor = {};
-		depthAttachmentDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		depthAttachmentDescriptor.imageView = m_SwapChain->getDepthBufferImageViews()[i];
-		depthAttachmentDescriptor.sampler = VK_NULL_HANDLE;
-
-		// Depth Attachment Descriptor Write
-		VkWriteDescriptorSet depthWrite = {};
-		depthWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		depthWrite.dstSet = inputDescriptorSets[i];
-		depthWrite.dstBinding = 1;
-		depthWrite.dstArrayElement = 0;
-		depthWrite.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-		depthWrite.descriptorCount = 1;
-		depthWrite.pImageInfo = &depthAttachmentDescriptor;
-
-		// List of input descriptor writes
-		std::vector<VkWriteDescriptorSet> setWrites = { colorWrite, depthWrite };
-
-		// Update descriptor sets
-		vkUpdateDescriptorSets(m_Device->device(), static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+		resizeBenchmark.recreatedLastFrame = true;
+		resizeBenchmark.recreates++;
+		resizeBenchmark.recreateMs += lastRecreateMs;
+		resizeBenchmark.recreateMaxMs = std::max(resizeBenchmark.recreateMaxMs, lastRecreateMs);
 	}
+
+	printf("Swapchain recreated: %ix%i, present mode %s, %i images, %.3f ms.\n",
+		(int)m_SwapChain->getSwapChainExtent().width, (int)m_SwapChain->getSwapChainExtent().height,
+		SwapChain::getPresentModeName(m_SwapChain->getPresentMode()), (int)m_SwapChain->getImageCount(), lastRecreateMs);
+
+	printf("-------- END recreateSwapChain\n");
 }
 
-void VulkanRenderer::recreateSwapChain()
+void VulkanRenderer::createFrameResources()
 {
-	printf("-------- BEGIN recreateSwapChain\n");
+	createFrameContexts();
+	createFrameCommandPools();
+	createUniformBuffers();
+	createDescriptorAllocators();
 
-	auto extent = m_Window->getExtent();
+	m_GpuTimer = std::make_unique<GpuTimer>(m_Device, static_cast<uint32_t>(frames.size()));
+}
 
-	while (extent.width == 0 || extent.height == 0) {
-		extent = m_Window->getExtent();
-		glfwWaitEvents();
+void VulkanRenderer::createFrameReadback()
+{
+	FrameReadback::Callback callback;
+	uint32_t requestedBufferCount = 0;
+	{
+		std::lock_guard<std::mutex> lock(readbackMutex);
+		readbackRequested = false;
+		callback = readbackCallback;
+		requestedBufferCount = readbackBufferCount;
 	}
+	if (!callback || m_FrameReadback != nullptr) return;
 
-	vkDeviceWaitIdle(m_Device->device());
+	// Copies in flight, one handed over late (frames are noticed complete at the next submission) and one converting
+	uint32_t bufferCount = requestedBufferCount > 0 ? requestedBufferCount : framesInFlight + 2;
+	m_FrameReadback = std::make_unique<FrameReadback>(m_Device, m_FrameScheduler, bufferCount, callback);
+	m_FrameReadback->setWaitWhenFull(readbackWaitWhenFull);
+}
 
-	if (m_SwapChain == nullptr) {
-		m_SwapChain = std::make_unique<SwapChain>(m_Device, extent, nullptr, m_Window);
-	}
-	else {
-		cleanupOnRecreateSwapChain();
-		m_SwapChain = std::make_unique<SwapChain>(m_Device, extent, std::move(m_SwapChain), m_Window);
+void VulkanRenderer::reportReadbackSupport()
+{
+	if (m_FrameReadback != nullptr && !m_SwapChain->isReadbackSupported())
+	{
+		printf("Frame readback: swapchain images can not be copied from (format %i), no frames will be read back.\n",
+			(int)m_SwapChain->getSwapChainImageFormat());
 	}
-
-	createDescriptorSetLayout();
-	createPushConstantRange();
-
-	// if render pass compatible do nothing else
-	createGraphicsPipeline();
-
-	// freeCommandBuffers();
-	createCommandBuffers();
-	createTextureSampler();
-	createUniformBuffers();
-	createDescriptorPool();
-	createDescriptorSets();
-	createInputDescriptorSets();
-
-	printf("-------- END recreateSwapChain\n");
 }
 
-void VulkanRenderer::freeCommandBuffers()
+void VulkanRenderer::updateProjection()
 {
-	vkFreeCommandBuffers(
-		m_Device->device(),
-		m_Device->getCommandPool(),
-		static_cast<uint32_t>(commandBuffers.size()),
-		commandBuffers.data());
+	float aspectRatio = (float)m_SwapChain->getSwapChainExtent().width / (float)m_SwapChain->getSwapChainExtent().height;
 
-	commandBuffers.clear();
+	uboViewProjection.projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 100.f);
+
+	// Vulkan inverts Y axis
+	uboViewProjection.projection[1][1] *= -1;
 }
 
-void VulkanRenderer::updateUniformBuffers(uint32_t imageIndex)
+void VulkanRenderer::updateUniformBuffers(uint32_t frameIndex)
 {
+	FrameContext& frame = frames[frameIndex];
+
 	// Copy ViewProjection data (UboViewProjection)
 	void* data;
-	vkMapMemory(m_Device->device(), vpUniformBufferMemory[imageIndex], 0, sizeof(UboViewProjection), 0, &data);
+	vkMapMemory(m_Device->device(), frame.vpUniformBufferMemory, 0, sizeof(UboViewProjection), 0, &data);
 	memcpy(data, &uboViewProjection, sizeof(UboViewProjection));
-	vkUnmapMemory(m_Device->device(), vpUniformBufferMemory[imageIndex]);
+	vkUnmapMemory(m_Device->device(), frame.vpUniformBufferMemory);
 
 	// void* dataUniVar;
 	// vkMapMemory(m_Device->device(), vpUniformBufferMemoryUniVar[imageIndex], 0, sizeof(UniformVariables), 0, &dataUniVar);
 	// memcpy(data, &uniformVariables, sizeof(UniformVariables));
 	// vkUnmapMemory(m_Device->device(), vpUniformBufferMemoryUniVar[imageIndex]);
 
-	// Copy Model data (Model struct)
-	// for (size_t i = 0; i < meshList.size(); i++)
-	// {
-	// 	Model* thisModel = (Model*)((uint64_t)modelTransferSpace + (i * modelUniformAlignment));
-	// 	*thisModel = meshList[i].getModel();
-	// }
-
-	// Map the list of model data
-	// vkMapMemory(m_Device->device(), modelDynUniformBufferMemory[imageIndex], 0, modelUniformAlignment * meshList.size(), 0, &data);
-	// memcpy(data, modelTransferSpace, modelUniformAlignment * meshList.size());
-	// vkUnmapMemory(m_Device->device(), modelDynUniformBufferMemory[imageIndex]);
+	// Copy Model data, only the buffer of the path recorded this frame is read by the shader
+	if (frame.recordedObjectDataPath == ObjectDataPath::DynamicUniform)
+	{
+		for (size_t i = 0; i < modelList.size(); i++)
+		{
+			Model* thisModel = (Model*)((uint8_t*)frame.modelDynUniformBufferMapped + (i * modelUniformAlignment));
+			thisModel->model = modelList[i].getModel();
+		}
+	}
+	else if (frame.recordedObjectDataPath == ObjectDataPath::StorageBuffer)
+	{
+		glm::mat4* objectTransforms = (glm::mat4*)frame.modelStorageBufferMapped;
+		for (size_t i = 0; i < modelList.size(); i++)
+		{
+			objectTransforms[i] = modelList[i].getModel();
+		}
+	}
 }
 
-void VulkanRenderer::recordCommands(uint32_t currentImage)
+void VulkanRenderer::recordCommands(uint32_t frameIndex, uint32_t imageIndex)
 {
+	FrameContext& frame = frames[frameIndex];
+	VkCommandBuffer commandBuffer = frame.commandBuffer;
+
 	// Information about how to begin each command buffer
 	VkCommandBufferBeginInfo bufferBeginInfo = {};
 	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-	// Information about how to begin a render pass (only needed for graphical applications)
-	VkRenderPassBeginInfo renderPassBeginInfo = {};
-	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassBeginInfo.renderPass = m_SwapChain->getRenderPass(); // Render Pass to begin
-	renderPassBeginInfo.renderArea.offset = { 0, 0 };              // Start point of render pass in pixels
-	renderPassBeginInfo.renderArea.extent = m_SwapChain->getSwapChainExtent(); // Size of region to run render pass on (starting at offset)
-
-	std::array<VkClearValue, 3> clearValues = {};
-	clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-	clearValues[1].color = { 0.29f, 0.14f, 0.35f, 1.0f };
-	clearValues[2].depthStencil.depth = 1.0f;
-
-	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size()); // Count of clear values
-	renderPassBeginInfo.pClearValues = clearValues.data();                           // List of clear values
-
-	renderPassBeginInfo.framebuffer = m_SwapChain->getFrameBuffer(currentImage);
+	bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; // Re-recorded every frame after its pool is reset
 
 	// Start recording commands to command buffer
-	VkResult result = vkBeginCommandBuffer(commandBuffers[currentImage], &bufferBeginInfo);
+	VkResult result = vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo);
 
 	if (result != VK_SUCCESS)
 	{
@@ -1778,112 +2173,146 @@ void VulkanRenderer::recordCommands(uint32_t currentImage)
 
 	// printf("Command Buffer begin recording.\n");
 
+	// The selected path's pipeline may still be compiling: draw with the fallback path instead, or skip the models
+	ObjectDataPath drawPath = objectDataPath;
+	bool drawModels = true;
+	if (graphicsPipelines[(int)drawPath] == nullptr)
 	{
-		// Begin Render Pass
-		vkCmdBeginRenderPass(commandBuffers[currentImage], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
+		if (pipelineFallbackPolicy == PipelineFallbackPolicy::UseFallback)
+		{
+			drawPath = fallbackObjectDataPath;
+		}
+		else
 		{
-			// Start 1st Subpass
+			drawModels = false;
+		}
+	}
 
-			// Bind Pipeline to be used in Render Pass (1st Subpass)
-			vkCmdBindPipeline(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	// Remember which path this command buffer uses, so its GPU time is attributed correctly when read back.
+	// The model draws and the uniform buffer update of this frame follow it as well.
+	frame.recordedObjectDataPath = drawPath;
+	frame.recordedFallback = !drawModels || drawPath != objectDataPath;
+	frame.recordedFrameNumber = renderedFrames;
+	lastFrameStats.objectDataPath = drawPath;
+	lastFrameStats.fallback = frame.recordedFallback;
+
+	// The depth pre-pass needs both of its pipelines for the path, until then its subpass stays empty
+	// and the geometry pass tests and writes depth itself
+	frame.recordedDepthPrepass = depthPrepass && depthPrepassPipelines[(int)drawPath] != nullptr && depthEqualPipelines[(int)drawPath] != nullptr;
+
+	m_GpuTimer->begin(commandBuffer, frameIndex);
+
+	// 1st subpass: the models are split over the recording jobs, each job records its share into
+	// a secondary command buffer from its own pool, the primary buffer only executes them
+	uint32_t modelCount = drawModels ? static_cast<uint32_t>(modelList.size()) : 0;
+	uint32_t jobCount = std::min(recordingJobCount, modelCount);
+	std::vector<VkCommandBuffer> secondaryBuffers(jobCount);
+	std::vector<VkCommandBuffer> prepassSecondaryBuffers(frame.recordedDepthPrepass ? jobCount : 0);
+	std::vector<CommandStateTracker::Stats> prepassCommandStats(prepassSecondaryBuffers.size());
+
+	m_JobSystem->parallelFor(jobCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t job = begin; job < end; job++)
+		{
+			uint32_t firstModel = modelCount * job / jobCount;
+			uint32_t endModel = modelCount * (job + 1) / jobCount;
 
-			for (size_t j = 0; j < modelList.size(); j++)
+			// Same models for the pre-pass, a buffer of its own (different subpass)
+			if (frame.recordedDepthPrepass)
 			{
-				MeshModel thisModel = modelList[j];
-
-				// "Push" constants to given shader stage directly (no buffer)
-				VkShaderStageFlags stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-				vkCmdPushConstants(
-					commandBuffers[currentImage],
-					pipelineLayout,
-					stageFlags,           // Stage to push constants to
-					0,                    // Offset of push constants to update
-					sizeof(Model),        // Size of data being pushed
-					&thisModel.getModel() // Actual data being pushed (can be array)
-				);
-
-				// printf("MeshModel->getMeshCount: %i\n", (int)thisModel.getMeshCount());
-
-				for (size_t k = 0; k < thisModel.getMeshCount(); k++)
-				{
-					// printf("MeshModel->getIndexCount: %i\n", thisModel.getMesh(k)->getIndexCount());
-
-					// Bind Vertex Buffer
-					VkBuffer vertexBuffers[] = { thisModel.getMesh(k)->getVertexBuffer() }; // Vertex Buffers to bind
-					VkDeviceSize offsets[] = { 0 };                                         // Offsets into buffers being bound
-					vkCmdBindVertexBuffers(commandBuffers[currentImage], 0, 1, vertexBuffers, offsets); // Command to bind vertex buffer before drawing with them
-
-					// Bind mesh Index Buffer, with 0 offset and using the uint32 type
-					VkBuffer indexBuffer = thisModel.getMesh(k)->getIndexBuffer(); // Index Buffer to bind
-					VkDeviceSize offset = 0;                                       // Offsets into buffers being bound
-					vkCmdBindIndexBuffer(commandBuffers[currentImage], indexBuffer, offset, VK_INDEX_TYPE_UINT32);
-
-					// Dynamic Offset Amount
-					uint32_t dynamicOffset = 0;
-					uint32_t* dynamicOffsetPointer = nullptr;
-					uint32_t dynamicOffsetCount = 0; // value 0 for Push Constants
-					// dynamicOffset = static_cast<uint32_t>(modelUniformAlignment) * (uint32_t)j;
-					// dynamicOffsetPointer = &dynamicOffset;
-					// dynamicOffsetCount = 1; // value 1 for Uniform Buffer Dynamic
-
-					std::array<VkDescriptorSet, 2> descriptorSetGroup =
-					{
-						descriptorSets[currentImage],
-						samplerDescriptorSets[thisModel.getMesh(k)->getTexId()]
-					};
-
-					// Bind Descriptor Sets (Uniform Buffers and Texture Samplers)
-					vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
-						static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), dynamicOffset, dynamicOffsetPointer);
-
-					// Execute pipeline
-					// vkCmdDraw(commandBuffers[i], static_cast<uint32_t>(firstMesh.getVertexCount()), 1, 0, 0);
-					vkCmdDrawIndexed(commandBuffers[currentImage], static_cast<uint32_t>(thisModel.getMesh(k)->getIndexCount()), 1, 0, 0, 0);
-				}
+				prepassSecondaryBuffers[job] = recordModelDraws(frameIndex, imageIndex, job, firstModel, endModel, true);
+				prepassCommandStats[job] = m_JobCommandStates[job].getStats();
 			}
 
-			// Bind vertices
-			// vkCmdDraw - another draw command for different geometry
-
-			// vkCmdBindPipeline - Bind another pipeline
+			secondaryBuffers[job] = recordModelDraws(frameIndex, imageIndex, job, firstModel, endModel, false);
 		}
+	});
+
+	// All binds go through the state tracker, which skips the ones that would not change anything
+	m_CommandState.begin(commandBuffer);
 
+	// The geometry pass only covers the part of the scene attachments rendered at this frame's resolution
+	m_SwapChain->getRenderGraph().setRenderArea(m_SwapChain->getGeometryPass(), frame.renderExtent);
+
+	// The render graph begins, advances and ends the render passes (clear values, framebuffer of this swapchain image),
+	// each pass only records its own commands
+	m_SwapChain->getRenderGraph().execute(commandBuffer, imageIndex, [&](RenderGraph::PassId pass, VkCommandBuffer passCommandBuffer)
+	{
+		if (pass == m_SwapChain->getDepthPrepass())
 		{
-			// Stard 2nd Subpass
-			vkCmdNextSubpass(commandBuffers[currentImage], VK_SUBPASS_CONTENTS_INLINE);
+			// Empty while the pre-pass is off
+			if (!prepassSecondaryBuffers.empty())
+			{
+				vkCmdExecuteCommands(passCommandBuffer, static_cast<uint32_t>(prepassSecondaryBuffers.size()), prepassSecondaryBuffers.data());
+			}
+		}
+		else if (pass == m_SwapChain->getGeometryPass())
+		{
+			// Secondary command buffers only, nothing to execute when there are no models
+			if (jobCount > 0)
+			{
+				vkCmdExecuteCommands(passCommandBuffer, jobCount, secondaryBuffers.data());
+			}
+		}
+		else if (pass == m_SwapChain->getCompositePass())
+		{
+			// Full resolution, the scene attachments are upscaled to the swapchain image (dynamic resolution)
+			recordViewportAndScissor(passCommandBuffer, m_SwapChain->getSwapChainExtent());
 
-			vkCmdBindPipeline(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, secondPipeline);
+			m_CommandState.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, secondPipeline->pipeline);
 
-			// "Push" constants to given shader stage directly (no buffer)
+			// Viewport split and depth range are baked into the pipeline (specialization constants), only the rendered region is pushed
+			CompositePushConstant compositePushConstant;
+			compositePushConstant.renderSize = glm::vec2((float)frame.renderExtent.width, (float)frame.renderExtent.height);
+			m_CommandState.pushConstants(secondPipelineLayout->layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(CompositePushConstant), &compositePushConstant);
 
-			uniformVariables.ViewportWidth = (int)m_SwapChain->getSwapChainExtent().width;
+			// Bind Descriptor Sets (Input Attachment Descriptor Set)
+			m_CommandState.bindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, secondPipelineLayout->layout, 0, frame.inputDescriptorSet);
 
-			VkShaderStageFlags stageFlagsUniVar = VK_SHADER_STAGE_FRAGMENT_BIT;
-			vkCmdPushConstants(
-				commandBuffers[currentImage],
-				secondPipelineLayout,
-				stageFlagsUniVar,         // Stage to push constants to
-				0,                        // Offset of push constants to update
-				sizeof(UniformVariables), // Size of data being pushed
-				&uniformVariables         // Actual data being pushed (can be array)
-			);
+			vkCmdDraw(passCommandBuffer, 3, 1, 0, 0);
+		}
+	});
 
-			// printf("-------- vkCmdPushConstants uniformVariables.ViewportWidth: %i\n", uniformVariables.ViewportWidth);
+	// Copy of the finished image for the CPU, read back a few frames later without a wait
+	if (m_FrameReadback != nullptr && readbackEnabled && renderedFrames % readbackInterval == 0 && m_SwapChain->isReadbackSupported())
+	{
+		m_FrameReadback->recordCopy(commandBuffer, m_SwapChain->getSwapChainImages()[imageIndex], m_SwapChain->getImageFinalLayout(),
+			m_SwapChain->getSwapChainImageFormat(), m_SwapChain->getSwapChainExtent());
+	}
 
-			// Bind Descriptor Sets (Input Attachment Descriptor Set)
-			vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, secondPipelineLayout, 0,
-				1, &inputDescriptorSets[currentImage], 0, nullptr);
+	m_GpuTimer->end(commandBuffer, frameIndex);
 
-			vkCmdDraw(commandBuffers[currentImage], 3, 1, 0, 0);
+	// Draws of the recording jobs plus the composite triangle
+	lastFrameStats.drawCalls = 1;
+	lastFrameStats.triangles = 1;
+	for (uint32_t job = 0; job < jobCount; job++)
+	{
+		for (uint32_t pass = 0; pass < (frame.recordedDepthPrepass ? 2u : 1u); pass++)
+		{
+			lastFrameStats.drawCalls += m_JobDrawStats[job * 2 + pass].drawCalls;
+			lastFrameStats.triangles += m_JobDrawStats[job * 2 + pass].triangles;
 		}
+	}
 
-		// End Render Pass
-		vkCmdEndRenderPass(commandBuffers[currentImage]);
+	// Report the bind counts whenever they change (e.g. model added, object data path switched)
+	CommandStateTracker::Stats commandStats = m_CommandState.getStats();
+	for (uint32_t job = 0; job < jobCount; job++)
+	{
+		commandStats += m_JobCommandStates[job].getStats();
+	}
+	for (const CommandStateTracker::Stats& stats : prepassCommandStats)
+	{
+		commandStats += stats;
+	}
+
+	if (commandStats != lastCommandStats)
+	{
+		lastCommandStats = commandStats;
+		printCommandStats();
 	}
 
 	// Stop recording to command buffer
-	result = vkEndCommandBuffer(commandBuffers[currentImage]);
+	result = vkEndCommandBuffer(commandBuffer);
 
 	if (result != VK_SUCCESS)
 	{
@@ -1893,6 +2322,141 @@ void VulkanRenderer::recordCommands(uint32_t currentImage)
 	// printf("Command Buffer end recording.\n");
 }
 
+VkCommandBuffer VulkanRenderer::recordModelDraws(uint32_t frameIndex, uint32_t imageIndex, uint32_t job, uint32_t firstModel, uint32_t endModel, bool prepassDraws)
+{
+	FrameContext& frame = frames[frameIndex];
+
+	// Pool and state tracker of this job only, so jobs never share anything that needs a lock
+	VkCommandBuffer commandBuffer = frame.commandPools[1 + job]->allocate(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+	CommandStateTracker& commandState = m_JobCommandStates[job];
+	ObjectDataPath drawPath = frame.recordedObjectDataPath;
+
+	// Secondary buffers continue the render pass of the primary buffer (depth pre-pass or geometry pass)
+	RenderGraph& renderGraph = m_SwapChain->getRenderGraph();
+	RenderGraph::PassId pass = prepassDraws ? m_SwapChain->getDepthPrepass() : m_SwapChain->getGeometryPass();
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderGraph.getRenderPass(pass);
+	inheritanceInfo.subpass = renderGraph.getSubpass(pass);
+	inheritanceInfo.framebuffer = renderGraph.getFramebuffer(pass, imageIndex);
+
+	VkCommandBufferBeginInfo bufferBeginInfo = {};
+	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	bufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	VkResult result = vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to start recording a Secondary Command Buffer!");
+	}
+
+	// Secondary buffers start without any dynamic state. The scene is rendered at this frame's resolution.
+	recordViewportAndScissor(commandBuffer, frame.renderExtent);
+
+	commandState.begin(commandBuffer);
+
+	// Bind Pipeline to be used in Render Pass (1st Subpass). After a pre-pass the depth is already final (EQUAL, no writes).
+	const PipelineRegistry::PipelineRef& pipeline = prepassDraws ? depthPrepassPipelines[(int)drawPath] :
+		frame.recordedDepthPrepass ? depthEqualPipelines[(int)drawPath] : graphicsPipelines[(int)drawPath];
+	commandState.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+
+	// This job's slot only, summed by recordCommands once every job is done
+	FrameStats& drawStats = m_JobDrawStats[job * 2 + (prepassDraws ? 1 : 0)];
+	drawStats.drawCalls = 0;
+	drawStats.triangles = 0;
+
+	for (uint32_t j = firstModel; j < endModel; j++)
+	{
+		MeshModel& thisModel = modelList[j];
+
+		if (!thisModel.isVisible()) continue;
+
+		if (drawPath == ObjectDataPath::PushConstant)
+		{
+			// "Push" constants to given shader stage directly (no buffer)
+			VkShaderStageFlags stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+			commandState.pushConstants(
+				pipelineLayout->layout,
+				stageFlags,           // Stage to push constants to
+				0,                    // Offset of push constants to update
+				sizeof(Model),        // Size of data being pushed
+				&thisModel.getModel() // Actual data being pushed (can be array)
+			);
+		}
+
+		for (size_t k = 0; k < thisModel.getMeshCount(); k++)
+		{
+			// Bind Vertex Buffer (the pre-pass only fetches positions)
+			VkBuffer vertexBuffer = prepassDraws ? thisModel.getMesh(k)->getPositionBuffer() : thisModel.getMesh(k)->getVertexBuffer(); // Vertex Buffer to bind
+			VkDeviceSize vertexOffset = 0;                                   // Offset into buffer being bound
+			commandState.bindVertexBuffer(0, vertexBuffer, vertexOffset);     // Command to bind vertex buffer before drawing with them
+
+			// Bind mesh Index Buffer, with 0 offset and using the uint32 type
+			VkBuffer indexBuffer = thisModel.getMesh(k)->getIndexBuffer(); // Index Buffer to bind
+			VkDeviceSize offset = 0;                                       // Offsets into buffers being bound
+			commandState.bindIndexBuffer(indexBuffer, offset, VK_INDEX_TYPE_UINT32);
+
+			// Dynamic Offset Amount
+			// The layout always contains the dynamic uniform buffer binding, so one offset is always required,
+			// it is only meaningful on the Dynamic Uniform path
+			uint32_t dynamicOffset = 0;
+			if (drawPath == ObjectDataPath::DynamicUniform)
+			{
+				dynamicOffset = static_cast<uint32_t>(modelUniformAlignment) * j;
+			}
+			uint32_t* dynamicOffsetPointer = &dynamicOffset;
+			uint32_t dynamicOffsetCount = 1;
+
+			// Bind Descriptor Sets (Uniform Buffers and Texture Samplers), one set at a time so the
+			// tracker can skip set 0 when only the texture changes and vice versa
+			commandState.bindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout->layout, 0,
+				frame.descriptorSet, dynamicOffsetCount, dynamicOffsetPointer);
+			// The pre-pass has no fragment shader, no texture to bind
+			if (!prepassDraws)
+			{
+				commandState.bindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout->layout, 1,
+					samplerDescriptorSets[thisModel.getMesh(k)->getTexId()]);
+			}
+
+			// Storage Buffer path indexes the object transforms with gl_InstanceIndex, so pass the model index as firstInstance
+			uint32_t firstInstance = drawPath == ObjectDataPath::StorageBuffer ? j : 0;
+
+			// Execute pipeline
+			vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(thisModel.getMesh(k)->getIndexCount()), 1, 0, 0, firstInstance);
+			drawStats.drawCalls++;
+			drawStats.triangles += thisModel.getMesh(k)->getIndexCount() / 3;
+		}
+	}
+
+	result = vkEndCommandBuffer(commandBuffer);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to stop recording a Secondary Command Buffer!");
+	}
+
+	return commandBuffer;
+}
+
+void VulkanRenderer::recordViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent)
+{
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width  = (float)extent.width;
+	viewport.height = (float)extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = extent;
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
 /****
 void VulkanRenderer::recordCommandBufferLVE(int imageIndex)
 {
@@ -1956,7 +2520,7 @@ void VulkanRenderer::renderGameObjectsLVE(VkCommandBuffer commandBuffer)
 
 		vkCmdPushConstants(
 			commandBuffer,
-			pipelineLayout,
+			pipelineLayout->layout,
 			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 			0,
 			sizeof(SimplePushConstantData),
@@ -2002,7 +2566,6 @@ void VulkanRenderer::getPhysicalDevice()
 }
 ****/
 
-/****
 void VulkanRenderer::allocateDynamicBufferTransferSpace()
 {
 	// 0000000100000000 256
@@ -2011,18 +2574,448 @@ void VulkanRenderer::allocateDynamicBufferTransferSpace()
 	// 1111111100000000 ~(256-1) mask for all possible values
 	// 0000000100000000 (64+256-1) & ~(256-1)
 
+	minUniformBufferOffset = m_Device->properties.limits.minUniformBufferOffsetAlignment;
+
 	// Calculate alignment of model data
-	// modelUniformAlignment = (sizeof(Model) + minUniformBufferOffset - 1) & ~(minUniformBufferOffset - 1);
+	modelUniformAlignment = (sizeof(Model) + minUniformBufferOffset - 1) & ~(minUniformBufferOffset - 1);
 
-	// Hard limit for memory
-	// Create space in memory to hold dynamic buffer that is aligned to our required alignment and holds MAX_OBJECTS
-	// modelTransferSpace = (Model*)_aligned_malloc(modelUniformAlignment * MAX_OBJECTS, modelUniformAlignment);
+	// No separate transfer space is needed, model data is written straight into the
+	// persistently mapped dynamic uniform buffer (see createUniformBuffers)
 
-	// printf("allocateDynamicBufferTransferSpace: Model struct size = %i\n", (int)sizeof(Model));
-	// printf("allocateDynamicBufferTransferSpace: minUniformBufferOffset = %i\n", (int)minUniformBufferOffset);
-	// printf("allocateDynamicBufferTransferSpace: modelUniformAlignment = %i\n", (int)modelUniformAlignment);
+	printf("allocateDynamicBufferTransferSpace: Model struct size = %i\n", (int)sizeof(Model));
+	printf("allocateDynamicBufferTransferSpace: minUniformBufferOffset = %i\n", (int)minUniformBufferOffset);
+	printf("allocateDynamicBufferTransferSpace: modelUniformAlignment = %i\n", (int)modelUniformAlignment);
+}
+
+void VulkanRenderer::setFramesInFlight(uint32_t count)
+{
+	// Rebuilding the frame resources under a running render thread (and resizing the readback ring) is not supported
+	assert(
+		m_SwapChain == nullptr &&
+		"Cannot change the frames in flight after init()!");
+
+	count = SwapChain::clampFramesInFlight(count);
+
+	if (count == framesInFlight) return;
+
+	framesInFlight = count;
+
+	printf("Frames in flight set to %i.\n", framesInFlight);
+}
+
+void VulkanRenderer::setLatencyPolicy(const LatencyPolicy& policy)
+{
+	std::lock_guard<std::mutex> lock(latencyPolicyMutex);
+
+	pendingLatencyPolicy = policy;
+	latencyPolicyPending = true;
+}
+
+LatencyPolicy VulkanRenderer::getLatencyPolicy()
+{
+	std::lock_guard<std::mutex> lock(latencyPolicyMutex);
+
+	return latencyPolicyPending ? pendingLatencyPolicy : latencyPolicy;
+}
+
+void VulkanRenderer::applyLatencyPolicy()
+{
+	std::lock_guard<std::mutex> lock(latencyPolicyMutex);
+
+	if (!latencyPolicyPending) return;
+
+	const LatencyPolicy policy = pendingLatencyPolicy;
+	latencyPolicyPending = false;
+
+	bool swapChainChanged = policy.presentMode != latencyPolicy.presentMode || policy.swapchainImageCount != latencyPolicy.swapchainImageCount;
+
+	// Report the numbers of the old policy before they are reset
+	if (latencyTotals.frames > 0)
+	{
+		printLatencyReport();
+	}
+
+	latencyPolicy = policy;
+	latencyTotals = LatencyTotals();
+	nextFrameStart = std::chrono::steady_clock::now();
+
+	printf("Latency policy: present mode %s, %u swapchain images (0 = default), frame-rate cap %.1f, just-in-time input %s\n",
+		SwapChain::getPresentModeName(policy.presentMode), policy.swapchainImageCount, policy.frameRateCap, policy.justInTimeInput ? "on" : "off");
+
+	// The swapchain is recreated further down in draw(), never in the middle of recording a frame
+	if (swapChainChanged && m_SwapChain != nullptr)
+	{
+		swapChainPolicyChanged = true;
+	}
+}
+
+void VulkanRenderer::setDepthPrepass(bool enabled)
+{
+	// Picked up by the next recorded frame, the render pass always has the pre-pass subpass
+	if (depthPrepass.exchange(enabled) == enabled) return;
+
+	printf("Depth pre-pass: %s\n", enabled ? "on (geometry pass depth test EQUAL)" : "off");
+}
+
+void VulkanRenderer::setFrameReadback(FrameReadback::Callback callback, uint32_t bufferCount)
+{
+	std::lock_guard<std::mutex> lock(readbackMutex);
+	readbackCallback = callback;
+	readbackBufferCount = bufferCount;
+	readbackRequested = true;
+}
+
+void VulkanRenderer::setReadbackWaitWhenFull(bool wait)
+{
+	readbackWaitWhenFull = wait;
+
+	if (m_FrameReadback != nullptr)
+	{
+		m_FrameReadback->setWaitWhenFull(wait);
+	}
+}
+
+bool VulkanRenderer::getLastGpuTime(uint64_t* frameNumber, double* gpuMs)
+{
+	if (!lastGpuTimeValid) return false;
+
+	*frameNumber = lastGpuTimeFrame;
+	*gpuMs = lastGpuTimeMs;
+	return true;
+}
+
+void VulkanRenderer::flushFrameReadback()
+{
+	if (m_FrameReadback == nullptr) return;
+
+	// Completing the frames hands their buffers to the readback worker, which then delivers them
+	m_FrameScheduler->flush();
+	m_FrameReadback->flush();
+}
+
+void VulkanRenderer::setShadingOptions(const ShadingOptions& options)
+{
+	std::lock_guard<std::mutex> lock(shadingOptionsMutex);
+
+	pendingShadingOptions = options;
+	shadingOptionsPending = true;
+}
+
+ShadingOptions VulkanRenderer::getShadingOptions()
+{
+	std::lock_guard<std::mutex> lock(shadingOptionsMutex);
+
+	return shadingOptionsPending ? pendingShadingOptions : shadingOptions;
+}
+
+void VulkanRenderer::applyShadingOptions()
+{
+	bool changed;
+	{
+		// Only the hand-over is locked, setShadingOptions must not wait for the pipeline rebuild below
+		std::lock_guard<std::mutex> lock(shadingOptionsMutex);
+
+		if (!shadingOptionsPending) return;
+
+		shadingOptionsPending = false;
+
+		changed = pendingShadingOptions.textured != shadingOptions.textured ||
+			pendingShadingOptions.splitFraction != shadingOptions.splitFraction ||
+			pendingShadingOptions.depthLowerBound != shadingOptions.depthLowerBound ||
+			pendingShadingOptions.depthUpperBound != shadingOptions.depthUpperBound;
+
+		shadingOptions = pendingShadingOptions;
+	}
+
+	// shadingOptions is only written by this thread, reading it unlocked from here on is fine
+
+	printf("Shading options: %s, depth view right of %.2f, depth range [%.3f, %.3f]\n",
+		shadingOptions.textured ? "textured" : "vertex color", shadingOptions.splitFraction, shadingOptions.depthLowerBound, shadingOptions.depthUpperBound);
+
+	// Before init() the pipelines are simply created with the new values
+	if (!changed || graphicsPipelines[(int)fallbackObjectDataPath] == nullptr) return;
+
+	// New shader variants mean new pipelines. The frames in flight still use the old ones.
+	m_FrameScheduler->flush();
+
+	destroyGraphicsPipelines();
+	createGraphicsPipeline();
+}
+
+void VulkanRenderer::startResizeBenchmark(uint32_t resizeCount)
+{
+	// Resizes go through the window
+	if (m_Window->isHeadless())
+	{
+		printf("Resize benchmark needs a window, not started (headless).\n");
+		return;
+	}
+
+	int width, height;
+	glfwGetWindowSize(m_Window->getHandle(), &width, &height);
+
+	resizeBenchmark = {};
+	resizeBenchmark.running = true;
+	resizeBenchmark.resizeCount = resizeCount;
+	resizeBenchmark.baseWidth = width;
+	resizeBenchmark.baseHeight = height;
+	resizeBenchmark.nextResize = std::chrono::steady_clock::now() + std::chrono::milliseconds(500); // let the first frames settle
+
+	printf("Resize benchmark started: %i resizes, one every %i ms.\n", (int)resizeCount, (int)resizeBenchmark.resizeIntervalMs);
+}
+
+void VulkanRenderer::updateResizeBenchmark()
+{
+	ResizeBenchmark& bench = resizeBenchmark;
+
+	if (!bench.running) return;
+
+	auto frameStart = std::chrono::steady_clock::now();
+
+	// Time of the previous frame, split by whether it recreated the swapchain
+	if (bench.frames > 0)
+	{
+		double frameMs = std::chrono::duration<double, std::milli>(frameStart - bench.lastFrameStart).count();
+		if (bench.recreatedLastFrame)
+		{
+			bench.hitchFrames++;
+			bench.hitchFrameMs += frameMs;
+			bench.hitchFrameMaxMs = std::max(bench.hitchFrameMaxMs, frameMs);
+		}
+		else
+		{
+			bench.steadyFrames++;
+			bench.steadyFrameMs += frameMs;
+		}
+	}
+
+	bench.frames++;
+	bench.lastFrameStart = frameStart;
+	bench.recreatedLastFrame = false;
+
+	if (frameStart < bench.nextResize) return;
+
+	bench.nextResize = frameStart + std::chrono::milliseconds(bench.resizeIntervalMs);
+
+	if (bench.resizesDone == bench.resizeCount)
+	{
+		// One more interval has passed since the last resize, so it has been measured
+		bench.running = false;
+		int width = bench.baseWidth;
+		int height = bench.baseHeight;
+		m_JobSystem->runOnMainThread([this, width, height]() { glfwSetWindowSize(m_Window->getHandle(), width, height); });
+		printResizeBenchmarkReport();
+		return;
+	}
+
+	// Cycle through a few sizes around the starting size
+	const int offsets[4][2] = { { -160, -90 }, { 160, 90 }, { -320, 0 }, { 0, -180 } };
+	const int* offset = offsets[bench.resizesDone % 4];
+	int width = std::max(bench.baseWidth + offset[0], 64);
+	int height = std::max(bench.baseHeight + offset[1], 64);
+	m_JobSystem->runOnMainThread([this, width, height]() { glfwSetWindowSize(m_Window->getHandle(), width, height); });
+	bench.resizesDone++;
+}
+
+void VulkanRenderer::printResizeBenchmarkReport()
+{
+	const ResizeBenchmark& bench = resizeBenchmark;
+
+	double steadyMs = bench.steadyFrames > 0 ? bench.steadyFrameMs / bench.steadyFrames : 0.0;
+	double hitchMs = bench.hitchFrames > 0 ? bench.hitchFrameMs / bench.hitchFrames : 0.0;
+
+	printf("==== Resize Benchmark (%i resizes requested, %i swapchain recreations) ====\n", (int)bench.resizesDone, (int)bench.recreates);
+	printf("  recreateSwapChain   avg %8.3f ms   max %8.3f ms\n", bench.recreates > 0 ? bench.recreateMs / bench.recreates : 0.0, bench.recreateMaxMs);
+	printf("  resize frame time   avg %8.3f ms   max %8.3f ms\n", hitchMs, bench.hitchFrameMaxMs);
+	printf("  steady frame time   avg %8.3f ms\n", steadyMs);
+	printf("  hitch per resize    avg %8.3f ms\n", hitchMs - steadyMs);
+}
+
+void VulkanRenderer::printLatencyReport()
+{
+	if (latencyTotals.frames == 0) return;
+
+	printf("Latency (%s, %u frames): acquire wait avg %.3f ms max %.3f ms, input to submit avg %.3f ms max %.3f ms\n",
+		m_SwapChain != nullptr ? SwapChain::getPresentModeName(m_SwapChain->getPresentMode()) : SwapChain::getPresentModeName(latencyPolicy.presentMode),
+		latencyTotals.frames,
+		latencyTotals.acquireWaitMs / latencyTotals.frames, latencyTotals.acquireWaitMaxMs,
+		latencyTotals.inputToSubmitMs / latencyTotals.frames, latencyTotals.inputToSubmitMaxMs);
+}
+
+void VulkanRenderer::startRenderThread()
+{
+	if (renderThreadRunning) return;
+
+	renderThreadStop = false;
+	renderThreadFailed = false;
+	renderThreadRunning = true;
+
+	// Everything created so far (init, uploads) happens-before the thread start
+	renderThread = std::thread(&VulkanRenderer::renderThreadMain, this);
+
+	printf("Render thread started.\n");
+}
+
+void VulkanRenderer::stopRenderThread()
+{
+	if (!renderThreadRunning) return;
+
+	renderThreadStop = true;
+	renderThread.join();
+	renderThreadRunning = false;
+
+	// Window calls queued by the last frames
+	m_JobSystem->processMainThreadJobs();
+
+	printf("Render thread stopped after %llu frames.\n", (unsigned long long)renderedFrames.load());
+}
+
+void VulkanRenderer::renderThreadMain()
+{
+	try
+	{
+		while (!renderThreadStop)
+		{
+			draw();
+		}
+	}
+	catch (const std::exception& e)
+	{
+		// Reported to the main loop, which stops the simulation and shuts down
+		printf("ERROR: render thread: %s\n", e.what());
+		renderThreadFailed = true;
+	}
+}
+
+void VulkanRenderer::startObjectDataBenchmark(uint32_t framesPerPath)
+{
+	objectDataBenchmark = {};
+	objectDataBenchmark.running = true;
+	objectDataBenchmark.framesPerPath = framesPerPath > 0 ? framesPerPath : 1;
+	objectDataBenchmark.previousPath = objectDataPath;
+
+	objectDataPath = (ObjectDataPath)objectDataBenchmark.pathIndex;
+
+	printf("Object data benchmark started: %i frames per path, %i warm-up frames.\n",
+		objectDataBenchmark.framesPerPath, objectDataBenchmark.warmupFrames);
+}
+
+void VulkanRenderer::collectGpuTime(uint32_t frameIndex)
+{
+	double gpuMs = 0.0;
+	if (!m_GpuTimer->getElapsedMs(frameIndex, &gpuMs)) return;
+
+	lastGpuTimeValid = true;
+	lastGpuTimeFrame = frames[frameIndex].recordedFrameNumber;
+	lastGpuTimeMs = gpuMs;
+
+	dynamicResolution.update(gpuMs, static_cast<uint32_t>(frames.size()));
+
+	// Attributed to the mode the frame was recorded with (the pre-pass waits for its pipelines)
+	bool withPrepass = frames[frameIndex].recordedDepthPrepass;
+	if (withPrepass != depthPrepassGpuTime.withPrepass)
+	{
+		if (depthPrepassGpuTime.samples > 0)
+		{
+			printf("GPU frame time %s depth pre-pass: %.3f ms (%i frames)\n", depthPrepassGpuTime.withPrepass ? "with" : "without",
+				depthPrepassGpuTime.gpuMs / depthPrepassGpuTime.samples, (int)depthPrepassGpuTime.samples);
+		}
+		depthPrepassGpuTime = DepthPrepassGpuTime();
+		depthPrepassGpuTime.withPrepass = withPrepass;
+	}
+	depthPrepassGpuTime.samples++;
+	depthPrepassGpuTime.gpuMs += gpuMs;
+
+	if (!objectDataBenchmark.running || !frames[frameIndex].recordedBenchmarkSample) return;
+
+	// GPU results arrive a few frames late, so use the path the frame's command buffer was recorded with
+	ObjectDataStats& stats = objectDataBenchmark.stats[(int)frames[frameIndex].recordedObjectDataPath];
+	stats.gpuSamples++;
+	stats.gpuMs += gpuMs;
+}
+
+void VulkanRenderer::updateObjectDataBenchmark(uint32_t frameIndex, double recordCpuMs)
+{
+	FrameContext& frame = frames[frameIndex];
+	frame.recordedBenchmarkSample = false;
+
+	if (!objectDataBenchmark.running) return;
+
+	// The path's pipeline may still be compiling after the switch. Those frames are not the path's: its warm-up and
+	// measurement only start once it is actually drawn.
+	if (frame.recordedFallback)
+	{
+		objectDataBenchmark.stats[(int)objectDataPath].fallbackFrames++;
+		return;
+	}
+
+	if (objectDataBenchmark.frameInPath >= objectDataBenchmark.warmupFrames)
+	{
+		ObjectDataStats& stats = objectDataBenchmark.stats[(int)frame.recordedObjectDataPath];
+		stats.frames++;
+		stats.recordCpuMs += recordCpuMs;
+		frame.recordedBenchmarkSample = true;
+	}
+
+	objectDataBenchmark.frameInPath++;
+
+	if (objectDataBenchmark.frameInPath < objectDataBenchmark.warmupFrames + objectDataBenchmark.framesPerPath) return;
+
+	// Move on to the next path, or finish
+	objectDataBenchmark.frameInPath = 0;
+	objectDataBenchmark.pathIndex++;
+
+	if (objectDataBenchmark.pathIndex < OBJECT_DATA_PATH_COUNT)
+	{
+		objectDataPath = (ObjectDataPath)objectDataBenchmark.pathIndex;
+		return;
+	}
+
+	objectDataBenchmark.running = false;
+	objectDataPath = objectDataBenchmark.previousPath;
+
+	printObjectDataBenchmarkReport();
+}
+
+void VulkanRenderer::printCommandStats()
+{
+	const CommandStateTracker::Stats& stats = lastCommandStats;
+
+	printf("Command state (%s): %i binds issued, %i elided [pipeline %i/%i, descriptor set %i/%i, vertex %i/%i, index %i/%i, push constant %i/%i]\n",
+		getObjectDataPathName(objectDataPath), stats.totalIssued(), stats.totalElided(),
+		stats.pipelines.issued, stats.pipelines.elided,
+		stats.descriptorSets.issued, stats.descriptorSets.elided,
+		stats.vertexBuffers.issued, stats.vertexBuffers.elided,
+		stats.indexBuffers.issued, stats.indexBuffers.elided,
+		stats.pushConstants.issued, stats.pushConstants.elided);
+}
+
+void VulkanRenderer::printObjectDataBenchmarkReport()
+{
+	printf("\n");
+	printf("---- Object data benchmark (%i objects, %i frames per path)\n", (int)modelList.size(), objectDataBenchmark.framesPerPath);
+	printf("%-24s %16s %16s %16s\n", "Path", "Record CPU (ms)", "GPU (ms)", "Fallback frames");
+
+	for (int i = 0; i < OBJECT_DATA_PATH_COUNT; i++)
+	{
+		const ObjectDataStats& stats = objectDataBenchmark.stats[i];
+
+		double recordCpuMs = stats.frames > 0 ? stats.recordCpuMs / stats.frames : 0.0;
+
+		if (stats.gpuSamples > 0)
+		{
+			printf("%-24s %16.4f %16.4f %16u\n", getObjectDataPathName((ObjectDataPath)i), recordCpuMs, stats.gpuMs / stats.gpuSamples,
+				stats.fallbackFrames);
+		}
+		else
+		{
+			printf("%-24s %16.4f %16s %16u\n", getObjectDataPathName((ObjectDataPath)i), recordCpuMs, "n/a", stats.fallbackFrames);
+		}
+	}
+
+	printf("Active path restored to: %s\n", getObjectDataPathName(objectDataPath));
+	printf("\n");
 }
-****/
 
 bool VulkanRenderer::checkInstanceExtensionSupport(std::vector<const char*>* checkExtensions)
 {
@@ -2549,6 +3542,25 @@ void VulkanRenderer::createTextureSampler()
 
 		printf("Vulkan Texture Sampler successfully created.\n");
 	}
+
+	// Composite pass: scene attachments are upscaled with bilinear taps, never sampled outside the rendered region
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.anisotropyEnable = VK_FALSE;
+	samplerCreateInfo.maxAnisotropy = 1;
+
+	if (!compositeSampler) {
+		VkResult result = vkCreateSampler(m_Device->device(), &samplerCreateInfo, nullptr, &compositeSampler);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Composite Sampler!");
+		}
+
+		printf("Vulkan Composite Sampler successfully created.\n");
+	}
 }
 
 int VulkanRenderer::createTextureImage(std::string fileName)
@@ -2585,32 +3597,62 @@ int VulkanRenderer::createTextureImage(std::string fileName)
 		&texImageMemory);
 
 	// COPY DATA TO IMAGE
+	// All three steps go into one command buffer that is submitted without waiting for the queue to go idle
+	VkDevice device = m_Device->device();
+	VkCommandPool uploadCommandPool = m_Device->getCommandPool();
+	VkCommandBuffer uploadCommandBuffer = beginCommandBuffer(device, uploadCommandPool);
 
 	// Transition image to be DST for copy operation
 	// Use Memory Barrier to transition image layout from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-	transitionImageLayout(m_Device->device(), m_Device->graphicsQueue(), m_Device->getCommandPool(),
-		texImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	recordTransitionImageLayout(uploadCommandBuffer, texImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
 	// Copy image data
-	copyImageBuffer(m_Device->device(), m_Device->graphicsQueue(), m_Device->getCommandPool(), imageStagingBuffer, texImage, width, height);
+	recordCopyImageBuffer(uploadCommandBuffer, imageStagingBuffer, texImage, width, height);
 
 	// Transition image to be shader readable for shader usage
-	transitionImageLayout(m_Device->device(), m_Device->graphicsQueue(), m_Device->getCommandPool(),
-		texImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// (the barrier also orders the copy before any later fragment shader read on this queue)
+	recordTransitionImageLayout(uploadCommandBuffer, texImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	vkEndCommandBuffer(uploadCommandBuffer);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &uploadCommandBuffer;
+
+	if (vkQueueSubmit(m_Device->graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit a Texture upload!");
+	}
+
+	// Submitted ahead of the frame being recorded on the same queue, so the upload is complete once that frame is.
+	// Only then the staging buffer and the command buffer can be released.
+	m_FrameScheduler->onFrameComplete(m_FrameScheduler->getRecordingFrame(),
+		[device, uploadCommandPool, uploadCommandBuffer, imageStagingBuffer, imageStagingBufferMemory]()
+		{
+			vkFreeCommandBuffers(device, uploadCommandPool, 1, &uploadCommandBuffer);
+			vkDestroyBuffer(device, imageStagingBuffer, nullptr);
+			vkFreeMemory(device, imageStagingBufferMemory, nullptr);
+		});
 
 	// Add texture data to vector for reference
 	textureImages.push_back(texImage);
 	textureImageMemory.push_back(texImageMemory);
 
-	vkDestroyBuffer(m_Device->device(), imageStagingBuffer, nullptr);
-	vkFreeMemory(m_Device->device(), imageStagingBufferMemory, nullptr);
-
 	// Return index of new texture image
 	return (int)textureImages.size() - 1;
 }
 
 int VulkanRenderer::createTexture(std::string fileName)
 {
+	// Every file is uploaded once, models using it share the descriptor set
+	auto cached = textureCache.find(fileName);
+	if (cached != textureCache.end())
+	{
+		assetCacheStats.textureHits++;
+		return cached->second;
+	}
+
 	// Create Texture Image and get its location in array
 	int textureImageLoc = createTextureImage(fileName);
 
@@ -2621,49 +3663,28 @@ int VulkanRenderer::createTexture(std::string fileName)
 	// Create Texture Descriptor
 	int descriptorLoc = createTextureDescriptor(imageView);
 
+	textureCache[fileName] = descriptorLoc;
+	assetCacheStats.textureLoads++;
+
 	// Return location of set with texture
 	return descriptorLoc;
 }
 
 int VulkanRenderer::createTextureDescriptor(VkImageView textureImage)
 {
-	VkDescriptorSet descriptorSet;
-
-	// Descriptor Set Allocation Info
-	VkDescriptorSetAllocateInfo setAllocInfo = {};
-	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocInfo.descriptorPool = samplerDescriptorPool;
-	setAllocInfo.descriptorSetCount = 1;
-	setAllocInfo.pSetLayouts = &samplerSetLayout;
-
-	// Allocate Descriptor Sets
-	VkResult result = vkAllocateDescriptorSets(m_Device->device(), &setAllocInfo, &descriptorSet);
-
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate Texture Descriptor Sets!");
-	}
+	// Allocate Descriptor Set (persistent, lives as long as the texture)
+	VkDescriptorSet descriptorSet = m_DescriptorAllocator->allocate(samplerSetLayout);
 
-	printf("Vulkan Descriptor Sets (Texture Samplers) successfully allocated from the Descriptor Pool.\n");
+	printf("Vulkan Descriptor Sets (Texture Samplers) successfully allocated from the Descriptor Allocator.\n");
 
 	// Texture Image Info
-	VkDescriptorImageInfo imageInfo = {};
-	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; // Image layout when in use
-	imageInfo.imageView = textureImage;                               // Image to bind to set
-	imageInfo.sampler = textureSampler;                               // Sampler to use for set
-
-	// Descriptor Write Info
-	VkWriteDescriptorSet descriptorWrite = {};
-	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrite.dstSet = descriptorSet;
-	descriptorWrite.dstBinding = 0;
-	descriptorWrite.dstArrayElement = 0;
-	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	descriptorWrite.descriptorCount = 1;
-	descriptorWrite.pImageInfo = &imageInfo;
+	DescriptorUpdateEntry imageEntry = {};
+	imageEntry.image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; // Image layout when in use
+	imageEntry.image.imageView = textureImage;                               // Image to bind to set
+	imageEntry.image.sampler = textureSampler;                               // Sampler to use for set
 
 	// Update new descriptor set
-	vkUpdateDescriptorSets(m_Device->device(), 1, &descriptorWrite, 0, nullptr);
+	m_DescriptorLayoutCache->updateDescriptorSet(descriptorSet, samplerSetLayout, &imageEntry);
 
 	// Add descriptor set to list
 	samplerDescriptorSets.push_back(descriptorSet);
@@ -2674,20 +3695,84 @@ int VulkanRenderer::createTextureDescriptor(VkImageView textureImage)
 
 int VulkanRenderer::createMeshModel(std::string modelFile)
 {
-	// Import model "scene"
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(modelFile,
-		aiProcess_Triangulate |
-		aiProcess_FlipUVs |
-		aiProcess_JoinIdenticalVertices);
+	// Model matrices live in fixed size per-object buffers (see createUniformBuffers)
+	if (producerSnapshot.modelTransforms.size() >= MAX_OBJECTS)
+	{
+		throw std::runtime_error("Failed to add model, MAX_OBJECTS reached! (" + modelFile + ")");
+	}
+
+	// Ids are handed out in creation order, the render thread loads the models in the same order
+	int modelId = (int)producerSnapshot.modelTransforms.size();
+
+	producerSnapshot.modelTransforms.push_back(glm::mat4(1.0f));
+	producerSnapshot.modelVisibility.push_back(true);
+
+	// A file is imported once. Its first load reaches the render thread first, later ones find its meshes in the cache.
+	if (!requestedModelFiles.insert(modelFile).second)
+	{
+		producerSnapshot.modelLoads.push_back({ modelId, modelFile, nullptr });
+		return modelId;
+	}
+
+	// Start parsing right away, the job keeps the import alive until it has run
+	auto modelImport = std::make_shared<MeshModelImport>();
+	modelImport->fileName = modelFile;
+	modelImport->job = m_JobSystem->scheduleOnLane(importLane, [modelImport]()
+	{
+		// Import model "scene"
+		modelImport->scene = modelImport->importer.ReadFile(modelImport->fileName,
+			aiProcess_Triangulate |
+			aiProcess_FlipUVs |
+			aiProcess_JoinIdenticalVertices);
+
+		if (modelImport->scene)
+		{
+			// Get vector of all materials with 1:1 ID placement
+			modelImport->textureNames = MeshModel::LoadMaterials(modelImport->scene);
+		}
+	});
+
+	producerSnapshot.modelLoads.push_back({ modelId, modelFile, modelImport });
+
+	return modelId;
+}
+
+int VulkanRenderer::loadMeshModel(const SceneSnapshot::ModelLoad& modelLoad)
+{
+	// Model matrices live in fixed size per-object buffers (see createUniformBuffers)
+	if (modelList.size() >= MAX_OBJECTS)
+	{
+		throw std::runtime_error("Failed to add model, MAX_OBJECTS reached! (" + modelLoad.fileName + ")");
+	}
+
+	// Another model of an uploaded file: share its meshes (and through them its textures)
+	auto cached = meshCache.find(modelLoad.fileName);
+	if (cached != meshCache.end())
+	{
+		assetCacheStats.meshHits++;
+		modelList.push_back(cached->second);
+		return (int)modelList.size() - 1;
+	}
+
+	if (modelLoad.import == nullptr)
+	{
+		throw std::runtime_error("Failed to load model, no import and not cached! (" + modelLoad.fileName + ")");
+	}
+
+	MeshModelImport& modelImport = *modelLoad.import;
+
+	// Usually done long ago, otherwise run it here if no worker has started it yet
+	m_JobSystem->wait(modelImport.job);
+
+	const std::string& modelFile = modelImport.fileName;
+	const aiScene* scene = modelImport.scene;
 
 	if (!scene)
 	{
 		throw std::runtime_error("Failed to load model! (" + modelFile + ")");
 	}
 
-	// Get vector of all materials with 1:1 ID placement
-	std::vector<std::string> textureNames = MeshModel::LoadMaterials(scene);
+	const std::vector<std::string>& textureNames = modelImport.textureNames;
 
 	// Conversion from the materials list IDs to our Descriptor Array IDs
 	std::vector<int> matToTex(textureNames.size());
@@ -2712,8 +3797,10 @@ int VulkanRenderer::createMeshModel(std::string modelFile)
 	std::vector<Mesh> modelMeshes = MeshModel::LoadNode(m_Device->getPhysicalDevice(), m_Device->device(),
 		m_Device->graphicsQueue(), m_Device->getCommandPool(), scene->mRootNode, scene, matToTex);
 
-	// Create mesh model and add to list
+	// Create mesh model and add to list, the cache keeps the meshes for further models of the file
 	MeshModel meshModel = MeshModel(modelMeshes);
+	meshCache[modelFile] = meshModel;
+	assetCacheStats.meshLoads++;
 	modelList.push_back(meshModel);
 
 	return (int)modelList.size() - 1;
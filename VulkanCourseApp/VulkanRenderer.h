@@ -15,27 +15,269 @@
 #include "SwapChain.h"
 #include "PipelineLVE.h"
 #include "Shader.h"
+#include "ShaderCompiler.h"
 #include "Camera.h"
-
+#include "GpuTimer.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorLayoutCache.h"
+#include "PipelineRegistry.h"
+#include "ShaderVariant.h"
+#include "CommandStateTracker.h"
+#include "FrameCommandPool.h"
+#include "FrameScheduler.h"
+#include "SpscQueue.h"
+#include "JobSystem.h"
+#include "DynamicResolution.h"
+#include "FrameReadback.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 
+// How per-object data (the model matrix) reaches the vertex shader
+enum class ObjectDataPath
+{
+	PushConstant = 0,   // vkCmdPushConstants once per model (PushModel block)
+	DynamicUniform = 1, // per-frame dynamic uniform buffer, one aligned slot per model (UboModel block)
+	StorageBuffer = 2,  // per-frame storage buffer of transforms, indexed with firstInstance (ObjectTransforms block)
+};
+
+const int OBJECT_DATA_PATH_COUNT = 3;
+
+const char* getObjectDataPathName(ObjectDataPath path);
+
+// What the 1st subpass draws while the selected path's pipeline is still compiling in the background
+enum class PipelineFallbackPolicy
+{
+	UseFallback = 0, // draw with the fallback path (compiled synchronously at startup)
+	SkipDraws = 1,   // skip the model draws until the pipeline is ready
+};
+
+// Specialization constant IDs, must match layout(constant_id = N) in the shaders
+enum class FirstFragmentConstant : uint32_t // shader.frag
+{
+	Textured = 0,
+};
+
+enum class SecondFragmentConstant : uint32_t // second.frag
+{
+	SplitFraction = 0,
+	DepthLowerBound = 1,
+	DepthUpperBound = 2,
+};
+
+// Push constant block of second.frag (Composite), must match its layout
+struct CompositePushConstant
+{
+	glm::vec2 renderSize; // Rendered region of the scene attachments in pixels
+};
+
+// Values that are constant per pipeline, baked into specialized shader variants (see ShaderVariant).
+// Changing them creates new pipelines, can be changed at runtime with VulkanRenderer::setShadingOptions
+struct ShadingOptions
+{
+	bool textured = true;          // 1st subpass: sample the model texture, or output the vertex color
+	float splitFraction = 0.5f;    // 2nd subpass: color left of this fraction of the viewport, depth right of it
+	float depthLowerBound = 0.98f; // 2nd subpass: depth range shown from white to black
+	float depthUpperBound = 1.0f;
+};
+
+// Presentation and latency settings, can be changed at runtime with VulkanRenderer::setLatencyPolicy
+struct LatencyPolicy
+{
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR; // FIFO, FIFO_RELAXED, MAILBOX or IMMEDIATE (FIFO if unsupported)
+	uint32_t swapchainImageCount = 0; // 0 = minImageCount + 1, otherwise at least minImageCount
+	float frameRateCap = 0.0f;        // Frames per second, 0 = uncapped
+	bool justInTimeInput = false;     // Sample input after waiting for the frame slot (right before recording) instead of before
+};
+
+// Model file parsed by a job (see VulkanRenderer::createMeshModel), defined in VulkanRenderer.cpp
+struct MeshModelImport;
+
+// Immutable copy of the scene state, published by the simulation thread and consumed by the render thread.
+// Transforms and camera are full state (the newest snapshot wins), structural changes are deltas and are applied from every snapshot.
+struct SceneSnapshot
+{
+	struct ModelLoad
+	{
+		int modelId;
+		std::string fileName;
+		std::shared_ptr<MeshModelImport> import; // Import job started by createMeshModel, nullptr if the file was requested before (mesh cache)
+	};
+
+	uint64_t sequence = 0;
+	std::chrono::steady_clock::time_point publishTime;
+
+	bool hasView = false;
+	glm::mat4 view = glm::mat4(1.0f);
+	std::vector<glm::mat4> modelTransforms; // Indexed by model id
+	std::vector<bool> modelVisibility;      // Indexed by model id
+	std::vector<ModelLoad> modelLoads;      // Models created since the previous published snapshot, in id order
+};
+
+
 class VulkanRenderer
 {
 public:
 	VulkanRenderer() = delete;
-	VulkanRenderer(std::shared_ptr<WindowLVE> window);
+	VulkanRenderer(std::shared_ptr<WindowLVE> window, std::shared_ptr<JobSystem> jobSystem);
 	~VulkanRenderer();
 
 	int init();
+
+	// Scene producer side. Called by one simulation thread while the render thread draws:
+	// these only write the producer's snapshot, the renderer state is touched by draw() alone.
+	// createMeshModel returns the model id right away, the file is parsed by a job and uploaded by the render thread.
+	// A file is parsed and uploaded once, further models of it share its meshes and textures (mesh and texture caches).
 	int createMeshModel(std::string modelFile);
 	void updateModel(int modelId, glm::mat4 newModel);
+	// Hidden models keep their meshes and id but are not drawn
+	void setModelVisible(int modelId, bool visible);
 	void update(float deltaTime, std::shared_ptr<Camera> camera);
+	// Hands an immutable copy of the scene to the renderer, once per simulation tick. Never blocks:
+	// if the render thread is behind, structural changes are kept and go out with the next snapshot.
+	void publishSnapshot();
+
 	void draw();
 	void cleanup();
-	void cleanupOnRecreateSwapChain(); // called in recreateSwapChainLVE
-
+	// Rebuilds only the swapchain and its extent dependent attachments, everything else survives a resize
 	void recreateSwapChain();
+
+	// Per-object data path used by the 1st subpass, can be switched between frames
+	void setObjectDataPath(ObjectDataPath path) { objectDataPath = path; }
+	ObjectDataPath getObjectDataPath() { return objectDataPath; }
+
+	// Only the active path's pipeline is compiled at startup, the other paths compile on the job system's compile lane
+	void setPipelineFallbackPolicy(PipelineFallbackPolicy policy) { pipelineFallbackPolicy = policy; }
+	// Background pipeline compilations still outstanding, updated once per frame
+	uint32_t getPipelinesPending() { return pipelinesPending; }
+	// Blocks until the background compilations finish and installs their pipelines, call between frames
+	void waitForPendingPipelines();
+
+	// Compile every shader at init() even if the SPIR-V cache has it (cold start measurement), call before init()
+	void setRecompileShaders(bool recompile) { recompileShaders = recompile; }
+
+	// Thread safe, applied at the start of the next draw() (rebuilds the pipelines if a value changed)
+	void setShadingOptions(const ShadingOptions& options);
+	ShadingOptions getShadingOptions();
+
+	// A/B benchmark: renders framesPerPath frames with each path, then prints CPU record cost and GPU time
+	void startObjectDataBenchmark(uint32_t framesPerPath);
+	bool isObjectDataBenchmarkRunning() { return objectDataBenchmark.running; }
+
+	// Resize storm: resizes the window resizeCount times, then prints the recreation cost and the frame hitch per resize
+	void startResizeBenchmark(uint32_t resizeCount);
+	bool isResizeBenchmarkRunning() { return resizeBenchmark.running; }
+
+	// Dynamic resolution: the scene is rendered to part of its attachments and upscaled, the scale follows the
+	// GPU frame time. Thread safe, a scale change never recreates anything. Switching it on or off rebuilds the render
+	// graph and pipelines at the start of the next draw(): the upscale samples the scene attachments, which splits the
+	// frame into two render passes, so that layout is only used while it is on.
+	void setDynamicResolution(const DynamicResolution::Settings& settings) { dynamicResolution.setSettings(settings); }
+	DynamicResolution::Settings getDynamicResolution() { return dynamicResolution.getSettings(); }
+	float getResolutionScale() { return dynamicResolution.getScale(); }
+
+	// Depth pre-pass: models are drawn depth only (position stream) before the color pass, which then tests EQUAL
+	// without writing depth. Can be switched between frames. Until its pipelines have compiled in the background,
+	// frames are drawn without it.
+	void setDepthPrepass(bool enabled);
+	bool getDepthPrepass() { return depthPrepass; }
+
+	// Frame readback: the final image of each frame is copied into host memory and delivered to callback as RGBA8 on a
+	// worker thread, a few frames after it was rendered (see FrameReadback). bufferCount 0 = frames in flight + 2.
+	// Set before init() or once while running (thread safe): the render thread then creates the readback between frames
+	// and recreates the swapchain, its images are only copyable (TRANSFER_SRC) with a readback.
+	// Frames are only copied while enabled (thread safe).
+	void setFrameReadback(FrameReadback::Callback callback, uint32_t bufferCount = 0);
+	void setReadbackEnabled(bool enabled) { readbackEnabled = enabled; }
+	bool isReadbackEnabled() { return readbackEnabled; }
+	// Only every Nth rendered frame is copied (thread safe)
+	void setReadbackInterval(uint32_t interval) { readbackInterval = std::max(interval, 1u); }
+	// Consumer behind: drop frames (default) or stall the render thread until a readback buffer is free.
+	// Once running, set it before setFrameReadback.
+	void setReadbackWaitWhenFull(bool wait);
+
+	// Bind calls issued/elided by the command state tracker in the last recorded frame
+	const CommandStateTracker::Stats& getCommandStats() { return lastCommandStats; }
+
+	// Number of frames the CPU may record ahead of the GPU (1-4), independent of the swapchain image count.
+	// 1 = lowest latency, more frames = more CPU/GPU overlap. Set before init(): FrameContexts, the swapchain and the
+	// readback ring are all sized by it.
+	void setFramesInFlight(uint32_t count);
+	uint32_t getFramesInFlight() { return framesInFlight; }
+
+	// Present mode and image count changes recreate only the swapchain (pipelines, buffers and descriptors are kept).
+	// Thread safe, the policy is applied at the start of the next draw().
+	void setLatencyPolicy(const LatencyPolicy& policy);
+	LatencyPolicy getLatencyPolicy();
+	VkPresentModeKHR getActivePresentMode() { return m_SwapChain->getPresentMode(); }
+
+	// Polls input and updates camera/models, called by draw() before waiting for the frame slot,
+	// or after it with LatencyPolicy::justInTimeInput. Set before startRenderThread() when running one.
+	void setInputSampler(std::function<void()> sampler) { inputSampler = sampler; }
+
+	// Measured per frame: time blocked on the frame slot + image acquire, and from sampling input to queue submit
+	struct FrameLatency
+	{
+		double acquireWaitMs = 0.0;
+		double inputToSubmitMs = 0.0;
+	};
+
+	const FrameLatency& getLastFrameLatency() { return lastFrameLatency; }
+	void printLatencyReport();
+
+	// Dedicated render thread: runs draw() until stopRenderThread(), consuming the newest published snapshot each frame.
+	// Without it the owner calls draw() itself, as before.
+	void startRenderThread();
+	void stopRenderThread();
+	bool isRenderThreadRunning() { return renderThreadRunning; }
+	bool hasRenderThreadFailed() { return renderThreadFailed; }
+
+	uint64_t getRenderedFrameCount() { return renderedFrames; }
+	// Timeline value the next frame will be submitted with, the frameIndex its readback is delivered with.
+	// Render thread only, stays the same until a frame is actually submitted (skipped frames do not count).
+	uint64_t getRecordingFrame() { return m_FrameScheduler->getRecordingFrame(); }
+	// Waits for every submitted frame and hands its readback to the callback (render thread only, between frames)
+	void flushFrameReadback();
+
+	// Files loaded vs. requests served from the caches (render thread)
+	struct AssetCacheStats
+	{
+		uint32_t meshLoads = 0;
+		uint32_t meshHits = 0;
+		uint32_t textureLoads = 0;
+		uint32_t textureHits = 0;
+	};
+
+	const AssetCacheStats& getAssetCacheStats() { return assetCacheStats; }
+
+	// Recorded for the last frame: draw calls and triangles of every pass (depth pre-pass and composite included),
+	// CPU time spent recording. Render thread only.
+	struct FrameStats
+	{
+		uint32_t drawCalls = 0;
+		uint64_t triangles = 0;
+		double recordCpuMs = 0.0;
+		ObjectDataPath objectDataPath = ObjectDataPath::PushConstant; // Path the models were recorded with
+		bool fallback = false; // Requested path not ready: drawn with the fallback path or without models
+	};
+
+	const FrameStats& getLastFrameStats() { return lastFrameStats; }
+	// GPU time of the newest frame whose timestamps were read back, a few frames after it was rendered.
+	// frameNumber is the getRenderedFrameCount() value before that frame. False until the first one (or without timestamps).
+	bool getLastGpuTime(uint64_t* frameNumber, double* gpuMs);
+
+	std::shared_ptr<DeviceLVE> getDevice() { return m_Device; }
+
 	// void recordCommandBufferLVE(int imageIndex);
 	// void renderGameObjectsLVE(VkCommandBuffer commandBuffer);
 	// void drawFrameLVE();
@@ -52,33 +294,61 @@ private:
 	// void createRenderPass();
 	void createShaders();
 	void createDescriptorSetLayout();
+	void createSceneSetLayout();    // Composite pass: input attachments or sampled, see sceneSampled
 	void createPushConstantRange();
 	void createGraphicsPipeline();
 	// void createColorBufferImage();
 	// void createDepthBufferImage();
 	// void createFramebuffers();
 	// void createCommandPool();
-	void createCommandBuffers();
+	void createFrameCommandPools();
 	// void createSynchronization();
 	void createTextureSampler();
 
+	void createFrameContexts();
 	void createUniformBuffers();
-	void createDescriptorPool();
-	void createDescriptorSets();
-	void createInputDescriptorSets();
-
-	void freeCommandBuffers();
-
-	void updateUniformBuffers(uint32_t imageIndex);
+	void createDescriptorAllocators();
+	void createFrameDescriptorSets(uint32_t frameIndex);
+
+	void updateUniformBuffers(uint32_t frameIndex);
+
+	void createFrameResources();    // FrameContexts with their command pools, buffers and descriptor allocators
+	void destroyFrameResources();
+	void createFrameReadback();     // Only with a readback callback, at most once
+	void reportReadbackSupport();   // Warns if the swapchain images can not be copied from
+	void destroyGraphicsPipelines();
+	// Moves pipelines finished in the background into graphicsPipelines (render thread, between frames)
+	void updatePipelineRequests();
+	void updateProjection();        // aspect ratio follows the swapchain extent
+
+	void updateResizeBenchmark();
+	void printResizeBenchmarkReport();
+
+	// -- Render thread / snapshot consumer side
+	void renderThreadMain();
+	void applyLatencyPolicy();      // pending setLatencyPolicy() request, start of draw()
+	void applyShadingOptions();     // pending setShadingOptions() request, start of draw()
+	void sampleScene(std::chrono::steady_clock::time_point* inputTime);
+	bool consumeSnapshots();        // applies every queued snapshot, returns false if there was none
 
 	// -- Record Functions --
-	void recordCommands(uint32_t currentImage);
+	void recordCommands(uint32_t frameIndex, uint32_t imageIndex);
+	// 1st subpass draws of models [firstModel, endModel) into a secondary command buffer, run by a recording job.
+	// prepassDraws: the depth only draws of the pre-pass subpass instead of the geometry pass draws.
+	VkCommandBuffer recordModelDraws(uint32_t frameIndex, uint32_t imageIndex, uint32_t job, uint32_t firstModel, uint32_t endModel, bool prepassDraws);
+	void recordViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent);
 
 	// -- Get Functions
 	// void getPhysicalDevice();
 
 	// -- Allocate Functions
-	// void allocateDynamicBufferTransferSpace();
+	void allocateDynamicBufferTransferSpace();
+
+	// -- Benchmark Functions
+	void collectGpuTime(uint32_t frameIndex); // Object data benchmark, dynamic resolution and depth pre-pass comparison
+	void updateObjectDataBenchmark(uint32_t frameIndex, double recordCpuMs);
+	void printObjectDataBenchmarkReport();
+	void printCommandStats();
 
 	// -- Support Functions
 	// -- -- Checker Functions
@@ -107,16 +377,38 @@ private:
 	int createTexture(std::string fileName);
 	int createTextureDescriptor(VkImageView textureImage);
 
+	int loadMeshModel(const SceneSnapshot::ModelLoad& modelLoad);
+
 	// -- Loader Functions
 	stbi_uc* loadTextureFile(std::string fileName, int* width, int* height, VkDeviceSize* imageSize);
 
 private:
 	std::shared_ptr<WindowLVE> m_Window; // lveWindow
+	std::shared_ptr<JobSystem> m_JobSystem; // Recording jobs, model import, main thread lane
+	JobSystem::LaneId importLane; // Assimp imports, kept off the threads that wait on recording and transform jobs
+	JobSystem::LaneId compileLane; // Background pipeline compiles, same
 	std::shared_ptr<DeviceLVE> m_Device; // lveDevice
+	std::shared_ptr<FrameScheduler> m_FrameScheduler; // GPU progress (timeline), shared with the SwapChain
 	std::unique_ptr<SwapChain> m_SwapChain; // lveSwapChain
 	std::unique_ptr<PipelineLVE> m_Pipeline; // lvePipeline
-	std::unique_ptr<Shader> m_ShaderFirst;
-	std::unique_ptr<Shader> m_ShaderSecond;
+	std::unique_ptr<ShaderCompiler> m_ShaderCompiler; // GLSL sources to SPIR-V, cached on disk
+	bool recompileShaders = false;
+	std::array<std::unique_ptr<Shader>, OBJECT_DATA_PATH_COUNT> m_ShaderFirst; // one vertex shader variant per ObjectDataPath
+	std::array<ShaderLibrary::ShaderModuleRef, OBJECT_DATA_PATH_COUNT> m_DepthPrepassVertex; // POSITION_ONLY variant per ObjectDataPath, vertex stage only
+	std::unique_ptr<Shader> m_ShaderSecond;        // Composite, scene attachments as input attachments
+	std::unique_ptr<Shader> m_ShaderSecondSampled; // Composite, scene attachments sampled and upscaled (dynamic resolution)
+	bool sceneSampled = false; // Dynamic resolution layout of the swapchain's render graph, the pipelines and scene set layout
+	Shader& getCompositeShader() { return sceneSampled ? *m_ShaderSecondSampled : *m_ShaderSecond; }
+	std::unique_ptr<GpuTimer> m_GpuTimer;
+	DynamicResolution dynamicResolution;
+	std::unique_ptr<FrameReadback> m_FrameReadback;
+	FrameReadback::Callback readbackCallback; // Under readbackMutex, with the buffer count
+	uint32_t readbackBufferCount = 0;
+	std::mutex readbackMutex;
+	std::atomic<bool> readbackRequested{ false }; // Callback set, the readback not created yet
+	std::atomic<bool> readbackEnabled{ true };
+	std::atomic<uint32_t> readbackInterval{ 1 };
+	bool readbackWaitWhenFull = false;
 
 	int currentFrame = 0;
 
@@ -130,10 +422,104 @@ private:
 		glm::mat4 view;
 	} uboViewProjection;
 
-	struct UniformVariables
+	ObjectDataPath objectDataPath = ObjectDataPath::StorageBuffer;
+
+	// Per-path measurements of the object data A/B benchmark
+	struct ObjectDataStats
+	{
+		uint32_t frames = 0;
+		uint32_t fallbackFrames = 0; // Drawn without the path's pipeline while it compiled, not counted
+		double recordCpuMs = 0.0;
+		uint32_t gpuSamples = 0;
+		double gpuMs = 0.0;
+	};
+
+	struct ObjectDataBenchmark
+	{
+		bool running = false;
+		uint32_t framesPerPath = 0;
+		uint32_t warmupFrames = 10; // frames skipped after each switch (pipeline change, first touch of buffers)
+		uint32_t frameInPath = 0;   // warm-up and measured frames actually drawn with the path
+		int pathIndex = 0;
+		ObjectDataPath previousPath = ObjectDataPath::StorageBuffer;
+		std::array<ObjectDataStats, OBJECT_DATA_PATH_COUNT> stats;
+	} objectDataBenchmark;
+
+	// Average GPU frame time since the frames switched to or from the depth pre-pass, printed at the next switch
+	struct DepthPrepassGpuTime
 	{
-		int ViewportWidth;
-	} uniformVariables;
+		bool withPrepass = false;
+		uint32_t samples = 0;
+		double gpuMs = 0.0;
+	} depthPrepassGpuTime;
+
+	// -- Resize
+	// Resize events are coalesced, the swapchain is recreated once no new event arrived for this long
+	// (right away if the swapchain is out of date)
+	static constexpr double RESIZE_COALESCE_MS = 50.0;
+	bool resizePending = false;
+	std::chrono::steady_clock::time_point lastResizeEvent;
+	double lastRecreateMs = 0.0;
+	VkFormat pipelineColorFormat = VK_FORMAT_UNDEFINED; // Swapchain format the pipelines' render pass was created with
+
+	struct ResizeBenchmark
+	{
+		bool running = false;
+		uint32_t resizeCount = 0;
+		uint32_t resizesDone = 0;
+		uint32_t resizeIntervalMs = 250; // longer than RESIZE_COALESCE_MS, so every resize gets its own recreation
+		int baseWidth = 0;
+		int baseHeight = 0;
+		std::chrono::steady_clock::time_point nextResize;
+		std::chrono::steady_clock::time_point lastFrameStart;
+		uint32_t frames = 0;
+		bool recreatedLastFrame = false;
+		uint32_t recreates = 0;
+		double recreateMs = 0.0;
+		double recreateMaxMs = 0.0;
+		uint32_t hitchFrames = 0;
+		double hitchFrameMs = 0.0;
+		double hitchFrameMaxMs = 0.0;
+		uint32_t steadyFrames = 0;
+		double steadyFrameMs = 0.0;
+	} resizeBenchmark;
+
+	// -- Latency
+	LatencyPolicy latencyPolicy;          // Active policy, written by the render thread under latencyPolicyMutex
+	LatencyPolicy pendingLatencyPolicy;
+	bool latencyPolicyPending = false;
+	std::mutex latencyPolicyMutex;
+	bool swapChainPolicyChanged = false; // applied at the start of the next draw()
+	std::function<void()> inputSampler;
+	std::chrono::steady_clock::time_point nextFrameStart; // frame-rate cap pacing
+
+	struct LatencyTotals
+	{
+		uint32_t frames = 0;
+		double acquireWaitMs = 0.0;
+		double acquireWaitMaxMs = 0.0;
+		double inputToSubmitMs = 0.0;
+		double inputToSubmitMaxMs = 0.0;
+	};
+
+	FrameLatency lastFrameLatency;
+	LatencyTotals latencyTotals; // since the last policy change
+
+	// -- Scene snapshots
+	// A few slots so a short render stall does not hold back structural changes, the consumer drains all of them
+	static constexpr size_t SNAPSHOT_QUEUE_SIZE = 4;
+	SpscQueue<SceneSnapshot, SNAPSHOT_QUEUE_SIZE> snapshotQueue;
+	SceneSnapshot producerSnapshot; // Simulation thread only
+	std::unordered_set<std::string> requestedModelFiles; // Simulation thread only, files with an import job
+	uint64_t consumedSequence = 0;  // Render thread only, 0 = nothing consumed yet
+	std::chrono::steady_clock::time_point consumedPublishTime;
+
+	// -- Render thread
+	std::thread renderThread;
+	std::atomic<bool> renderThreadRunning{ false };
+	std::atomic<bool> renderThreadStop{ false };
+	std::atomic<bool> renderThreadFailed{ false };
+	std::atomic<uint64_t> renderedFrames{ 0 };
 
 	// Vulkan Components
 	// -- Main
@@ -153,7 +539,61 @@ private:
 
 	// std::vector<SwapChainVCA::SwapchainImage> swapChainImages;
 	// std::vector<VkFramebuffer> swapChainFramebuffers;
-	std::vector<VkCommandBuffer> commandBuffers;
+
+	// Everything the CPU writes while recording one frame. Indexed by frame-in-flight (not by swapchain image),
+	// a FrameContext is reused once the fence of the frame that last used it has signalled.
+	struct FrameContext
+	{
+		// Transient command pools, reset wholesale when the frame comes around.
+		// [0] primary buffer (render thread), [1 + job] secondary buffers of each parallel recording job.
+		std::vector<std::unique_ptr<FrameCommandPool>> commandPools;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE; // Primary buffer of this frame, allocated from commandPools[0]
+
+		// Timeline value of the last submission recorded with this context, it is recycled once that frame completes
+		uint64_t lastFrame = 0;
+
+		VkBuffer vpUniformBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory vpUniformBufferMemory = VK_NULL_HANDLE;
+
+		// Model matrices, dynamic uniform buffer path (persistently mapped)
+		VkBuffer modelDynUniformBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory modelDynUniformBufferMemory = VK_NULL_HANDLE;
+		void* modelDynUniformBufferMapped = nullptr;
+
+		// Model matrices, storage buffer path (persistently mapped)
+		VkBuffer modelStorageBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory modelStorageBufferMemory = VK_NULL_HANDLE;
+		void* modelStorageBufferMapped = nullptr;
+
+		// Transient descriptor sets, the allocator is reset each time the frame comes around
+		std::unique_ptr<DescriptorAllocator> descriptorAllocator;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkDescriptorSet inputDescriptorSet = VK_NULL_HANDLE;
+
+		// ObjectDataPath the command buffer was last recorded with (to attribute GPU timestamps)
+		ObjectDataPath recordedObjectDataPath = ObjectDataPath::StorageBuffer;
+		bool recordedFallback = false;        // The requested path's pipeline was still compiling (fallback path or no models)
+		bool recordedBenchmarkSample = false; // Measured by the object data benchmark, its GPU time counts
+		bool recordedDepthPrepass = false;
+		uint64_t recordedFrameNumber = 0; // renderedFrames when recorded
+
+		// Part of the scene attachments the geometry pass renders to (dynamic resolution)
+		VkExtent2D renderExtent = {};
+	};
+
+	uint32_t framesInFlight = SwapChain::DEFAULT_FRAMES_IN_FLIGHT;
+	uint32_t recordingJobCount = 1; // Parallel 1st subpass recording jobs, one per job system thread
+	std::vector<FrameContext> frames;
+
+	// Redundant bind elimination while recording, stats of the last recorded frame
+	CommandStateTracker m_CommandState;             // Primary command buffer
+	std::vector<CommandStateTracker> m_JobCommandStates; // One per recording job (secondary command buffers)
+	CommandStateTracker::Stats lastCommandStats;     // Totals over all command buffers of the frame
+	std::vector<FrameStats> m_JobDrawStats;           // Per recording job: [2 * job] geometry pass, [2 * job + 1] depth pre-pass
+	FrameStats lastFrameStats;
+	bool lastGpuTimeValid = false;
+	uint64_t lastGpuTimeFrame = 0;
+	double lastGpuTimeMs = 0.0;
 
 	// std::vector<VkImage> colorBufferImages;
 	// std::vector<VkDeviceMemory> colorBufferImageMemory;
@@ -164,45 +604,57 @@ private:
 	// std::vector<VkImageView> depthBufferImageViews;
 
 	VkSampler textureSampler;
+	VkSampler compositeSampler = VK_NULL_HANDLE; // Scene attachments in the composite pass
 
 	// -- Descriptors
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorSetLayout samplerSetLayout;
 	VkDescriptorSetLayout inputSetLayout;
 	VkPushConstantRange pushConstantRange;
-	VkPushConstantRange pushConstantRangeUniVar;
 
-	VkDescriptorPool descriptorPool;
-	VkDescriptorPool samplerDescriptorPool;
-	VkDescriptorPool inputDescriptorPool;
-	std::vector<VkDescriptorSet> descriptorSets;
+	std::unique_ptr<DescriptorLayoutCache> m_DescriptorLayoutCache;
+	std::unique_ptr<DescriptorAllocator> m_DescriptorAllocator; // Persistent sets (textures), per-frame sets live in FrameContext
 	std::vector<VkDescriptorSet> samplerDescriptorSets;
-	std::vector<VkDescriptorSet> inputDescriptorSets;
-
-	std::vector<VkBuffer> vpUniformBuffer;
-	std::vector<VkDeviceMemory> vpUniformBufferMemory;
 
 	// std::vector<VkBuffer> vpUniformBufferUniVar;
 	// std::vector<VkDeviceMemory> vpUniformBufferMemoryUniVar;
 
-	// std::vector<VkBuffer> modelDynUniformBuffer;
-	// std::vector<VkDeviceMemory> modelDynUniformBufferMemory;
-
-	// VkDeviceSize minUniformBufferOffset;
-	// size_t modelUniformAlignment;
-	// Model* modelTransferSpace;
+	VkDeviceSize minUniformBufferOffset;
+	size_t modelUniformAlignment;
 
 	// -- Assets
 	std::vector<VkImage> textureImages;
 	std::vector<VkDeviceMemory> textureImageMemory;
 	std::vector<VkImageView> textureImageViews;
+	// Render thread only. Models of one file share the MeshModel's meshes (the cache entries own the buffers),
+	// textures are shared by file name across models and files.
+	std::unordered_map<std::string, MeshModel> meshCache;   // Model file -> uploaded meshes
+	std::unordered_map<std::string, int> textureCache;      // Texture file -> sampler descriptor set index
+	AssetCacheStats assetCacheStats;
 
 	// -- Pipelines
-	VkPipeline graphicsPipeline;
-	VkPipelineLayout pipelineLayout;
-
-	VkPipeline secondPipeline;
-	VkPipelineLayout secondPipelineLayout;
+	// Shared references from the device's PipelineRegistry
+	std::array<PipelineRegistry::PipelineRef, OBJECT_DATA_PATH_COUNT> graphicsPipelines; // 1st subpass, one per ObjectDataPath, empty while compiling
+	std::array<PipelineRegistry::PipelineRequestRef, OBJECT_DATA_PATH_COUNT> graphicsPipelineRequests; // background compilations
+	// Depth pre-pass (depth only) and the geometry pass after it (depth test EQUAL, no depth writes), always compiled in the background
+	std::array<PipelineRegistry::PipelineRef, OBJECT_DATA_PATH_COUNT> depthPrepassPipelines;
+	std::array<PipelineRegistry::PipelineRequestRef, OBJECT_DATA_PATH_COUNT> depthPrepassPipelineRequests;
+	std::array<PipelineRegistry::PipelineRef, OBJECT_DATA_PATH_COUNT> depthEqualPipelines;
+	std::array<PipelineRegistry::PipelineRequestRef, OBJECT_DATA_PATH_COUNT> depthEqualPipelineRequests;
+	std::atomic<bool> depthPrepass{ false };
+	ObjectDataPath fallbackObjectDataPath = ObjectDataPath::StorageBuffer; // always has a pipeline
+	std::atomic<PipelineFallbackPolicy> pipelineFallbackPolicy{ PipelineFallbackPolicy::UseFallback };
+	std::atomic<uint32_t> pipelinesPending{ 0 };
+	PipelineRegistry::PipelineLayoutRef pipelineLayout;
+
+	// Specialization constants of the pipelines above
+	ShadingOptions shadingOptions;         // Active options, written by the render thread under shadingOptionsMutex
+	ShadingOptions pendingShadingOptions;
+	bool shadingOptionsPending = false;
+	std::mutex shadingOptionsMutex;
+
+	PipelineRegistry::PipelineRef secondPipeline;
+	PipelineRegistry::PipelineLayoutRef secondPipelineLayout;
 
 	// VkRenderPass renderPass;
 
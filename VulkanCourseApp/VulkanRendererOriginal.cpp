@@ -990,7 +990,7 @@ void VulkanRendererOriginal::createGraphicsPipeline()
 	pipelineCreateInfo.basePipelineIndex = -1; // or index of pipeline being created to derive from (in case creating multiple at once)
 
 	// Create Graphics Pipeline
-	result = vkCreateGraphicsPipelines(m_Device->device(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &graphicsPipeline);
+	result = vkCreateGraphicsPipelines(m_Device->device(), m_Device->pipelineCache(), 1, &pipelineCreateInfo, nullptr, &graphicsPipeline);
 	if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create a Graphics Pipeline (1st Subpass)!");
@@ -1048,7 +1048,7 @@ void VulkanRendererOriginal::createGraphicsPipeline()
 	pipelineCreateInfo.subpass = 1;                   // Use 2nd Subpass (starting at 0)
 
 	// Create second pipeline
-	result = vkCreateGraphicsPipelines(m_Device->device(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &secondPipeline);
+	result = vkCreateGraphicsPipelines(m_Device->device(), m_Device->pipelineCache(), 1, &pipelineCreateInfo, nullptr, &secondPipeline);
 	if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create a Graphics Pipeline (2nd Subpass)!");
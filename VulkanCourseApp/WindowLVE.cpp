@@ -17,19 +17,48 @@ float WindowLVE::s_MouseScrollOffsetX;
 float WindowLVE::s_MouseScrollOffsetY;
 
 
-WindowLVE::WindowLVE(uint32_t width, uint32_t height, std::string title)
-	: m_Width(width), m_Height(height), m_Title(title)
+WindowLVE::WindowLVE(uint32_t width, uint32_t height, std::string title, bool headless)
+	: m_Width(width), m_Height(height), m_Title(title), m_Headless(headless)
 {
 	initWindow();
 }
 
 WindowLVE::~WindowLVE()
 {
+	if (m_Headless) return;
+
 	// Destroy GLFW window and stop GLFW
 	glfwDestroyWindow(m_WindowHandle);
 	glfwTerminate();
 }
 
+void WindowLVE::requestClose()
+{
+	if (m_Headless)
+	{
+		m_CloseRequested = true;
+		return;
+	}
+
+	glfwSetWindowShouldClose(m_WindowHandle, GLFW_TRUE);
+}
+
+void WindowLVE::setExtent(uint32_t width, uint32_t height)
+{
+	if (!m_Headless)
+	{
+		// The framebuffer size callback reports the new extent
+		glfwSetWindowSize(m_WindowHandle, (int)width, (int)height);
+		return;
+	}
+
+	if (width == m_Width && height == m_Height) return;
+
+	m_Width = width;
+	m_Height = height;
+	m_FramebufferResized = true;
+}
+
 float WindowLVE::getChangeX()
 {
 	float theChange = 0.0f;
@@ -65,20 +94,25 @@ float WindowLVE::getMouseScrollOffsetY()
 void WindowLVE::framebufferResizeCallback(GLFWwindow* windowHandle, int width, int height)
 {
 	auto window = reinterpret_cast<WindowLVE*>(glfwGetWindowUserPointer(windowHandle));
-	window->m_FramebufferResized = true;
+	// Size first, the render thread reads the size once it sees the flag
 	window->m_Width = width;
 	window->m_Height = height;
+	window->m_FramebufferResized = true;
 }
 
 void WindowLVE::initWindow()
 {
-	glfwInit();
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
-
-	m_WindowHandle = glfwCreateWindow(m_Width, m_Height, m_Title.c_str(), nullptr, nullptr);
-	glfwSetWindowUserPointer(m_WindowHandle, this);
-	// glfwSetFramebufferSizeCallback(m_WindowHandle, framebufferResizeCallback);
+	// Headless runs need no display at all (CI, lavapipe), GLFW is never initialized
+	if (!m_Headless)
+	{
+		glfwInit();
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+
+		m_WindowHandle = glfwCreateWindow(m_Width, m_Height, m_Title.c_str(), nullptr, nullptr);
+		glfwSetWindowUserPointer(m_WindowHandle, this);
+		glfwSetFramebufferSizeCallback(m_WindowHandle, framebufferResizeCallback); // The renderer coalesces these events
+	}
 
 	// from MoravaEngine/src/Platform/Windows/WindowsWindow.cpp
 	for (size_t i = 0; i < 1024; i++) {
@@ -94,6 +128,10 @@ void WindowLVE::initWindow()
 
 void WindowLVE::createWindowSurface(VkInstance instance, VkSurfaceKHR* surface)
 {
+	if (m_Headless) {
+		throw std::runtime_error("No window surface in headless mode.");
+	}
+
 	if (glfwCreateWindowSurface(instance, m_WindowHandle, nullptr, surface) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create a window surface.");
 	}
@@ -3,6 +3,7 @@
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 
+#include <atomic>
 #include <cstdint>
 #include <string>
 
@@ -11,19 +12,24 @@ class WindowLVE
 {
 public:
 	WindowLVE() = default;
-	WindowLVE(uint32_t width, uint32_t height, std::string title);
+	// Headless: no GLFW and no window, the extent is only the size of the offscreen images rendered to
+	WindowLVE(uint32_t width, uint32_t height, std::string title, bool headless = false);
 	~WindowLVE();
 
 	WindowLVE(const WindowLVE&) = delete;
 
-	bool shouldClose() { return glfwWindowShouldClose(m_WindowHandle); }
-	VkExtent2D getExtent() { return { m_Width, m_Height }; }
+	bool shouldClose() { return m_Headless ? m_CloseRequested.load() : glfwWindowShouldClose(m_WindowHandle) != 0; }
+	void requestClose();
+	bool isHeadless() { return m_Headless; }
+	VkExtent2D getExtent() { return { m_Width.load(), m_Height.load() }; }
+	// Resizes the window, or when headless the offscreen images (recreated by the renderer at its next frame)
+	void setExtent(uint32_t width, uint32_t height);
 	bool wasWindowResized() { return m_FramebufferResized; }
 	void resetWindowResizedFlag() { m_FramebufferResized = false; }
 
 	void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
 
-	GLFWwindow* getHandle() { return m_WindowHandle; }
+	GLFWwindow* getHandle() { return m_WindowHandle; } // nullptr when headless
 
 	// from MoravaEngine/src/Platform/Windows/WindowsWindow.cpp
 	static bool* getKeys() { return s_Keys; };
@@ -40,11 +46,14 @@ private:
 	void initWindow();
 
 private:
-	uint32_t m_Width;
-	uint32_t m_Height;
-	bool m_FramebufferResized = false;
+	// Written by the GLFW callback on the main thread, read by the render thread
+	std::atomic<uint32_t> m_Width;
+	std::atomic<uint32_t> m_Height;
+	std::atomic<bool> m_FramebufferResized{ false };
 	std::string m_Title;
-	GLFWwindow* m_WindowHandle;
+	GLFWwindow* m_WindowHandle = nullptr;
+	bool m_Headless = false;
+	std::atomic<bool> m_CloseRequested{ false }; // Headless only, a window has its own close flag
 
 	static bool s_Keys[1024];
 	static bool s_Buttons[32];
@@ -5,76 +5,892 @@
 #include <GLFW/glfw3.h>
 
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 #include <vector>
 #include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
 
 #include "WindowLVE.h"
 #include "VulkanRenderer.h"
 #include "CameraController.h"
+#include "Input.h"
+#include "JobSystem.h"
+#include "CaptureWriter.h"
+#include "BatchRenderer.h"
+#include "Benchmark.h"
 
+std::shared_ptr<JobSystem> jobSystem;
 std::shared_ptr<WindowLVE> window;
 std::unique_ptr<VulkanRenderer> vulkanRenderer;
 
 std::shared_ptr<Camera> camera;
 std::unique_ptr<CameraController> cameraController;
+std::shared_ptr<CaptureWriter> captureWriter; // Created when capturing first starts
+CaptureWriter::Settings captureWriterSettings;
+bool captureAvailable = false;                // Interactive runs only
 
-void initWindow(std::string wName = "Vulkan Renderer", const int width = 1280, const int height = 720)
+void initWindow(std::string wName = "Vulkan Renderer", const int width = 1280, const int height = 720, bool headless = false)
 {
-	window = std::make_shared<WindowLVE>(width, height, wName);
+	window = std::make_shared<WindowLVE>(width, height, wName, headless);
 	camera = std::make_shared<Camera>(glm::vec3(0.0f, 10.0f, 40.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
 	cameraController = std::make_unique<CameraController>(camera, 1.778f, 4.0f, 0.1f);
 }
 
-int main()
+bool parseObjectDataPath(const char* name, ObjectDataPath* path)
 {
+	if (strcmp(name, "push") == 0)    { *path = ObjectDataPath::PushConstant;   return true; }
+	if (strcmp(name, "dynamic") == 0) { *path = ObjectDataPath::DynamicUniform; return true; }
+	if (strcmp(name, "storage") == 0) { *path = ObjectDataPath::StorageBuffer;  return true; }
+	return false;
+}
+
+bool parsePresentMode(const char* name, VkPresentModeKHR* mode)
+{
+	if (strcmp(name, "fifo") == 0)         { *mode = VK_PRESENT_MODE_FIFO_KHR;         return true; }
+	if (strcmp(name, "fifo-relaxed") == 0) { *mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR; return true; }
+	if (strcmp(name, "mailbox") == 0)      { *mode = VK_PRESENT_MODE_MAILBOX_KHR;      return true; }
+	if (strcmp(name, "immediate") == 0)    { *mode = VK_PRESENT_MODE_IMMEDIATE_KHR;    return true; }
+	return false;
+}
+
+// Latency hotkeys: F1 FIFO, F2 FIFO_RELAXED, F3 MAILBOX, F4 IMMEDIATE, F5 toggle just-in-time input
+void handleLatencyKeys(GLFWwindow* windowHandle)
+{
+	static bool keyWasDown[5] = {};
+	const KeyCode keys[5] = { Key::F1, Key::F2, Key::F3, Key::F4, Key::F5 };
+	const VkPresentModeKHR modes[4] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+
+	for (int i = 0; i < 5; i++)
+	{
+		bool keyDown = Input::IsKeyPressed(keys[i], windowHandle);
+		bool keyPressed = keyDown && !keyWasDown[i];
+		keyWasDown[i] = keyDown;
+
+		if (!keyPressed) continue;
+
+		LatencyPolicy policy = vulkanRenderer->getLatencyPolicy();
+		if (i < 4)
+		{
+			policy.presentMode = modes[i];
+		}
+		else
+		{
+			policy.justInTimeInput = !policy.justInTimeInput;
+		}
+		vulkanRenderer->setLatencyPolicy(policy);
+	}
+}
+
+// Shading hotkey: F6 toggles textured / vertex color shading (a different specialized pipeline variant)
+void handleShadingKeys(GLFWwindow* windowHandle)
+{
+	static bool keyWasDown = false;
+
+	bool keyDown = Input::IsKeyPressed(Key::F6, windowHandle);
+	bool keyPressed = keyDown && !keyWasDown;
+	keyWasDown = keyDown;
+
+	if (!keyPressed) return;
+
+	ShadingOptions options = vulkanRenderer->getShadingOptions();
+	options.textured = !options.textured;
+	vulkanRenderer->setShadingOptions(options);
+}
+
+// Dynamic resolution hotkey: F7 toggles it (off: full resolution, the frame goes back to one merged render pass)
+void handleResolutionKeys(GLFWwindow* windowHandle)
+{
+	static bool keyWasDown = false;
+
+	bool keyDown = Input::IsKeyPressed(Key::F7, windowHandle);
+	bool keyPressed = keyDown && !keyWasDown;
+	keyWasDown = keyDown;
+
+	if (!keyPressed) return;
+
+	DynamicResolution::Settings settings = vulkanRenderer->getDynamicResolution();
+	settings.enabled = !settings.enabled;
+	vulkanRenderer->setDynamicResolution(settings);
+}
+
+// Depth pre-pass hotkey: F8 toggles it, to compare the GPU frame time of a scene with and without
+void handleDepthPrepassKeys(GLFWwindow* windowHandle)
+{
+	static bool keyWasDown = false;
+
+	bool keyDown = Input::IsKeyPressed(Key::F8, windowHandle);
+	bool keyPressed = keyDown && !keyWasDown;
+	keyWasDown = keyDown;
+
+	if (!keyPressed) return;
+
+	vulkanRenderer->setDepthPrepass(!vulkanRenderer->getDepthPrepass());
+}
+
+// The writer's encoder threads and the renderer's frame readback (with copyable swapchain images) only exist once
+// capturing starts. Frames reach the writer through the readback worker. With the stall policy a full encoder queue
+// blocks that worker, the readback buffers fill up and the render thread waits for them: every frame is kept.
+void startCaptureWriter()
+{
+	captureWriter = std::make_shared<CaptureWriter>(captureWriterSettings);
+	std::shared_ptr<CaptureWriter> writer = captureWriter;
+	vulkanRenderer->setReadbackInterval(captureWriterSettings.interval);
+	vulkanRenderer->setReadbackWaitWhenFull(captureWriterSettings.overflowPolicy == CaptureWriter::OverflowPolicy::Stall);
+	vulkanRenderer->setReadbackEnabled(true);
+	vulkanRenderer->setFrameReadback([writer](const FrameReadback::Frame& frame) { writer->submit(frame); });
+}
+
+// Capture hotkey: F9 starts and stops writing frames (see --capture for the format and policy)
+void handleCaptureKeys(GLFWwindow* windowHandle)
+{
+	static bool keyWasDown = false;
+
+	bool keyDown = Input::IsKeyPressed(Key::F9, windowHandle);
+	bool keyPressed = keyDown && !keyWasDown;
+	keyWasDown = keyDown;
+
+	if (!keyPressed || !captureAvailable) return;
+
+	bool capturing = captureWriter == nullptr || !vulkanRenderer->isReadbackEnabled();
+	if (captureWriter == nullptr)
+	{
+		startCaptureWriter();
+	}
+	vulkanRenderer->setReadbackEnabled(capturing);
+	printf("Capture %s\n", capturing ? "started" : "stopped");
+
+	if (!capturing)
+	{
+		captureWriter->printStats();
+	}
+}
+
+// Render stall test: the render thread is stalled regularly, once per second the simulation tick rate
+// is printed next to the render frame rate. With the render thread the simulation keeps its rate.
+// The stall is injected from the renderer's input sampler, which runs on the render thread once per frame.
+struct RenderStallTest
+{
+	uint32_t seconds = 0; // 0 = off
+	uint32_t stallEveryFrames = 30;
+	uint32_t stallMs = 250;
+
+	uint64_t sampledFrames = 0; // Render thread only
+	bool started = false;
+	std::chrono::steady_clock::time_point lastReport;
+	uint64_t ticksAtReport = 0;
+	uint64_t framesAtReport = 0;
+	uint32_t reports = 0;
+	double simRateMin = 0.0;
+	double simRateMax = 0.0;
+	double simRateSum = 0.0;
+	double renderRateSum = 0.0;
+};
+
+// From the input sampler: sleeps stallMs after every stallEveryFrames frames
+void injectRenderStall(RenderStallTest& test)
+{
+	test.sampledFrames++;
+	if (test.sampledFrames % test.stallEveryFrames == 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(test.stallMs));
+	}
+}
+
+// Returns true once the test is over
+bool updateRenderStallTest(RenderStallTest& test, uint64_t simulationTicks, uint64_t renderedFrames)
+{
+	auto now = std::chrono::steady_clock::now();
+	if (!test.started)
+	{
+		test.started = true;
+		test.lastReport = now;
+		test.ticksAtReport = simulationTicks;
+		test.framesAtReport = renderedFrames;
+		return false;
+	}
+
+	double seconds = std::chrono::duration<double>(now - test.lastReport).count();
+	if (seconds < 1.0) return false;
+
+	double simRate = (simulationTicks - test.ticksAtReport) / seconds;
+	double renderRate = (renderedFrames - test.framesAtReport) / seconds;
+
+	test.simRateMin = test.reports == 0 ? simRate : std::min(test.simRateMin, simRate);
+	test.simRateMax = test.reports == 0 ? simRate : std::max(test.simRateMax, simRate);
+	test.simRateSum += simRate;
+	test.renderRateSum += renderRate;
+	test.reports++;
+
+	printf("Render stall test %2u/%u: simulation %7.1f ticks/s, render %7.1f frames/s\n", test.reports, test.seconds, simRate, renderRate);
+
+	test.lastReport = now;
+	test.ticksAtReport = simulationTicks;
+	test.framesAtReport = renderedFrames;
+
+	if (test.reports < test.seconds) return false;
+
+	printf("==== Render Stall Test (%u ms stall every %u frames) ====\n", test.stallMs, test.stallEveryFrames);
+	printf("  simulation   avg %7.1f ticks/s   min %7.1f   max %7.1f\n", test.simRateSum / test.reports, test.simRateMin, test.simRateMax);
+	printf("  render       avg %7.1f frames/s\n", test.renderRateSum / test.reports);
+	return true;
+}
+
+// Frame readback test: every frame is read back, frames must arrive in order. Runs on the readback worker,
+// the state is shared with the callback because the renderer outlives main's locals.
+void setReadbackTest(VulkanRenderer& renderer)
+{
+	struct ReadbackTest
+	{
+		uint64_t lastFrameIndex = 0;
+		uint64_t frames = 0;
+		uint64_t outOfOrder = 0;
+	};
+
+	auto test = std::make_shared<ReadbackTest>();
+
+	renderer.setFrameReadback([test](const FrameReadback::Frame& frame)
+	{
+		if (frame.frameIndex <= test->lastFrameIndex)
+		{
+			test->outOfOrder++;
+		}
+		test->lastFrameIndex = frame.frameIndex;
+		test->frames++;
+
+		if (test->frames % 120 != 1) return;
+
+		uint64_t sum[4] = {};
+		size_t pixelCount = (size_t)frame.width * frame.height;
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				sum[c] += frame.rgba[i * 4 + c];
+			}
+		}
+
+		printf("Readback test: frame %llu (%ux%u), mean RGBA %.1f %.1f %.1f %.1f, %llu frames, %llu out of order\n",
+			(unsigned long long)frame.frameIndex, frame.width, frame.height,
+			(double)sum[0] / pixelCount, (double)sum[1] / pixelCount, (double)sum[2] / pixelCount, (double)sum[3] / pixelCount,
+			(unsigned long long)test->frames, (unsigned long long)test->outOfOrder);
+	});
+}
+
+// Job system microbenchmark: fork/join overhead of empty jobs and parallel_for scaling, from 1 thread to all hardware threads
+void runJobSystemBenchmark()
+{
+	const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	const uint32_t forkJoinRounds = 100;
+	const uint32_t forkJoinJobs = 1000;
+	const uint32_t parallelForRounds = 20;
+	const uint32_t matrixCount = 100000;
+
+	std::vector<glm::mat4> matrices(matrixCount, glm::mat4(1.0f));
+	double baselineMs = 0.0;
+
+	printf("==== Job System Benchmark (1 - %u threads) ====\n", maxThreads);
+
+	for (uint32_t threads = 1; threads <= maxThreads; threads++)
+	{
+		JobSystem jobs(threads - 1);
+
+		// Fork/join: one root, many empty children, wait for the root
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t round = 0; round < forkJoinRounds; round++)
+		{
+			JobSystem::JobHandle root = jobs.createJob(nullptr);
+			for (uint32_t i = 0; i < forkJoinJobs; i++)
+			{
+				jobs.schedule([]() {}, root);
+			}
+			jobs.run(root);
+			jobs.wait(root);
+		}
+		double forkJoinUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / (forkJoinRounds * forkJoinJobs);
+
+		// Scaling: a fixed amount of transform math split with parallelFor
+		start = std::chrono::steady_clock::now();
+		for (uint32_t round = 0; round < parallelForRounds; round++)
+		{
+			jobs.parallelFor(matrixCount, 0, [&matrices](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					matrices[i] = glm::rotate(matrices[i], glm::radians(1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+					matrices[i] = glm::translate(matrices[i], glm::vec3(0.001f, 0.0f, 0.0f));
+				}
+			});
+		}
+		double parallelForMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / parallelForRounds;
+
+		if (threads == 1)
+		{
+			baselineMs = parallelForMs;
+		}
+
+		printf("  %2u threads   fork/join %7.3f us/job   parallel_for %8.3f ms   speedup %5.2fx\n",
+			threads, forkJoinUs, parallelForMs, parallelForMs > 0.0 ? baselineMs / parallelForMs : 0.0);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	// Command line options
+	// --object-data-path=push|dynamic|storage  select how model matrices reach the vertex shader
+	// --object-data-benchmark [frames]         run the A/B benchmark of all object data paths at startup
+	// --frames-in-flight=N                     frames the CPU may record ahead of the GPU (1-4, default 2)
+	// --present-mode=fifo|fifo-relaxed|mailbox|immediate
+	// --swapchain-images=N                     swapchain image count (default minimum + 1)
+	// --fps-cap=N                              frame-rate cap in frames per second
+	// --jit-input                              sample input right before recording, after waiting for the frame slot
+	// --resize-benchmark [count]               resize the window count times and report the hitch per resize
+	// --single-thread                          simulate and render on the main thread (no render thread)
+	// --sim-rate=N                             simulation ticks per second with the render thread (default 120)
+	// --render-stall-test [seconds]            stall the renderer regularly and report simulation vs render rate
+	// --job-threads=N                          job system threads including the main thread (default all hardware threads)
+	// --job-benchmark                          run the job system microbenchmark and exit
+	// --clear-pipeline-cache                   delete the on-disk pipeline cache first (cold pipeline creation)
+	// --pipeline-fallback=fallback|skip        draws whose pipeline still compiles use the fallback pipeline (default) or are skipped
+	// --recompile-shaders                      compile the GLSL shaders even if the SPIR-V cache (Shaders/cache/) has them
+	// --shading=textured|vertex-color          1st subpass shader variant (F6 toggles at runtime)
+	// --depth-split=F                          2nd subpass shows depth right of this fraction of the window (default 0.5)
+	// --depth-range=LOWER,UPPER                depth range shown from white to black (default 0.98,1.0)
+	// --dynamic-resolution [target-ms]         scale the scene resolution to keep the GPU frame time at the target (default 16.6, F7 toggles)
+	// --resolution-scale=MIN,MAX               bounds of the dynamic resolution scale (default 0.5,1.0)
+	// --depth-prepass                          draw depth only first, then shade with depth test EQUAL (F8 toggles)
+	// --headless[=WxH]                         no window: render to offscreen images (default 1366x768), e.g. on lavapipe
+	// --frames=N                               exit after N rendered frames
+	// --readback-test                          read every frame back to the CPU, check the frame order and print its mean color
+	// --capture[=png|qoi|y4m]                  capture frames from the start (default png), without it F9 starts and stops capturing
+	// --capture-path=PATH                      image directory or Y4M file (default Captures/ or capture.y4m)
+	// --capture-every=N                        capture every Nth rendered frame (default 1)
+	// --capture-threads=N                      encoder threads (default 2)
+	// --capture-queue=N                        frames waiting for an encoder (default 8)
+	// --capture-policy=drop|stall              encoders behind: drop frames (default) or slow the renderer down
+	// --batch=JOBLIST                          render the jobs of a job list headless to disk and exit (see BatchRenderer.h),
+	//                                          3 frames in flight unless --frames-in-flight is given
+	// --benchmark[=SCENE]                      draw a scripted scene with a fixed timestep and write a JSON report, then exit
+	//                                          (SCENE: job list, its first job; default the two cyborgs with a camera loop)
+	// --benchmark-frames=N                     measured frames (default the scene's frame count)
+	// --benchmark-warmup=N                     frames drawn before measuring (default 60)
+	// --benchmark-report=FILE                  report file (default benchmark.json)
+	ObjectDataPath objectDataPath = ObjectDataPath::StorageBuffer;
+	uint32_t framesInFlight = SwapChain::DEFAULT_FRAMES_IN_FLIGHT;
+	LatencyPolicy latencyPolicy;
+	bool runObjectDataBenchmark = false;
+	uint32_t resizeBenchmarkCount = 0;
+	uint32_t benchmarkFramesPerPath = 500;
+	bool useRenderThread = true;
+	float simulationRate = 120.0f;
+	RenderStallTest stallTest;
+	uint32_t jobWorkerCount = JobSystem::AUTO_WORKER_COUNT;
+	PipelineFallbackPolicy pipelineFallbackPolicy = PipelineFallbackPolicy::UseFallback;
+	ShadingOptions shadingOptions;
+	DynamicResolution::Settings dynamicResolution;
+	bool recompileShaders = false;
+	bool depthPrepass = false;
+	bool headless = false;
+	uint32_t windowWidth = 1366;
+	uint32_t windowHeight = 768;
+	uint64_t frameLimit = 0; // 0 = until closed
+	bool readbackTest = false;
+	CaptureWriter::Settings captureSettings;
+	bool captureAtStart = false;
+	std::string batchJobList;
+	bool framesInFlightSet = false;
+	bool runBenchmark = false;
+	Benchmark::Settings benchmarkSettings;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--object-data-path=", 19) == 0)
+		{
+			if (!parseObjectDataPath(argv[i] + 19, &objectDataPath))
+			{
+				std::cerr << "Unknown object data path: " << argv[i] + 19 << " (expected push, dynamic or storage)" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strncmp(argv[i], "--frames-in-flight=", 19) == 0)
+		{
+			framesInFlight = (uint32_t)atoi(argv[i] + 19);
+			framesInFlightSet = true;
+		}
+		else if (strncmp(argv[i], "--present-mode=", 15) == 0)
+		{
+			if (!parsePresentMode(argv[i] + 15, &latencyPolicy.presentMode))
+			{
+				std::cerr << "Unknown present mode: " << argv[i] + 15 << " (expected fifo, fifo-relaxed, mailbox or immediate)" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strncmp(argv[i], "--swapchain-images=", 19) == 0)
+		{
+			latencyPolicy.swapchainImageCount = (uint32_t)atoi(argv[i] + 19);
+		}
+		else if (strncmp(argv[i], "--fps-cap=", 10) == 0)
+		{
+			latencyPolicy.frameRateCap = (float)atof(argv[i] + 10);
+		}
+		else if (strcmp(argv[i], "--jit-input") == 0)
+		{
+			latencyPolicy.justInTimeInput = true;
+		}
+		else if (strcmp(argv[i], "--resize-benchmark") == 0)
+		{
+			resizeBenchmarkCount = 40;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				resizeBenchmarkCount = (uint32_t)atoi(argv[++i]);
+			}
+		}
+		else if (strcmp(argv[i], "--single-thread") == 0)
+		{
+			useRenderThread = false;
+		}
+		else if (strncmp(argv[i], "--sim-rate=", 11) == 0)
+		{
+			simulationRate = std::max((float)atof(argv[i] + 11), 1.0f);
+		}
+		else if (strcmp(argv[i], "--render-stall-test") == 0)
+		{
+			stallTest.seconds = 10;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				stallTest.seconds = (uint32_t)atoi(argv[++i]);
+			}
+		}
+		else if (strncmp(argv[i], "--job-threads=", 14) == 0)
+		{
+			jobWorkerCount = (uint32_t)std::max(atoi(argv[i] + 14), 1) - 1;
+		}
+		else if (strcmp(argv[i], "--clear-pipeline-cache") == 0)
+		{
+			std::remove(DeviceLVE::pipelineCacheFile());
+		}
+		else if (strncmp(argv[i], "--pipeline-fallback=", 20) == 0)
+		{
+			if (strcmp(argv[i] + 20, "fallback") == 0)
+			{
+				pipelineFallbackPolicy = PipelineFallbackPolicy::UseFallback;
+			}
+			else if (strcmp(argv[i] + 20, "skip") == 0)
+			{
+				pipelineFallbackPolicy = PipelineFallbackPolicy::SkipDraws;
+			}
+			else
+			{
+				std::cerr << "Unknown pipeline fallback policy: " << argv[i] + 20 << " (expected fallback or skip)" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strcmp(argv[i], "--recompile-shaders") == 0)
+		{
+			recompileShaders = true;
+		}
+		else if (strncmp(argv[i], "--shading=", 10) == 0)
+		{
+			if (strcmp(argv[i] + 10, "textured") == 0)
+			{
+				shadingOptions.textured = true;
+			}
+			else if (strcmp(argv[i] + 10, "vertex-color") == 0)
+			{
+				shadingOptions.textured = false;
+			}
+			else
+			{
+				std::cerr << "Unknown shading: " << argv[i] + 10 << " (expected textured or vertex-color)" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strncmp(argv[i], "--depth-split=", 14) == 0)
+		{
+			shadingOptions.splitFraction = (float)atof(argv[i] + 14);
+		}
+		else if (strncmp(argv[i], "--depth-range=", 14) == 0)
+		{
+			if (sscanf(argv[i] + 14, "%f,%f", &shadingOptions.depthLowerBound, &shadingOptions.depthUpperBound) != 2 ||
+				shadingOptions.depthUpperBound <= shadingOptions.depthLowerBound)
+			{
+				std::cerr << "Invalid depth range: " << argv[i] + 14 << " (expected LOWER,UPPER with LOWER < UPPER)" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strcmp(argv[i], "--dynamic-resolution") == 0)
+		{
+			dynamicResolution.enabled = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				dynamicResolution.targetMs = atof(argv[++i]);
+			}
+		}
+		else if (strncmp(argv[i], "--resolution-scale=", 19) == 0)
+		{
+			if (sscanf(argv[i] + 19, "%f,%f", &dynamicResolution.minScale, &dynamicResolution.maxScale) != 2 ||
+				dynamicResolution.minScale <= 0.0f || dynamicResolution.maxScale < dynamicResolution.minScale)
+			{
+				std::cerr << "Invalid resolution scale: " << argv[i] + 19 << " (expected MIN,MAX with 0 < MIN <= MAX)" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strcmp(argv[i], "--depth-prepass") == 0)
+		{
+			depthPrepass = true;
+		}
+		else if (strncmp(argv[i], "--headless", 10) == 0 && (argv[i][10] == '\0' || argv[i][10] == '='))
+		{
+			headless = true;
+			if (argv[i][10] == '=' &&
+				(sscanf(argv[i] + 11, "%ux%u", &windowWidth, &windowHeight) != 2 || windowWidth == 0 || windowHeight == 0))
+			{
+				std::cerr << "Invalid headless size: " << argv[i] + 11 << " (expected WxH)" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strncmp(argv[i], "--frames=", 9) == 0)
+		{
+			frameLimit = (uint64_t)std::max(atoi(argv[i] + 9), 0);
+		}
+		else if (strcmp(argv[i], "--readback-test") == 0)
+		{
+			readbackTest = true;
+		}
+		else if (strncmp(argv[i], "--capture", 9) == 0 && (argv[i][9] == '\0' || argv[i][9] == '='))
+		{
+			captureAtStart = true;
+			if (argv[i][9] == '=' && !CaptureWriter::parseFormat(argv[i] + 10, &captureSettings.format))
+			{
+				std::cerr << "Unknown capture format: " << argv[i] + 10 << " (expected png, qoi or y4m)" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strncmp(argv[i], "--capture-path=", 15) == 0)
+		{
+			captureSettings.path = argv[i] + 15;
+		}
+		else if (strncmp(argv[i], "--capture-every=", 16) == 0)
+		{
+			captureSettings.interval = (uint32_t)std::max(atoi(argv[i] + 16), 1);
+		}
+		else if (strncmp(argv[i], "--capture-threads=", 18) == 0)
+		{
+			captureSettings.workerCount = (uint32_t)std::max(atoi(argv[i] + 18), 1);
+		}
+		else if (strncmp(argv[i], "--capture-queue=", 16) == 0)
+		{
+			captureSettings.queueCapacity = (uint32_t)std::max(atoi(argv[i] + 16), 1);
+		}
+		else if (strncmp(argv[i], "--capture-policy=", 17) == 0)
+		{
+			if (strcmp(argv[i] + 17, "drop") == 0)
+			{
+				captureSettings.overflowPolicy = CaptureWriter::OverflowPolicy::Drop;
+			}
+			else if (strcmp(argv[i] + 17, "stall") == 0)
+			{
+				captureSettings.overflowPolicy = CaptureWriter::OverflowPolicy::Stall;
+			}
+			else
+			{
+				std::cerr << "Unknown capture policy: " << argv[i] + 17 << " (expected drop or stall)" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strncmp(argv[i], "--batch=", 8) == 0)
+		{
+			batchJobList = argv[i] + 8;
+		}
+		else if (strncmp(argv[i], "--benchmark-frames=", 19) == 0)
+		{
+			benchmarkSettings.measuredFrames = (uint32_t)atoi(argv[i] + 19);
+		}
+		else if (strncmp(argv[i], "--benchmark-warmup=", 19) == 0)
+		{
+			benchmarkSettings.warmupFrames = (uint32_t)atoi(argv[i] + 19);
+		}
+		else if (strncmp(argv[i], "--benchmark-report=", 19) == 0)
+		{
+			benchmarkSettings.reportFile = argv[i] + 19;
+		}
+		else if (strncmp(argv[i], "--benchmark", 11) == 0 && (argv[i][11] == '\0' || argv[i][11] == '='))
+		{
+			runBenchmark = true;
+			if (argv[i][11] == '=')
+			{
+				benchmarkSettings.sceneFile = argv[i] + 12;
+			}
+		}
+		else if (strcmp(argv[i], "--job-benchmark") == 0)
+		{
+			runJobSystemBenchmark();
+			return EXIT_SUCCESS;
+		}
+		else if (strcmp(argv[i], "--object-data-benchmark") == 0)
+		{
+			runObjectDataBenchmark = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				benchmarkFramesPerPath = (uint32_t)atoi(argv[++i]);
+			}
+		}
+	}
+
+	// Batch: headless, the main thread draws every job frame itself
+	std::vector<BatchRenderer::Job> batchJobs;
+	if (!batchJobList.empty())
+	{
+		if (!BatchRenderer::loadJobList(batchJobList, &batchJobs))
+		{
+			return EXIT_FAILURE;
+		}
+
+		headless = true;
+		useRenderThread = false;
+		windowWidth = batchJobs[0].width;
+		windowHeight = batchJobs[0].height;
+		if (!framesInFlightSet)
+		{
+			framesInFlight = 3; // GPU, readback and encoders overlap on consecutive frames
+		}
+	}
+
+	// Benchmark: the main thread draws the scripted scene, windowed or headless
+	BatchRenderer::Job benchmarkScene;
+	if (runBenchmark)
+	{
+		if (!batchJobs.empty())
+		{
+			std::cerr << "--benchmark and --batch can not be combined" << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (!Benchmark::loadScene(benchmarkSettings, &benchmarkScene))
+		{
+			return EXIT_FAILURE;
+		}
+
+		useRenderThread = false;
+		windowWidth = benchmarkScene.width;
+		windowHeight = benchmarkScene.height;
+	}
+
+	// Created on the main thread, which makes it the job system's main thread lane
+	jobSystem = std::make_shared<JobSystem>(jobWorkerCount);
+
 	// Create Window
-	initWindow("Vulkan Renderer", 1366, 768);
+	initWindow("Vulkan Renderer", windowWidth, windowHeight, headless);
+
+	vulkanRenderer = std::make_unique<VulkanRenderer>(window, jobSystem);
+	vulkanRenderer->setFramesInFlight(framesInFlight);
+	vulkanRenderer->setLatencyPolicy(latencyPolicy);
+	vulkanRenderer->setPipelineFallbackPolicy(pipelineFallbackPolicy);
+	vulkanRenderer->setShadingOptions(shadingOptions);
+	vulkanRenderer->setDynamicResolution(dynamicResolution);
+	vulkanRenderer->setDepthPrepass(depthPrepass);
+	vulkanRenderer->setRecompileShaders(recompileShaders);
 
-	vulkanRenderer = std::make_unique<VulkanRenderer>(window);
+	std::unique_ptr<BatchRenderer> batchRenderer;
+	if (!batchJobs.empty())
+	{
+		batchRenderer = std::make_unique<BatchRenderer>(*vulkanRenderer, window, camera, batchJobs, captureSettings);
+	}
+	else if (readbackTest)
+	{
+		setReadbackTest(*vulkanRenderer);
+	}
+	else if (runBenchmark)
+	{
+		// No readback: nothing but the scene is measured
+	}
+	else
+	{
+		// Nothing is set up for capturing until it starts, from the beginning (--capture) or with F9
+		captureAvailable = true;
+		captureWriterSettings = captureSettings;
+		if (captureAtStart)
+		{
+			startCaptureWriter();
+		}
+	}
 
 	if (vulkanRenderer->init() == EXIT_FAILURE)
 	{
 		return EXIT_FAILURE;
 	}
 
+	if (batchRenderer != nullptr)
+	{
+		vulkanRenderer->setObjectDataPath(objectDataPath);
+		return batchRenderer->run() ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (runBenchmark)
+	{
+		vulkanRenderer->setObjectDataPath(objectDataPath);
+		Benchmark benchmark(*vulkanRenderer, window, camera, benchmarkScene, benchmarkSettings);
+		return benchmark.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	float angle = 0.0f;
 	float deltaTime = 0.0f;
 	float lastTime = 0.0f;
 
-	int meshId1 = vulkanRenderer->createMeshModel("Models/cyborg.obj");
-	int meshId2 = vulkanRenderer->createMeshModel("Models/cyborg.obj");
+	// Both files are parsed in parallel by the job system
+	std::vector<int> meshIds;
+	meshIds.push_back(vulkanRenderer->createMeshModel("Models/cyborg.obj"));
+	meshIds.push_back(vulkanRenderer->createMeshModel("Models/cyborg.obj"));
 
-	// Loop until closed
-	while (!window->shouldClose())
+	const std::vector<glm::vec3> meshPositions = { glm::vec3(-9.5f, 0.0f, 0.0f), glm::vec3(9.5f, 0.0f, 0.0f) };
+	std::vector<glm::mat4> modelMats(meshIds.size());
+
+	vulkanRenderer->setObjectDataPath(objectDataPath);
+
+	if (runObjectDataBenchmark)
 	{
-		glfwPollEvents();
+		vulkanRenderer->startObjectDataBenchmark(benchmarkFramesPerPath);
+	}
+
+	if (resizeBenchmarkCount > 0)
+	{
+		vulkanRenderer->startResizeBenchmark(resizeBenchmarkCount);
+	}
 
-		float now = (float)glfwGetTime();
+	uint64_t simulationTicks = 0;
+
+	// Not glfwGetTime, GLFW is not initialized when headless
+	auto startTime = std::chrono::steady_clock::now();
+
+	// One simulation tick: input, camera and model transforms, published to the renderer as a snapshot
+	auto simulate = [&]()
+	{
+		float now = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
 		deltaTime = now - lastTime;
 		lastTime = now;
 
 		angle += 20.0f * deltaTime;
 		if (angle > 360.0f) { angle -= 360.0f; }
 
-		glm::mat4 modelMat1(1.0f);
-		modelMat1 = glm::translate(modelMat1, glm::vec3(-9.5f, 0.0f, 0.0f));
-		modelMat1 = glm::rotate(modelMat1, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-		modelMat1 = glm::scale(modelMat1, glm::vec3(5.0f));
-
-		glm::mat4 modelMat2(1.0f);
-		modelMat2 = glm::translate(modelMat2, glm::vec3( 9.5f, 0.0f, 0.0f));
-		modelMat2 = glm::rotate(modelMat2, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-		modelMat2 = glm::scale(modelMat2, glm::vec3(5.0f));
+		// Transforms are computed in parallel, each job writes its own entries
+		jobSystem->parallelFor((uint32_t)meshIds.size(), 0, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				glm::mat4 modelMat(1.0f);
+				modelMat = glm::translate(modelMat, meshPositions[i]);
+				modelMat = glm::rotate(modelMat, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+				modelMat = glm::scale(modelMat, glm::vec3(5.0f));
+				modelMats[i] = modelMat;
+			}
+		});
 
-		vulkanRenderer->updateModel(meshId1, modelMat1);
-		vulkanRenderer->updateModel(meshId2, modelMat2);
+		// The producer snapshot is written by the simulation thread only
+		for (size_t i = 0; i < meshIds.size(); i++)
+		{
+			vulkanRenderer->updateModel(meshIds[i], modelMats[i]);
+		}
 
 		camera->OnUpdate(deltaTime);
-		cameraController->Update(deltaTime, window->getHandle());
+		if (!headless)
+		{
+			cameraController->Update(deltaTime, window->getHandle());
+		}
 		vulkanRenderer->update(deltaTime, camera);
 
-		vulkanRenderer->draw();
+		vulkanRenderer->publishSnapshot();
+		simulationTicks++;
+	};
+
+	// Window events are polled once per loop iteration: by the input sampler when single threaded (so just-in-time
+	// input sees the newest events), otherwise by the loop
+	bool eventsPolled = false;
+	auto pollEvents = [&]()
+	{
+		if (!headless && !eventsPolled)
+		{
+			glfwPollEvents();
+		}
+		eventsPolled = true;
+	};
+
+	if (!useRenderThread)
+	{
+		// Single threaded: called by the renderer either before waiting for the frame slot
+		// or, with just-in-time input, right before recording
+		vulkanRenderer->setInputSampler([&]()
+		{
+			pollEvents();
+			simulate();
+			if (stallTest.seconds > 0)
+			{
+				injectRenderStall(stallTest);
+			}
+		});
+	}
+	else
+	{
+		// The simulation runs on this thread, the sampler only stalls the render thread
+		if (stallTest.seconds > 0)
+		{
+			vulkanRenderer->setInputSampler([&]() { injectRenderStall(stallTest); });
+		}
+		vulkanRenderer->startRenderThread();
+	}
+
+	auto tickPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / simulationRate));
+	auto nextTick = std::chrono::steady_clock::now();
+
+	// Loop until closed
+	while (!window->shouldClose() && !vulkanRenderer->hasRenderThreadFailed())
+	{
+		if (!useRenderThread)
+		{
+			vulkanRenderer->draw();
+		}
+
+		// Single threaded the input sampler has polled already, unless the renderer skipped the frame before sampling
+		pollEvents();
+		eventsPolled = false;
+
+		if (!headless)
+		{
+			handleLatencyKeys(window->getHandle());
+			handleShadingKeys(window->getHandle());
+			handleResolutionKeys(window->getHandle());
+			handleDepthPrepassKeys(window->getHandle());
+			handleCaptureKeys(window->getHandle());
+		}
+		jobSystem->processMainThreadJobs();
+
+		if (useRenderThread)
+		{
+			// The simulation runs at its own fixed rate, whatever the render thread is doing
+			simulate();
+
+			nextTick += tickPeriod;
+			auto now = std::chrono::steady_clock::now();
+			if (nextTick < now - tickPeriod)
+			{
+				nextTick = now; // fell behind (debugger, window drag), do not try to catch up
+			}
+			std::this_thread::sleep_until(nextTick);
+		}
+
+		if (stallTest.seconds > 0 && updateRenderStallTest(stallTest, simulationTicks, vulkanRenderer->getRenderedFrameCount()))
+		{
+			window->requestClose();
+		}
+
+		if (frameLimit > 0 && vulkanRenderer->getRenderedFrameCount() >= frameLimit)
+		{
+			window->requestClose();
+		}
 	}
 
+	vulkanRenderer->stopRenderThread();
+
 	return EXIT_SUCCESS;
 }